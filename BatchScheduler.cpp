@@ -0,0 +1,131 @@
+#include "BatchScheduler.h"
+#include "BoundedQueue.h"
+#include "SeamMemory.h"
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Pin the calling worker of pool to its own CPU, once per thread
+void pinWorker(const ThreadPool& pool) {
+    thread_local const ThreadPool* pinnedFor = nullptr;
+    if (pinnedFor == &pool || !pool.onWorker()) return;
+    pinnedFor = &pool;  // a failed pin is not retried
+    pinThreadToCpu(static_cast<unsigned>(pool.workerIndex()));
+}
+
+// Byte budget shared by the jobs in flight
+class ByteBudget {
+public:
+    explicit ByteBudget(size_t limit) : limit(limit) {}
+
+    void acquire(size_t bytes) {
+        std::unique_lock<std::mutex> lock(mutex);
+        // An oversized job waits for an empty pipeline instead of forever
+        freed.wait(lock, [&] { return inFlight == 0 || inFlight + bytes <= limit; });
+        inFlight += bytes;
+    }
+
+    void release(size_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlight -= bytes;
+        }
+        freed.notify_all();
+    }
+
+private:
+    size_t limit;
+    size_t inFlight = 0;
+    std::mutex mutex;
+    std::condition_variable freed;
+};
+
+struct Carved {
+    size_t index;
+    cv::Mat result;
+    size_t bytes;
+};
+
+} // namespace
+
+size_t BatchScheduler::defaultWorkingSet(const cv::Mat& decoded) {
+    return workingSet(decoded.size(), decoded.elemSize());
+}
+
+size_t BatchScheduler::workingSet(cv::Size size, size_t elemSize) {
+    const size_t pixels = static_cast<size_t>(size.width) * static_cast<size_t>(size.height);
+    return pixels * (2 * elemSize + 1 + 2 * sizeof(double));
+}
+
+void BatchScheduler::run(size_t count, const DecodeFn& decode, const CarveFn& carve,
+                         const EncodeFn& encode, const FailFn& fail, const CostFn& cost) {
+    ByteBudget budget(opts.memoryBudget);
+    BoundedQueue<Carved> results;  // bounded by the budget
+
+    auto failSafely = [&](size_t index, const char* what) {
+        try { fail(index, what); } catch (...) {}
+    };
+
+    auto write = [&] {
+        Carved item;
+        while (results.pop(item)) {
+            try {
+                encode(item.index, item.result);
+            }
+            catch (const std::exception& e) {
+                failSafely(item.index, e.what());
+            }
+            item.result.release();
+            budget.release(item.bytes);
+        }
+    };
+    std::vector<std::thread> writers;
+    for (unsigned k = 0; k < std::max(1u, opts.encoders); k++) writers.emplace_back(write);
+
+    {
+        std::unique_ptr<ThreadPool> own;
+        ThreadPool* pool = opts.pool.get();
+        if (!pool) {
+            own = std::make_unique<ThreadPool>(opts.workers);
+            pool = own.get();
+        }
+        std::vector<std::future<void>> jobs;
+        for (size_t i = 0; i < count; i++) {
+            cv::Mat decoded;
+            size_t bytes = 0;
+            try {
+                decoded = decode(i);
+                bytes = cost(decoded);
+            }
+            catch (const std::exception& e) {
+                failSafely(i, e.what());
+                continue;
+            }
+
+            budget.acquire(bytes);
+            jobs.push_back(pool->submit([&, i, bytes, decoded]() mutable {
+                if (opts.pinWorkers) pinWorker(*pool);
+                try {
+                    cv::Mat result = carve(i, decoded);
+                    decoded.release();
+                    results.push({ i, result, bytes });
+                }
+                catch (const std::exception& e) {
+                    decoded.release();
+                    failSafely(i, e.what());
+                    budget.release(bytes);
+                }
+            }));
+        }
+        for (std::future<void>& job : jobs) job.wait();
+    }
+
+    results.close();
+    for (std::thread& w : writers) w.join();
+}
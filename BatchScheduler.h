@@ -0,0 +1,76 @@
+#ifndef BATCH_SCHEDULER_H
+#define BATCH_SCHEDULER_H
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+class ThreadPool;
+
+/**
+ * @brief Runs many independent decode -> carve -> encode jobs.
+ *
+ * One reader thread decodes jobs in order, a fixed pool of workers carves
+ * them and Options::encoders writer threads encode the results, so I/O
+ * overlaps with carving and encodes (slow for large PNGs) with each
+ * other. A job is admitted to the pool only while the estimated working
+ * set of all jobs in flight fits the memory budget (a single job larger
+ * than the budget still runs, alone). Its bytes are released once its
+ * result has been encoded.
+ *
+ * With Options::pool the jobs run on that pool rather than on a pool of the
+ * scheduler's own. Carvers given the same pool (setThreadPool) then
+ * split a big image's kernels over the workers left idle by the small
+ * images, instead of leaving them idle until the big image is done.
+ *
+ * With Options::pinWorkers each pool worker is pinned to a CPU before its
+ * first job, so the scratch memory its carvers first touch (or place with
+ * BufferPlacement::kLocalNode) stays on that CPU's NUMA node.
+ */
+class BatchScheduler {
+public:
+    struct Options {
+        unsigned workers = 1;               // carving threads
+        size_t memoryBudget = size_t(1) << 30;  // bytes across jobs in flight
+        std::shared_ptr<ThreadPool> pool;   // carve here instead; workers unused
+        unsigned encoders = 1;              // writer threads, at least one
+        bool pinWorkers = false;            // pin each pool worker to a CPU of its own
+    };
+
+    // Stage callbacks, all given the job index. Any exception fails the job
+    // through the failure callback; the other jobs carry on.
+    typedef std::function<cv::Mat(size_t)> DecodeFn;                      // reader thread
+    typedef std::function<cv::Mat(size_t, cv::Mat&)> CarveFn;             // worker threads
+    typedef std::function<void(size_t, const cv::Mat&)> EncodeFn;         // writer threads
+    typedef std::function<void(size_t, const std::string&)> FailFn;       // any thread
+    typedef std::function<size_t(const cv::Mat&)> CostFn;                 // reader thread
+
+    explicit BatchScheduler(const Options& options) : opts(options) {}
+
+    /**
+     * @brief Estimated peak bytes to carve an image: the image and its
+     * result, the gray plane, and a 64-bit energy map and DP table.
+     */
+    static size_t defaultWorkingSet(const cv::Mat& decoded);
+
+    /**
+     * @brief defaultWorkingSet of an image not decoded yet, of the given
+     * size and bytes per pixel.
+     */
+    static size_t workingSet(cv::Size size, size_t elemSize);
+
+    /**
+     * @brief Run jobs 0..count-1 through the three stages and return when
+     * all of them have been encoded or failed.
+     */
+    void run(size_t count, const DecodeFn& decode, const CarveFn& carve,
+             const EncodeFn& encode, const FailFn& fail,
+             const CostFn& cost = defaultWorkingSet);
+
+private:
+    Options opts;
+};
+
+#endif // BATCH_SCHEDULER_H
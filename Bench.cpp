@@ -0,0 +1,416 @@
+#include "BenchCorpus.h"
+#include "BenchPareto.h"
+#include "SeamCarver.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+
+// ============================================================================
+// seam_bench: Google Benchmark microbenchmarks of the seam carving hot paths
+// and end-to-end resizes on synthetic images.
+//
+//   seam_bench --benchmark_filter=DP/1920       one method and size
+//   seam_bench --benchmark_filter=Resize/.*/256  the quick end-to-end runs
+//   seam_bench --benchmark_out=bench.json --benchmark_out_format=json
+//   seam_bench --benchmark_filter=Profile/checkerboard  pathological input
+//   seam_bench --benchmark_filter=Remove.*Seam/     interleaved vs planar removal
+//   seam_bench --corpus-out corpus --corpus-sizes 512x512,3840x2160
+//                                                write the images and exit
+//   seam_bench --pareto-out pareto.csv --corpus-sizes 512x512
+//                                                speed vs quality sweep, then exit
+//
+// The images are synthetic (BenchCorpus.h). The Profile/ benchmarks run
+// the seam finders and a resize on every content profile at
+// --corpus-sizes (default 512x512 and 1920x1080); --corpus-seed varies
+// their pixels.
+//
+// --pareto-out carves every profile at --corpus-sizes to three quarters
+// of the width with each of a sweep of methods, precisions, DP batch sizes
+// and pyramid settings (BenchPareto.h; best of --pareto-repeats runs, default
+// 1). Each gets its removed source energy relative to exact DP and an
+// artifact score of the new edges across its seam joins; the table and CSV
+// mark every image's Pareto front of time against both scores.
+//
+// Every benchmark reports pixels/s of the plane it works on; seam finders,
+// removals and resizes also report seams/s. The 4K and 8K resizes take
+// minutes, so filter them out when comparing small changes.
+//
+// Resizes also report allocs/seam: heap allocations of the whole resize per
+// seam carved (each cv::Mat buffer counts once, through its UMatData). The
+// seam loop itself should not allocate, so this is the setup spread over
+// the seams.
+// ============================================================================
+
+namespace {
+
+std::atomic<size_t> heapAllocations{ 0 };
+
+uint32_t corpusSeed = 0;  // --corpus-seed
+
+// Images are built once per profile and size, outside the timed loops.
+// The size-only benchmarks use the mixed profile.
+const cv::Mat& image(int width, int height, CorpusProfile profile = CorpusProfile::Mixed) {
+    static std::map<std::tuple<int, int, int>, cv::Mat> images;
+    cv::Mat& img = images[std::make_tuple(static_cast<int>(profile), width, height)];
+    if (img.empty()) img = makeCorpusImage(profile, width, height, corpusSeed);
+    return img;
+}
+
+void setRates(benchmark::State& state, double pixels, double seams) {
+    state.counters["pixels/s"] = benchmark::Counter(pixels, benchmark::Counter::kIsIterationInvariantRate);
+    if (seams > 0) {
+        state.counters["seams/s"] = benchmark::Counter(seams, benchmark::Counter::kIsIterationInvariantRate);
+    }
+}
+
+void BM_CalculateEnergy(benchmark::State& state) {
+    const cv::Mat& img = image(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+    SeamCarver carver(img);
+    for (auto _ : state) {
+        cv::Mat energy = carver.calculateEnergy(img);
+        benchmark::DoNotOptimize(energy.data);
+    }
+    setRates(state, static_cast<double>(img.total()), 0);
+}
+
+// One seam from a precomputed energy map
+template <std::vector<int> (SeamCarver::*Find)(const cv::Mat&)>
+void BM_FindSeam(benchmark::State& state) {
+    const cv::Mat& img = image(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+    SeamCarver carver(img);
+    cv::Mat energy = carver.calculateEnergy(img);
+    for (auto _ : state) {
+        std::vector<int> seam = (carver.*Find)(energy);
+        benchmark::DoNotOptimize(seam.data());
+    }
+    setRates(state, static_cast<double>(img.total()), 1);
+}
+
+template <bool Vertical>
+void BM_RemoveSeam(benchmark::State& state) {
+    const cv::Mat& img = image(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+    SeamCarver carver(img);
+    cv::Mat energy = carver.calculateEnergy(img);
+    std::vector<int> seam = Vertical ? carver.findVerticalSeamDP(energy) : carver.findHorizontalSeamDP(energy);
+    for (auto _ : state) {
+        cv::Mat carved = Vertical ? carver.removeVerticalSeam(img, seam) : carver.removeHorizontalSeam(img, seam);
+        benchmark::DoNotOptimize(carved.data);
+    }
+    setRates(state, static_cast<double>(img.total()), 1);
+}
+
+// The same seam removed from the B, G and R planes of the image apart, as
+// a planar (SoA) working image would carve it; compare with RemoveSeam
+template <bool Vertical>
+void BM_RemoveSeamPlanar(benchmark::State& state) {
+    const cv::Mat& img = image(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+    SeamCarver carver(img);
+    cv::Mat energy = carver.calculateEnergy(img);
+    std::vector<int> seam = Vertical ? carver.findVerticalSeamDP(energy) : carver.findHorizontalSeamDP(energy);
+    std::vector<cv::Mat> planes;
+    cv::split(img, planes);
+    for (auto _ : state) {
+        for (const cv::Mat& plane : planes) {
+            cv::Mat carved = Vertical ? carver.removeVerticalSeam(plane, seam)
+                                      : carver.removeHorizontalSeam(plane, seam);
+            benchmark::DoNotOptimize(carved.data);
+        }
+    }
+    setRates(state, static_cast<double>(img.total()), 1);
+}
+
+// k = range(2) disjoint DP seams removed in one compaction pass
+template <bool Vertical>
+void BM_RemoveSeams(benchmark::State& state) {
+    const cv::Mat& img = image(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+    const int k = static_cast<int>(state.range(2));
+    SeamCarver carver(img);
+    cv::Mat energy = carver.calculateEnergy(img);
+    std::vector<std::vector<int>> seams = Vertical ? carver.findVerticalSeamsDP(energy, k)
+                                                   : carver.findHorizontalSeamsDP(energy, k);
+    for (auto _ : state) {
+        cv::Mat carved = Vertical ? carver.removeVerticalSeams(img, seams) : carver.removeHorizontalSeams(img, seams);
+        benchmark::DoNotOptimize(carved.data);
+    }
+    setRates(state, static_cast<double>(img.total()), static_cast<double>(seams.size()));
+}
+
+// range(2) = target size in percent of each dimension, range(3) = 1 for
+// both dimensions, 0 for the width only
+template <SeamStrategy Strategy>
+void BM_Resize(benchmark::State& state) {
+    const int width = static_cast<int>(state.range(0));
+    const int height = static_cast<int>(state.range(1));
+    const cv::Mat& img = image(width, height);
+    const int targetWidth = static_cast<int>(width * state.range(2) / 100);
+    const int targetHeight = state.range(3) ? static_cast<int>(height * state.range(2) / 100) : height;
+    const int seams = (width - targetWidth) + (height - targetHeight);
+    size_t allocations = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        SeamCarver carver(img);
+        state.ResumeTiming();
+        const size_t before = heapAllocations.load(std::memory_order_relaxed);
+        cv::Mat out = carver.resize(carver.resizeOptions(targetWidth, targetHeight, Strategy));
+        allocations += heapAllocations.load(std::memory_order_relaxed) - before;
+        benchmark::DoNotOptimize(out.data);
+    }
+    setRates(state, static_cast<double>(img.total()), seams);
+    state.counters["allocs/seam"] = benchmark::Counter(static_cast<double>(allocations) / std::max(seams, 1),
+                                                       benchmark::Counter::kAvgIterations);
+}
+
+// Resize/DP to 75% of the width with range(2) seams per compaction of the
+// colour image (SeamCarver::setLazyRemoval, 0: every seam)
+void BM_ResizeLazy(benchmark::State& state) {
+    const int width = static_cast<int>(state.range(0));
+    const int height = static_cast<int>(state.range(1));
+    const cv::Mat& img = image(width, height);
+    const int targetWidth = width * 3 / 4;
+    for (auto _ : state) {
+        state.PauseTiming();
+        SeamCarver carver(img);
+        carver.setLazyRemoval(static_cast<int>(state.range(2)));
+        state.ResumeTiming();
+        cv::Mat out = carver.resize(carver.resizeOptions(targetWidth, height, SeamStrategy::DP));
+        benchmark::DoNotOptimize(out.data);
+    }
+    setRates(state, static_cast<double>(img.total()), width - targetWidth);
+}
+
+// A thumbnail of range(0) x range(0) pixels carved to 75% of each side,
+// on the small-image path if range(1) (SeamCarver::setSmallImagePath)
+void BM_ResizeSmall(benchmark::State& state) {
+    const int side = static_cast<int>(state.range(0));
+    const cv::Mat& img = image(side, side);
+    const int target = side * 3 / 4;
+    size_t allocations = 0;
+    for (auto _ : state) {
+        const size_t before = heapAllocations.load(std::memory_order_relaxed);
+        SeamCarver carver(img);
+        carver.setSmallImagePath(state.range(1) != 0);
+        cv::Mat out = carver.resize(carver.resizeOptions(target, target, SeamStrategy::DP));
+        allocations += heapAllocations.load(std::memory_order_relaxed) - before;
+        benchmark::DoNotOptimize(out.data);
+    }
+    setRates(state, static_cast<double>(img.total()), 2 * (side - target));
+    state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocations), benchmark::Counter::kAvgIterations);
+}
+
+const std::vector<std::pair<int, int>> kSizes = {
+    { 256, 256 }, { 512, 512 }, { 1024, 1024 }, { 1920, 1080 }, { 3840, 2160 }, { 7680, 4320 },
+};
+
+void sizes(benchmark::internal::Benchmark* b) {
+    for (const auto& s : kSizes) b->Args({ s.first, s.second });
+}
+
+void batchArgs(benchmark::internal::Benchmark* b) {
+    for (const auto& s : kSizes) {
+        for (int k : { 8, 32 }) b->Args({ s.first, s.second, k });
+    }
+}
+
+// One seam from a precomputed energy map of a profile image
+void profileSeam(benchmark::State& state, CorpusProfile profile, cv::Size size,
+                 std::vector<int> (SeamCarver::*find)(const cv::Mat&), GraphSolver solver) {
+    const cv::Mat& img = image(size.width, size.height, profile);
+    SeamCarver carver(img);
+    carver.setGraphSolver(solver);
+    cv::Mat energy = carver.calculateEnergy(img);
+    for (auto _ : state) {
+        std::vector<int> seam = (carver.*find)(energy);
+        benchmark::DoNotOptimize(seam.data());
+    }
+    setRates(state, static_cast<double>(img.total()), 1);
+}
+
+// A quarter of the width of a profile image carved away
+void profileResize(benchmark::State& state, CorpusProfile profile, cv::Size size, SeamStrategy strategy) {
+    const cv::Mat& img = image(size.width, size.height, profile);
+    const int targetWidth = size.width * 3 / 4;
+    for (auto _ : state) {
+        state.PauseTiming();
+        SeamCarver carver(img);
+        state.ResumeTiming();
+        cv::Mat out = carver.resize(carver.resizeOptions(targetWidth, size.height, strategy));
+        benchmark::DoNotOptimize(out.data);
+    }
+    setRates(state, static_cast<double>(img.total()), size.width - targetWidth);
+}
+
+void registerProfileBenchmarks(const std::vector<cv::Size>& profileSizes) {
+    typedef std::vector<int> (SeamCarver::*Finder)(const cv::Mat&);
+    struct SeamCase {
+        const char* name;
+        Finder find;
+        GraphSolver solver;
+    };
+    const SeamCase seamCases[] = {
+        { "DP", &SeamCarver::findVerticalSeamDP, GraphSolver::Dijkstra },
+        { "Greedy", &SeamCarver::findVerticalSeamGreedy, GraphSolver::Dijkstra },
+        { "GraphCut", &SeamCarver::findVerticalSeamGraphCut, GraphSolver::Dijkstra },
+        { "AStar", &SeamCarver::findVerticalSeamGraphCut, GraphSolver::AStar },
+    };
+    for (CorpusProfile profile : corpusProfiles()) {
+        for (const cv::Size& size : profileSizes) {
+            const std::string suffix = "/" + std::to_string(size.width) + "x" + std::to_string(size.height);
+            const std::string prefix = std::string("Profile/") + corpusProfileName(profile) + "/";
+            for (const SeamCase& s : seamCases) {
+                benchmark::RegisterBenchmark((prefix + "VerticalSeam/" + s.name + suffix).c_str(), profileSeam,
+                                             profile, size, s.find, s.solver)
+                    ->Unit(benchmark::kMillisecond);
+            }
+            benchmark::RegisterBenchmark((prefix + "Resize/DP" + suffix).c_str(), profileResize, profile, size,
+                                         SeamStrategy::DP)
+                ->Unit(benchmark::kMillisecond)->Iterations(1);
+            benchmark::RegisterBenchmark((prefix + "Resize/Greedy" + suffix).c_str(), profileResize, profile, size,
+                                         SeamStrategy::Greedy)
+                ->Unit(benchmark::kMillisecond)->Iterations(1);
+        }
+    }
+}
+
+// "512x512,1920x1080"
+std::vector<cv::Size> parseSizes(const std::string& list) {
+    std::vector<cv::Size> sizes;
+    std::stringstream in(list);
+    std::string spec;
+    while (std::getline(in, spec, ',')) {
+        const size_t x = spec.find('x');
+        if (x == std::string::npos) throw std::runtime_error("Sizes are WxH: " + spec);
+        const int w = std::stoi(spec.substr(0, x));
+        const int h = std::stoi(spec.substr(x + 1));
+        if (w < 1 || h < 1) throw std::runtime_error("Sizes must be positive: " + spec);
+        sizes.emplace_back(w, h);
+    }
+    return sizes;
+}
+
+void smallArgs(benchmark::internal::Benchmark* b) {
+    for (int side : { 32, 64, 128, 256 }) {
+        for (int path : { 0, 1 }) b->Args({ side, path });
+    }
+}
+
+void lazyArgs(benchmark::internal::Benchmark* b) {
+    for (const auto& s : kSizes) {
+        for (int pass : { 0, 8, 32, 128 }) b->Args({ s.first, s.second, pass });
+    }
+}
+
+void resizeArgs(benchmark::internal::Benchmark* b) {
+    for (const auto& s : kSizes) {
+        for (int percent : { 90, 75, 50 }) {
+            b->Args({ s.first, s.second, percent, 0 });
+            b->Args({ s.first, s.second, percent, 1 });
+        }
+    }
+}
+
+} // namespace
+
+// Counting replacements of the global allocation functions; the default
+// array forms forward to these
+void* operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+BENCHMARK(BM_CalculateEnergy)->Name("Energy")->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_FindSeam, &SeamCarver::findVerticalSeamDP)->Name("VerticalSeam/DP")
+    ->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_FindSeam, &SeamCarver::findHorizontalSeamDP)->Name("HorizontalSeam/DP")
+    ->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_FindSeam, &SeamCarver::findVerticalSeamGreedy)->Name("VerticalSeam/Greedy")
+    ->Apply(sizes)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FindSeam, &SeamCarver::findHorizontalSeamGreedy)->Name("HorizontalSeam/Greedy")
+    ->Apply(sizes)->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_FindSeam, &SeamCarver::findVerticalSeamGraphCut)->Name("VerticalSeam/GraphCut")
+    ->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_FindSeam, &SeamCarver::findHorizontalSeamGraphCut)->Name("HorizontalSeam/GraphCut")
+    ->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RemoveSeam, true)->Name("RemoveVerticalSeam")->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RemoveSeam, false)->Name("RemoveHorizontalSeam")->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RemoveSeamPlanar, true)->Name("RemoveVerticalSeam/Planar")->Apply(sizes)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RemoveSeamPlanar, false)->Name("RemoveHorizontalSeam/Planar")->Apply(sizes)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RemoveSeams, true)->Name("RemoveVerticalSeams")->Apply(batchArgs)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_RemoveSeams, false)->Name("RemoveHorizontalSeams")->Apply(batchArgs)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Resize, SeamStrategy::DP)->Name("Resize/DP")->Apply(resizeArgs)
+    ->ArgNames({ "w", "h", "pct", "both" })->Unit(benchmark::kMillisecond)->Iterations(1);
+BENCHMARK_TEMPLATE(BM_Resize, SeamStrategy::Greedy)->Name("Resize/Greedy")->Apply(resizeArgs)
+    ->ArgNames({ "w", "h", "pct", "both" })->Unit(benchmark::kMillisecond)->Iterations(1);
+BENCHMARK_TEMPLATE(BM_Resize, SeamStrategy::Pyramid)->Name("Resize/Pyramid")->Apply(resizeArgs)
+    ->ArgNames({ "w", "h", "pct", "both" })->Unit(benchmark::kMillisecond)->Iterations(1);
+BENCHMARK_TEMPLATE(BM_Resize, SeamStrategy::GraphCut)->Name("Resize/GraphCut")->Apply(resizeArgs)
+    ->ArgNames({ "w", "h", "pct", "both" })->Unit(benchmark::kMillisecond)->Iterations(1);
+BENCHMARK(BM_ResizeLazy)->Name("Resize/DP/Lazy")->Apply(lazyArgs)
+    ->ArgNames({ "w", "h", "pass" })->Unit(benchmark::kMillisecond)->Iterations(1);
+BENCHMARK(BM_ResizeSmall)->Name("Resize/DP/Small")->Apply(smallArgs)
+    ->ArgNames({ "side", "path" })->Unit(benchmark::kMicrosecond);
+
+// Google Benchmark's main, after the corpus flags are taken out of argv
+int main(int argc, char** argv) {
+    std::vector<cv::Size> profileSizes = { { 512, 512 }, { 1920, 1080 } };
+    std::string corpusOut;
+    std::string paretoOut;
+    int paretoRepeats = 1;
+    std::vector<char*> rest = { argv[0] };
+    try {
+        for (int i = 1; i < argc; i++) {
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error(std::string("Missing value for ") + argv[i]);
+                return argv[++i];
+            };
+            if (std::strcmp(argv[i], "--corpus-out") == 0) corpusOut = value();
+            else if (std::strcmp(argv[i], "--corpus-sizes") == 0) profileSizes = parseSizes(value());
+            else if (std::strcmp(argv[i], "--corpus-seed") == 0) corpusSeed = static_cast<uint32_t>(std::stoul(value()));
+            else if (std::strcmp(argv[i], "--pareto-out") == 0) paretoOut = value();
+            else if (std::strcmp(argv[i], "--pareto-repeats") == 0) paretoRepeats = std::max(1, std::stoi(value()));
+            else rest.push_back(argv[i]);
+        }
+        if (!corpusOut.empty()) {
+            for (const std::string& file : writeCorpus(corpusOut, profileSizes, corpusSeed)) {
+                std::cout << file << "\n";
+            }
+            return 0;
+        }
+        if (!paretoOut.empty()) {
+            const std::vector<ParetoResult> results =
+                runParetoSweep(profileSizes, paretoConfigs(), paretoRepeats, corpusSeed, &std::cerr);
+            printParetoTable(std::cout, results);
+            writeParetoCsv(paretoOut, results);
+            return 0;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    registerProfileBenchmarks(profileSizes);
+    int count = static_cast<int>(rest.size());
+    benchmark::Initialize(&count, rest.data());
+    if (benchmark::ReportUnrecognizedArguments(count, rest.data())) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
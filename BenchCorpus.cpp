@@ -0,0 +1,159 @@
+#include "BenchCorpus.h"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Linear congruential generator: the same stream on every platform
+struct Lcg {
+    uint32_t state;
+    uint32_t next() {
+        state = state * 1664525u + 1013904223u;
+        return state;
+    }
+    // 0..n-1 from the high bits
+    int below(int n) { return static_cast<int>((static_cast<uint64_t>(next()) * static_cast<uint32_t>(n)) >> 32); }
+};
+
+uchar clampByte(int v) {
+    return static_cast<uchar>(std::min(255, std::max(0, v)));
+}
+
+void mixed(cv::Mat& img, Lcg& rng) {
+    const int width = img.cols;
+    const int height = img.rows;
+    for (int r = 0; r < height; r++) {
+        cv::Vec3b* row = img.ptr<cv::Vec3b>(r);
+        for (int c = 0; c < width; c++) {
+            const int noise = static_cast<int>(rng.next() >> 27);  // 0..31
+            const bool block = ((r / 64) + (c / 96)) % 5 == 0;
+            row[c] = block ? cv::Vec3b(40, 160, 90)
+                           : cv::Vec3b(static_cast<uchar>((c * 255 / width + noise) & 255),
+                                       static_cast<uchar>((r * 255 / height + noise) & 255),
+                                       static_cast<uchar>(((r + c) / 4 + noise) & 255));
+        }
+    }
+}
+
+void gradient(cv::Mat& img, Lcg& rng) {
+    // A random direction per channel, no noise
+    int dx[3], dy[3];
+    for (int k = 0; k < 3; k++) {
+        dx[k] = rng.below(256);
+        dy[k] = rng.below(256);
+    }
+    const int span = std::max(1, img.cols + img.rows);
+    for (int r = 0; r < img.rows; r++) {
+        cv::Vec3b* row = img.ptr<cv::Vec3b>(r);
+        for (int c = 0; c < img.cols; c++) {
+            for (int k = 0; k < 3; k++) {
+                row[c][k] = clampByte((c * dx[k] + r * dy[k]) / span);
+            }
+        }
+    }
+}
+
+void texture(cv::Mat& img, Lcg& rng) {
+    for (int r = 0; r < img.rows; r++) {
+        cv::Vec3b* row = img.ptr<cv::Vec3b>(r);
+        for (int c = 0; c < img.cols; c++) {
+            const uint32_t v = rng.next();
+            row[c] = cv::Vec3b(static_cast<uchar>(v >> 24), static_cast<uchar>(v >> 16), static_cast<uchar>(v >> 8));
+        }
+    }
+}
+
+void sparse(cv::Mat& img, Lcg& rng) {
+    img.setTo(cv::Scalar(70, 110, 150));
+    // About one object per 256x256 pixels, each up to a sixth of the short side
+    const int objects = std::max(1, static_cast<int>(static_cast<long long>(img.cols) * img.rows / (256 * 256)));
+    const int maxSide = std::max(4, std::min(img.cols, img.rows) / 6);
+    for (int k = 0; k < objects; k++) {
+        const int w = 4 + rng.below(maxSide);
+        const int h = 4 + rng.below(maxSide);
+        const int x0 = rng.below(std::max(1, img.cols - w));
+        const int y0 = rng.below(std::max(1, img.rows - h));
+        const bool disc = rng.below(2) == 0;
+        for (int r = y0; r < std::min(img.rows, y0 + h); r++) {
+            cv::Vec3b* row = img.ptr<cv::Vec3b>(r);
+            for (int c = x0; c < std::min(img.cols, x0 + w); c++) {
+                const double u = (c - x0 + 0.5) / w * 2 - 1;
+                const double v = (r - y0 + 0.5) / h * 2 - 1;
+                if (disc && u * u + v * v > 1) continue;
+                const uint32_t n = rng.next();
+                row[c] = cv::Vec3b(static_cast<uchar>(n >> 24), static_cast<uchar>(n >> 16), static_cast<uchar>(n >> 8));
+            }
+        }
+    }
+}
+
+void checkerboard(cv::Mat& img, Lcg& rng) {
+    const int run = std::min(img.cols, 8);
+    for (int r = 0; r < img.rows; r++) {
+        cv::Vec3b* row = img.ptr<cv::Vec3b>(r);
+        for (int c = 0; c < img.cols; c++) {
+            const uchar v = ((r / 2 + c / 2) & 1) ? 255 : 0;
+            row[c] = cv::Vec3b(v, v, v);
+        }
+        // A flat grey run, far from the one above on average
+        const int start = rng.below(img.cols - run + 1);
+        for (int c = start; c < start + run; c++) row[c] = cv::Vec3b(128, 128, 128);
+    }
+}
+
+} // namespace
+
+const std::vector<CorpusProfile>& corpusProfiles() {
+    static const std::vector<CorpusProfile> all = {
+        CorpusProfile::Mixed, CorpusProfile::Gradient, CorpusProfile::Texture,
+        CorpusProfile::Sparse, CorpusProfile::Checkerboard,
+    };
+    return all;
+}
+
+const char* corpusProfileName(CorpusProfile profile) {
+    switch (profile) {
+    case CorpusProfile::Mixed: return "mixed";
+    case CorpusProfile::Gradient: return "gradient";
+    case CorpusProfile::Texture: return "texture";
+    case CorpusProfile::Sparse: return "sparse";
+    case CorpusProfile::Checkerboard: return "checkerboard";
+    }
+    return "unknown";
+}
+
+cv::Mat makeCorpusImage(CorpusProfile profile, int width, int height, uint32_t seed) {
+    if (width < 1 || height < 1) {
+        throw std::runtime_error("Corpus images need a positive size.");
+    }
+    cv::Mat img(height, width, CV_8UC3);
+    Lcg rng{ 0x9e3779b9u ^ static_cast<uint32_t>(width * 7919 + height) ^ (seed * 0x85ebca6bu) };
+    switch (profile) {
+    case CorpusProfile::Mixed: mixed(img, rng); break;
+    case CorpusProfile::Gradient: gradient(img, rng); break;
+    case CorpusProfile::Texture: texture(img, rng); break;
+    case CorpusProfile::Sparse: sparse(img, rng); break;
+    case CorpusProfile::Checkerboard: checkerboard(img, rng); break;
+    }
+    return img;
+}
+
+std::vector<std::string> writeCorpus(const std::string& dir, const std::vector<cv::Size>& sizes, uint32_t seed) {
+    fs::create_directories(dir);
+    std::vector<std::string> files;
+    for (CorpusProfile profile : corpusProfiles()) {
+        for (const cv::Size& size : sizes) {
+            const std::string name = std::string(corpusProfileName(profile)) + "_" + std::to_string(size.width) +
+                                     "x" + std::to_string(size.height) + ".png";
+            const std::string path = (fs::path(dir) / name).string();
+            if (!cv::imwrite(path, makeCorpusImage(profile, size.width, size.height, seed))) {
+                throw std::runtime_error("Failed to save image to: " + path);
+            }
+            files.push_back(path);
+        }
+    }
+    return files;
+}
@@ -0,0 +1,50 @@
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Content profiles of the synthetic benchmark images.
+ *  - Mixed:        smooth colour gradients with fine noise and a grid of
+ *                  flat blocks, textured and empty regions side by side
+ *  - Gradient:     flat linear gradients only: near-zero energy and
+ *                  near-ties everywhere
+ *  - Texture:      per-pixel noise: high energy everywhere
+ *  - Sparse:       a flat background with a few textured objects
+ *  - Checkerboard: a 2-pixel checkerboard with one short flat run per row
+ *                  at a random column. Every row's cheapest pixel is in a
+ *                  run, so A*'s per-row bound prunes nothing, and greedy
+ *                  walks from run to run into the texture around them
+ */
+enum class CorpusProfile {
+    Mixed,
+    Gradient,
+    Texture,
+    Sparse,
+    Checkerboard
+};
+
+// @brief Every profile, in declaration order.
+const std::vector<CorpusProfile>& corpusProfiles();
+
+// @brief Lower-case name of a profile ("checkerboard").
+const char* corpusProfileName(CorpusProfile profile);
+
+/**
+ * @brief Synthetic CV_8UC3 image of a profile. Deterministic: the same
+ * profile, size and seed always give the same pixels.
+ */
+cv::Mat makeCorpusImage(CorpusProfile profile, int width, int height, uint32_t seed = 0);
+
+/**
+ * @brief Write every profile at every size to dir as
+ * <profile>_<w>x<h>.png; returns the files written. Throws
+ * std::runtime_error if one cannot be written.
+ */
+std::vector<std::string> writeCorpus(const std::string& dir, const std::vector<cv::Size>& sizes,
+                                     uint32_t seed = 0);
+
+#endif // BENCH_CORPUS_H
@@ -0,0 +1,264 @@
+#include "BenchPareto.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+
+// Three quarters of the width, like the Profile/ resizes
+int targetWidth(const cv::Mat& img) {
+    return img.cols * 3 / 4;
+}
+
+cv::Mat carve(const cv::Mat& img, const ParetoConfig& config) {
+    SeamCarver carver(img);
+    carver.setPyramidLevels(config.pyramidLevels);
+    carver.setPyramidCorridor(config.pyramidCorridor);
+    carver.setGreedyBeamWidth(config.beamWidth);
+    ResizeOptions options = carver.resizeOptions(targetWidth(img), img.rows, config.strategy);
+    options.precision = config.precision;
+    options.seamBatch = config.seamBatch;
+    return carver.resize(options);
+}
+
+// The image with its column (mod 256) in an alpha plane. Gray, and with it
+// every energy and seam, ignores alpha, so a carve of the copy removes the
+// same pixels as one of the image and tells where each kept pixel was.
+cv::Mat tagColumns(const cv::Mat& img) {
+    cv::Mat tagged(img.rows, img.cols, CV_8UC4);
+    for (int i = 0; i < img.rows; i++) {
+        const cv::Vec3b* src = img.ptr<cv::Vec3b>(i);
+        cv::Vec4b* dst = tagged.ptr<cv::Vec4b>(i);
+        for (int j = 0; j < img.cols; j++) {
+            dst[j] = cv::Vec4b(src[j][0], src[j][1], src[j][2], static_cast<uchar>(j & 255));
+        }
+    }
+    return tagged;
+}
+
+// Source column of every pixel of carved (a width-only carve of the tagged
+// source): the first column at or right of the previous match with the
+// pixel's tag and colour. CV_32S, carved's size.
+cv::Mat sourceColumns(const cv::Mat& source, const cv::Mat& carved, const cv::Mat& carvedTagged) {
+    if (carvedTagged.size() != carved.size()) {
+        throw std::runtime_error("The tagged carve has a different size.");
+    }
+    cv::Mat columns(carved.rows, carved.cols, CV_32S);
+    for (int i = 0; i < carved.rows; i++) {
+        const cv::Vec3b* src = source.ptr<cv::Vec3b>(i);
+        const cv::Vec3b* out = carved.ptr<cv::Vec3b>(i);
+        const cv::Vec4b* tag = carvedTagged.ptr<cv::Vec4b>(i);
+        int* col = columns.ptr<int>(i);
+        int j = 0;
+        for (int k = 0; k < carved.cols; k++) {
+            const cv::Vec3b pixel(tag[k][0], tag[k][1], tag[k][2]);
+            if (pixel != out[k]) {
+                throw std::runtime_error("The tagged carve removed other pixels.");
+            }
+            j += (tag[k][3] - j) & 255;
+            while (j < source.cols && src[j] != pixel) j += 256;
+            if (j >= source.cols) {
+                throw std::runtime_error("A carved pixel has no source column.");
+            }
+            col[k] = j++;
+        }
+    }
+    return columns;
+}
+
+int stepL1(const cv::Vec3b& a, const cv::Vec3b& b) {
+    return std::abs(a[0] - b[0]) + std::abs(a[1] - b[1]) + std::abs(a[2] - b[2]);
+}
+
+void score(const cv::Mat& source, const cv::Mat& energy, const cv::Mat& carved, const cv::Mat& columns,
+           ParetoResult& result) {
+    // Removed: all of the source energy but the kept pixels'
+    double kept = 0.0;
+    for (int i = 0; i < carved.rows; i++) {
+        const double* e = energy.ptr<double>(i);
+        const int* col = columns.ptr<int>(i);
+        for (int k = 0; k < carved.cols; k++) kept += e[col[k]];
+    }
+    result.removedEnergy = cv::sum(energy)[0] - kept;
+
+    // Joins: output neighbours that were not neighbours in the source
+    double excess = 0.0;
+    for (int i = 0; i < carved.rows; i++) {
+        const cv::Vec3b* src = source.ptr<cv::Vec3b>(i);
+        const cv::Vec3b* out = carved.ptr<cv::Vec3b>(i);
+        const int* col = columns.ptr<int>(i);
+        for (int k = 0; k + 1 < carved.cols; k++) {
+            const int a = col[k];
+            const int b = col[k + 1];
+            if (b == a + 1) continue;
+            const int replaced = std::min(stepL1(src[a], src[a + 1]), stepL1(src[b - 1], src[b]));
+            excess += std::max(0, stepL1(out[k], out[k + 1]) - replaced);
+        }
+        if (i + 1 == carved.rows) continue;
+        const cv::Vec3b* srcBelow = source.ptr<cv::Vec3b>(i + 1);
+        const cv::Vec3b* outBelow = carved.ptr<cv::Vec3b>(i + 1);
+        const int* colBelow = columns.ptr<int>(i + 1);
+        for (int k = 0; k < carved.cols; k++) {
+            const int a = col[k];
+            const int b = colBelow[k];
+            if (a == b) continue;
+            const int replaced = std::min(stepL1(src[a], srcBelow[a]), stepL1(src[b], srcBelow[b]));
+            excess += std::max(0, stepL1(out[k], outBelow[k]) - replaced);
+        }
+    }
+    result.artifact = excess / static_cast<double>(carved.total());
+}
+
+const char* strategyName(SeamStrategy strategy) {
+    switch (strategy) {
+    case SeamStrategy::DP: return "dp";
+    case SeamStrategy::Greedy: return "greedy";
+    case SeamStrategy::Pyramid: return "pyramid";
+    case SeamStrategy::GraphCut: return "graph";
+    }
+    return "?";
+}
+
+const char* precisionName(EnergyPrecision precision) {
+    switch (precision) {
+    case EnergyPrecision::Double: return "double";
+    case EnergyPrecision::Float: return "float";
+    case EnergyPrecision::Fixed16: return "fixed16";
+    }
+    return "?";
+}
+
+// As fast and at least as good on both scores, and better on one
+bool dominates(const ParetoResult& a, const ParetoResult& b) {
+    return a.ms <= b.ms && a.energyVsDP <= b.energyVsDP && a.artifact <= b.artifact &&
+           (a.ms < b.ms || a.energyVsDP < b.energyVsDP || a.artifact < b.artifact);
+}
+
+} // namespace
+
+std::vector<ParetoConfig> paretoConfigs() {
+    std::vector<ParetoConfig> configs;
+    auto add = [&](const std::string& name, SeamStrategy strategy) -> ParetoConfig& {
+        configs.emplace_back();
+        configs.back().name = name;
+        configs.back().strategy = strategy;
+        return configs.back();
+    };
+    add("dp/double", SeamStrategy::DP);
+    add("dp/float", SeamStrategy::DP).precision = EnergyPrecision::Float;
+    add("dp/fixed16", SeamStrategy::DP).precision = EnergyPrecision::Fixed16;
+    for (int batch : { 4, 16 }) {
+        add("dp/double/batch" + std::to_string(batch), SeamStrategy::DP).seamBatch = batch;
+    }
+    add("dp/double/batch-adaptive", SeamStrategy::DP).seamBatch = SeamCarver::kAdaptiveSeamBatch;
+    add("dp/fixed16/batch16", SeamStrategy::DP).precision = EnergyPrecision::Fixed16;
+    configs.back().seamBatch = 16;
+    for (int levels : { 1, 3 }) {
+        for (int corridor : { 2, 4, 8 }) {
+            ParetoConfig& c = add("pyramid/l" + std::to_string(levels) + "/c" + std::to_string(corridor),
+                                  SeamStrategy::Pyramid);
+            c.pyramidLevels = levels;
+            c.pyramidCorridor = corridor;
+        }
+    }
+    add("greedy", SeamStrategy::Greedy);
+    add("greedy/beam8", SeamStrategy::Greedy).beamWidth = 8;
+    add("graph", SeamStrategy::GraphCut);
+    return configs;
+}
+
+std::vector<ParetoResult> runParetoSweep(const std::vector<cv::Size>& sizes, const std::vector<ParetoConfig>& configs,
+                                         int repeats, uint32_t seed, std::ostream* log) {
+    std::vector<ParetoResult> results;
+    for (CorpusProfile profile : corpusProfiles()) {
+        for (const cv::Size& size : sizes) {
+            const cv::Mat img = makeCorpusImage(profile, size.width, size.height, seed);
+            const cv::Mat tagged = tagColumns(img);
+            cv::Mat energy;
+            SeamCarver(img).calculateEnergy(img).convertTo(energy, CV_64F);
+            const int seams = img.cols - targetWidth(img);
+
+            const size_t first = results.size();
+            for (const ParetoConfig& config : configs) {
+                ParetoResult r;
+                r.profile = profile;
+                r.size = size;
+                r.config = config;
+                cv::Mat carved;
+                for (int k = 0; k < std::max(repeats, 1); k++) {
+                    const auto t0 = std::chrono::steady_clock::now();
+                    cv::Mat out = carve(img, config);
+                    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                    if (k == 0 || ms < r.ms) r.ms = ms;
+                    if (k == 0) carved = out;
+                }
+                r.seamsPerSecond = r.ms > 0.0 ? seams * 1000.0 / r.ms : 0.0;
+                score(img, energy, carved, sourceColumns(img, carved, carve(tagged, config)), r);
+                results.push_back(r);
+                if (log) {
+                    *log << corpusProfileName(profile) << " " << size.width << "x" << size.height << " "
+                         << config.name << ": " << r.ms << " ms" << std::endl;
+                }
+            }
+
+            const double reference = results[first].removedEnergy;
+            for (size_t k = first; k < results.size(); k++) {
+                // DP removing nothing leaves any removal infinitely worse
+                const double removed = results[k].removedEnergy;
+                results[k].energyVsDP = reference > 0.0 ? removed / reference
+                                      : removed > 0.0 ? std::numeric_limits<double>::infinity() : 1.0;
+            }
+            for (size_t k = first; k < results.size(); k++) {
+                results[k].pareto = true;
+                for (size_t m = first; m < results.size() && results[k].pareto; m++) {
+                    if (m != k && dominates(results[m], results[k])) results[k].pareto = false;
+                }
+            }
+        }
+    }
+    return results;
+}
+
+void printParetoTable(std::ostream& os, const std::vector<ParetoResult>& results) {
+    const std::ios::fmtflags flags = os.flags();
+    for (size_t k = 0; k < results.size(); k++) {
+        const ParetoResult& r = results[k];
+        if (k == 0 || r.profile != results[k - 1].profile || r.size != results[k - 1].size) {
+            os << (k == 0 ? "" : "\n") << corpusProfileName(r.profile) << " " << r.size.width << "x"
+               << r.size.height << " (* Pareto front)\n"
+               << std::left << std::setw(28) << "  config" << std::right << std::setw(12) << "ms"
+               << std::setw(12) << "seams/s" << std::setw(14) << "energy/DP" << std::setw(12) << "artifact"
+               << "\n";
+        }
+        os << (r.pareto ? "* " : "  ") << std::left << std::setw(26) << r.config.name << std::right << std::fixed
+           << std::setprecision(2) << std::setw(12) << r.ms << std::setprecision(0) << std::setw(12)
+           << r.seamsPerSecond << std::setprecision(4) << std::setw(14) << r.energyVsDP << std::setprecision(3)
+           << std::setw(12) << r.artifact << "\n";
+    }
+    os.flags(flags);
+}
+
+void writeParetoCsv(const std::string& path, const std::vector<ParetoResult>& results) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Could not open CSV for writing: " + path);
+    }
+    out << "profile,width,height,config,strategy,precision,seam_batch,pyramid_levels,pyramid_corridor,"
+           "beam_width,ms,seams_per_s,removed_energy,energy_vs_dp,artifact,pareto\n";
+    out << std::setprecision(10);
+    for (const ParetoResult& r : results) {
+        out << corpusProfileName(r.profile) << "," << r.size.width << "," << r.size.height << "," << r.config.name
+            << "," << strategyName(r.config.strategy) << "," << precisionName(r.config.precision) << ","
+            << r.config.seamBatch << "," << r.config.pyramidLevels << "," << r.config.pyramidCorridor << ","
+            << r.config.beamWidth << "," << r.ms << "," << r.seamsPerSecond << "," << r.removedEnergy << ","
+            << r.energyVsDP << "," << r.artifact << "," << (r.pareto ? 1 : 0) << "\n";
+    }
+    if (!out) {
+        throw std::runtime_error("Failed to write CSV: " + path);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef BENCH_PARETO_H
+#define BENCH_PARETO_H
+
+#include "BenchCorpus.h"
+#include "SeamCarver.h"
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One configuration of the speed vs quality sweep: a seam finder
+ * and the settings that trade its seams for time.
+ */
+struct ParetoConfig {
+    std::string name;                                 // "dp/float", "pyramid/l3/c4"
+    SeamStrategy strategy = SeamStrategy::DP;
+    EnergyPrecision precision = EnergyPrecision::Double;
+    int seamBatch = 1;                                // DP only; or SeamCarver::kAdaptiveSeamBatch
+    int pyramidLevels = 3;                            // pyramid only
+    int pyramidCorridor = 4;                          // pyramid only
+    int beamWidth = 1;                                // greedy only
+};
+
+/**
+ * @brief Speed and quality of one configuration on one corpus image,
+ * carved to three quarters of its width.
+ *  - removedEnergy: source energy (Sobel, double) of the removed pixels
+ *  - energyVsDP:    removedEnergy over that of exact DP on the same image,
+ *                   1 for DP itself; above 1 is worse (infinite when
+ *                   DP removes none and the config some)
+ *  - artifact:      colour edges the carve made across its seam joins,
+ *                   beyond the smaller original step each join replaced,
+ *                   per output pixel (8-bit BGR L1)
+ */
+struct ParetoResult {
+    CorpusProfile profile = CorpusProfile::Mixed;
+    cv::Size size;
+    ParetoConfig config;
+    double ms = 0.0;           // fastest of the repeats
+    double seamsPerSecond = 0.0;
+    double removedEnergy = 0.0;
+    double energyVsDP = 1.0;
+    double artifact = 0.0;
+    bool pareto = false;       // no other config of the image is as fast and as good on both scores
+};
+
+/**
+ * @brief The default sweep over methods, precisions, DP batch sizes and
+ * pyramid settings. The first entry is exact DP (double precision, one
+ * seam per DP), the reference of energyVsDP.
+ */
+std::vector<ParetoConfig> paretoConfigs();
+
+/**
+ * @brief Run every config on every profile at every size, timing the best
+ * of repeats resizes and scoring the first, and mark each image's Pareto
+ * front. Progress lines go to log if not null. configs.front() is the
+ * energyVsDP reference. Throws std::runtime_error if a carve's removed
+ * pixels cannot be traced back to the source.
+ */
+std::vector<ParetoResult> runParetoSweep(const std::vector<cv::Size>& sizes, const std::vector<ParetoConfig>& configs,
+                                         int repeats, uint32_t seed, std::ostream* log = nullptr);
+
+// @brief One table per image, Pareto-front configs starred.
+void printParetoTable(std::ostream& os, const std::vector<ParetoResult>& results);
+
+/**
+ * @brief Write the results as CSV with a header row. Throws
+ * std::runtime_error if the file cannot be written.
+ */
+void writeParetoCsv(const std::string& path, const std::vector<ParetoResult>& results);
+
+#endif // BENCH_PARETO_H
@@ -0,0 +1,257 @@
+#include "CarveCache.h"
+#include "SeamMap.h"
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char kEnergyMagic[4] = { 'S', 'C', 'E', 'N' };
+constexpr uint32_t kEnergyVersion = 1;
+
+#pragma pack(push, 1)
+struct EnergyHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t rows;
+    int32_t cols;
+    int32_t type;
+};
+#pragma pack(pop)
+
+size_t planeBytes(const cv::Mat& m) {
+    return m.empty() ? 0 : m.total() * m.elemSize();
+}
+
+// Raw dump of a single-channel plane; false on any I/O error
+bool writeEnergy(const std::string& path, const cv::Mat& energy) {
+    EnergyHeader header;
+    std::memcpy(header.magic, kEnergyMagic, sizeof(kEnergyMagic));
+    header.version = kEnergyVersion;
+    header.rows = energy.rows;
+    header.cols = energy.cols;
+    header.type = energy.type();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const size_t rowBytes = energy.cols * energy.elemSize();
+    for (int i = 0; i < energy.rows; i++) {
+        out.write(reinterpret_cast<const char*>(energy.ptr(i)), rowBytes);
+    }
+    return static_cast<bool>(out);
+}
+
+// A header or size that does not match an energy map of writeEnergy (a
+// corrupt or stale file) is a miss, checked before anything is allocated
+bool readEnergy(const std::string& path, cv::Mat& energy) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    const std::streamoff fileBytes = in.tellg();
+    in.seekg(0);
+    EnergyHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kEnergyMagic, sizeof(kEnergyMagic)) != 0 ||
+        header.version != kEnergyVersion || header.rows <= 0 || header.cols <= 0) {
+        return false;
+    }
+    if (header.type != CV_64FC1 && header.type != CV_32FC1 && header.type != CV_16UC1) {
+        return false;
+    }
+    const uint64_t dataBytes = static_cast<uint64_t>(header.rows) * static_cast<uint64_t>(header.cols) *
+                               CV_ELEM_SIZE(header.type);
+    if (fileBytes < 0 || static_cast<uint64_t>(fileBytes) != sizeof(header) + dataBytes) {
+        return false;
+    }
+    cv::Mat m(header.rows, header.cols, header.type);
+    if (!in.read(reinterpret_cast<char*>(m.data), planeBytes(m))) {
+        return false;
+    }
+    energy = m;
+    return true;
+}
+
+} // namespace
+
+CarveCache::CarveCache(size_t memoryBudget, const std::string& diskDir)
+    : budget(memoryBudget), dir(diskDir) {
+    if (!dir.empty()) {
+        fs::create_directories(dir);
+    }
+}
+
+std::string CarveCache::key(uint64_t sourceHash, const std::string& settings) {
+    std::ostringstream os;
+    os << std::hex << sourceHash << '-';
+    // Keep the key usable as a file name
+    for (char c : settings) {
+        os << (std::isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '-' ? c : '_');
+    }
+    return os.str();
+}
+
+std::string CarveCache::energySettings(EnergyPrecision precision, EnergyFunction function) {
+    return "energy/p" + std::to_string(static_cast<int>(precision)) +
+           "/f" + std::to_string(static_cast<int>(function));
+}
+
+// Called with mutex held. Moves a hit to the front.
+const CarveCache::Entry* CarveCache::findInMemory(const std::string& id) {
+    auto it = index.find(id);
+    if (it == index.end()) return nullptr;
+    lru.splice(lru.begin(), lru, it->second);
+    return &*it->second;
+}
+
+// Called with mutex held
+void CarveCache::storeInMemory(Entry entry) {
+    auto old = index.find(entry.id);
+    if (old != index.end()) {
+        bytes -= old->second->bytes;
+        lru.erase(old->second);
+        index.erase(old);
+    }
+    if (entry.bytes > budget) return;
+
+    bytes += entry.bytes;
+    lru.push_front(std::move(entry));
+    index[lru.front().id] = lru.begin();
+    while (bytes > budget) {
+        bytes -= lru.back().bytes;
+        index.erase(lru.back().id);
+        lru.pop_back();
+    }
+}
+
+std::string CarveCache::diskPath(const std::string& key, const char* kind) const {
+    return (fs::path(dir) / (key + "." + kind)).string();
+}
+
+bool CarveCache::findEnergy(const std::string& key, cv::Mat& energy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (const Entry* e = findInMemory("energy:" + key)) {
+        energy = e->planes[0].clone();
+        return true;
+    }
+    if (dir.empty() || !readEnergy(diskPath(key, "energy"), energy)) {
+        return false;
+    }
+    Entry entry;
+    entry.id = "energy:" + key;
+    entry.planes[0] = energy.clone();
+    entry.bytes = planeBytes(energy);
+    storeInMemory(std::move(entry));
+    return true;
+}
+
+void CarveCache::storeEnergy(const std::string& key, const cv::Mat& energy) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry entry;
+    entry.id = "energy:" + key;
+    entry.planes[0] = energy.clone();
+    entry.bytes = planeBytes(energy);
+    storeInMemory(std::move(entry));
+    if (!dir.empty() && !writeEnergy(diskPath(key, "energy"), energy)) {
+        throw std::runtime_error("Failed to write cached energy map: " + diskPath(key, "energy"));
+    }
+}
+
+bool CarveCache::findSeamMap(const std::string& key, SeamIndexMap& map) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (const Entry* e = findInMemory("seammap:" + key)) {
+        map.vertical = e->planes[0].clone();
+        map.horizontal = e->planes[1].clone();
+        map.minWidth = e->minWidth;
+        map.minHeight = e->minHeight;
+        return true;
+    }
+    if (dir.empty() || !fs::exists(diskPath(key, "seammap"))) {
+        return false;
+    }
+    try {
+        // The key already names the source, so the mapped copy is not rehashed
+        MappedSeamMap mapped(diskPath(key, "seammap"));
+        map.vertical = mapped.map().vertical.clone();
+        map.horizontal = mapped.map().horizontal.clone();
+        map.minWidth = mapped.map().minWidth;
+        map.minHeight = mapped.map().minHeight;
+    }
+    catch (const std::runtime_error&) {
+        return false;
+    }
+    Entry entry;
+    entry.id = "seammap:" + key;
+    entry.planes[0] = map.vertical.clone();
+    entry.planes[1] = map.horizontal.clone();
+    entry.minWidth = map.minWidth;
+    entry.minHeight = map.minHeight;
+    entry.bytes = planeBytes(map.vertical) + planeBytes(map.horizontal);
+    storeInMemory(std::move(entry));
+    return true;
+}
+
+void CarveCache::storeSeamMap(const std::string& key, const SeamIndexMap& map, const cv::Mat& source) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry entry;
+    entry.id = "seammap:" + key;
+    entry.planes[0] = map.vertical.clone();
+    entry.planes[1] = map.horizontal.clone();
+    entry.minWidth = map.minWidth;
+    entry.minHeight = map.minHeight;
+    entry.bytes = planeBytes(map.vertical) + planeBytes(map.horizontal);
+    storeInMemory(std::move(entry));
+    if (!dir.empty()) {
+        saveSeamMap(diskPath(key, "seammap"), map, source);
+    }
+}
+
+bool CarveCache::findResult(const std::string& key, cv::Mat& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (const Entry* e = findInMemory("result:" + key)) {
+        result = e->planes[0].clone();
+        return true;
+    }
+    if (dir.empty() || !fs::exists(diskPath(key, "png"))) {
+        return false;
+    }
+    cv::Mat decoded = cv::imread(diskPath(key, "png"), cv::IMREAD_UNCHANGED);
+    if (decoded.empty()) {
+        return false;
+    }
+    Entry entry;
+    entry.id = "result:" + key;
+    entry.planes[0] = decoded;
+    entry.bytes = planeBytes(decoded);
+    storeInMemory(std::move(entry));
+    result = decoded.clone();
+    return true;
+}
+
+void CarveCache::storeResult(const std::string& key, const cv::Mat& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry entry;
+    entry.id = "result:" + key;
+    entry.planes[0] = result.clone();
+    entry.bytes = planeBytes(result);
+    storeInMemory(std::move(entry));
+    // PNG keeps 8- and 16-bit results lossless; float results stay in memory
+    const bool pngDepth = result.depth() == CV_8U || result.depth() == CV_16U;
+    if (!dir.empty() && pngDepth && !cv::imwrite(diskPath(key, "png"), result)) {
+        throw std::runtime_error("Failed to write cached result: " + diskPath(key, "png"));
+    }
+}
+
+void CarveCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    lru.clear();
+    index.clear();
+    bytes = 0;
+}
+
+size_t CarveCache::memoryBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytes;
+}
@@ -0,0 +1,86 @@
+#ifndef CARVE_CACHE_H
+#define CARVE_CACHE_H
+
+#include "SeamCarver.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Memory plus optional on-disk cache of carving work, for sources
+ * that are carved again and again (other targets, other methods).
+ *
+ * Entries are keyed by the source's content hash (hashImage) and a
+ * settings string naming everything the entry depends on, e.g.
+ * "dp/double/backward/sobel/320x200". Three kinds are kept:
+ *  - energy maps: initial energy of a source (see setInitialEnergy)
+ *  - seam maps:   SeamIndexMap of a source
+ *  - results:     carved image for one method, settings and target size
+ *
+ * The memory tier keeps the most recently used entries within a byte
+ * budget. With a disk directory every stored entry is also written to
+ * <dir>/<key>.<kind>, and a memory miss falls back to that file. Results
+ * are stored as PNG, energy maps and seam maps as raw planes. All calls are
+ * thread-safe; lookups return copies the caller may modify.
+ */
+class CarveCache {
+public:
+    static constexpr size_t kDefaultMemoryBudget = size_t(256) << 20;
+
+    /**
+     * @param memoryBudget bytes kept in memory (0 disables the memory tier)
+     * @param diskDir      directory of the disk tier, created on demand;
+     *                     empty disables it
+     */
+    explicit CarveCache(size_t memoryBudget = kDefaultMemoryBudget, const std::string& diskDir = std::string());
+
+    /**
+     * @brief Cache key of a source in a given configuration.
+     */
+    static std::string key(uint64_t sourceHash, const std::string& settings);
+
+    /**
+     * @brief Settings part of an energy map key.
+     */
+    static std::string energySettings(EnergyPrecision precision, EnergyFunction function);
+
+    bool findEnergy(const std::string& key, cv::Mat& energy);
+    void storeEnergy(const std::string& key, const cv::Mat& energy);
+
+    bool findSeamMap(const std::string& key, SeamIndexMap& map);
+    void storeSeamMap(const std::string& key, const SeamIndexMap& map, const cv::Mat& source);
+
+    bool findResult(const std::string& key, cv::Mat& result);
+    void storeResult(const std::string& key, const cv::Mat& result);
+
+    /**
+     * @brief Drop the memory tier (disk files are kept).
+     */
+    void clear();
+
+    size_t memoryBytes() const;
+
+private:
+    struct Entry {
+        std::string id;  // kind + key
+        cv::Mat planes[2];
+        int minWidth = 0, minHeight = 0;  // seam maps only
+        size_t bytes = 0;
+    };
+
+    const Entry* findInMemory(const std::string& id);
+    void storeInMemory(Entry entry);
+    std::string diskPath(const std::string& key, const char* kind) const;
+
+    size_t budget;
+    std::string dir;
+    mutable std::mutex mutex;
+    std::list<Entry> lru;  // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t bytes = 0;
+};
+
+#endif // CARVE_CACHE_H
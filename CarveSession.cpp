@@ -0,0 +1,273 @@
+#include "CarveSession.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Copy of the seam's pixels: rows x 1 for a vertical seam, 1 x cols for a
+// horizontal one
+cv::Mat seamPixels(const cv::Mat& img, const std::vector<int>& seam, bool vertical) {
+    const size_t es = img.elemSize();
+    cv::Mat pixels = vertical ? cv::Mat(img.rows, 1, img.type()) : cv::Mat(1, img.cols, img.type());
+    for (int k = 0; k < static_cast<int>(seam.size()); k++) {
+        const uchar* src = vertical ? img.ptr(k) + seam[k] * es : img.ptr(seam[k]) + k * es;
+        std::memcpy(vertical ? pixels.ptr(k) : pixels.ptr(0) + k * es, src, es);
+    }
+    return pixels;
+}
+
+// img with the seam's pixels put back; the inverse of a seam removal
+cv::Mat insertPixels(const cv::Mat& img, const std::vector<int>& seam, const cv::Mat& pixels, bool vertical) {
+    const size_t es = img.elemSize();
+    if (vertical) {
+        cv::Mat out(img.rows, img.cols + 1, img.type());
+        for (int r = 0; r < img.rows; r++) {
+            const uchar* src = img.ptr(r);
+            uchar* dst = out.ptr(r);
+            const size_t left = seam[r] * es;
+            std::memcpy(dst, src, left);
+            std::memcpy(dst + left, pixels.ptr(r), es);
+            std::memcpy(dst + left + es, src + left, (img.cols - seam[r]) * es);
+        }
+        return out;
+    }
+    cv::Mat out(img.rows + 1, img.cols, img.type());
+    for (int c = 0; c < img.cols; c++) {
+        const int s = seam[c];
+        for (int r = 0; r <= img.rows; r++) {
+            const uchar* src = r < s ? img.ptr(r) : r == s ? pixels.ptr(0) : img.ptr(r - 1);
+            std::memcpy(out.ptr(r) + c * es, src + c * es, es);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+CarveSession::CarveSession(const cv::Mat& image)
+    : seamCarver(cv::Mat(image)) {
+    adopt(image);
+}
+
+void CarveSession::reset(const cv::Mat& image) {
+    seamCarver.reset(cv::Mat(image));
+    adopt(image);
+}
+
+void CarveSession::adopt(const cv::Mat& image) {
+    // The carver has already checked the pixel type
+    currentImage = image;
+    currentGray = seamCarver.grayImageView();
+    sharedPlanes = true;
+    energy.release();
+    currentMask = SeamMask();
+    history.clear();
+    future.clear();
+    removed = 0;
+    energyRemoved = 0.0;
+}
+
+void CarveSession::setMask(const cv::Mat& protect, const cv::Mat& remove) {
+    SeamMask m(protect, remove);
+    if (!m.empty() && m.size() != currentImage.size()) {
+        throw std::runtime_error("Mask does not match the image size.");
+    }
+    currentMask = std::move(m);
+    history.clear();
+    future.clear();
+    energy.release();  // cleared bits must get their own energy back
+}
+
+bool CarveSession::energyValid() const {
+    return !energy.empty() && energy.size() == currentGray.size() &&
+           energyPrecision == seamCarver.getPrecision() && energyFunction == seamCarver.getEnergyFunction();
+}
+
+std::vector<int> CarveSession::step(bool vertical) {
+    if ((vertical ? currentImage.cols : currentImage.rows) <= 1) return {};
+
+    const bool forward = usesForwardEnergy();
+    if (!forward) prepareEnergy();
+
+    std::vector<int> seam;
+    switch (strategy) {
+    case SeamStrategy::DP:
+        if (forward) {
+            seam = vertical ? seamCarver.findVerticalSeamForwardDP(currentGray)
+                            : seamCarver.findHorizontalSeamForwardDP(currentGray);
+        } else {
+            seam = vertical ? seamCarver.findVerticalSeamDP(energy) : seamCarver.findHorizontalSeamDP(energy);
+        }
+        break;
+    case SeamStrategy::Greedy:
+        seam = vertical ? seamCarver.findVerticalSeamGreedy(energy) : seamCarver.findHorizontalSeamGreedy(energy);
+        break;
+    case SeamStrategy::Pyramid:
+        seam = vertical ? seamCarver.findVerticalSeamPyramid(energy) : seamCarver.findHorizontalSeamPyramid(energy);
+        break;
+    case SeamStrategy::GraphCut:
+    default: {
+        // Graph solvers need non-negative costs
+        const cv::Mat* graph = &energy;
+        if (!currentMask.empty()) {
+            currentMask.applyShiftedTo(energy, shiftedEnergy);
+            graph = &shiftedEnergy;
+        }
+        seam = vertical ? seamCarver.findVerticalSeamGraphCut(*graph)
+                        : seamCarver.findHorizontalSeamGraphCut(*graph);
+        break;
+    }
+    }
+    if (seam.empty()) return seam;
+    commitStep(seam, vertical, !forward && seamCarver.isIncrementalEnergy());
+    return seam;
+}
+
+std::vector<int> CarveSession::stepCheapest(int verticalLeft, int horizontalLeft, bool& vertical) {
+    if (strategy != SeamStrategy::DP || usesForwardEnergy() || verticalLeft <= 0 || horizontalLeft <= 0 ||
+        currentImage.cols <= 1 || currentImage.rows <= 1) {
+        vertical = verticalLeft > 0;
+        return step(vertical);
+    }
+    prepareEnergy();
+    std::vector<int> seam;
+    vertical = seamCarver.findCheapestSeamDP(energy, verticalLeft, horizontalLeft, seam);
+    commitStep(seam, vertical, seamCarver.isIncrementalEnergy());
+    return seam;
+}
+
+// Forward-energy DP reads its costs from the gray plane; a mask needs
+// a map to fold into, so it falls back to backward energy
+bool CarveSession::usesForwardEnergy() const {
+    return strategy == SeamStrategy::DP && seamCarver.getEnergyModel() == EnergyModel::Forward &&
+           currentMask.empty();
+}
+
+const cv::Mat& CarveSession::energyMap() {
+    prepareEnergy();
+    return energy;
+}
+
+void CarveSession::prepareEnergy() {
+    if (!energyValid()) {
+        energy = seamCarver.calculateEnergyFromGray(currentGray);
+        energyPrecision = seamCarver.getPrecision();
+        energyFunction = seamCarver.getEnergyFunction();
+    }
+    // A CV_16U (Fixed16) map cannot hold the mask energies; it is kept as
+    // Float from here on and patched at Float rounding
+    if (!currentMask.empty() && energy.depth() == CV_16U) {
+        energy.convertTo(energy, CV_32F, 1.0 / SeamCarver::kFixedEnergyScale);
+    }
+    currentMask.applyTo(energy);
+}
+
+void CarveSession::commitStep(const std::vector<int>& seam, bool vertical, bool patchEnergy) {
+    future.clear();
+    const double seamEnergy = !usesForwardEnergy() && energyValid() ? seamCarver.seamEnergy(energy, seam, vertical) : 0.0;
+    energyRemoved += seamEnergy;
+    if (maxHistory > 0) {
+        history.push_back(record(seam, vertical, seamEnergy));
+        if (history.size() > maxHistory) history.pop_front();
+    }
+    removeSeam(seam, vertical, patchEnergy);
+}
+
+CarveSession::Step CarveSession::record(const std::vector<int>& seam, bool vertical, double seamEnergy) const {
+    Step s;
+    s.vertical = vertical;
+    s.energy = seamEnergy;
+    s.seam = PackedSeam(seam);
+    s.pixels = seamPixels(currentImage, seam, vertical);
+    s.grayPixels = seamPixels(currentGray, seam, vertical);
+    s.maskBits = currentMask.seamBits(seam, vertical);
+    return s;
+}
+
+// Copy-on-write: the planes share the source image and the carver's gray
+// plane until the first in-place removal
+void CarveSession::detach() {
+    if (!sharedPlanes) return;
+    currentImage = currentImage.clone();
+    currentGray = currentGray.clone();
+    sharedPlanes = false;
+}
+
+void CarveSession::removeSeam(const std::vector<int>& seam, bool vertical, bool patchEnergy) {
+    detach();
+    const bool patch = patchEnergy && energyValid();
+    if (vertical) {
+        seamCarver.removeVerticalSeamInPlace(currentImage, seam);
+        seamCarver.removeVerticalSeamInPlace(currentGray, seam);
+        currentMask.removeVerticalSeam(seam);
+        if (patch) seamCarver.updateEnergyAfterVerticalSeamInPlace(energy, currentGray, seam);
+    } else {
+        seamCarver.removeHorizontalSeamInPlace(currentImage, seam);
+        seamCarver.removeHorizontalSeamInPlace(currentGray, seam);
+        currentMask.removeHorizontalSeam(seam);
+        if (patch) seamCarver.updateEnergyAfterHorizontalSeamInPlace(energy, currentGray, seam);
+    }
+    if (!patch) energy.release();
+    seamCarver.sampleMemory({ &currentImage, &currentGray, &energy });
+    removed++;
+}
+
+void CarveSession::insertSeam(const Step& s) {
+    s.seam.unpack(seamScratch);
+    currentImage = insertPixels(currentImage, seamScratch, s.pixels, s.vertical);
+    currentGray = insertPixels(currentGray, seamScratch, s.grayPixels, s.vertical);
+    if (s.vertical) currentMask.insertVerticalSeam(seamScratch, s.maskBits);
+    else currentMask.insertHorizontalSeam(seamScratch, s.maskBits);
+    energy.release();
+    removed--;
+}
+
+int CarveSession::stepMany(bool vertical, int n) {
+    int taken = 0;
+    while (taken < n && !step(vertical).empty()) taken++;
+    return taken;
+}
+
+bool CarveSession::undo() {
+    if (history.empty()) return false;
+    insertSeam(history.back());
+    energyRemoved -= history.back().energy;
+    future.push_back(std::move(history.back()));
+    history.pop_back();
+    return true;
+}
+
+bool CarveSession::redo() {
+    if (future.empty()) return false;
+    // The seam was found on exactly this image, so no search is needed
+    future.back().seam.unpack(seamScratch);
+    removeSeam(seamScratch, future.back().vertical, false);
+    energyRemoved += future.back().energy;
+    history.push_back(std::move(future.back()));
+    future.pop_back();
+    return true;
+}
+
+void CarveSession::scrubTo(int position) {
+    while (removed > position && undo()) {}
+    while (removed < position && redo()) {}
+}
+
+void CarveSession::setUndoLimit(size_t steps) {
+    maxHistory = steps;
+    while (history.size() + future.size() > maxHistory) {
+        if (!history.empty()) history.pop_front();
+        else future.erase(future.begin());
+    }
+}
+
+void CarveSession::enlarge(int newWidth, int newHeight, const CancelToken* cancel) {
+    currentImage = seamCarver.enlargeImage(currentImage, std::max(newWidth, currentImage.cols),
+                                           std::max(newHeight, currentImage.rows), ProgressCallback(), cancel);
+    currentGray = seamCarver.toGray(currentImage).clone();
+    energy.release();
+    currentMask = SeamMask();
+    history.clear();
+    future.clear();
+}
@@ -0,0 +1,169 @@
+#ifndef CARVE_SESSION_H
+#define CARVE_SESSION_H
+
+#include "SeamCarver.h"
+#include "SeamPack.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/**
+ * @brief Interactive, seam-by-seam carving of one image with undo.
+ *
+ * The session owns every working buffer: the image and its gray plane,
+ * the energy map (patched along each seam when the carver has incremental
+ * energy on), the protect/remove mask, and through its SeamCarver the DP,
+ * backpointer and graph workspaces of the seam finders. Settings such as
+ * the precision, energy function or thread counts are made on carver().
+ *
+ * Each step records only its seam, packed to 2-bit moves (PackedSeam), with
+ * the removed image, gray and mask values: O(H) memory per vertical seam
+ * rather than a frame snapshot. undo() reinserts the last seam exactly and
+ * redo() removes it again without a new search, so scrubTo() can move a
+ * timeline slider over up to undoLimit() steps in either direction.
+ */
+class CarveSession {
+public:
+    // Steps kept for undo() unless setUndoLimit says otherwise
+    static constexpr size_t kDefaultUndoLimit = 1024;
+
+    /**
+     * @brief Start from image (see SeamCarver::isSupportedImageType). The buffer is
+     * shared until the first step, which carves a copy; the session never
+     * writes into it.
+     */
+    explicit CarveSession(const cv::Mat& image);
+
+    /**
+     * @brief Carve image (shared as above) from now on; drops the history and the
+     * mask but keeps the carver and its settings.
+     */
+    void reset(const cv::Mat& image);
+
+    // @brief Settings and seam finders. Its own image is the image the
+    // session last started from; resizing it does not affect the session.
+    SeamCarver& carver() { return seamCarver; }
+    const SeamCarver& carver() const { return seamCarver; }
+
+    void setStrategy(SeamStrategy s) { strategy = s; }
+    SeamStrategy getStrategy() const { return strategy; }
+
+    /**
+     * @brief Protect/remove masks of the current image size (see
+     * SeamCarver::setMask); carved with the image and restored by undo.
+     * Drops the undo and redo steps, which were taken without it.
+     */
+    void setMask(const cv::Mat& protect, const cv::Mat& remove);
+
+    /**
+     * @brief Find and remove one seam with the current strategy.
+     * @return the seam, in the coordinates of the image before the step;
+     *         empty when the image is a single pixel wide (tall)
+     */
+    std::vector<int> step(bool vertical);
+
+    // @brief Up to n steps in one direction; returns the number taken.
+    int stepMany(bool vertical, int n);
+
+    /**
+     * @brief One step in the cheaper direction given the seams still to
+     * remove per axis (SeamCarver::findCheapestSeamDP). Other strategies
+     * and forward energy step vertically while verticalLeft > 0.
+     * @param vertical set to the direction taken
+     */
+    std::vector<int> stepCheapest(int verticalLeft, int horizontalLeft, bool& vertical);
+
+    /**
+     * @brief Put the last removed seam back. Returns false when there is
+     * nothing to undo.
+     */
+    bool undo();
+    bool canUndo() const { return !history.empty(); }
+
+    /**
+     * @brief Remove the last undone seam again. Returns false when there
+     * is nothing to redo; a step() drops the redo steps.
+     */
+    bool redo();
+    bool canRedo() const { return !future.empty(); }
+
+    /**
+     * @brief Undo or redo until seamsRemoved() == position, clamped to
+     * [earliestPosition(), latestPosition()].
+     */
+    void scrubTo(int position);
+    int earliestPosition() const { return removed - static_cast<int>(history.size()); }
+    int latestPosition() const { return removed + static_cast<int>(future.size()); }
+
+    // @brief Undo steps kept (redo steps count against the same limit).
+    void setUndoLimit(size_t steps);
+    size_t undoLimit() const { return maxHistory; }
+
+    /**
+     * @brief Enlarge by seam insertion (SeamCarver::enlargeImage) to at
+     * least newWidth x newHeight. Drops the history and the mask, since
+     * inserted seams have neither. Throws CarveCancelled if cancel is set.
+     */
+    void enlarge(int newWidth, int newHeight, const CancelToken* cancel = nullptr);
+
+    const cv::Mat& image() const { return currentImage; }
+    const cv::Mat& gray() const { return currentGray; }
+    const SeamMask& mask() const { return currentMask; }
+
+    /**
+     * @brief Backward energy map of the current image with the mask
+     * applied, as the next step searches it. Computed here when stale (the
+     * first call after a load, undo or forward-energy step); otherwise the
+     * incrementally patched map is returned as it is.
+     */
+    const cv::Mat& energyMap();
+    int seamsRemoved() const { return removed; }
+
+    /**
+     * @brief Total energy of the seams removed so far, each summed on the
+     * (masked) energy map it was found on; undo and redo take it back and
+     * add it again. Forward-energy DP steps have no energy map and add 0.
+     */
+    double removedEnergy() const { return energyRemoved; }
+
+private:
+    // What undo() needs to reverse one step, and redo() to repeat it
+    struct Step {
+        bool vertical = true;
+        PackedSeam seam;
+        cv::Mat pixels;                 // removed image pixels, rows x 1 or 1 x cols
+        cv::Mat grayPixels;             // same for the gray plane
+        std::vector<uint8_t> maskBits;  // SeamMask::seamBits (empty without a mask)
+        double energy = 0.0;            // added to removedEnergy() by the step
+    };
+
+    void adopt(const cv::Mat& image);
+    void detach();
+    bool energyValid() const;
+    bool usesForwardEnergy() const;
+    void prepareEnergy();
+    void commitStep(const std::vector<int>& seam, bool vertical, bool patchEnergy);
+    Step record(const std::vector<int>& seam, bool vertical, double seamEnergy) const;
+    void removeSeam(const std::vector<int>& seam, bool vertical, bool patchEnergy);
+    void insertSeam(const Step& s);
+
+    SeamCarver seamCarver;
+    SeamStrategy strategy = SeamStrategy::DP;
+    cv::Mat currentImage;
+    cv::Mat currentGray;
+    bool sharedPlanes = false;  // the planes are still headers of the source
+    cv::Mat energy;  // of currentGray with the mask applied (empty = recompute)
+    cv::Mat shiftedEnergy;  // graph cut's non-negative copy of a masked energy
+    EnergyPrecision energyPrecision = EnergyPrecision::Double;
+    EnergyFunction energyFunction = EnergyFunction::Sobel;
+    SeamMask currentMask;
+    std::deque<Step> history;  // oldest first
+    std::vector<Step> future;  // undone steps, next redo last
+    size_t maxHistory = kDefaultUndoLimit;
+    int removed = 0;
+    double energyRemoved = 0.0;
+    std::vector<int> seamScratch;  // unpacked seam of undo() and redo()
+};
+
+#endif // CARVE_SESSION_H
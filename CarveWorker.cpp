@@ -0,0 +1,418 @@
+#include "CarveWorker.h"
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+// Publish at most this often while a run is going (about one 60 Hz frame)
+const std::chrono::milliseconds kPublishInterval(16);
+
+SeamStrategy strategyFor(CarveMethod method) {
+    switch (method) {
+    case CarveMethod::Greedy:  return SeamStrategy::Greedy;
+    case CarveMethod::Graph:   return SeamStrategy::GraphCut;
+    case CarveMethod::Pyramid: return SeamStrategy::Pyramid;
+    case CarveMethod::DP:
+    default:                   return SeamStrategy::DP;
+    }
+}
+
+// Heap allocations of this thread since start
+HeapCounter heapSince(const HeapCounter& start) {
+    const HeapCounter& now = threadHeapCounter();
+    HeapCounter since;
+    since.allocations = now.allocations - start.allocations;
+    since.bytes = now.bytes - start.bytes;
+    return since;
+}
+
+} // namespace
+
+void applyCarveSettings(CarveSession& session, const CarveSettings& settings) {
+    session.setStrategy(strategyFor(settings.method));
+    session.carver().setEnergyModel(settings.energyModel);
+    session.carver().setPrecision(settings.precision);
+    session.carver().setEnergyFunction(settings.energyFunction);
+    session.carver().setGraphQueue(settings.graphQueue);
+    session.carver().setGraphSolver(settings.graphSolver);
+    session.carver().setGreedyBeamWidth(settings.greedyBeamWidth);
+    session.carver().setGreedyStarts(settings.greedyStarts);
+}
+
+CarveWorker::CarveWorker()
+    : thread([this] { threadMain(); }) {
+}
+
+CarveWorker::~CarveWorker() {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        pendingCommand = Command::Quit;
+        commandPending = true;
+    }
+    commandReady.notify_one();
+    thread.join();
+}
+
+void CarveWorker::load(const cv::Mat& image, int seamsRemovedSoFar) {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        pendingCommand = Command::Load;
+        pendingImage = image;
+        pendingSeamsRemoved = seamsRemovedSoFar;
+        commandPending = true;
+        cancelCarve.cancel();
+    }
+    commandReady.notify_one();
+}
+
+void CarveWorker::start(CarveRun newRun, const CarveSettings& newSettings) {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        if (pendingCommand != Command::Load) {  // a pending load runs first
+            pendingCommand = Command::Start;
+        }
+        pendingRun = newRun;
+        pendingSettings = newSettings;
+        commandPending = true;
+        cancelCarve.cancel();
+    }
+    commandReady.notify_one();
+}
+
+void CarveWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        if (pendingCommand != Command::Load) {
+            pendingCommand = Command::Stop;
+        }
+        pendingRun = CarveRun::None;
+        commandPending = true;
+        cancelCarve.cancel();
+    }
+    commandReady.notify_one();
+}
+
+void CarveWorker::undo() {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        if (pendingCommand != Command::Load) {
+            pendingCommand = Command::Undo;
+        }
+        pendingRun = CarveRun::None;
+        commandPending = true;
+        cancelCarve.cancel();
+    }
+    commandReady.notify_one();
+}
+
+void CarveWorker::scrub(int position) {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        if (pendingCommand != Command::Load) {
+            pendingCommand = Command::Scrub;
+        }
+        pendingPosition = position;
+        pendingRun = CarveRun::None;
+        commandPending = true;
+        cancelCarve.cancel();
+    }
+    commandReady.notify_one();
+}
+
+void CarveWorker::setHeatmaps(bool on) {
+    if (heatmaps.exchange(on) == on || !on) return;
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        // Any other command publishes soon enough by itself
+        if (pendingCommand != Command::None) return;
+        pendingCommand = Command::Publish;
+        commandPending = true;
+    }
+    commandReady.notify_one();
+}
+
+const CarveSnapshot* CarveWorker::poll() {
+    return snapshots.consume() ? &snapshots.readSlot() : nullptr;
+}
+
+void CarveWorker::frameTick() {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        frameCounter++;
+    }
+    commandReady.notify_one();
+}
+
+void CarveWorker::threadMain() {
+    for (;;) {
+        Command command = Command::None;
+        {
+            std::unique_lock<std::mutex> lock(commandMutex);
+            if (run == CarveRun::None) {
+                commandReady.wait(lock, [this] { return commandPending.load(); });
+            }
+            else if (waitingForFrame) {
+                // Budgeted runs carve one slice per UI frame
+                commandReady.wait(lock, [this] { return commandPending || frameCounter != seenFrame; });
+            }
+            if (commandPending) {
+                command = pendingCommand;
+                pendingCommand = Command::None;
+                commandPending = false;
+                if (command == Command::Quit) return;
+                apply(command);
+            }
+            if (waitingForFrame && frameCounter != seenFrame) {
+                seenFrame = frameCounter;
+                waitingForFrame = false;
+            }
+        }
+
+        if (run == CarveRun::None || waitingForFrame) continue;
+
+        bool show = true;
+        bool progressed = false;
+        if (settings.frameBudgetMs > 0.0 && run != CarveRun::Step) {
+            progressed = carveSlice();
+            waitingForFrame = true;
+        }
+        else {
+            // One seam per iteration so new commands are picked up quickly
+            auto now = std::chrono::steady_clock::now();
+            show = run == CarveRun::Step || now - lastPublish >= kPublishInterval;
+            progressed = carveRunStep(show);
+            sliceSeams = 1;
+        }
+
+        if (!progressed || run == CarveRun::Step) {
+            completed = !progressed && error.empty();
+            runHeap = heapSince(runHeapStart);
+            run = CarveRun::None;
+            waitingForFrame = false;
+            show = true;
+        }
+        if (show) publish();
+    }
+}
+
+bool CarveWorker::carveRunStep(bool show) {
+    switch (run) {
+    case CarveRun::Step:
+        if (settings.cheapestDirection) return carveCheapest(show);
+        return carveOnce(settings.stepVertical, show);
+    case CarveRun::Vertical:
+        return carveOnce(true, show);
+    case CarveRun::Horizontal:
+        return carveOnce(false, show);
+    case CarveRun::Full:
+        if (settings.cheapestDirection) {
+            if (carveCheapest(show)) return true;
+            if (!error.empty()) return false;
+        }
+        if (session->image().cols > settings.targetWidth) return carveOnce(true, show);
+        if (session->image().rows > settings.targetHeight) return carveOnce(false, show);
+        return enlargeOnce();
+    case CarveRun::None:
+        break;
+    }
+    return false;
+}
+
+// Carve seams until the frame budget is used up. Only the seam expected to
+// be the last one of the slice is handed to the UI for its overlay.
+bool CarveWorker::carveSlice() {
+    using Ms = std::chrono::duration<double, std::milli>;
+    auto sliceStart = std::chrono::steady_clock::now();
+    sliceSeams = 0;
+    for (;;) {
+        auto seamStart = std::chrono::steady_clock::now();
+        double elapsed = Ms(seamStart - sliceStart).count();
+        bool last = elapsed + seamMsEstimate >= settings.frameBudgetMs || commandPending;
+
+        if (!carveRunStep(last)) return false;
+        sliceSeams++;
+
+        double seamMs = Ms(std::chrono::steady_clock::now() - seamStart).count();
+        seamMsEstimate = seamMsEstimate > 0.0 ? 0.8 * seamMsEstimate + 0.2 * seamMs : seamMs;
+        if (last) return true;
+    }
+}
+
+// Called with commandMutex held
+void CarveWorker::apply(Command command) {
+    cancelCarve.reset();
+    switch (command) {
+    case Command::Load:
+        session = std::make_unique<CarveSession>(pendingImage);
+        pendingImage.release();
+        seamsRemoved = pendingSeamsRemoved;
+        session->carver().setLogger(streamLogger(std::cout));
+        // Use the idle cores for the energy and DP; after the first seam
+        // only the band along each removed seam is recomputed
+        session->carver().setEnergyThreads(std::max(1u, std::thread::hardware_concurrency()));
+        session->carver().setDPThreads(session->carver().getEnergyThreads());
+        // Interactive runs wait on one seam at a time: search it from both
+        // ends where the image is too narrow for column chunks
+        session->carver().setBidirectionalDP(true);
+        session->carver().setIncrementalEnergy(true);
+        run = CarveRun::None;
+        lastRun = CarveRun::None;
+        completed = false;
+        error.clear();
+        if (pendingRun == CarveRun::None) {
+            publish();
+            break;
+        }
+        [[fallthrough]];  // load and start sent together
+    case Command::Start:
+        if (!session) break;
+        settings = pendingSettings;
+        run = lastRun = pendingRun;
+        pendingRun = CarveRun::None;
+        completed = false;
+        error.clear();
+        applyCarveSettings(*session, settings);
+        session->carver().resetMemoryStats();
+        runStart = std::chrono::steady_clock::now();
+        runHeapStart = threadHeapCounter();
+        runHeap = HeapCounter();
+        break;
+    case Command::Stop:
+        if (run != CarveRun::None) {
+            run = CarveRun::None;
+            publish();
+        }
+        break;
+    case Command::Publish:
+        // A running run publishes on its own
+        if (run == CarveRun::None) publish();
+        break;
+    case Command::Undo:
+    case Command::Scrub:
+        run = CarveRun::None;
+        if (session) {
+            // seamsRemoved continues the count from load(); the session's starts at 0
+            const int base = seamsRemoved - session->seamsRemoved();
+            if (command == Command::Undo) session->undo();
+            else session->scrubTo(pendingPosition - base);
+            seamsRemoved = base + session->seamsRemoved();
+            shownSeam.clear();
+            publish();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Find and remove one seam; returns false when the target is reached
+bool CarveWorker::carveOnce(bool vertical, bool show) {
+    if (!session) return false;
+    const cv::Mat& image = session->image();
+    if (vertical ? image.cols <= settings.targetWidth : image.rows <= settings.targetHeight) {
+        return false;
+    }
+
+    try {
+        return stepTaken(session->step(vertical), vertical, show);
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+}
+
+// One seam in the cheaper direction while both sizes are above the target
+// (else in the one that is); false once both are reached
+bool CarveWorker::carveCheapest(bool show) {
+    if (!session) return false;
+    const int verticalLeft = session->image().cols - settings.targetWidth;
+    const int horizontalLeft = session->image().rows - settings.targetHeight;
+    if (verticalLeft <= 0 && horizontalLeft <= 0) return false;
+
+    try {
+        bool vertical = true;
+        std::vector<int> seam = session->stepCheapest(verticalLeft, horizontalLeft, vertical);
+        return stepTaken(std::move(seam), vertical, show);
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+}
+
+bool CarveWorker::stepTaken(std::vector<int> seam, bool vertical, bool show) {
+    if (seam.empty()) return false;
+    if (show) {
+        // The UI draws it over the image; no pixels are touched here
+        shownSeam = std::move(seam);
+        shownSeamVertical = vertical;
+    }
+    seamsRemoved++;
+    return true;
+}
+
+// Insert every missing seam in one step; returns false when there are none
+bool CarveWorker::enlargeOnce() {
+    if (!session ||
+        (session->image().cols >= settings.targetWidth && session->image().rows >= settings.targetHeight)) {
+        return false;
+    }
+    try {
+        session->enlarge(settings.targetWidth, settings.targetHeight, &cancelCarve);
+        return true;
+    }
+    catch (const CarveCancelled&) {
+        // A command is pending; the run goes on or ends when it is applied
+        return true;
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+}
+
+void CarveWorker::publish() {
+    CarveSnapshot& snap = snapshots.writeSlot();
+    if (session) session->image().copyTo(snap.image);  // reuses the slot's buffer when the size matches
+    else snap.image.release();
+    snap.seam.assign(shownSeam.begin(), shownSeam.end());
+    snap.seamVertical = shownSeamVertical;
+    shownSeam.clear();
+    snap.seamsRemoved = seamsRemoved;
+    snap.sliceSeams = sliceSeams;
+    snap.run = run;
+    snap.lastRun = lastRun;
+    snap.completed = completed;
+    snap.elapsedMs = lastRun == CarveRun::None ? 0.0
+        : std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - runStart).count();
+    snap.error = error;
+    const int base = session ? seamsRemoved - session->seamsRemoved() : seamsRemoved;
+    snap.historyFirst = session ? base + session->earliestPosition() : seamsRemoved;
+    snap.historyLast = session ? base + session->latestPosition() : seamsRemoved;
+    snap.stats = session ? session->carver().stats() : SeamCarverStats();
+    // The steps run outside any resize call, so the worker counts the
+    // run's allocations itself
+    if (run != CarveRun::None) runHeap = heapSince(runHeapStart);
+    snap.stats.memory.allocations = runHeap.allocations;
+    snap.stats.memory.allocatedBytes = runHeap.bytes;
+    snap.stats.memory.heapCounted = heapCountingLinked();
+    if (heatmaps && session) {
+        try {
+            session->energyMap().copyTo(snap.energy);
+            snap.cost = session->carver().costTable(snap.energy, shownSeamVertical);
+            snap.costVertical = shownSeamVertical;
+        }
+        catch (const std::exception& e) {
+            snap.energy.release();
+            snap.cost.release();
+            snap.error = e.what();
+        }
+    }
+    else {
+        snap.energy.release();
+        snap.cost.release();
+    }
+    snapshots.publish();
+    lastPublish = std::chrono::steady_clock::now();
+}
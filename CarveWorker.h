@@ -0,0 +1,234 @@
+#ifndef CARVE_WORKER_H
+#define CARVE_WORKER_H
+
+#include "CarveSession.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Single-producer / single-consumer triple buffer. The writer fills
+ * writeSlot() and publishes it; the reader takes the newest published slot
+ * with consume(). Neither side ever blocks or waits for the other.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    // @brief Slot owned by the writer until publish().
+    T& writeSlot() { return slots[back]; }
+
+    // @brief Hand the write slot to the reader (replacing any unread one).
+    void publish() { back = middle.exchange(back | kFresh) & kIndex; }
+
+    // @brief Take the newest published slot; false if nothing new arrived.
+    bool consume() {
+        if (!(middle.load() & kFresh)) return false;
+        front = middle.exchange(front) & kIndex;
+        return true;
+    }
+
+    // @brief Slot owned by the reader until the next consume().
+    const T& readSlot() const { return slots[front]; }
+
+private:
+    static constexpr int kIndex = 3;
+    static constexpr int kFresh = 4;
+
+    T slots[3];
+    int back = 0;                 // writer only
+    int front = 1;                // reader only
+    std::atomic<int> middle{ 2 }; // shared: index | kFresh
+};
+
+// Seam finder used by the GUI worker
+enum class CarveMethod {
+    DP,
+    Greedy,
+    Graph,
+    Pyramid
+};
+
+// What the worker is carving
+enum class CarveRun {
+    None,
+    Step,        // one seam in the step direction
+    Vertical,    // down to the target width
+    Horizontal,  // down to the target height
+    Full         // width first (or cheapest direction first), then height, then
+                 // seam insertion up to the target
+};
+
+/**
+ * @brief Carving parameters sent with every run.
+ */
+struct CarveSettings {
+    CarveMethod method = CarveMethod::DP;
+    EnergyPrecision precision = EnergyPrecision::Double;
+    EnergyModel energyModel = EnergyModel::Backward;  // DP method only
+    EnergyFunction energyFunction = EnergyFunction::Sobel;
+    GraphQueue graphQueue = GraphQueue::BinaryHeap;
+    GraphSolver graphSolver = GraphSolver::Dijkstra;
+    int greedyBeamWidth = 1;  // Greedy method only
+    int greedyStarts = 1;     // Greedy method only
+    int targetWidth = 0;
+    int targetHeight = 0;
+    bool stepVertical = true;  // direction of CarveRun::Step
+    bool cheapestDirection = false;  // Step and Full: the cheaper DP seam of both directions
+    double frameBudgetMs = 0.0;  // > 0: carve this long per UI frame, then wait for frameTick()
+};
+
+/**
+ * @brief Set session's strategy and its carver's seam finder and energy
+ * settings from settings (everything but the run targets and pacing).
+ */
+void applyCarveSettings(CarveSession& session, const CarveSettings& settings);
+
+/**
+ * @brief State published by the worker for the UI.
+ */
+struct CarveSnapshot {
+    cv::Mat image;                   // working image
+    std::vector<int> seam;           // last shown seam, in the coordinates it was
+                                     // removed from; empty when there is none
+    bool seamVertical = true;
+    int seamsRemoved = 0;
+    int sliceSeams = 0;              // seams removed since the previous snapshot's slice
+    CarveRun run = CarveRun::None;   // run in progress (None when idle)
+    CarveRun lastRun = CarveRun::None;
+    bool completed = false;          // lastRun reached its target
+    double elapsedMs = 0.0;          // wall time of lastRun so far
+    int historyFirst = 0;            // seamsRemoved values scrub() can reach;
+    int historyLast = 0;             // undo() works while seamsRemoved > historyFirst
+    SeamCarverStats stats;           // worker carver's phase stats since the last load;
+                                     // stats.memory covers lastRun only
+    cv::Mat energy;                  // with setHeatmaps on: the session's energy map
+    cv::Mat cost;                    // and its DP cost table (SeamCarver::costTable)
+    bool costVertical = true;        // direction of cost: that of the last seam
+    std::string error;
+};
+
+/**
+ * @brief Carves on a background thread so the UI frame never waits on
+ * energy, seam search or removal. Runs go at full compute speed, publishing
+ * a snapshot at most about once per frame interval (and always when a run
+ * ends) through a TripleBuffer. With a frame budget the worker instead
+ * carves as many seams as fit the budget, publishes once and waits for the
+ * next frameTick().
+ */
+class CarveWorker {
+public:
+    CarveWorker();
+    ~CarveWorker();
+
+    CarveWorker(const CarveWorker&) = delete;
+    CarveWorker& operator=(const CarveWorker&) = delete;
+
+    /**
+     * @brief Stop any run and carve from image next. The buffer is shared,
+     * not copied, and is never written: the worker's session copies it on
+     * the first seam removal.
+     * @param seamsRemoved counter value to continue from
+     */
+    void load(const cv::Mat& image, int seamsRemoved = 0);
+
+    /**
+     * @brief Start (or replace) a run with the given settings.
+     */
+    void start(CarveRun run, const CarveSettings& settings);
+
+    /**
+     * @brief Stop the current run after the seam in progress (seam
+     * insertion stops between seams).
+     */
+    void stop();
+
+    /**
+     * @brief Stop any run and put the last removed seam back.
+     */
+    void undo();
+
+    /**
+     * @brief Stop any run and undo or redo seams until seamsRemoved is
+     * position (clamped to the snapshot's history range).
+     */
+    void scrub(int position);
+
+    /**
+     * @brief Publish the energy map and DP cost table with every snapshot
+     * (off by default: the table costs a DP pass per snapshot). Turning it
+     * on while idle publishes at once.
+     */
+    void setHeatmaps(bool on);
+
+    /**
+     * @brief Called by the UI once per frame; paces frame-budgeted runs.
+     */
+    void frameTick();
+
+    /**
+     * @brief Fetch the newest snapshot, if any; never blocks. The returned
+     * snapshot stays valid until the next poll().
+     */
+    const CarveSnapshot* poll();
+
+private:
+    enum class Command { None, Load, Start, Stop, Undo, Scrub, Publish, Quit };
+
+    void threadMain();
+    void apply(Command command);
+    bool carveRunStep(bool show);
+    bool carveSlice();
+    bool carveOnce(bool vertical, bool show);
+    bool carveCheapest(bool show);
+    // Count a seam the session removed and keep it for the UI if show
+    bool stepTaken(std::vector<int> seam, bool vertical, bool show);
+    bool enlargeOnce();
+    void publish();
+
+    // UI -> worker command slot (rare, so a mutex is fine)
+    std::mutex commandMutex;
+    std::condition_variable commandReady;
+    std::atomic<bool> commandPending{ false };
+    Command pendingCommand = Command::None;
+    cv::Mat pendingImage;
+    int pendingSeamsRemoved = 0;
+    int pendingPosition = 0;
+    CarveRun pendingRun = CarveRun::None;
+    CarveSettings pendingSettings;
+    CancelToken cancelCarve;  // set with every command, stops a long enlarge
+    std::atomic<bool> heatmaps{ false };
+
+    // Worker-owned carving state
+    std::unique_ptr<CarveSession> session;
+    int seamsRemoved = 0;
+    CarveRun run = CarveRun::None;
+    CarveRun lastRun = CarveRun::None;
+    bool completed = false;
+    CarveSettings settings;
+    std::string error;
+    std::chrono::steady_clock::time_point runStart;
+    HeapCounter runHeapStart;  // worker thread's allocations when the run started
+    HeapCounter runHeap;       // and the run's own, up to its end
+    std::chrono::steady_clock::time_point lastPublish;
+    std::vector<int> shownSeam;  // seam for the next snapshot's overlay
+    bool shownSeamVertical = true;
+
+    // Frame pacing (frameCounter/seenFrame guarded by commandMutex)
+    unsigned frameCounter = 0;
+    unsigned seenFrame = 0;
+    bool waitingForFrame = false;
+    int sliceSeams = 0;
+    double seamMsEstimate = 0.0;
+
+    // Worker -> UI snapshots
+    TripleBuffer<CarveSnapshot> snapshots;
+
+    std::thread thread;
+};
+
+#endif // CARVE_WORKER_H
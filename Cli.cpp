@@ -0,0 +1,1509 @@
+#include "Cli.h"
+#include "BatchScheduler.h"
+#include "CarveCache.h"
+#include "SeamCarver.h"
+#include "SeamDecode.h"
+#include "SeamGpu.h"
+#include "SeamMap.h"
+#include "SeamMemory.h"
+#include "SeamMetrics.h"
+#include "SeamSettings.h"
+#include "SeamStream.h"
+#include "SeamTiles.h"
+#include "SeamVideo.h"
+#include "SeamTrace.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct CliOptions {
+    std::vector<std::string> inputs;
+    std::string width = "100%";
+    std::string height = "100%";
+    std::string method = "dp";          // dp | greedy | pyramid | graph
+    std::string precision = "double";   // double | float | fixed16
+    std::string energy = "backward";    // backward | forward
+    std::string energyFunction = "sobel";  // sobel | scharr | dual | l1 | saliency | fast
+    std::string seamOrder = "width";    // width | optimal | cheapest
+    int beamWidth = 1;                  // greedy only
+    int greedyStarts = 1;               // greedy only
+    int seamStep = 1;                   // columns a dp or greedy seam may move per row
+    std::string outputDir = "output";
+    std::string naming = "source";      // source | gui
+    int threads = 1;
+    int energyThreads = 1;
+    int dpThreads = 1;
+    bool bidirectionalDP = false;       // meet-in-the-middle DP on 2+ DP threads
+    int lazyRemoval = 0;                // seams per image compaction, 0: every seam
+    bool shareThreads = false;          // images and their kernels on one -j pool
+    bool pinWorkers = false;            // one CPU per -j worker
+    bool hugePages = false;             // scratch planes on huge pages
+    int numaNode = BufferPlacement::kFirstTouch;
+    int encodeThreads = 0;              // 0: -j
+    EncodeOptions encode;
+    size_t memoryBudgetMB = 1024;
+    std::string cacheDir;               // empty: no cache
+    std::string protectMask;            // mask images, empty: none
+    std::string removeMask;
+    std::string removeObject;           // empty | restore | shrink
+    std::string traceFile;              // empty: no trace
+    std::string metricsFile;            // empty: no metrics dump
+    int metricsIntervalMs = 10000;
+    double timeoutMs = 0;               // per image carve, 0: none
+    double carveQuality = 1.0;          // below 1: hybrid scale + carve
+    double borderTrim = -1.0;           // 0 or above: crop flat borders first
+    std::string region;                 // "x,y,w,h" the seams stay inside; empty: whole image
+    bool fullDecode = false;            // no reduced JPEG decode for --carve-quality
+    std::vector<std::string> sizes;     // "W" or "WxH" each; all carved in one run
+    int streamRows = 0;                 // > 0: carve mapped PPM/PGM inputs in strips
+    int tiles = 0;                      // > 0: carve the width in this many parallel tiles
+    int tileOverlap = TileCarver::kDefaultOverlap;
+    bool opencl = false;                // carve on the OpenCL device (GpuCarver)
+    bool video = false;                 // inputs are videos (VideoCarver)
+    int corridor = VideoCarver::kDefaultCorridor;
+    int keyframeInterval = VideoCarver::kDefaultKeyframeInterval;
+    int blockFrames = VideoCarver::kDefaultBlockFrames;
+    bool yuv = false;                   // carve video frames as 4:2:0 planes
+    std::string fourcc;                 // empty: the input's codec
+    size_t cacheMB = CarveCache::kDefaultMemoryBudget >> 20;
+    bool incremental = true;
+    bool compactGraph = false;
+    bool seamMap = false;
+    float seamMapMinPercent = 25.0f;
+    std::string regressFile;            // non-empty: golden regression run (--regress)
+    bool regressRecord = false;
+    double maxSlowdownPct = 10.0;       // negative: no timing gates (--max-slowdown off)
+    int regressRuns = 3;
+    bool quiet = false;
+    bool verbose = false;
+};
+
+struct JobResult {
+    std::string input;
+    std::string output;
+    std::vector<std::string> outputs;   // --sizes: one file per size, in list order
+    std::string error;
+    std::string seamMap = "off";        // off | hit | built
+    std::string cache = "off";          // off | hit | miss
+    int srcWidth = 0, srcHeight = 0;
+    int decodeFactor = 1;               // decoded at 1 / decodeFactor (JPEG, --carve-quality)
+    int dstWidth = 0, dstHeight = 0;
+    double loadMs = 0, carveMs = 0, saveMs = 0;
+    MemoryStats memory;                 // of the resize; zero peak if nothing was carved
+};
+
+void printUsage(std::ostream& os) {
+    os << "Usage: seam_carving [--gui] | [options] <input>...\n"
+          "  <input>                 image file, directory or glob (e.g. photos/*.jpg)\n"
+          "  -w, --width <px|pct%>   target width  (default 100%)\n"
+          "  -h, --height <px|pct%>  target height (default 100%)\n"
+          "  -m, --method <name>     dp | greedy | pyramid | graph (default dp)\n"
+          "  -p, --precision <name>  double | float | fixed16 (default double)\n"
+          "  -e, --energy <model>    backward | forward seam cost for dp (default backward)\n"
+          "  -f, --energy-fn <name>  sobel | scharr | dual | l1 | saliency | fast backward\n"
+          "                          energy (default sobel; l1 is the cheapest, fast is\n"
+          "                          Sobel without the sqrt)\n"
+          "  --beam-width <n>        partial seams kept per row by greedy (default 1)\n"
+          "  --greedy-starts <n>     greedy walks per seam, cheapest kept (default 1)\n"
+          "  --seam-step <n>         columns a dp or greedy seam may move per row, 1..3\n"
+          "                          (default 1; wider steps find one seam at a time)\n"
+          "  --seam-order <order>    width | optimal | cheapest order of dp seams when both\n"
+          "                          sizes shrink (default width; optimal is much slower,\n"
+          "                          cheapest searches both directions at once per seam)\n"
+          "  -o, --output-dir <dir>  output directory (default output)\n"
+          "  --naming <scheme>       source: keep the input file name\n"
+          "                          gui: output_<method>_<w>w_<h>h_<W>x<H>.png\n"
+          "  -j, --threads <n>       images carved in parallel (default 1)\n"
+          "  --energy-threads <n>    threads per image for full energy maps (default 1)\n"
+          "  --dp-threads <n>        threads per image for the vertical DP (default 1)\n"
+          "  --bidirectional-dp      with 2+ DP threads, fill each seam's DP from both ends\n"
+          "                          at once on narrow images (with --no-incremental)\n"
+          "  --lazy-removal <n>      remove seams from the colour image n at a time in one\n"
+          "                          compaction pass instead of shifting it per seam\n"
+          "  --share-threads         carve the images and the energy, DP and removal shares\n"
+          "                          of each on one work-stealing pool of -j threads; the\n"
+          "                          shares of a big image go to threads left idle by the\n"
+          "                          small ones (energy and DP threads default to -j)\n"
+          "  --pin-workers           pin each of the -j carving threads to a CPU of its own\n"
+          "  --huge-pages            put the DP tables and energy maps on 2 MiB pages\n"
+          "                          (reserved ones if any, else transparent)\n"
+          "  --numa <node|local>     prefer that NUMA node (local: the carving thread's)\n"
+          "                          for the DP tables and energy maps\n"
+          "  --encode-threads <n>    images encoded in parallel while the next ones carve\n"
+          "                          (default -j)\n"
+          "  --png-compression <n>   PNG level 0 (fastest) .. 9 (smallest) (default OpenCV's)\n"
+          "  --jpeg-quality <n>      JPEG quality 0..100 (default OpenCV's)\n"
+          "  --webp-quality <n>      WebP quality 1..100, 101 lossless (default OpenCV's)\n"
+          "  --memory-budget <MB>    working-set budget of images in flight (default 1024)\n"
+          "  --cache-dir <dir>       reuse results and energy maps of earlier runs\n"
+          "                          with the same image content and settings\n"
+          "  --cache-mb <MB>         in-memory part of the cache (default 256)\n"
+          "  --no-incremental        recompute energy and DP from scratch per seam\n"
+          "  --compact-graph         graph: float distances and 2-bit parents, about a\n"
+          "                          third of the node state (double seams may differ)\n"
+          "  --seam-map              reuse or create <input>.seammap (dp only); a PPM/PGM\n"
+          "                          its map covers is rendered row by row into the output\n"
+          "                          without decoding either image whole\n"
+          "  --seam-map-min <pct%>   smallest size a new seam map covers (default 25%)\n"
+          "  --protect <mask>        keep the nonzero pixels of this image (input size)\n"
+          "  --remove <mask>         carve the nonzero pixels of this image first\n"
+          "  --remove-object <mode>  carve dp seams until the --remove pixels are gone,\n"
+          "                          then restore the size or shrink (ignores -w/-h)\n"
+          "  --timeout <ms>          fail images whose resize runs longer (default none)\n"
+          "  --carve-quality <q>     0..1: area-scale most of a large reduction first and\n"
+          "                          carve the rest; 1 carves every seam (default 1).\n"
+          "                          JPEGs are decoded at 1/2, 1/4 or 1/8 when the scale\n"
+          "                          would go below that anyway\n"
+          "  --full-decode           always decode JPEGs in full\n"
+          "  --trim-borders <e>      crop border columns/rows whose energy stays at or\n"
+          "                          below e in one step before carving the rest\n"
+          "  --region <x,y,w,h>      keep vertical seams inside columns x..x+w and\n"
+          "                          horizontal seams inside rows y..y+h (px or pct%);\n"
+          "                          energy and DP cover only those bands\n"
+          "  --sizes <list>          comma-separated W or WxH reductions (px or pct%) carved\n"
+          "                          in one run, largest first; each is written as\n"
+          "                          <name>_<w>x<h>.<ext> as the carve passes it\n"
+          "  --tiles <n>             carve the width in n vertical tiles on n threads, then\n"
+          "                          strips across the tile edges; width only, not optimal\n"
+          "  --tile-overlap <px>     half-width of the edge strips (default 64, 0: none)\n"
+          "  --stream <rows>         carve binary PPM/PGM inputs from a memory map in\n"
+          "                          strips of <rows> rows; width only, dp, backward energy\n"
+          "  --opencl                carve on the OpenCL device; dp, backward per-pixel\n"
+          "                          energy at float precision, reduction only\n"
+          "  --video                 inputs are videos; every frame is carved to -w/-h with\n"
+          "                          dp seams kept close to the previous frame's\n"
+          "  --corridor <px>         search radius around last frame's seams (default 8,\n"
+          "                          0: full dp per frame)\n"
+          "  --keyframe-interval <n> full dp every n frames (default 30, 0: first only)\n"
+          "  --block-frames <n>      carve n frames at a time with shared seams (default 1)\n"
+          "  --fourcc <code>         codec of video outputs (default: the input's)\n"
+          "  --yuv                   carve video frames as 4:2:0 Y'CbCr planes: energy from\n"
+          "                          the luma, chroma carved along the projected seams\n"
+          "  --regress <file.json>   golden regression run: carve with every seam finder\n"
+          "                          and graph solver, and the dp with every energy model,\n"
+          "                          function, precision and storage, on the inputs\n"
+          "                          (default test.jpg) to -w/-h (default 80% x 90%) and\n"
+          "                          compare seams, outputs and timings with the baseline;\n"
+          "                          differing outputs are written to -o for a look\n"
+          "  --record                write the baseline of --regress instead of checking\n"
+          "  --max-slowdown <pct>    --regress fails a resize or phase of at least 5 ms\n"
+          "                          that is this much slower (default 10); off: check\n"
+          "                          seams and outputs only (baseline of another machine)\n"
+          "  --regress-runs <n>      resizes per case, the fastest is timed (default 3)\n"
+          "  --trace <file.json>     write a Chrome trace (chrome://tracing, Perfetto)\n"
+          "                          of every job, seam step and phase\n"
+          "  --metrics-file <file>   dump Prometheus metrics of the batch to file every\n"
+          "                          --metrics-interval-ms (default 10000) and at the end\n"
+          "  -q, --quiet             drop progress logs (JSON records still print)\n"
+          "  -v, --verbose           also log progress every 10 seams\n"
+          "Images are decoded, carved and encoded as a pipeline. Each image prints\n"
+          "one JSON line with its timings on stdout (and for carved images the peak\n"
+          "working memory, heap allocations and bytes copied by removal and\n"
+          "transposes); progress logs go to stderr.\n";
+}
+
+bool hasExtension(const fs::path& p, std::initializer_list<const char*> exts) {
+    std::string ext = p.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    for (const char* e : exts) {
+        if (ext == e) return true;
+    }
+    return false;
+}
+
+bool isImageFile(const fs::path& p) {
+    return hasExtension(p, { ".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".webp", ".ppm", ".pgm" });
+}
+
+bool isVideoFile(const fs::path& p) {
+    return hasExtension(p, { ".mp4", ".m4v", ".mov", ".avi", ".mkv", ".webm" });
+}
+
+// Shell-style match of '*' and '?' against a file name
+bool wildcardMatch(const char* pattern, const char* name) {
+    if (*pattern == '\0') return *name == '\0';
+    if (*pattern == '*') {
+        return wildcardMatch(pattern + 1, name) || (*name != '\0' && wildcardMatch(pattern, name + 1));
+    }
+    if (*name == '\0') return false;
+    return (*pattern == '?' || *pattern == *name) && wildcardMatch(pattern + 1, name + 1);
+}
+
+// Expand files, directories (non-recursive; their images, or videos) and
+// globs in the file name part
+std::vector<std::string> expandInputs(const std::vector<std::string>& inputs, bool videos) {
+    std::vector<std::string> files;
+    for (const std::string& in : inputs) {
+        fs::path p(in);
+        std::string name = p.filename().string();
+        if (name.find_first_of("*?") != std::string::npos) {
+            fs::path dir = p.has_parent_path() ? p.parent_path() : fs::path(".");
+            std::vector<std::string> matched;
+            if (fs::is_directory(dir)) {
+                for (const auto& entry : fs::directory_iterator(dir)) {
+                    if (entry.is_regular_file() &&
+                        wildcardMatch(name.c_str(), entry.path().filename().string().c_str())) {
+                        matched.push_back(entry.path().string());
+                    }
+                }
+            }
+            std::sort(matched.begin(), matched.end());
+            files.insert(files.end(), matched.begin(), matched.end());
+        }
+        else if (fs::is_directory(p)) {
+            std::vector<std::string> found;
+            for (const auto& entry : fs::directory_iterator(p)) {
+                if (entry.is_regular_file() && (videos ? isVideoFile(entry.path()) : isImageFile(entry.path()))) {
+                    found.push_back(entry.path().string());
+                }
+            }
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        }
+        else {
+            files.push_back(in);  // a missing file is reported by its job
+        }
+    }
+    return files;
+}
+
+// "640" or "640x480" of --sizes; without a height, defaultHeight px
+cv::Size parseSizeSpec(const std::string& spec, int originalWidth, int originalHeight, int defaultHeight) {
+    const size_t x = spec.find('x');
+    if (x == std::string::npos) return cv::Size(parseDimension(spec, originalWidth), defaultHeight);
+    return cv::Size(parseDimension(spec.substr(0, x), originalWidth),
+                    parseDimension(spec.substr(x + 1), originalHeight));
+}
+
+// "x,y,w,h" of --region, each in px or pct% of the source side
+cv::Rect parseRegion(const std::string& spec, int originalWidth, int originalHeight) {
+    std::vector<std::string> parts;
+    std::stringstream in(spec);
+    std::string part;
+    while (std::getline(in, part, ',')) parts.push_back(part);
+    if (parts.size() != 4) throw std::runtime_error("Regions are x,y,w,h: " + spec);
+    // Offsets may be 0, which parseDimension rounds up
+    auto offset = [](const std::string& s, int original) { return std::stod(s) == 0.0 ? 0 : parseDimension(s, original); };
+    return cv::Rect(offset(parts[0], originalWidth), offset(parts[1], originalHeight),
+                    parseDimension(parts[2], originalWidth), parseDimension(parts[3], originalHeight));
+}
+
+std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if ((unsigned char)c < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }
+            else {
+                out += c;
+            }
+        }
+    }
+    return out;
+}
+
+std::string toJson(const JobResult& r) {
+    std::ostringstream os;
+    os << "{\"input\":\"" << jsonEscape(r.input) << "\""
+       << ",\"status\":\"" << (r.error.empty() ? "ok" : "error") << "\"";
+    if (!r.error.empty()) os << ",\"error\":\"" << jsonEscape(r.error) << "\"";
+    os << ",\"output\":\"" << jsonEscape(r.output) << "\"";
+    if (!r.outputs.empty()) {
+        os << ",\"outputs\":[";
+        for (size_t i = 0; i < r.outputs.size(); i++) {
+            os << (i ? "," : "") << "\"" << jsonEscape(r.outputs[i]) << "\"";
+        }
+        os << "]";
+    }
+    os
+       << ",\"src_width\":" << r.srcWidth << ",\"src_height\":" << r.srcHeight
+       << ",\"dst_width\":" << r.dstWidth << ",\"dst_height\":" << r.dstHeight
+       << ",\"seam_map\":\"" << r.seamMap << "\""
+       << ",\"cache\":\"" << r.cache << "\""
+       << ",\"load_ms\":" << r.loadMs << ",\"carve_ms\":" << r.carveMs
+       << ",\"save_ms\":" << r.saveMs;
+    if (r.decodeFactor > 1) os << ",\"decode_scale\":" << r.decodeFactor;
+    if (r.memory.peakBytes > 0) {
+        os << ",\"peak_bytes\":" << r.memory.peakBytes
+           << ",\"removal_bytes\":" << r.memory.removalBytes
+           << ",\"transpose_bytes\":" << r.memory.transposeBytes;
+        if (r.memory.heapCounted) {
+            os << ",\"allocations\":" << r.memory.allocations
+               << ",\"allocated_bytes\":" << r.memory.allocatedBytes;
+        }
+    }
+    os << "}";
+    return os.str();
+}
+
+double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int parseNumaNode(const std::string& name) {
+    if (name == "local") return BufferPlacement::kLocalNode;
+    const int node = std::stoi(name);
+    if (node < 0 || node >= numaNodeCount()) {
+        throw std::runtime_error("Unknown NUMA node: " + name + " (" + std::to_string(numaNodeCount()) + " online)");
+    }
+    return node;
+}
+
+// Render from <input>.seammap, (re)building it when missing, stale or too
+// shallow for the target. The map only covers shrinking; larger targets are
+// rendered at the source size and enlarged by seam insertion.
+cv::Mat resizeWithSeamMap(SeamCarver& carver, const CliOptions& opt, const std::string& input,
+                          int targetWidth, int targetHeight, JobResult& result) {
+    const cv::Mat& source = carver.imageView();
+    const int width = std::min(targetWidth, source.cols);
+    const int height = std::min(targetHeight, source.rows);
+    auto enlarge = [&](const cv::Mat& carved) {
+        if (targetWidth <= carved.cols && targetHeight <= carved.rows) return carved;
+        return carver.enlargeImage(carved, std::max(targetWidth, carved.cols), std::max(targetHeight, carved.rows));
+    };
+    const std::string mapPath = seamMapPathFor(input);
+    try {
+        MappedSeamMap mapped(mapPath);
+        const SeamIndexMap& map = mapped.map();
+        if (mapped.matches(source) && width >= map.minWidth && height >= map.minHeight) {
+            result.seamMap = "hit";
+            return enlarge(carver.renderFromSeamIndexMap(map, source, width, height));
+        }
+    }
+    catch (const std::runtime_error&) {
+        // No usable map yet
+    }
+
+    int minWidth = std::min(width, std::max(1, (int)std::lround(source.cols * opt.seamMapMinPercent / 100.0)));
+    int minHeight = std::min(height, std::max(1, (int)std::lround(source.rows * opt.seamMapMinPercent / 100.0)));
+    SeamIndexMap map = carver.buildSeamIndexMap(minWidth, minHeight);
+    saveSeamMap(mapPath, map, source);
+    result.seamMap = "built";
+    return enlarge(carver.renderFromSeamIndexMap(map, source, width, height));
+}
+
+// --seam-map without a decode: a PPM/PGM input whose map covers the target
+// is rendered row by row from the mapped image and map straight into its
+// output, so neither image is ever held whole and the job costs a read of
+// both files and the write. False, with nothing written, for a job that has
+// to carve: a missing, stale or too shallow map, a larger target, GUI
+// naming (PNG output) or an output that would overwrite the input.
+bool serveSeamMap(const CliOptions& opt, const std::string& input, JobResult& result) {
+    std::string ext = fs::path(input).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    if (opt.method != "dp" || opt.naming != "source" || (ext != ".ppm" && ext != ".pgm")) return false;
+    const std::string output = (fs::path(opt.outputDir) / fs::path(input).filename()).string();
+    std::error_code ec;
+    if (fs::equivalent(input, output, ec)) return false;
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::unique_ptr<MappedImage> source;
+    std::unique_ptr<MappedSeamMap> mapped;
+    try {
+        source = std::make_unique<MappedImage>(input);
+        mapped = std::make_unique<MappedSeamMap>(seamMapPathFor(input));
+    }
+    catch (const std::runtime_error&) {
+        return false;  // not 8-bit, or no map yet
+    }
+    const SeamIndexMap& map = mapped->map();
+    const int width = parseDimension(opt.width, source->cols());
+    const int height = parseDimension(opt.height, source->rows());
+    if (map.vertical.cols != source->cols() || map.vertical.rows != source->rows() || width < map.minWidth ||
+        width > source->cols() || height < map.minHeight || height > source->rows() ||
+        mapped->sourceHash() != hashImage(*source)) {
+        return false;
+    }
+    result.input = input;
+    result.output = output;
+    result.seamMap = "hit";
+    result.srcWidth = source->cols();
+    result.srcHeight = source->rows();
+    result.dstWidth = width;
+    result.dstHeight = height;
+    result.loadMs = msSince(t0);
+
+    // Rendering and encoding are one pass, timed as the save
+    t0 = std::chrono::steady_clock::now();
+    NetpbmWriter out(output, width, height, source->channels());
+    renderSeamMapRows(map, width, height, static_cast<size_t>(source->channels()),
+                      [&](int i) { return source->row(i); }, [&](const uchar* row) { out.writeRow(row); });
+    out.finish();
+    result.saveMs = msSince(t0);
+    return true;
+}
+
+// Carve stage of one job: decoded is the source image. With a cache a
+// repeated job returns the stored result, and a new one starts from the
+// cached initial energy map. With --sizes every size but the smallest is
+// queued on writers as the carve reaches it (its future in writes) and the
+// smallest is returned. With kernels (--share-threads) the carver's helper
+// shares run on that pool, the one carving the jobs.
+cv::Mat carveJob(const CliOptions& opt, const cv::Mat& decoded, JobResult& result, CarveCache* cache,
+                 SeamTrace* trace, CarveMetrics* metrics, ThreadPool* writers,
+                 std::vector<std::future<void>>& writes, const std::shared_ptr<ThreadPool>& kernels) {
+    auto t0 = std::chrono::steady_clock::now();
+    SeamCarver carver{ cv::Mat(decoded) };  // shares the decoded buffer
+    carver.setTrace(trace);
+    // JSON records own stdout; progress logs go to stderr
+    if (!opt.quiet) {
+        carver.setLogger(streamLogger(std::cerr), opt.verbose ? LogLevel::Debug : LogLevel::Info);
+    }
+    // Sizes are of the source, which a reduced decode has already shrunk
+    int width = parseDimension(opt.width, result.srcWidth);
+    int height = parseDimension(opt.height, result.srcHeight);
+    carver.setPrecision(parsePrecision(opt.precision));
+    carver.setEnergyModel(parseEnergyModel(opt.energy));
+    carver.setSeamOrder(parseSeamOrder(opt.seamOrder));
+    carver.setGreedyBeamWidth(opt.beamWidth);
+    carver.setGreedyStarts(opt.greedyStarts);
+    carver.setSeamStep(opt.seamStep);
+    carver.setEnergyFunction(parseEnergyFunction(opt.energyFunction));
+    carver.setIncrementalEnergy(opt.incremental);
+    carver.setIncrementalDP(opt.incremental);
+    carver.setGraphStorage(opt.compactGraph ? GraphStorage::Compact : GraphStorage::Full);
+    BufferPlacement placement;
+    placement.hugePages = opt.hugePages;
+    placement.numaNode = opt.numaNode;
+    carver.setBufferPlacement(placement);
+    if (kernels) {
+        // A share per pool thread: the ones this job finds busy are carved
+        // by the job itself while it waits
+        carver.setThreadPool(kernels);
+        carver.setEnergyThreads(std::max(static_cast<unsigned>(opt.energyThreads), kernels->size()));
+        carver.setDPThreads(std::max(static_cast<unsigned>(opt.dpThreads), kernels->size()));
+    } else {
+        carver.setEnergyThreads(static_cast<unsigned>(opt.energyThreads));
+        carver.setDPThreads(static_cast<unsigned>(opt.dpThreads));
+    }
+    carver.setBidirectionalDP(opt.bidirectionalDP);
+    carver.setLazyRemoval(opt.lazyRemoval);
+
+    // Masks are named in the result key by their content hash
+    std::string maskSettings;
+    cv::Mat masks[2];
+    const std::string* maskPaths[2] = { &opt.protectMask, &opt.removeMask };
+    for (int k = 0; k < 2; k++) {
+        if (maskPaths[k]->empty()) continue;
+        masks[k] = cv::imread(*maskPaths[k], cv::IMREAD_GRAYSCALE);
+        if (masks[k].empty()) {
+            throw std::runtime_error("Failed to read mask: " + *maskPaths[k]);
+        }
+        maskSettings += (k == 0 ? "/protect" : "/remove") + std::to_string(hashImage(masks[k]));
+    }
+    carver.setMask(masks[0], masks[1]);
+
+    auto outputPath = [&](const cv::Mat& image) {
+        std::string name;
+        if (opt.naming == "gui") {
+            name = guiOutputFilename(opt.method,
+                                     (int)std::round(100.0f * image.cols / (float)result.srcWidth),
+                                     (int)std::round(100.0f * image.rows / (float)result.srcHeight),
+                                     image.cols, image.rows);
+        }
+        else if (!opt.sizes.empty()) {
+            const fs::path source(result.input);
+            name = source.stem().string() + "_" + std::to_string(image.cols) + "x" + std::to_string(image.rows) +
+                   source.extension().string();
+        }
+        else {
+            name = fs::path(result.input).filename().string();
+        }
+        return (fs::path(opt.outputDir) / name).string();
+    };
+
+    cv::Mat out;
+    std::string resultKey;
+    if (cache) {
+        const uint64_t sourceHash = hashImage(decoded);
+        resultKey = CarveCache::key(sourceHash,
+            opt.method + "/" + opt.precision + "/" + opt.energy + "/" + opt.energyFunction + "/" + opt.seamOrder + "/b" + std::to_string(opt.beamWidth) + "/s" + std::to_string(opt.greedyStarts) +
+            (opt.seamStep > 1 ? "/step" + std::to_string(opt.seamStep) : "") +
+            (opt.compactGraph && opt.method == "graph" ? "/compact" : "") +
+            (opt.tiles > 0 ? "/tiles" + std::to_string(opt.tiles) + "o" + std::to_string(opt.tileOverlap) : "") +
+            maskSettings + (opt.removeObject.empty() ? "" : "/object-" + opt.removeObject) + (opt.opencl ? "/opencl" : "") +
+            (opt.carveQuality < 1.0 ? "/q" + std::to_string(opt.carveQuality) : "") +
+            (opt.borderTrim >= 0.0 ? "/trim" + std::to_string(opt.borderTrim) : "") +
+            (opt.region.empty() ? "" : "/region" + opt.region) + (opt.seamMap ? "/map/" : "/") + std::to_string(width) + "x" + std::to_string(height));
+        result.cache = cache->findResult(resultKey, out) ? "hit" : "miss";
+        if (metrics) metrics->recordCache(result.cache == "hit");
+
+        if (out.empty() && !opt.seamMap && !opt.opencl) {
+            const std::string energyKey = CarveCache::key(sourceHash,
+                CarveCache::energySettings(carver.getPrecision(), carver.getEnergyFunction()));
+            cv::Mat energy;
+            if (!cache->findEnergy(energyKey, energy)) {
+                energy = carver.calculateEnergy(decoded);
+                cache->storeEnergy(energyKey, energy);
+            }
+            carver.setInitialEnergy(energy);
+        }
+    }
+
+    if (!out.empty()) {
+        // Cached result
+    }
+    else if (!opt.removeObject.empty()) {
+        out = carver.removeObject(opt.removeObject == "restore");
+    }
+    else if (opt.method == "dp" && opt.seamMap) {
+        out = resizeWithSeamMap(carver, opt, result.input, width, height, result);
+    }
+    else if (opt.opencl) {
+        GpuCarver gpu(decoded);
+        gpu.setEnergyFunction(carver.getEnergyFunction());
+        CancelToken cancel;
+        ProgressCallback progress;
+        if (opt.timeoutMs > 0) {
+            progress = [&](const CarveProgress& p) {
+                if (p.elapsedMs > opt.timeoutMs) cancel.cancel();
+            };
+        }
+        try {
+            out = gpu.resize(width, height, progress, &cancel);
+        }
+        catch (const CarveCancelled&) {
+            throw std::runtime_error("Resize timed out after " + std::to_string(static_cast<long long>(msSince(t0))) + " ms.");
+        }
+    }
+    else if (!opt.sizes.empty()) {
+        std::vector<cv::Size> sizes;
+        for (const std::string& spec : opt.sizes) {
+            const cv::Size s = parseSizeSpec(spec, decoded.cols, decoded.rows, height);
+            if (std::find(sizes.begin(), sizes.end(), s) != sizes.end()) {
+                throw std::runtime_error("--sizes lists " + std::to_string(s.width) + "x" +
+                                         std::to_string(s.height) + " twice.");
+            }
+            sizes.push_back(s);
+        }
+        // The carve reaches the smallest last
+        size_t smallest = 0;
+        for (size_t k = 1; k < sizes.size(); k++) {
+            if (sizes[k].width < sizes[smallest].width ||
+                (sizes[k].width == sizes[smallest].width && sizes[k].height < sizes[smallest].height)) {
+                smallest = k;
+            }
+        }
+        CancelToken cancel;
+        ResizeOptions options = carver.resizeOptions(width, height, parseStrategy(opt.method));
+        options.cancel = &cancel;
+        if (opt.timeoutMs > 0) {
+            options.progress = [&](const CarveProgress& p) {
+                if (p.elapsedMs > opt.timeoutMs) cancel.cancel();
+            };
+        }
+        std::vector<std::string> outputs(sizes.size());
+        try {
+            carver.resizeSizes(sizes, options, [&](size_t k, const cv::Mat& image) {
+                outputs[k] = outputPath(image);
+                if (k == smallest) {
+                    out = image;
+                    return;
+                }
+                // Later seams copy the carver's planes first, so image stays intact
+                writes.push_back(writers->submit([path = outputs[k], image, &opt] {
+                    writeImage(path, image, opt.encode);
+                }));
+            });
+        }
+        catch (const CarveCancelled&) {
+            throw std::runtime_error("Resize timed out after " + std::to_string(static_cast<long long>(msSince(t0))) + " ms.");
+        }
+        result.outputs = outputs;
+    }
+    else if (opt.tiles > 0) {
+        if (height != decoded.rows || width > decoded.cols) {
+            throw std::runtime_error("--tiles only reduces the width.");
+        }
+        TileCarver tiler(static_cast<unsigned>(opt.tiles));
+        tiler.setTiles(opt.tiles);
+        tiler.setOverlap(opt.tileOverlap);
+        CancelToken cancel;
+        ResizeOptions options = carver.resizeOptions(width, height, parseStrategy(opt.method));
+        options.cancel = &cancel;
+        if (opt.timeoutMs > 0) {
+            options.progress = [&](const CarveProgress& p) {
+                if (p.elapsedMs > opt.timeoutMs) cancel.cancel();
+            };
+        }
+        try {
+            out = tiler.carve(decoded, options);
+        }
+        catch (const CarveCancelled&) {
+            throw std::runtime_error("Resize timed out after " + std::to_string(static_cast<long long>(msSince(t0))) + " ms.");
+        }
+    }
+    else {
+        // The deadline is checked between seams
+        CancelToken cancel;
+        ResizeOptions options = carver.resizeOptions(width, height, parseStrategy(opt.method));
+        options.carveQuality = opt.carveQuality;
+        options.borderTrim = opt.borderTrim;
+        if (!opt.region.empty()) options.region = parseRegion(opt.region, decoded.cols, decoded.rows);
+        options.cancel = &cancel;
+        if (opt.timeoutMs > 0) {
+            options.progress = [&](const CarveProgress& p) {
+                if (p.elapsedMs > opt.timeoutMs) cancel.cancel();
+            };
+        }
+        try {
+            out = carver.resize(options);
+        }
+        catch (const CarveCancelled&) {
+            throw std::runtime_error("Resize timed out after " + std::to_string(static_cast<long long>(msSince(t0))) + " ms.");
+        }
+    }
+    if (cache && result.cache == "miss") {
+        cache->storeResult(resultKey, out);
+    }
+    result.carveMs = msSince(t0);
+    result.memory = carver.stats().memory;
+    if (metrics && result.cache != "hit") {
+        const long long seams = std::abs(out.cols - decoded.cols) + std::abs(out.rows - decoded.rows);
+        metrics->recordJob(carver.stats(), seams, static_cast<long long>(decoded.total()), result.carveMs,
+                           carver.workspaceBytes());
+    }
+    result.dstWidth = out.cols;
+    result.dstHeight = out.rows;
+    result.output = outputPath(out);
+    return out;
+}
+
+// Streamed job: width-only carve straight from the mapped input, written
+// row by row, so neither the source nor the result is ever held whole
+void streamJob(const CliOptions& opt, const std::string& input, JobResult& result, SeamTrace* trace) {
+    result.input = input;
+    auto t0 = std::chrono::steady_clock::now();
+    MappedImage source(input);
+    result.loadMs = msSince(t0);
+    result.srcWidth = source.cols();
+    result.srcHeight = source.rows();
+    const int width = parseDimension(opt.width, source.cols());
+    if (parseDimension(opt.height, source.rows()) != source.rows() || width > source.cols()) {
+        throw std::runtime_error("--stream only reduces the width.");
+    }
+
+    t0 = std::chrono::steady_clock::now();
+    StreamCarver carver(source, opt.streamRows);
+    carver.carver().setTrace(trace);
+    carver.carver().setPrecision(parsePrecision(opt.precision));
+    carver.carver().setEnergyFunction(parseEnergyFunction(opt.energyFunction));
+    carver.carver().setEnergyThreads(static_cast<unsigned>(opt.energyThreads));
+    CancelToken cancel;
+    ProgressCallback progress;
+    if (opt.timeoutMs > 0 || opt.verbose) {
+        progress = [&](const CarveProgress& p) {
+            if (opt.timeoutMs > 0 && p.elapsedMs > opt.timeoutMs) cancel.cancel();
+            if (opt.verbose && !opt.quiet && p.seamsDone % 10 == 0) {
+                std::cerr << "Streamed " << p.seamsDone << "/" << p.seamsTotal << " seams\n";
+            }
+        };
+    }
+    try {
+        carver.removeVerticalSeams(source.cols() - width, progress, &cancel);
+    }
+    catch (const CarveCancelled&) {
+        throw std::runtime_error("Resize timed out after " + std::to_string(static_cast<long long>(msSince(t0))) + " ms.");
+    }
+    result.carveMs = msSince(t0);
+    result.dstWidth = carver.width();
+    result.dstHeight = carver.height();
+
+    fs::path name = opt.naming == "gui"
+        ? fs::path(guiOutputFilename(opt.method, (int)std::round(100.0f * carver.width() / (float)source.cols()), 100,
+                                     carver.width(), carver.height()))
+        : fs::path(input).filename();
+    name.replace_extension(source.channels() == 3 ? ".ppm" : ".pgm");
+    result.output = (fs::path(opt.outputDir) / name).string();
+
+    t0 = std::chrono::steady_clock::now();
+    carver.save(result.output);
+    result.saveMs = msSince(t0);
+}
+
+// Video job: frames are decoded, carved and encoded as a pipeline by
+// VideoCarver; the stage times are reported as load, carve and save
+void videoJob(const CliOptions& opt, const std::string& input, JobResult& result, SeamTrace* trace) {
+    result.input = input;
+    cv::VideoCapture probe(input);
+    if (!probe.isOpened()) {
+        throw std::runtime_error("Could not open video: " + input);
+    }
+    result.srcWidth = static_cast<int>(probe.get(cv::CAP_PROP_FRAME_WIDTH));
+    result.srcHeight = static_cast<int>(probe.get(cv::CAP_PROP_FRAME_HEIGHT));
+    probe.release();
+    const int width = parseDimension(opt.width, result.srcWidth);
+    const int height = parseDimension(opt.height, result.srcHeight);
+    if (width > result.srcWidth || height > result.srcHeight) {
+        throw std::runtime_error("--video only reduces the frame size.");
+    }
+
+    VideoCarver carver(width, height);
+    carver.carver().setTrace(trace);
+    carver.carver().setPrecision(parsePrecision(opt.precision));
+    carver.carver().setEnergyFunction(parseEnergyFunction(opt.energyFunction));
+    carver.carver().setIncrementalEnergy(opt.incremental);
+    carver.carver().setEnergyThreads(static_cast<unsigned>(opt.energyThreads));
+    carver.carver().setDPThreads(static_cast<unsigned>(opt.dpThreads));
+    carver.setCorridor(opt.corridor);
+    carver.setKeyframeInterval(opt.keyframeInterval);
+    carver.setBlockFrames(opt.blockFrames);
+    carver.setFourcc(opt.fourcc);
+    carver.setYuv(opt.yuv);
+    result.dstWidth = width;
+    result.dstHeight = height;
+    result.output = (fs::path(opt.outputDir) / fs::path(input).filename()).string();
+
+    const auto t0 = std::chrono::steady_clock::now();
+    CancelToken cancel;
+    ProgressCallback progress;
+    if (opt.timeoutMs > 0 || opt.verbose) {
+        progress = [&](const CarveProgress& p) {
+            if (opt.timeoutMs > 0 && p.elapsedMs > opt.timeoutMs) cancel.cancel();
+            if (opt.verbose && !opt.quiet && p.seamsDone % 10 == 0) {
+                std::cerr << "Carved " << p.seamsDone << "/" << p.seamsTotal << " frames\n";
+            }
+        };
+    }
+    try {
+        VideoCarveStats stats = carver.carveFile(input, result.output, progress, &cancel);
+        result.loadMs = stats.decodeMs;
+        result.carveMs = stats.carveMs;
+        result.saveMs = stats.encodeMs;
+    }
+    catch (const CarveCancelled&) {
+        throw std::runtime_error("Video timed out after " + std::to_string(static_cast<long long>(msSince(t0))) + " ms.");
+    }
+}
+
+// ---- --regress: golden outputs and timing gates ----
+
+// Methods of every --regress case, each on every input: every seam finder
+// and graph solver, then the DP with each energy model, function, precision
+// and storage. setup changes the carver from its defaults.
+struct RegressMethod {
+    const char* name;
+    SeamStrategy strategy;
+    void (*setup)(SeamCarver&);
+};
+const RegressMethod kRegressMethods[] = {
+    { "dp", SeamStrategy::DP, [](SeamCarver&) {} },
+    { "dp-forward", SeamStrategy::DP, [](SeamCarver& c) { c.setEnergyModel(EnergyModel::Forward); } },
+    { "dp-backpointers", SeamStrategy::DP, [](SeamCarver& c) { c.setDPStorage(DPStorage::Backpointers); } },
+    { "dp-parallel", SeamStrategy::DP, [](SeamCarver& c) { c.setDPThreads(4); } },
+    { "dp-bidirectional", SeamStrategy::DP, [](SeamCarver& c) { c.setBidirectionalDP(true); } },
+    { "dp-incremental", SeamStrategy::DP, [](SeamCarver& c) { c.setIncrementalDP(true); } },
+    { "dp-float", SeamStrategy::DP, [](SeamCarver& c) { c.setPrecision(EnergyPrecision::Float); } },
+    { "dp-fixed16", SeamStrategy::DP, [](SeamCarver& c) { c.setPrecision(EnergyPrecision::Fixed16); } },
+    { "dp-scharr", SeamStrategy::DP, [](SeamCarver& c) { c.setEnergyFunction(EnergyFunction::Scharr); } },
+    { "dp-dual", SeamStrategy::DP, [](SeamCarver& c) { c.setEnergyFunction(EnergyFunction::DualGradient); } },
+    { "dp-l1", SeamStrategy::DP, [](SeamCarver& c) { c.setEnergyFunction(EnergyFunction::L1Gradient); } },
+    { "dp-saliency", SeamStrategy::DP, [](SeamCarver& c) { c.setEnergyFunction(EnergyFunction::Saliency); } },
+    { "dp-fast", SeamStrategy::DP, [](SeamCarver& c) { c.setEnergyFunction(EnergyFunction::FastSobel); } },
+    { "dp-optimal-order", SeamStrategy::DP, [](SeamCarver& c) { c.setSeamOrder(SeamOrder::Optimal); } },
+    { "greedy", SeamStrategy::Greedy, [](SeamCarver&) {} },
+    { "pyramid", SeamStrategy::Pyramid, [](SeamCarver&) {} },
+    { "graph", SeamStrategy::GraphCut, [](SeamCarver&) {} },
+    { "graph-dag", SeamStrategy::GraphCut, [](SeamCarver& c) { c.setGraphSolver(GraphSolver::DagRelaxation); } },
+    { "graph-astar", SeamStrategy::GraphCut, [](SeamCarver& c) { c.setGraphSolver(GraphSolver::AStar); } },
+    { "graph-bucket", SeamStrategy::GraphCut, [](SeamCarver& c) {
+          c.setPrecision(EnergyPrecision::Fixed16);
+          c.setGraphQueue(GraphQueue::Bucket);
+      } },
+    { "graph-radix", SeamStrategy::GraphCut, [](SeamCarver& c) {
+          c.setPrecision(EnergyPrecision::Fixed16);
+          c.setGraphQueue(GraphQueue::Radix);
+      } },
+};
+// Timings below this are too noisy to gate
+constexpr double kMinGatedMs = 5.0;
+
+struct RegressCase {
+    std::string input;
+    std::string method;
+    int width = 0, height = 0;
+    std::string seamHash;    // first vertical and horizontal seam of the source; empty: none
+    std::string outputHash;
+    double ms = 0;           // best resize of the runs
+    std::map<std::string, double> phaseMs;  // phases of that run
+};
+
+std::string hex64(uint64_t v) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+    return buf;
+}
+
+// FNV-1a over the columns (rows) of both seams
+uint64_t hashSeams(const std::vector<int>& vertical, const std::vector<int>& horizontal) {
+    uint64_t h = 1469598103934665603ull;
+    for (const std::vector<int>* seam : { &vertical, &horizontal }) {
+        for (int v : *seam) {
+            h = (h ^ static_cast<uint32_t>(v)) * 1099511628211ull;
+        }
+        h = (h ^ 0xffffffffu) * 1099511628211ull;  // separator
+    }
+    return h;
+}
+
+// "DP forward" -> "dp_forward"
+std::string phaseKey(SeamPhase p) {
+    std::string key;
+    for (const char* c = SeamCarverStats::name(p); *c; c++) {
+        key += *c == ' ' ? '_' : static_cast<char>(std::tolower(static_cast<unsigned char>(*c)));
+    }
+    return key;
+}
+
+// Carve image with one method runs times; out receives the first result
+RegressCase runRegressCase(const std::string& input, const cv::Mat& image, const RegressMethod& method,
+                           int width, int height, int runs, cv::Mat& out) {
+    RegressCase rc;
+    rc.input = input;
+    rc.method = method.name;
+    rc.width = width;
+    rc.height = height;
+    const SeamStrategy strategy = method.strategy;
+    SeamCarver probe{ cv::Mat(image) };
+    method.setup(probe);
+
+    // Forward energy has no seam finder of its own on an energy map
+    if (probe.getEnergyModel() != EnergyModel::Forward) {
+        typedef std::vector<int> (SeamCarver::*Finder)(const cv::Mat&);
+        static const std::map<SeamStrategy, std::pair<Finder, Finder>> finders = {
+            { SeamStrategy::DP, { &SeamCarver::findVerticalSeamDP, &SeamCarver::findHorizontalSeamDP } },
+            { SeamStrategy::Greedy, { &SeamCarver::findVerticalSeamGreedy, &SeamCarver::findHorizontalSeamGreedy } },
+            { SeamStrategy::Pyramid, { &SeamCarver::findVerticalSeamPyramid, &SeamCarver::findHorizontalSeamPyramid } },
+            { SeamStrategy::GraphCut, { &SeamCarver::findVerticalSeamGraphCut, &SeamCarver::findHorizontalSeamGraphCut } },
+        };
+        const cv::Mat energy = probe.calculateEnergy(image);
+        const auto& f = finders.at(strategy);
+        rc.seamHash = hex64(hashSeams((probe.*f.first)(energy), (probe.*f.second)(energy)));
+    }
+
+    for (int run = 0; run < runs; run++) {
+        SeamCarver carver{ cv::Mat(image) };
+        method.setup(carver);
+        auto t0 = std::chrono::steady_clock::now();
+        cv::Mat result = carver.resize(carver.resizeOptions(width, height, strategy));
+        const double ms = msSince(t0);
+        if (run == 0) {
+            out = result;
+            rc.outputHash = hex64(hashImage(result));
+        }
+        if (run == 0 || ms < rc.ms) {
+            rc.ms = ms;
+            for (int p = 0; p < SeamCarverStats::kPhases; p++) {
+                const PhaseStats& s = carver.stats().phases[p];
+                if (s.calls > 0) rc.phaseMs[phaseKey(static_cast<SeamPhase>(p))] = s.totalMs;
+            }
+        }
+    }
+    return rc;
+}
+
+std::string toJson(const RegressCase& c) {
+    std::ostringstream os;
+    os << "{\"input\":\"" << jsonEscape(c.input) << "\",\"method\":\"" << c.method << "\""
+       << ",\"width\":" << c.width << ",\"height\":" << c.height
+       << ",\"seam_hash\":\"" << c.seamHash << "\",\"output_hash\":\"" << c.outputHash << "\""
+       << ",\"ms\":" << c.ms << ",\"phases\":{";
+    bool first = true;
+    for (const auto& p : c.phaseMs) {
+        os << (first ? "" : ",") << "\"" << p.first << "\":" << p.second;
+        first = false;
+    }
+    os << "}}";
+    return os.str();
+}
+
+// Value of "key": in a line written by toJson(RegressCase); the strings
+// never hold escapes but in the input path, which is only matched
+std::string jsonValue(const std::string& line, const std::string& key, size_t from = 0) {
+    const std::string tag = "\"" + key + "\":";
+    size_t at = line.find(tag, from);
+    if (at == std::string::npos) return std::string();
+    at += tag.size();
+    if (line[at] == '"') {
+        std::string value;
+        for (size_t i = at + 1; i < line.size() && line[i] != '"'; i++) {
+            if (line[i] == '\\' && i + 1 < line.size()) i++;
+            value += line[i];
+        }
+        return value;
+    }
+    const size_t end = line.find_first_of(",}", at);
+    return line.substr(at, end - at);
+}
+
+// Baseline cases of a file written by --regress --record
+std::vector<RegressCase> readBaseline(const std::string& path) {
+    std::ifstream f(path);
+    if (!f) throw std::runtime_error("Could not read the baseline " + path + "; record one with --record.");
+    std::vector<RegressCase> cases;
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.find("\"input\":") == std::string::npos) continue;
+        RegressCase c;
+        c.input = jsonValue(line, "input");
+        c.method = jsonValue(line, "method");
+        c.width = std::stoi(jsonValue(line, "width"));
+        c.height = std::stoi(jsonValue(line, "height"));
+        c.seamHash = jsonValue(line, "seam_hash");
+        c.outputHash = jsonValue(line, "output_hash");
+        c.ms = std::stod(jsonValue(line, "ms"));
+        const size_t phases = line.find("\"phases\":{");
+        if (phases != std::string::npos) {
+            for (int p = 0; p < SeamCarverStats::kPhases; p++) {
+                const std::string key = phaseKey(static_cast<SeamPhase>(p));
+                const std::string value = jsonValue(line, key, phases);
+                if (!value.empty()) c.phaseMs[key] = std::stod(value);
+            }
+        }
+        cases.push_back(c);
+    }
+    return cases;
+}
+
+// --regress: carve every method on every input and record the results as
+// the baseline, or check them against it. Prints one JSON line per case.
+int regressionRun(const CliOptions& opt, const std::vector<std::string>& files) {
+    std::vector<RegressCase> baseline;
+    if (!opt.regressRecord) {
+        try {
+            baseline = readBaseline(opt.regressFile);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<RegressCase> cases;
+    int failures = 0;
+    for (const std::string& file : files) {
+        const cv::Mat image = cv::imread(file, cv::IMREAD_COLOR);
+        if (image.empty()) {
+            std::cerr << "Error: Could not load image from: " << file << "\n";
+            return 1;
+        }
+        // Without -w/-h every case carves to 80% x 90%
+        const bool sized = opt.width != "100%" || opt.height != "100%";
+        const int width = parseDimension(sized ? opt.width : "80%", image.cols);
+        const int height = parseDimension(sized ? opt.height : "90%", image.rows);
+        for (const RegressMethod& method : kRegressMethods) {
+            cv::Mat out;
+            RegressCase c = runRegressCase(file, image, method, width, height, opt.regressRuns, out);
+            cases.push_back(c);
+
+            std::vector<std::string> problems;
+            double baselineMs = 0;
+            if (!opt.regressRecord) {
+                auto base = std::find_if(baseline.begin(), baseline.end(), [&](const RegressCase& b) {
+                    return b.input == c.input && b.method == c.method;
+                });
+                if (base == baseline.end()) {
+                    problems.push_back("not in the baseline");
+                } else {
+                    baselineMs = base->ms;
+                    if (base->width != c.width || base->height != c.height) problems.push_back("size differs");
+                    if (base->seamHash != c.seamHash) problems.push_back("seams differ");
+                    if (base->outputHash != c.outputHash) problems.push_back("output differs");
+                    const double limit = 1.0 + opt.maxSlowdownPct / 100.0;
+                    auto gate = [&](const std::string& what, double before, double now) {
+                        if (opt.maxSlowdownPct >= 0 && before >= kMinGatedMs && now > before * limit) {
+                            problems.push_back(what + " " + std::to_string(static_cast<int>(std::round(
+                                100.0 * (now - before) / before))) + "% slower");
+                        }
+                    };
+                    gate("resize", base->ms, c.ms);
+                    for (const auto& p : base->phaseMs) {
+                        auto now = c.phaseMs.find(p.first);
+                        if (now != c.phaseMs.end()) gate(p.first, p.second, now->second);
+                    }
+                }
+                // Keep what differs for a look
+                if (!problems.empty()) {
+                    fs::create_directories(opt.outputDir);
+                    const std::string name = fs::path(file).stem().string() + "_" + c.method + ".png";
+                    cv::imwrite((fs::path(opt.outputDir) / name).string(), out);
+                }
+            }
+            failures += problems.empty() ? 0 : 1;
+
+            std::ostringstream os;
+            os << "{\"input\":\"" << jsonEscape(file) << "\",\"method\":\"" << c.method << "\""
+               << ",\"status\":\"" << (opt.regressRecord ? "recorded" : problems.empty() ? "ok" : "fail") << "\""
+               << ",\"ms\":" << c.ms;
+            if (!opt.regressRecord) os << ",\"baseline_ms\":" << baselineMs;
+            if (!problems.empty()) {
+                os << ",\"problems\":[";
+                for (size_t i = 0; i < problems.size(); i++) os << (i ? "," : "") << "\"" << problems[i] << "\"";
+                os << "]";
+            }
+            os << "}";
+            std::cout << os.str() << std::endl;
+        }
+    }
+
+    if (opt.regressRecord) {
+        std::ofstream f(opt.regressFile, std::ios::trunc);
+        f << "{\"cases\":[\n";
+        for (size_t i = 0; i < cases.size(); i++) {
+            f << toJson(cases[i]) << (i + 1 < cases.size() ? ",\n" : "\n");
+        }
+        f << "]}\n";
+        if (!f) {
+            std::cerr << "Error: Could not write the baseline " << opt.regressFile << "\n";
+            return 1;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+// Fills opt from argv; returns false (after printing why) on bad usage
+bool parseArgs(int argc, char** argv, CliOptions& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+            return argv[++i];
+        };
+        if (arg == "--help") { printUsage(std::cout); return false; }
+        else if (arg == "-w" || arg == "--width") opt.width = value();
+        else if (arg == "-h" || arg == "--height") opt.height = value();
+        else if (arg == "-m" || arg == "--method") opt.method = value();
+        else if (arg == "-p" || arg == "--precision") opt.precision = value();
+        else if (arg == "-e" || arg == "--energy") opt.energy = value();
+        else if (arg == "--seam-order") opt.seamOrder = value();
+        else if (arg == "--beam-width") opt.beamWidth = std::max(1, std::stoi(value()));
+        else if (arg == "--greedy-starts") opt.greedyStarts = std::max(1, std::stoi(value()));
+        else if (arg == "--seam-step") opt.seamStep = std::min(SeamCarver::kMaxSeamStep, std::max(1, std::stoi(value())));
+        else if (arg == "-f" || arg == "--energy-fn") opt.energyFunction = value();
+        else if (arg == "-o" || arg == "--output-dir") opt.outputDir = value();
+        else if (arg == "--naming") opt.naming = value();
+        else if (arg == "-j" || arg == "--threads") opt.threads = std::max(1, std::stoi(value()));
+        else if (arg == "--energy-threads") opt.energyThreads = std::max(1, std::stoi(value()));
+        else if (arg == "--dp-threads") opt.dpThreads = std::max(1, std::stoi(value()));
+        else if (arg == "--bidirectional-dp") opt.bidirectionalDP = true;
+        else if (arg == "--lazy-removal") opt.lazyRemoval = std::max(0, std::stoi(value()));
+        else if (arg == "--share-threads") opt.shareThreads = true;
+        else if (arg == "--pin-workers") opt.pinWorkers = true;
+        else if (arg == "--huge-pages") opt.hugePages = true;
+        else if (arg == "--numa") opt.numaNode = parseNumaNode(value());
+        else if (arg == "--encode-threads") opt.encodeThreads = std::max(1, std::stoi(value()));
+        else if (arg == "--png-compression") opt.encode.pngCompression = std::min(9, std::max(0, std::stoi(value())));
+        else if (arg == "--jpeg-quality") opt.encode.jpegQuality = std::min(100, std::max(0, std::stoi(value())));
+        else if (arg == "--webp-quality") opt.encode.webpQuality = std::min(101, std::max(1, std::stoi(value())));
+        else if (arg == "--regress") opt.regressFile = value();
+        else if (arg == "--record") opt.regressRecord = true;
+        else if (arg == "--max-slowdown") {
+            const std::string pct = value();
+            opt.maxSlowdownPct = pct == "off" ? -1.0 : std::max(0.0, std::stod(pct));
+        }
+        else if (arg == "--regress-runs") opt.regressRuns = std::max(1, std::stoi(value()));
+        else if (arg == "--cache-dir") opt.cacheDir = value();
+        else if (arg == "--protect") opt.protectMask = value();
+        else if (arg == "--remove") opt.removeMask = value();
+        else if (arg == "--remove-object") opt.removeObject = value();
+        else if (arg == "--trace") opt.traceFile = value();
+        else if (arg == "--metrics-file") opt.metricsFile = value();
+        else if (arg == "--metrics-interval-ms") opt.metricsIntervalMs = std::max(1, std::stoi(value()));
+        else if (arg == "--timeout") opt.timeoutMs = std::max(0.0, std::stod(value()));
+        else if (arg == "--region") opt.region = value();
+        else if (arg == "--trim-borders") opt.borderTrim = std::max(0.0, std::stod(value()));
+        else if (arg == "--carve-quality") opt.carveQuality = std::min(1.0, std::max(0.0, std::stod(value())));
+        else if (arg == "--full-decode") opt.fullDecode = true;
+        else if (arg == "--sizes") {
+            std::stringstream list(value());
+            std::string spec;
+            while (std::getline(list, spec, ',')) {
+                if (!spec.empty()) opt.sizes.push_back(spec);
+            }
+            if (opt.sizes.empty()) throw std::runtime_error("--sizes needs at least one size.");
+        }
+        else if (arg == "--tiles") opt.tiles = std::max(0, std::stoi(value()));
+        else if (arg == "--tile-overlap") opt.tileOverlap = std::max(0, std::stoi(value()));
+        else if (arg == "--stream") opt.streamRows = std::max(1, std::stoi(value()));
+        else if (arg == "--cache-mb") opt.cacheMB = (size_t)std::max(0, std::stoi(value()));
+        else if (arg == "--memory-budget") opt.memoryBudgetMB = (size_t)std::max(1, std::stoi(value()));
+        else if (arg == "--opencl") opt.opencl = true;
+        else if (arg == "--video") opt.video = true;
+        else if (arg == "--corridor") opt.corridor = std::max(0, std::stoi(value()));
+        else if (arg == "--keyframe-interval") opt.keyframeInterval = std::max(0, std::stoi(value()));
+        else if (arg == "--block-frames") opt.blockFrames = std::max(1, std::stoi(value()));
+        else if (arg == "--fourcc") opt.fourcc = value();
+        else if (arg == "--yuv") opt.yuv = true;
+        else if (arg == "--no-incremental") opt.incremental = false;
+        else if (arg == "--compact-graph") opt.compactGraph = true;
+        else if (arg == "--seam-map") opt.seamMap = true;
+        else if (arg == "--seam-map-min") opt.seamMapMinPercent = std::stof(value());
+        else if (arg == "-q" || arg == "--quiet") opt.quiet = true;
+        else if (arg == "-v" || arg == "--verbose") opt.verbose = true;
+        else if (!arg.empty() && arg[0] == '-') throw std::runtime_error("Unknown option: " + arg);
+        else opt.inputs.push_back(arg);
+    }
+    if (opt.naming != "source" && opt.naming != "gui") {
+        throw std::runtime_error("Unknown naming scheme: " + opt.naming);
+    }
+    parseStrategy(opt.method);
+    parsePrecision(opt.precision);
+    parseEnergyModel(opt.energy);
+    parseEnergyFunction(opt.energyFunction);
+    parseSeamOrder(opt.seamOrder);
+    if (opt.seamMap && !(opt.protectMask.empty() && opt.removeMask.empty())) {
+        throw std::runtime_error("Masks cannot be combined with --seam-map.");
+    }
+    if (!opt.removeObject.empty()) {
+        if (opt.removeObject != "restore" && opt.removeObject != "shrink") {
+            throw std::runtime_error("Unknown object removal mode: " + opt.removeObject);
+        }
+        if (opt.removeMask.empty()) {
+            throw std::runtime_error("--remove-object needs a --remove mask.");
+        }
+    }
+    if (opt.streamRows > 0) {
+        if (opt.method != "dp" || opt.energy != "backward" || opt.energyFunction == "saliency") {
+            throw std::runtime_error("--stream needs dp with backward per-pixel energy.");
+        }
+        if (opt.seamMap || !opt.removeObject.empty() || !(opt.protectMask.empty() && opt.removeMask.empty()) ||
+            !opt.cacheDir.empty()) {
+            throw std::runtime_error("--stream cannot be combined with seam maps, masks or a cache.");
+        }
+    }
+    if (opt.opencl) {
+        if (opt.method != "dp" || opt.energy != "backward" || opt.energyFunction == "saliency") {
+            throw std::runtime_error("--opencl needs dp with backward per-pixel energy.");
+        }
+        if (opt.seamMap || !opt.removeObject.empty() || !(opt.protectMask.empty() && opt.removeMask.empty()) ||
+            opt.streamRows > 0) {
+            throw std::runtime_error("--opencl cannot be combined with seam maps, masks or --stream.");
+        }
+        if (!GpuCarver::available()) {
+            throw std::runtime_error("--opencl: no OpenCL device is available.");
+        }
+    }
+    if (opt.carveQuality < 1.0 && (opt.seamMap || !opt.removeObject.empty() || opt.opencl ||
+                                   opt.streamRows > 0 || opt.video)) {
+        throw std::runtime_error("--carve-quality only applies to plain resizes.");
+    }
+    if (opt.borderTrim >= 0.0 && (opt.seamMap || !opt.removeObject.empty() || opt.opencl || opt.streamRows > 0 ||
+                                  opt.video || !opt.sizes.empty() || opt.tiles > 0)) {
+        throw std::runtime_error("--trim-borders only applies to plain resizes.");
+    }
+    if (!opt.region.empty() && (opt.seamMap || !opt.removeObject.empty() || opt.opencl || opt.streamRows > 0 ||
+                                opt.video || !opt.sizes.empty() || opt.tiles > 0 || opt.carveQuality < 1.0 ||
+                                opt.borderTrim >= 0.0)) {
+        throw std::runtime_error("--region only applies to plain resizes without --carve-quality or --trim-borders.");
+    }
+    if (!opt.sizes.empty() && (opt.seamMap || !opt.removeObject.empty() || opt.opencl || opt.streamRows > 0 ||
+                               opt.video || !opt.cacheDir.empty() || opt.carveQuality < 1.0)) {
+        throw std::runtime_error("--sizes cannot be combined with seam maps, object removal, --opencl, --stream, "
+                                 "--video, a cache or --carve-quality.");
+    }
+    if (opt.tiles > 0 && (opt.seamMap || !opt.removeObject.empty() ||
+                          !(opt.protectMask.empty() && opt.removeMask.empty()) || opt.opencl ||
+                          opt.streamRows > 0 || opt.video || !opt.sizes.empty() || opt.carveQuality < 1.0)) {
+        throw std::runtime_error("--tiles cannot be combined with seam maps, masks, object removal, --opencl, "
+                                 "--stream, --video, --sizes or --carve-quality.");
+    }
+    if (opt.shareThreads && (opt.opencl || opt.streamRows > 0 || opt.video || opt.tiles > 0)) {
+        throw std::runtime_error("--share-threads cannot be combined with --opencl, --stream, --video or --tiles.");
+    }
+    if (opt.video) {
+        if (opt.method != "dp" || opt.energy != "backward") {
+            throw std::runtime_error("--video needs dp with backward energy.");
+        }
+        if (opt.seamMap || !opt.removeObject.empty() || !(opt.protectMask.empty() && opt.removeMask.empty()) ||
+            opt.streamRows > 0 || opt.opencl || !opt.cacheDir.empty()) {
+            throw std::runtime_error("--video cannot be combined with seam maps, masks, --stream, --opencl or a cache.");
+        }
+        if (!opt.fourcc.empty() && opt.fourcc.size() != 4) {
+            throw std::runtime_error("--fourcc needs a four-character code.");
+        }
+    }
+    if (opt.regressRecord && opt.regressFile.empty()) {
+        throw std::runtime_error("--record needs --regress <baseline.json>.");
+    }
+    // The checked-in sample is the default regression corpus
+    if (!opt.regressFile.empty() && opt.inputs.empty()) opt.inputs.push_back("test.jpg");
+    if (opt.inputs.empty()) {
+        printUsage(std::cerr);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string guiOutputFilename(const std::string& method, int widthPercent, int heightPercent,
+                              int width, int height) {
+    return "output_" + method + "_" +
+        std::to_string(widthPercent) + "w_" +
+        std::to_string(heightPercent) + "h_" +
+        std::to_string(width) + "x" +
+        std::to_string(height) + ".png";
+}
+
+std::vector<int> encodeParams(const std::string& path, const EncodeOptions& options) {
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    std::vector<int> params;
+    if (ext == ".png" && options.pngCompression >= 0) {
+        params = { cv::IMWRITE_PNG_COMPRESSION, std::min(options.pngCompression, 9) };
+    }
+    else if ((ext == ".jpg" || ext == ".jpeg") && options.jpegQuality >= 0) {
+        params = { cv::IMWRITE_JPEG_QUALITY, std::min(options.jpegQuality, 100) };
+    }
+    else if (ext == ".webp" && options.webpQuality >= 0) {
+        params = { cv::IMWRITE_WEBP_QUALITY, std::max(options.webpQuality, 1) };
+    }
+    return params;
+}
+
+void writeImage(const std::string& path, const cv::Mat& image, const EncodeOptions& options) {
+    if (!cv::imwrite(path, image, encodeParams(path, options))) {
+        throw std::runtime_error("Failed to save image to: " + path);
+    }
+}
+
+int run_cli(int argc, char** argv) {
+    CliOptions opt;
+    try {
+        if (!parseArgs(argc, argv, opt)) {
+            return argc > 1 && std::string(argv[1]) == "--help" ? 0 : 1;
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        printUsage(std::cerr);
+        return 1;
+    }
+
+    std::vector<std::string> files = expandInputs(opt.inputs, opt.video);
+    if (files.empty()) {
+        std::cerr << "No input images found.\n";
+        return 1;
+    }
+    if (!opt.regressFile.empty()) {
+        return regressionRun(opt, files);
+    }
+    if (!fs::exists(opt.outputDir)) {
+        fs::create_directories(opt.outputDir);
+    }
+
+
+    std::unique_ptr<CarveCache> cache;
+    if (!opt.cacheDir.empty()) {
+        cache = std::make_unique<CarveCache>(opt.cacheMB << 20, opt.cacheDir);
+    }
+
+    std::unique_ptr<SeamTrace> trace;
+    if (!opt.traceFile.empty()) {
+        trace = std::make_unique<SeamTrace>();
+    }
+    // Depth and held bytes are sampled by each dump
+    std::unique_ptr<CarveMetrics> metrics;
+    std::unique_ptr<MetricsFileWriter> metricsFile;
+    std::atomic<long long> pending{ static_cast<long long>(files.size()) };
+    if (!opt.metricsFile.empty()) {
+        metrics = std::make_unique<CarveMetrics>();
+        metricsFile = std::make_unique<MetricsFileWriter>([&] {
+            metrics->setQueueDepth(pending.load());
+            metrics->setBytesAllocated(cache ? static_cast<long long>(cache->memoryBytes()) : 0);
+            return metrics->prometheus();
+        }, opt.metricsFile, opt.metricsIntervalMs, streamLogger(std::cerr));
+    }
+
+    // Tracks of the pipeline threads, named by their stage
+    auto stageSpan = [&](const char* stage, size_t i) {
+        if (trace) trace->nameThread(stage);
+        std::unique_ptr<TraceSpan> span = std::make_unique<TraceSpan>(trace.get(), stage, "job");
+        span->arg("job", static_cast<long long>(i));
+        return span;
+    };
+
+    // Decode, carve and encode run as a pipeline over the worker pool;
+    // --sizes writes all but the smallest size on writers while carving
+    std::vector<JobResult> results(files.size());
+    std::vector<std::vector<std::future<void>>> writes(files.size());
+    std::unique_ptr<ThreadPool> writers;
+    if (!opt.sizes.empty()) {
+        writers = std::make_unique<ThreadPool>(static_cast<unsigned>(opt.threads));
+    }
+    // --share-threads: the batch jobs and every job's kernels
+    std::shared_ptr<ThreadPool> kernels;
+    if (opt.shareThreads) {
+        kernels = std::make_shared<ThreadPool>(static_cast<unsigned>(opt.threads));
+    }
+    std::mutex outputMutex;
+    int failures = 0;
+    auto report = [&](size_t i) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        if (!results[i].error.empty()) {
+            failures++;
+            if (metrics) metrics->recordFailure();
+        }
+        pending--;
+        std::cout << toJson(results[i]) << std::endl;
+    };
+
+    if (opt.video) {
+        // One video at a time; each is pipelined by frames
+        for (size_t i = 0; i < files.size(); i++) {
+            auto span = stageSpan("video", i);
+            try {
+                videoJob(opt, files[i], results[i], trace.get());
+            }
+            catch (const std::exception& e) {
+                results[i].input = files[i];
+                results[i].error = e.what();
+            }
+            report(i);
+        }
+    }
+    else if (opt.streamRows > 0) {
+        // One mapped image at a time: streaming bounds memory, not latency
+        for (size_t i = 0; i < files.size(); i++) {
+            auto span = stageSpan("stream", i);
+            try {
+                streamJob(opt, files[i], results[i], trace.get());
+            }
+            catch (const std::exception& e) {
+                results[i].input = files[i];
+                results[i].error = e.what();
+            }
+            report(i);
+        }
+    }
+    else {
+        // --seam-map: the PPM/PGM inputs an existing map covers are served
+        // without a decode (serveSeamMap); the rest go through the pipeline
+        std::vector<size_t> queued;
+        if (opt.seamMap) {
+            ThreadPool servers(static_cast<unsigned>(opt.threads));
+            std::vector<std::future<bool>> served;
+            for (size_t i = 0; i < files.size(); i++) {
+                served.push_back(servers.submit([&, i]() {
+                    auto span = stageSpan("serve", i);
+                    try {
+                        return serveSeamMap(opt, files[i], results[i]);
+                    }
+                    catch (const std::exception& e) {
+                        results[i].input = files[i];
+                        results[i].error = e.what();
+                        return true;
+                    }
+                }));
+            }
+            for (size_t i = 0; i < files.size(); i++) {
+                if (served[i].get()) report(i);
+                else queued.push_back(i);
+            }
+        }
+        else {
+            for (size_t i = 0; i < files.size(); i++) queued.push_back(i);
+        }
+
+        BatchScheduler::Options schedulerOptions;
+        schedulerOptions.workers = (unsigned)std::min<size_t>(opt.threads, queued.size());
+        schedulerOptions.memoryBudget = opt.memoryBudgetMB << 20;
+        schedulerOptions.encoders = (unsigned)std::min<size_t>(opt.encodeThreads > 0 ? opt.encodeThreads : opt.threads,
+                                                               queued.size());
+        if (opt.shareThreads) schedulerOptions.pool = kernels;
+        schedulerOptions.pinWorkers = opt.pinWorkers;
+        BatchScheduler scheduler(schedulerOptions);
+        scheduler.run(queued.size(),
+            [&](size_t k) {
+                const size_t i = queued[k];
+                auto span = stageSpan("decode", i);
+                results[i].input = files[i];
+                auto t0 = std::chrono::steady_clock::now();
+                // A hybrid resize scales first anyway, so a JPEG may skip
+                // the part of the decode the scale would throw away
+                JpegHeader jpeg;
+                if (opt.carveQuality < 1.0 && !opt.fullDecode && readJpegHeader(files[i], jpeg)) {
+                    const cv::Size source(jpeg.width, jpeg.height);
+                    const cv::Size bound = SeamCarver::hybridScaleBound(source,
+                        parseDimension(opt.width, jpeg.width), parseDimension(opt.height, jpeg.height),
+                        opt.carveQuality);
+                    results[i].decodeFactor = reducedDecodeFactor(source, bound);
+                    cv::Mat decoded = imreadReduced(files[i], results[i].decodeFactor, jpeg.channels);
+                    results[i].loadMs = msSince(t0);
+                    results[i].srcWidth = jpeg.width;
+                    results[i].srcHeight = jpeg.height;
+                    return decoded;
+                }
+                cv::Mat decoded = cv::imread(files[i], cv::IMREAD_UNCHANGED);
+                if (decoded.empty()) {
+                    throw std::runtime_error("Could not load image from: " + files[i]);
+                }
+                results[i].loadMs = msSince(t0);
+                results[i].srcWidth = decoded.cols;
+                results[i].srcHeight = decoded.rows;
+                return decoded;
+            },
+            [&](size_t k, cv::Mat& decoded) {
+                const size_t i = queued[k];
+                auto span = stageSpan("carve", i);
+                return carveJob(opt, decoded, results[i], cache.get(), trace.get(), metrics.get(), writers.get(),
+                                writes[i], kernels);
+            },
+            [&](size_t k, const cv::Mat& carved) {
+                const size_t i = queued[k];
+                auto span = stageSpan("encode", i);
+                auto t0 = std::chrono::steady_clock::now();
+                writeImage(results[i].output, carved, opt.encode);
+                for (std::future<void>& w : writes[i]) w.get();
+                results[i].saveMs = msSince(t0);
+                report(i);
+            },
+            [&](size_t k, const std::string& error) {
+                const size_t i = queued[k];
+                for (std::future<void>& w : writes[i]) {
+                    if (w.valid()) w.wait();
+                }
+                results[i].input = files[i];
+                results[i].error = error;
+                report(i);
+            });
+    }
+
+    metricsFile.reset();  // the last dump
+    if (trace) {
+        try {
+            trace->save(opt.traceFile);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 1;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <string>
+#include <vector>
+
+namespace cv { class Mat; }
+
+/**
+ * @brief Headless batch entry point: resize one or more images from the
+ * command line and print one JSON timing record per image on stdout.
+ * Run with --help for the options.
+ * @return process exit code (0 if every image succeeded)
+ */
+int run_cli(int argc, char** argv);
+
+/**
+ * @brief Output file name used by the GUI's "Save resized image":
+ * output_<method>_<w%>w_<h%>h_<width>x<height>.png
+ */
+std::string guiOutputFilename(const std::string& method, int widthPercent, int heightPercent,
+                              int width, int height);
+
+/**
+ * @brief Encoder settings for saved images; -1 keeps OpenCV's default.
+ */
+struct EncodeOptions {
+    int pngCompression = -1;  // 0 (fastest) .. 9 (smallest)
+    int jpegQuality = -1;     // 0 .. 100
+    int webpQuality = -1;     // 1 .. 100, above 100 lossless
+};
+
+/**
+ * @brief cv::imwrite parameters of options for the format of path's
+ * extension.
+ */
+std::vector<int> encodeParams(const std::string& path, const EncodeOptions& options);
+
+/**
+ * @brief cv::imwrite with encodeParams. Throws std::runtime_error if the
+ * image could not be saved.
+ */
+void writeImage(const std::string& path, const cv::Mat& image, const EncodeOptions& options);
+
+#endif // CLI_H
@@ -0,0 +1,9 @@
+#include "Cli.h"
+
+// ============================================================================
+// Headless entry point (no GUI dependencies)
+// ============================================================================
+
+int main(int argc, char** argv) {
+    return run_cli(argc, argv);
+}
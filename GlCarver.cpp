@@ -0,0 +1,558 @@
+#include "GlCarver.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+// OpenGL 1.1 headers do not have these
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS 0x8B82
+#endif
+#ifndef GL_INFO_LOG_LENGTH
+#define GL_INFO_LOG_LENGTH 0x8B84
+#endif
+#ifndef GL_DYNAMIC_COPY
+#define GL_DYNAMIC_COPY 0x88EA
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_WRITE_ONLY
+#define GL_WRITE_ONLY 0x88B9
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+
+namespace {
+
+// Work-group size of the per-pixel shaders (local_size_x and _y)
+const int kTile = 16;
+
+// Planes are uint per pixel in row-major order with the loaded image's
+// pitch: the image as packed BGRA bytes, the gray plane as its value.
+// "vertical" picks the seam direction; a horizontal seam has one row
+// index per column.
+const char* const kEnergyShader = R"GLSL(
+#version 430
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(std430, binding = 0) readonly buffer Gray { uint gray[]; };
+layout(std430, binding = 1) writeonly buffer Energy { float energy[]; };
+uniform int rows;
+uniform int cols;
+uniform int pitch;
+uniform int function;  // 0 Sobel, 1 Scharr, 2 dual gradient, 3 L1 gradient, 4 FastSobel
+
+int reflect101(int p, int n) {
+    if (n == 1) return 0;
+    if (p < 0) return -p;
+    if (p >= n) return 2 * n - p - 2;
+    return p;
+}
+
+void main() {
+    int c = int(gl_GlobalInvocationID.x);
+    int r = int(gl_GlobalInvocationID.y);
+    if (c >= cols || r >= rows) return;
+    int g[9];
+    for (int dr = -1; dr <= 1; dr++) {
+        int row = reflect101(r + dr, rows) * pitch;
+        for (int dc = -1; dc <= 1; dc++) g[(dr + 1) * 3 + dc + 1] = int(gray[row + reflect101(c + dc, cols)]);
+    }
+    float e;
+    if (function == 1) {
+        int gx = 3 * (g[2] - g[0]) + 10 * (g[5] - g[3]) + 3 * (g[8] - g[6]);
+        int gy = 3 * (g[6] - g[0]) + 10 * (g[7] - g[1]) + 3 * (g[8] - g[2]);
+        e = 0.25 * sqrt(float(gx * gx + gy * gy));
+    } else if (function == 2) {
+        int dx = g[5] - g[3];
+        int dy = g[7] - g[1];
+        e = sqrt(float(dx * dx + dy * dy));
+    } else if (function == 3) {
+        e = float(abs(g[5] - g[3]) + abs(g[7] - g[1]));
+    } else {
+        int gx = (g[2] - g[0]) + 2 * (g[5] - g[3]) + (g[8] - g[6]);
+        int gy = (g[6] - g[0]) + 2 * (g[7] - g[1]) + (g[8] - g[2]);
+        if (function == 4) {
+            gx = abs(gx);
+            gy = abs(gy);
+            e = 0.5 * float(2 * max(gx, gy) + min(gx, gy));
+        } else {
+            e = sqrt(float(gx * gx + gy * gy));
+        }
+    }
+    energy[r * pitch + c] = e;
+}
+)GLSL";
+
+// Backward-energy DP in one work-group, a line at a time, then item 0
+// backtracks with backtrackDP's tie-breaking (first minimum of the last
+// line, then straight, lower index, higher index)
+const char* const kDPShader = R"GLSL(
+#version 430
+layout(local_size_x = 256) in;
+layout(std430, binding = 0) readonly buffer Energy { float energy[]; };
+layout(std430, binding = 1) buffer Cost { float cost[]; };
+layout(std430, binding = 2) writeonly buffer Seam { int seam[]; };
+uniform int rows;
+uniform int cols;
+uniform int pitch;
+uniform int vertical;
+
+// Pixel of line i (row of a vertical seam), position j along it
+int at(int i, int j) { return vertical != 0 ? i * pitch + j : j * pitch + i; }
+
+void main() {
+    int lines = vertical != 0 ? rows : cols;
+    int width = vertical != 0 ? cols : rows;
+    int lid = int(gl_LocalInvocationID.x);
+    for (int j = lid; j < width; j += 256) cost[at(0, j)] = energy[at(0, j)];
+    memoryBarrierBuffer();
+    barrier();
+    for (int i = 1; i < lines; i++) {
+        for (int j = lid; j < width; j += 256) {
+            float m = cost[at(i - 1, j)];
+            if (j > 0) m = min(m, cost[at(i - 1, j - 1)]);
+            if (j + 1 < width) m = min(m, cost[at(i - 1, j + 1)]);
+            cost[at(i, j)] = energy[at(i, j)] + m;
+        }
+        memoryBarrierBuffer();
+        barrier();
+    }
+    if (lid != 0) return;
+
+    int j = 0;
+    for (int c = 1; c < width; c++) {
+        if (cost[at(lines - 1, c)] < cost[at(lines - 1, j)]) j = c;
+    }
+    seam[lines - 1] = j;
+    for (int i = lines - 2; i >= 0; i--) {
+        int best = j;
+        if (j > 0 && cost[at(i, j - 1)] < cost[at(i, best)]) best = j - 1;
+        if (j + 1 < width && cost[at(i, j + 1)] < cost[at(i, best)]) best = j + 1;
+        j = best;
+        seam[i] = j;
+    }
+}
+)GLSL";
+
+// dst = src planes without the seam; rows x cols is the size before it
+const char* const kRemoveShader = R"GLSL(
+#version 430
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(std430, binding = 0) readonly buffer SrcImage { uint srcImage[]; };
+layout(std430, binding = 1) writeonly buffer DstImage { uint dstImage[]; };
+layout(std430, binding = 2) readonly buffer SrcGray { uint srcGray[]; };
+layout(std430, binding = 3) writeonly buffer DstGray { uint dstGray[]; };
+layout(std430, binding = 4) readonly buffer Seam { int seam[]; };
+uniform int rows;
+uniform int cols;
+uniform int pitch;
+uniform int vertical;
+
+void main() {
+    int c = int(gl_GlobalInvocationID.x);
+    int r = int(gl_GlobalInvocationID.y);
+    if (c >= cols - vertical || r >= rows - (1 - vertical)) return;
+    int from = vertical != 0 ? r * pitch + (c < seam[r] ? c : c + 1)
+                             : (r < seam[c] ? r : r + 1) * pitch + c;
+    int to = r * pitch + c;
+    dstImage[to] = srcImage[from];
+    dstGray[to] = srcGray[from];
+}
+)GLSL";
+
+// Working image into the display texture
+const char* const kPresentShader = R"GLSL(
+#version 430
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(std430, binding = 0) readonly buffer Image { uint image[]; };
+layout(rgba8, binding = 0) writeonly uniform image2D target;
+uniform int rows;
+uniform int cols;
+uniform int pitch;
+
+void main() {
+    int c = int(gl_GlobalInvocationID.x);
+    int r = int(gl_GlobalInvocationID.y);
+    if (c >= cols || r >= rows) return;
+    uint p = image[r * pitch + c];
+    vec4 rgba = vec4(float((p >> 16) & 255u), float((p >> 8) & 255u), float(p & 255u), float(p >> 24));
+    imageStore(target, ivec2(c, r), rgba / 255.0);
+}
+)GLSL";
+
+// Value access shared by the heatmap shaders. The plane is uploaded as
+// raw words: element i of row-major storage with pitch elements a row,
+// as float, double (two words), uint16 (half a word) or int32.
+const char* const kHeatCommon = R"GLSL(
+#version 430
+layout(local_size_x = 16, local_size_y = 16) in;
+layout(std430, binding = 0) readonly buffer Values { uint words[]; };
+layout(std430, binding = 1) buffer Bounds { uint bounds[2]; };  // float bits of the min and max
+uniform int rows;
+uniform int cols;
+uniform int pitch;
+uniform int depth;  // 0 float, 1 double, 2 uint16, 3 int32
+
+float valueAt(int r, int c) {
+    int i = r * pitch + c;
+    if (depth == 1) return float(unpackDouble2x32(uvec2(words[2 * i], words[2 * i + 1])));
+    if (depth == 2) return float((words[i >> 1] >> (16 * (i & 1))) & 0xFFFFu);
+    if (depth == 3) return float(int(words[i]));
+    return uintBitsToFloat(words[i]);
+}
+)GLSL";
+
+// Min and max of the non-negative values. Their float bits order like
+// the values, so integer atomics do the reduction.
+const char* const kHeatRangeShader = R"GLSL(
+void main() {
+    int c = int(gl_GlobalInvocationID.x);
+    int r = int(gl_GlobalInvocationID.y);
+    if (c >= cols || r >= rows) return;
+    float v = valueAt(r, c);
+    if (!(v >= 0.0)) return;
+    uint bits = floatBitsToUint(v);
+    atomicMin(bounds[0], bits);
+    atomicMax(bounds[1], bits);
+}
+)GLSL";
+
+// Nearest value per target pixel through a black - purple - red - yellow -
+// white ramp over the range found above
+const char* const kHeatColorShader = R"GLSL(
+layout(rgba8, binding = 0) writeonly uniform image2D target;
+uniform int width;
+uniform int height;
+uniform int logScale;
+
+vec3 ramp(float t) {
+    const vec3 stops[5] = vec3[5](vec3(0.0, 0.0, 0.02), vec3(0.34, 0.06, 0.43), vec3(0.8, 0.2, 0.25),
+                                  vec3(0.99, 0.65, 0.04), vec3(1.0, 1.0, 0.9));
+    float x = clamp(t, 0.0, 1.0) * 4.0;
+    int k = min(int(x), 3);
+    return mix(stops[k], stops[k + 1], x - float(k));
+}
+
+void main() {
+    int x = int(gl_GlobalInvocationID.x);
+    int y = int(gl_GlobalInvocationID.y);
+    if (x >= width || y >= height) return;
+    int c = min(cols - 1, (x * cols) / width);
+    int r = min(rows - 1, (y * rows) / height);
+    float v = valueAt(r, c);
+    vec3 rgb;
+    if (v < 0.0) {
+        rgb = vec3(0.1, 0.35, 1.0);
+    } else {
+        float lo = uintBitsToFloat(bounds[0]);
+        float span = max(uintBitsToFloat(bounds[1]) - lo, 1e-20);
+        float t = logScale != 0 ? log(1.0 + (v - lo)) / log(1.0 + span) : (v - lo) / span;
+        rgb = ramp(t);
+    }
+    imageStore(target, ivec2(x, y), vec4(rgb, 1.0));
+}
+)GLSL";
+
+// Function uniform of the energy shader
+int energyFunctionCode(EnergyFunction function) {
+    switch (function) {
+    case EnergyFunction::Scharr: return 1;
+    case EnergyFunction::DualGradient: return 2;
+    case EnergyFunction::L1Gradient: return 3;
+    case EnergyFunction::FastSobel: return 4;
+    case EnergyFunction::Sobel:
+    default: return 0;
+    }
+}
+
+} // namespace
+
+bool GlCarver::loadFunctions() {
+    int major = 0, minor = 0;
+    if (const char* version = (const char*)glGetString(GL_VERSION)) {
+        std::sscanf(version, "%d.%d", &major, &minor);
+    }
+    if (major < 4 || (major == 4 && minor < 3)) return false;
+
+    auto load = [](const char* name) { return glfwGetProcAddress(name); };
+    createShader = (CreateShaderFn)load("glCreateShader");
+    shaderSource = (ShaderSourceFn)load("glShaderSource");
+    compileShader = (CompileShaderFn)load("glCompileShader");
+    getShaderiv = (GetShaderivFn)load("glGetShaderiv");
+    getShaderInfoLog = (GetShaderInfoLogFn)load("glGetShaderInfoLog");
+    deleteShader = (DeleteShaderFn)load("glDeleteShader");
+    createProgram = (CreateProgramFn)load("glCreateProgram");
+    attachShader = (AttachShaderFn)load("glAttachShader");
+    linkProgram = (LinkProgramFn)load("glLinkProgram");
+    getProgramiv = (GetProgramivFn)load("glGetProgramiv");
+    getProgramInfoLog = (GetProgramInfoLogFn)load("glGetProgramInfoLog");
+    deleteProgram = (DeleteProgramFn)load("glDeleteProgram");
+    useProgram = (UseProgramFn)load("glUseProgram");
+    getUniformLocation = (GetUniformLocationFn)load("glGetUniformLocation");
+    uniform1i = (Uniform1iFn)load("glUniform1i");
+    genBuffers = (GenBuffersFn)load("glGenBuffers");
+    deleteBuffers = (DeleteBuffersFn)load("glDeleteBuffers");
+    bindBuffer = (BindBufferFn)load("glBindBuffer");
+    bufferData = (BufferDataFn)load("glBufferData");
+    bufferSubData = (BufferSubDataFn)load("glBufferSubData");
+    getBufferSubData = (GetBufferSubDataFn)load("glGetBufferSubData");
+    bindBufferBase = (BindBufferBaseFn)load("glBindBufferBase");
+    dispatchCompute = (DispatchComputeFn)load("glDispatchCompute");
+    memoryBarrier = (MemoryBarrierFn)load("glMemoryBarrier");
+    bindImageTexture = (BindImageTextureFn)load("glBindImageTexture");
+    return createShader && shaderSource && compileShader && getShaderiv && getShaderInfoLog && deleteShader &&
+           createProgram && attachShader && linkProgram && getProgramiv && getProgramInfoLog && deleteProgram &&
+           useProgram && getUniformLocation && uniform1i && genBuffers && deleteBuffers && bindBuffer &&
+           bufferData && bufferSubData && getBufferSubData && bindBufferBase && dispatchCompute && memoryBarrier &&
+           bindImageTexture;
+}
+
+GLuint GlCarver::buildProgram(const char* source, std::string* error) {
+    GLuint shader = createShader(GL_COMPUTE_SHADER);
+    shaderSource(shader, 1, &source, nullptr);
+    compileShader(shader);
+    GLint ok = 0;
+    getShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        GLint length = 0;
+        getShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> log(std::max(1, length));
+        getShaderInfoLog(shader, (GLsizei)log.size(), nullptr, log.data());
+        *error = std::string("Compute shader did not compile: ") + log.data();
+        deleteShader(shader);
+        return 0;
+    }
+    GLuint program = createProgram();
+    attachShader(program, shader);
+    linkProgram(program);
+    deleteShader(shader);  // freed with the program
+    getProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        GLint length = 0;
+        getProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+        std::vector<char> log(std::max(1, length));
+        getProgramInfoLog(program, (GLsizei)log.size(), nullptr, log.data());
+        *error = std::string("Compute shader did not link: ") + log.data();
+        deleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+bool GlCarver::init(std::string* error) {
+    if (!loadFunctions()) {
+        *error = "Compute shaders need OpenGL 4.3.";
+        return false;
+    }
+    const std::string heatRange = std::string(kHeatCommon) + kHeatRangeShader;
+    const std::string heatColor = std::string(kHeatCommon) + kHeatColorShader;
+    const char* sources[kPrograms] = { kEnergyShader, kDPShader, kRemoveShader, kPresentShader,
+                                       heatRange.c_str(), heatColor.c_str() };
+    for (int p = 0; p < kPrograms; p++) {
+        programs[p] = buildProgram(sources[p], error);
+        if (programs[p] == 0) {
+            for (int q = 0; q < p; q++) deleteProgram(programs[q]);
+            return false;
+        }
+    }
+    genBuffers(kBuffers, buffers);
+    ready = true;
+    return true;
+}
+
+void GlCarver::destroy() {
+    if (!ready) return;
+    for (GLuint program : programs) deleteProgram(program);
+    deleteBuffers(kBuffers, buffers);
+    ready = false;
+    rows = cols = 0;
+}
+
+void GlCarver::setEnergyFunction(EnergyFunction function) {
+    if (function == EnergyFunction::Saliency) {
+        throw std::runtime_error("GPU carving needs a per-pixel energy function (saliency is global).");
+    }
+    energyFunction = function;
+}
+
+void GlCarver::load(const cv::Mat& image) {
+    if (image.empty() || image.depth() != CV_8U ||
+        (image.channels() != 1 && image.channels() != 3 && image.channels() != 4)) {
+        throw std::runtime_error("GPU carving needs an 8-bit image with 1, 3 or 4 channels.");
+    }
+    cv::Mat bgra, gray;
+    if (image.channels() == 4) bgra = image.isContinuous() ? image : image.clone();
+    else cv::cvtColor(image, bgra, image.channels() == 1 ? cv::COLOR_GRAY2BGRA : cv::COLOR_BGR2BGRA);
+    if (image.channels() == 1) gray = image;
+    else cv::cvtColor(image, gray, image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    cv::Mat grayWords;
+    gray.convertTo(grayWords, CV_32S);
+
+    rows = image.rows;
+    cols = image.cols;
+    pitch = image.cols;
+    channels = image.channels();
+    current = 0;
+
+    // Removal only shrinks the image, so the loaded size fits every seam;
+    // the heatmap buffers are sized by presentHeatmap
+    const std::ptrdiff_t plane = (std::ptrdiff_t)rows * pitch * 4;
+    const void* data[Seam + 1] = { bgra.data, nullptr, grayWords.data, nullptr, nullptr, nullptr, nullptr };
+    const std::ptrdiff_t sizes[Seam + 1] = { plane, plane, plane, plane, plane, plane,
+                                             (std::ptrdiff_t)std::max(rows, cols) * 4 };
+    for (int b = 0; b <= Seam; b++) {
+        bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[b]);
+        bufferData(GL_SHADER_STORAGE_BUFFER, sizes[b], data[b], GL_DYNAMIC_COPY);
+    }
+    bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GlCarver::setInt(Program program, const char* name, int value) {
+    uniform1i(getUniformLocation(programs[program], name), value);
+}
+
+void GlCarver::bindBuffers(std::initializer_list<Buffer> list) {
+    GLuint binding = 0;
+    for (Buffer b : list) bindBufferBase(GL_SHADER_STORAGE_BUFFER, binding++, buffers[b]);
+}
+
+void GlCarver::dispatch(int x, int y, int groupSize) {
+    dispatchCompute((GLuint)((x + groupSize - 1) / groupSize), (GLuint)((y + groupSize - 1) / groupSize), 1);
+}
+
+// The dispatches are ordered by buffer barriers only; nothing waits for
+// the GPU or reads back
+bool GlCarver::removeSeam(bool vertical) {
+    if (!ready || (vertical ? cols : rows) <= 1) return false;
+    const Buffer image = current ? Image1 : Image0;
+    const Buffer gray = current ? Gray1 : Gray0;
+
+    useProgram(programs[Energy]);
+    setInt(Energy, "rows", rows);
+    setInt(Energy, "cols", cols);
+    setInt(Energy, "pitch", pitch);
+    setInt(Energy, "function", energyFunctionCode(energyFunction));
+    bindBuffers({ gray, EnergyMap });
+    dispatch(cols, rows, kTile);
+    memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    useProgram(programs[DP]);
+    setInt(DP, "rows", rows);
+    setInt(DP, "cols", cols);
+    setInt(DP, "pitch", pitch);
+    setInt(DP, "vertical", vertical ? 1 : 0);
+    bindBuffers({ EnergyMap, Cost, Seam });
+    dispatchCompute(1, 1, 1);
+    memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    useProgram(programs[Remove]);
+    setInt(Remove, "rows", rows);
+    setInt(Remove, "cols", cols);
+    setInt(Remove, "pitch", pitch);
+    setInt(Remove, "vertical", vertical ? 1 : 0);
+    bindBuffers({ image, current ? Image0 : Image1, gray, current ? Gray0 : Gray1, Seam });
+    dispatch(cols, rows, kTile);
+    memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    useProgram(0);
+
+    current = 1 - current;
+    if (vertical) cols--;
+    else rows--;
+    return true;
+}
+
+void GlCarver::present(GLuint texture) {
+    if (!ready || !loaded()) return;
+    useProgram(programs[Present]);
+    setInt(Present, "rows", rows);
+    setInt(Present, "cols", cols);
+    setInt(Present, "pitch", pitch);
+    bindBuffers({ current ? Image1 : Image0 });
+    bindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    dispatch(cols, rows, kTile);
+    // ImGui samples the texture next
+    memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    useProgram(0);
+}
+
+void GlCarver::presentHeatmap(const cv::Mat& plane, GLuint texture, int width, int height, bool logScale) {
+    if (!ready || plane.empty() || width < 1 || height < 1) return;
+    int depth = -1;
+    switch (plane.depth()) {
+    case CV_32F: depth = 0; break;
+    case CV_64F: depth = 1; break;
+    case CV_16U: depth = 2; break;
+    case CV_32S: depth = 3; break;
+    }
+    if (depth < 0 || plane.channels() != 1) {
+        throw std::runtime_error("Heatmaps need a single-channel CV_64F, CV_32F, CV_16U or CV_32S plane.");
+    }
+
+    // Rows as they are in memory, padding included; the buffer is rounded
+    // up to whole words for the uint16 case
+    const std::ptrdiff_t bytes = (std::ptrdiff_t)(plane.rows - 1) * plane.step[0] + plane.cols * plane.elemSize();
+    bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[HeatValues]);
+    bufferData(GL_SHADER_STORAGE_BUFFER, (bytes + 3) & ~std::ptrdiff_t(3), nullptr, GL_STREAM_DRAW);
+    bufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, plane.data);
+    const GLuint bounds[2] = { 0x7F7FFFFFu, 0u };  // FLT_MAX, 0
+    bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[HeatBounds]);
+    bufferData(GL_SHADER_STORAGE_BUFFER, sizeof(bounds), bounds, GL_STREAM_DRAW);
+    bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    const int planePitch = (int)(plane.step[0] / plane.elemSize());
+
+    for (Program p : { HeatRange, HeatColor }) {
+        useProgram(programs[p]);
+        setInt(p, "rows", plane.rows);
+        setInt(p, "cols", plane.cols);
+        setInt(p, "pitch", planePitch);
+        setInt(p, "depth", depth);
+    }
+    useProgram(programs[HeatRange]);
+    bindBuffers({ HeatValues, HeatBounds });
+    dispatch(plane.cols, plane.rows, kTile);
+    memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    useProgram(programs[HeatColor]);
+    setInt(HeatColor, "width", width);
+    setInt(HeatColor, "height", height);
+    setInt(HeatColor, "logScale", logScale ? 1 : 0);
+    bindImageTexture(0, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    dispatch(width, height, kTile);
+    memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    useProgram(0);
+}
+
+cv::Mat GlCarver::download() const {
+    if (!ready || !loaded()) return cv::Mat();
+    cv::Mat bgra(rows, pitch, CV_8UC4);
+    memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    bindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[current ? Image1 : Image0]);
+    getBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (std::ptrdiff_t)bgra.total() * 4, bgra.data);
+    bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    cv::Mat out;
+    const cv::Mat view = bgra.colRange(0, cols);
+    if (channels == 4) view.copyTo(out);
+    else cv::cvtColor(view, out, channels == 1 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGRA2BGR);
+    return out;
+}
@@ -0,0 +1,160 @@
+#ifndef GL_CARVER_H
+#define GL_CARVER_H
+
+#include "SeamCarver.h"
+#include <GLFW/glfw3.h>
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+
+/**
+ * @brief Seam carving in OpenGL compute shaders, for the GUI.
+ *
+ * The working image, its gray plane, the energy map, the DP cost table and
+ * the seam live in shader storage buffers of the display's GL context.
+ * Every seam is three dispatches: the per-pixel energy of the gray plane,
+ * a one-work-group DP that also backtracks the seam, and the removal of
+ * the seam from the image and gray planes. present() writes the carved
+ * image straight into the display texture, so neither carving nor showing
+ * a frame moves pixels between the CPU and the GPU; download() is only
+ * needed to save or hand the image back to the CPU worker.
+ * presentHeatmap color-maps CPU planes (energy maps, DP cost tables) into
+ * a texture the same way.
+ *
+ * Seams are those of the DP method with backward energy at Float
+ * precision and a per-pixel energy function (GpuCarver's kernels as
+ * GLSL). Compute shaders need OpenGL 4.3; entry points are loaded through
+ * GLFW, and available() is false on older contexts.
+ */
+class GlCarver {
+public:
+    /**
+     * @brief Load the entry points and build the shaders; needs the
+     * current GL context. On failure error says why.
+     */
+    bool init(std::string* error);
+
+    bool available() const { return ready; }
+
+    /**
+     * @brief Upload image (8-bit, 1, 3 or 4 channels) as the working image
+     * and size the buffers for it. Throws std::runtime_error otherwise.
+     */
+    void load(const cv::Mat& image);
+    bool loaded() const { return rows > 0; }
+
+    // @brief Local energy function (EnergyFunction::Saliency is rejected).
+    void setEnergyFunction(EnergyFunction function);
+    EnergyFunction getEnergyFunction() const { return energyFunction; }
+
+    int width() const { return cols; }
+    int height() const { return rows; }
+
+    /**
+     * @brief Queue the search and removal of one vertical (horizontal) seam.
+     * @return false when the image is a single pixel wide (tall)
+     */
+    bool removeSeam(bool vertical);
+
+    /**
+     * @brief Write the working image into the top-left width() x height()
+     * of texture, a GL_RGBA8 texture at least that large.
+     */
+    void present(GLuint texture);
+
+    // @brief Copy of the working image in host memory, in the loaded channel count.
+    cv::Mat download() const;
+
+    /**
+     * @brief Color-map plane, a single-channel CV_64F, CV_32F, CV_16U or
+     * CV_32S map such as an energy map or a DP cost table, into the
+     * top-left width x height of texture (a GL_RGBA8 texture at least that
+     * large), sampling the nearest pixel when that is smaller than plane.
+     * The plane's rows go up as they are: the range reduction and the
+     * color map run in compute shaders, so nothing is converted on the
+     * CPU. Negative values (pixels marked for removal) are drawn blue.
+     * Needs init() but not load(); throws std::runtime_error for other
+     * plane types.
+     */
+    void presentHeatmap(const cv::Mat& plane, GLuint texture, int width, int height, bool logScale);
+
+    void destroy();
+
+private:
+    // GL 2.0 to 4.3 entry points, not in the OpenGL 1.1 headers
+    using CreateShaderFn = GLuint (APIENTRY*)(GLenum);
+    using ShaderSourceFn = void (APIENTRY*)(GLuint, GLsizei, const char* const*, const GLint*);
+    using CompileShaderFn = void (APIENTRY*)(GLuint);
+    using GetShaderivFn = void (APIENTRY*)(GLuint, GLenum, GLint*);
+    using GetShaderInfoLogFn = void (APIENTRY*)(GLuint, GLsizei, GLsizei*, char*);
+    using DeleteShaderFn = void (APIENTRY*)(GLuint);
+    using CreateProgramFn = GLuint (APIENTRY*)();
+    using AttachShaderFn = void (APIENTRY*)(GLuint, GLuint);
+    using LinkProgramFn = void (APIENTRY*)(GLuint);
+    using GetProgramivFn = void (APIENTRY*)(GLuint, GLenum, GLint*);
+    using GetProgramInfoLogFn = void (APIENTRY*)(GLuint, GLsizei, GLsizei*, char*);
+    using DeleteProgramFn = void (APIENTRY*)(GLuint);
+    using UseProgramFn = void (APIENTRY*)(GLuint);
+    using GetUniformLocationFn = GLint (APIENTRY*)(GLuint, const char*);
+    using Uniform1iFn = void (APIENTRY*)(GLint, GLint);
+    using GenBuffersFn = void (APIENTRY*)(GLsizei, GLuint*);
+    using DeleteBuffersFn = void (APIENTRY*)(GLsizei, const GLuint*);
+    using BindBufferFn = void (APIENTRY*)(GLenum, GLuint);
+    using BufferDataFn = void (APIENTRY*)(GLenum, std::ptrdiff_t, const void*, GLenum);
+    using BufferSubDataFn = void (APIENTRY*)(GLenum, std::ptrdiff_t, std::ptrdiff_t, const void*);
+    using GetBufferSubDataFn = void (APIENTRY*)(GLenum, std::ptrdiff_t, std::ptrdiff_t, void*);
+    using BindBufferBaseFn = void (APIENTRY*)(GLenum, GLuint, GLuint);
+    using DispatchComputeFn = void (APIENTRY*)(GLuint, GLuint, GLuint);
+    using MemoryBarrierFn = void (APIENTRY*)(GLbitfield);
+    using BindImageTextureFn = void (APIENTRY*)(GLuint, GLuint, GLint, GLboolean, GLint, GLenum, GLenum);
+
+    enum Program { Energy, DP, Remove, Present, HeatRange, HeatColor, kPrograms };
+    enum Buffer { Image0, Image1, Gray0, Gray1, EnergyMap, Cost, Seam, HeatValues, HeatBounds, kBuffers };
+
+    bool loadFunctions();
+    GLuint buildProgram(const char* source, std::string* error);
+    void setInt(Program program, const char* name, int value);
+    void bindBuffers(std::initializer_list<Buffer> buffers);
+    void dispatch(int x, int y, int groupSize);
+
+    CreateShaderFn createShader = nullptr;
+    ShaderSourceFn shaderSource = nullptr;
+    CompileShaderFn compileShader = nullptr;
+    GetShaderivFn getShaderiv = nullptr;
+    GetShaderInfoLogFn getShaderInfoLog = nullptr;
+    DeleteShaderFn deleteShader = nullptr;
+    CreateProgramFn createProgram = nullptr;
+    AttachShaderFn attachShader = nullptr;
+    LinkProgramFn linkProgram = nullptr;
+    GetProgramivFn getProgramiv = nullptr;
+    GetProgramInfoLogFn getProgramInfoLog = nullptr;
+    DeleteProgramFn deleteProgram = nullptr;
+    UseProgramFn useProgram = nullptr;
+    GetUniformLocationFn getUniformLocation = nullptr;
+    Uniform1iFn uniform1i = nullptr;
+    GenBuffersFn genBuffers = nullptr;
+    DeleteBuffersFn deleteBuffers = nullptr;
+    BindBufferFn bindBuffer = nullptr;
+    BufferDataFn bufferData = nullptr;
+    BufferSubDataFn bufferSubData = nullptr;
+    GetBufferSubDataFn getBufferSubData = nullptr;
+    BindBufferBaseFn bindBufferBase = nullptr;
+    DispatchComputeFn dispatchCompute = nullptr;
+    MemoryBarrierFn memoryBarrier = nullptr;
+    BindImageTextureFn bindImageTexture = nullptr;
+
+    GLuint programs[kPrograms] = {};
+    GLuint buffers[kBuffers] = {};
+    bool ready = false;
+
+    EnergyFunction energyFunction = EnergyFunction::Sobel;
+    // Every buffer keeps the loaded image's row pitch; removal writes the
+    // other image and gray buffer, so current picks Image0/Gray0 or 1
+    int current = 0;
+    int pitch = 0;
+    int rows = 0;
+    int cols = 0;
+    int channels = 0;
+};
+
+#endif // GL_CARVER_H
@@ -0,0 +1,21 @@
+// Counting replacements of the global allocation functions for the
+// memory stats of SeamCarver (MemoryStats). Linked into the executables
+// only; the default array and nothrow forms forward to these.
+#include "SeamStats.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+[[maybe_unused]] const bool linked = (setHeapCountingLinked(), true);
+} // namespace
+
+void* operator new(std::size_t size) {
+    HeapCounter& counter = threadHeapCounter();
+    counter.allocations++;
+    counter.bytes += size;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
@@ -1,11 +1,24 @@
 #include "SeamCarver.h"
+#include "Cli.h"
+#include "CarveWorker.h"
+#include "CarveCache.h"
+#include "GlCarver.h"
+#include "SeamMap.h"
+#include "SeamMapPrecompute.h"
+#include "MethodComparison.h"
+#include "SeamDecode.h"
+#include "ThreadPool.h"
 #include <iostream>
 #include <string>
 #include <chrono>
 #include <filesystem>
+#include <future>
 #include <memory>
 #include <vector>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
 
 #include <opencv2/opencv.hpp>
 
@@ -15,15 +28,170 @@
 
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
-#include "backends/imgui_impl_opengl2.h"
+#include "backends/imgui_impl_opengl3.h"
 
 namespace fs = std::filesystem;
 
-// For OpenGL texture output
+// OpenGL 1.1 headers (Windows) only ship the _EXT names for these
+#ifndef GL_BGR
+#define GL_BGR 0x80E0
+#endif
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_WRITE_ONLY
+#define GL_WRITE_ONLY 0x88B9
+#endif
+
+/**
+ * @brief Ring of pixel unpack buffers for asynchronous texture uploads.
+ * The CPU copies frame N+1 into one buffer while the driver is still
+ * transferring frame N out of the other, so glTexSubImage2D returns
+ * without waiting on the copy. Buffer entry points are not in the
+ * OpenGL 1.1 headers and are loaded through GLFW; when the context has
+ * no pixel buffer object support, available() is false and uploads go
+ * straight from client memory.
+ */
+class PixelUploadRing {
+public:
+    static constexpr int kSlots = 2;
+
+    /** @brief Load the buffer functions; needs a current GL context */
+    bool init() {
+        int major = 0, minor = 0;
+        if (const char* version = (const char*)glGetString(GL_VERSION)) {
+            std::sscanf(version, "%d.%d", &major, &minor);
+        }
+        bool core = major > 2 || (major == 2 && minor >= 1);
+        if (!core && !glfwExtensionSupported("GL_ARB_pixel_buffer_object")) return false;
+
+        const char* suffix = core ? "" : "ARB";
+        auto load = [suffix](const char* name) {
+            return glfwGetProcAddress((std::string(name) + suffix).c_str());
+        };
+        genBuffers = (GenBuffersFn)load("glGenBuffers");
+        deleteBuffers = (DeleteBuffersFn)load("glDeleteBuffers");
+        bindBuffer = (BindBufferFn)load("glBindBuffer");
+        bufferData = (BufferDataFn)load("glBufferData");
+        mapBuffer = (MapBufferFn)load("glMapBuffer");
+        unmapBuffer = (UnmapBufferFn)load("glUnmapBuffer");
+        if (!genBuffers || !deleteBuffers || !bindBuffer || !bufferData || !mapBuffer || !unmapBuffer) {
+            return false;
+        }
+
+        genBuffers(kSlots, buffers);
+        ready = true;
+        return true;
+    }
+
+    bool available() const { return ready; }
+
+    /**
+     * @brief Upload img into the bound texture's top-left corner via the next buffer
+     * @return false if the buffer could not be mapped (caller uploads directly)
+     */
+    bool upload(const cv::Mat& img, GLenum format) {
+        size_t rowBytes = (size_t)img.cols * img.elemSize();
+        size_t bytes = rowBytes * (size_t)img.rows;
+        GLuint buffer = buffers[next];
+        next = (next + 1) % kSlots;
+
+        bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        // Orphan the old storage so mapping never waits for a pending transfer
+        bufferData(GL_PIXEL_UNPACK_BUFFER, (std::ptrdiff_t)bytes, nullptr, GL_STREAM_DRAW);
+        auto* dst = (uchar*)mapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+        if (!dst) {
+            bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return false;
+        }
+        if (img.isContinuous()) {
+            std::memcpy(dst, img.data, bytes);
+        }
+        else {
+            for (int y = 0; y < img.rows; ++y) {
+                std::memcpy(dst + y * rowBytes, img.ptr(y), rowBytes);
+            }
+        }
+        unmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        // Source pointer is an offset into the bound buffer
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, img.cols, img.rows,
+            format, GL_UNSIGNED_BYTE, nullptr);
+        bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return true;
+    }
+
+    void destroy() {
+        if (ready) {
+            deleteBuffers(kSlots, buffers);
+            ready = false;
+        }
+    }
+
+private:
+    using GenBuffersFn = void (APIENTRY*)(GLsizei, GLuint*);
+    using DeleteBuffersFn = void (APIENTRY*)(GLsizei, const GLuint*);
+    using BindBufferFn = void (APIENTRY*)(GLenum, GLuint);
+    using BufferDataFn = void (APIENTRY*)(GLenum, std::ptrdiff_t, const void*, GLenum);
+    using MapBufferFn = void* (APIENTRY*)(GLenum, GLenum);
+    using UnmapBufferFn = GLboolean (APIENTRY*)(GLenum);
+
+    GenBuffersFn genBuffers = nullptr;
+    DeleteBuffersFn deleteBuffers = nullptr;
+    BindBufferFn bindBuffer = nullptr;
+    BufferDataFn bufferData = nullptr;
+    MapBufferFn mapBuffer = nullptr;
+    UnmapBufferFn unmapBuffer = nullptr;
+
+    GLuint buffers[kSlots] = {};
+    int next = 0;
+    bool ready = false;
+};
+
+// For OpenGL texture output. The texture is allocated once at the largest
+// size seen and carved frames are written into its top-left corner;
+// width/height give the part currently in use. Images larger than the
+// display limit go up as a display-size copy, so imageWidth/imageHeight
+// (the image shown) can exceed width/height.
 struct ImageTexture {
     GLuint id = 0;
     int width = 0;
     int height = 0;
+    int imageWidth = 0;
+    int imageHeight = 0;
+    int capacityWidth = 0;
+    int capacityHeight = 0;
+    int limitWidth = 0;    // display limit of uploads (0: full resolution)
+    int limitHeight = 0;
+    int maxSize = 0;       // GL_MAX_TEXTURE_SIZE, once known
+    cv::Mat scaled;        // reused display-size copy
+    PixelUploadRing* uploads = nullptr;  // optional async upload path
+
+    /** @brief Texture size for a w x h image: w x h scaled down, keeping
+     * the aspect, to fit the display limit and the GL maximum */
+    cv::Size uploadSize(int w, int h) const {
+        double scale = 1.0;
+        if (limitWidth > 0 && limitHeight > 0) {
+            scale = std::min({ scale, (double)limitWidth / w, (double)limitHeight / h });
+        }
+        if (maxSize > 0) scale = std::min({ scale, (double)maxSize / w, (double)maxSize / h });
+        if (scale >= 1.0) return cv::Size(w, h);
+        return cv::Size(std::max(1, (int)std::lround(w * scale)), std::max(1, (int)std::lround(h * scale)));
+    }
+
+    /** @brief Bottom-right UV of the used region, for ImGui::Image */
+    ImVec2 uvMax() const {
+        return ImVec2(capacityWidth > 0 ? (float)width / (float)capacityWidth : 1.0f,
+                      capacityHeight > 0 ? (float)height / (float)capacityHeight : 1.0f);
+    }
 
     void destroy() {
         if (id != 0) {
@@ -31,9 +199,35 @@ struct ImageTexture {
             id = 0;
         }
         width = height = 0;
+        imageWidth = imageHeight = 0;
+        capacityWidth = capacityHeight = 0;
     }
 };
 
+/**
+ * @brief Make outTex at least w x h, keeping its size if it is larger.
+ * Reallocation drops the contents.
+ */
+void reserveTexture(ImageTexture& outTex, int w, int h) {
+    if (outTex.id != 0 && w <= outTex.capacityWidth && h <= outTex.capacityHeight) {
+        glBindTexture(GL_TEXTURE_2D, outTex.id);
+        return;
+    }
+    int capW = std::max(w, outTex.capacityWidth);
+    int capH = std::max(h, outTex.capacityHeight);
+    outTex.destroy();
+
+    glGenTextures(1, &outTex.id);
+    glBindTexture(GL_TEXTURE_2D, outTex.id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Sized format: GlCarver::present writes it as an rgba8 image
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, capW, capH, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    outTex.capacityWidth = capW;
+    outTex.capacityHeight = capH;
+}
+
 /**
  * @brief Create output directory if it doesn't exist
  * @param outputDir Path to output directory
@@ -53,85 +247,66 @@ bool ensureOutputDirectory(const std::string& outputDir) {
     }
 }
 
+// Texture upload times, shown with the worker's phase stats
+static SeamCarverStats uploadStats;
+
 /**
- * @brief Convert cv::Mat (BGR/GRAY/BGRA) to an OpenGL RGBA texture
- * @param img Image in the form of cv::Mat
- * @param outTex Output texture in OpenGL format
- * @return true if successful conversion of cv::Mat to OpenGL RGBA texture
+ * @brief Upload cv::Mat (BGR/GRAY/BGRA) into the persistent OpenGL texture,
+ * as a display-size copy if it exceeds outTex's upload size
+ * @param img Image in the form of cv::Mat; may be a strided ROI
+ * @param outTex Texture to update; reallocated only when img does not fit
+ * @return true if the image was uploaded
  */
 bool LoadTextureFromMat(const cv::Mat& img, ImageTexture& outTex) {
     if (img.empty()) return false;
 
-    cv::Mat rgba;
+    GLenum format;
     switch (img.channels()) {
-    case 1:  cv::cvtColor(img, rgba, cv::COLOR_GRAY2RGBA); break;
-    case 3:  cv::cvtColor(img, rgba, cv::COLOR_BGR2RGBA);  break;
-    case 4:  cv::cvtColor(img, rgba, cv::COLOR_BGRA2RGBA); break;
+    case 1:  format = GL_LUMINANCE; break;
+    case 3:  format = GL_BGR;       break;
+    case 4:  format = GL_BGRA;      break;
     default:
         std::cerr << "Unsupported number of channels: " << img.channels() << "\n";
         return false;
     }
+    if (img.depth() != CV_8U) {
+        // 16-bit and float images are shown through an 8-bit copy
+        cv::Mat bytes;
+        img.convertTo(bytes, CV_8U, img.depth() == CV_16U ? 1.0 / 257 : 255.0);
+        return LoadTextureFromMat(bytes, outTex);
+    }
+    SEAM_PHASE(&uploadStats, TextureUpload);
+
+    if (outTex.maxSize == 0) glGetIntegerv(GL_MAX_TEXTURE_SIZE, &outTex.maxSize);
+    const cv::Size size = outTex.uploadSize(img.cols, img.rows);
+    const cv::Mat* pixels = &img;
+    if (size != img.size()) {
+        // Bilinear reads about four source pixels per texel, so the copy
+        // costs the display size, not the image size
+        cv::resize(img, outTex.scaled, size, 0, 0, cv::INTER_LINEAR);
+        pixels = &outTex.scaled;
+    }
+    outTex.imageWidth = img.cols;
+    outTex.imageHeight = img.rows;
 
-    GLuint texId;
-    glGenTextures(1, &texId);
-    glBindTexture(GL_TEXTURE_2D, texId);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RGBA,
-        rgba.cols,
-        rgba.rows,
-        0,
-        GL_RGBA,
-        GL_UNSIGNED_BYTE,
-        rgba.data
-    );
+    reserveTexture(outTex, pixels->cols, pixels->rows);
 
-    outTex.destroy();
-    outTex.id = texId;
-    outTex.width = rgba.cols;
-    outTex.height = rgba.rows;
-    return true;
-}
-
-/**
- * @brief Draws a red seam on a copy of a base image to visualize a seam step
- * @param baseImage Base image being resized
- * @param seam The seam data to be drawn on the image
- * @param isVertical Flag for checking if seam is vertical
- * @return a copy of the base image with the red seam drawn over it
- */
-cv::Mat drawSeamOnImage(const cv::Mat& baseImage,
-                        const std::vector<int>& seam,
-                        bool isVertical) {
-    cv::Mat vis = baseImage.clone();
-    if (vis.empty() || seam.empty())
-        return vis;
-
-    if (isVertical) {
-        // seam[i] is column for row i
-        for (int i = 0; i < (int)seam.size(); ++i) {
-            int j = seam[i];
-            if (i >= 0 && i < vis.rows && j >= 0 && j < vis.cols) {
-                vis.at<cv::Vec3b>(i, j) = cv::Vec3b(0, 0, 255); // BGR red
-            }
-        }
-    }
-    else {
-        // seam[j] is row for column j
-        for (int j = 0; j < (int)seam.size(); ++j) {
-            int i = seam[j];
-            if (i >= 0 && i < vis.rows && j >= 0 && j < vis.cols) {
-                vis.at<cv::Vec3b>(i, j) = cv::Vec3b(0, 0, 255);
-            }
-        }
+    if (outTex.uploads && outTex.uploads->available() && outTex.uploads->upload(*pixels, format)) {
+        outTex.width = pixels->cols;
+        outTex.height = pixels->rows;
+        return true;
     }
 
-    return vis;
+    // Upload straight from the Mat rows, honouring ROI stride
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)(pixels->step[0] / pixels->elemSize()));
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, pixels->cols, pixels->rows,
+        format, GL_UNSIGNED_BYTE, pixels->data);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    outTex.width = pixels->cols;
+    outTex.height = pixels->rows;
+    return true;
 }
 
 /**
@@ -144,6 +319,9 @@ int run_gui() {
         return 1;
     }
 
+    // No version or profile hints: GLFW then creates the newest compatibility
+    // context, which keeps GL_LUMINANCE uploads and, from OpenGL 4.3, has the
+    // compute shaders of GlCarver
     GLFWwindow* window = glfwCreateWindow(1280, 720, "Seam Carving GUI", nullptr, nullptr);
     if (!window) {
         std::cerr << "Failed to create GLFW window\n";
@@ -163,21 +341,54 @@ int run_gui() {
 
     ImGui::StyleColorsDark();
     ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL2_Init();
+    ImGui_ImplOpenGL3_Init("#version 130");
 
     // GUI state
     static char imagePath[512] = "test.jpg";
 
     // Current interactive view
-    ImageTexture imgTex;            
+    PixelUploadRing uploadRing;
+    if (!uploadRing.init()) {
+        std::cout << "Pixel buffer objects unavailable; uploading textures directly\n";
+    }
+    ImageTexture imgTex;
+    imgTex.uploads = &uploadRing;
+    bool actualSize = false;        // Image window at 1:1 with a full-resolution texture
+    // Until the Image window has been drawn, uploads fit the framebuffer
+    glfwGetFramebufferSize(window, &imgTex.limitWidth, &imgTex.limitHeight);
+
+    // Compute-shader carving straight into imgTex (DP, backward energy)
+    GlCarver gpuCarver;
+    std::string gpuError;
+    if (!gpuCarver.init(&gpuError)) {
+        std::cout << "GPU carving unavailable: " << gpuError << "\n";
+    }
+    std::vector<int> overlaySeam;   // seam drawn over the texture, if any
+    bool overlaySeamVertical = true;
+
+    // Heatmap view of the worker's energy map or DP cost table, color-mapped
+    // by gpuCarver's shaders from the raw values
+    bool showHeatmap = false;
+    int heatmapPlane = 0;
+    const char* heatmapPlaneNames[] = { "Energy", "DP cumulative cost" };
+    bool heatmapLog = false;
+    cv::Mat heatEnergy;             // copies of the latest snapshot's planes
+    cv::Mat heatCost;
+    bool heatCostVertical = true;
+    bool heatmapStale = false;      // heatTex does not show the chosen plane yet
+    ImageTexture heatTex;
 
     bool imageLoaded = false;
     std::string lastError;
 
     std::unique_ptr<SeamCarver> carver;
-    cv::Mat currentImage;           // working image (after seam removals)
+    cv::Mat currentImage;           // latest working image published by the worker
     int seamsRemoved = 0;
 
+    // Carving runs on this worker; the UI only sends commands and shows
+    // the snapshots it publishes
+    CarveWorker worker;
+
     // Original dimensions (for sliders)
     int originalWidth = 0;
     int originalHeight = 0;
@@ -188,10 +399,90 @@ int run_gui() {
 
     // Options
     bool useVerticalForStep = true;   // direction for the manual "Step" button
+    bool cheapestDirection = false;   // DP Step and Full runs: the cheaper of both seams
 
-    // Method selection: 0 = DP, 1 = Greedy, 2 = Graph
+    // Method selection: 0 = DP, 1 = Greedy, 2 = Graph, 3 = Pyramid
     int methodIndex = 0;
-    const char* methodNames[] = { "DP", "Greedy", "Graph (Dijkstra)" };
+    const char* methodNames[] = { "DP", "Greedy", "Graph (Dijkstra)", "Pyramid (coarse-to-fine)" };
+
+    // Energy precision: 0 = double, 1 = float, 2 = 16-bit fixed point
+    int precisionIndex = 0;
+    const char* precisionNames[] = { "Double (64-bit)", "Float (32-bit)", "Fixed point (16-bit)" };
+
+    // Seam cost model for the DP method: 0 = backward, 1 = forward
+    int energyModelIndex = 0;
+    const char* energyModelNames[] = { "Backward (gradient)", "Forward (inserted edges)" };
+    int energyFunctionIndex = 0;
+    const char* energyFunctionNames[] = { "Sobel", "Scharr", "Dual gradient", "L1 gradient", "Saliency-weighted",
+                                          "Fast Sobel" };
+
+    // Dijkstra queue for the graph method: 0 = binary heap, 1 = bucket, 2 = radix
+    int graphQueueIndex = 0;
+    const char* graphQueueNames[] = { "Binary heap", "Bucket (Dial)", "Radix heap" };
+    // Solver of the graph method, as GraphSolver
+    int graphSolverIndex = 0;
+    const char* graphSolverNames[] = { "Dijkstra", "DAG relaxation", "A* (row bound)" };
+
+    // Partial seams kept per row by the greedy method (1 = plain greedy),
+    // and greedy walks per seam
+    int greedyBeamWidth = 1;
+    int greedyStarts = 1;
+
+    // Frame budget for auto-run: carve up to this long per frame, one upload
+    bool useFrameBudget = false;
+    float frameBudgetMs = 12.0f;
+
+    // GPU mode: runs carve in gpuCarver on this thread instead of the
+    // worker; currentImage is only refreshed from the GPU when needed
+    bool useGpuCarve = false;
+    CarveRun gpuRun = CarveRun::None;
+    int gpuSeamsPerFrame = 8;
+    bool gpuImageStale = false;
+    std::chrono::steady_clock::time_point gpuRunStart;
+    int lastSliceSeams = 0;
+    int historyFirst = 0;             // seamsRemoved range the timeline can scrub
+    int historyLast = 0;
+
+    // Proxy preview: while a target slider is dragged, a second worker
+    // carves a downscaled copy; the full-resolution run starts on release
+    bool useProxyPreview = false;
+    int proxyScaleIndex = 1;
+    const char* proxyScaleNames[] = { "1/2", "1/4", "1/8" };
+    CarveWorker proxyWorker;
+    cv::Mat proxyOriginal;
+    std::string loadedPath;         // the proxy of a JPEG is decoded from it
+    JpegHeader loadedJpeg;          // zero size: not a JPEG
+    int proxyTargetWidth = 0;       // last target sent to proxyWorker
+    int proxyTargetHeight = 0;
+    bool proxyShown = false;        // texture shows the proxy, not currentImage
+    bool proxyDragging = false;     // a proxy drag has not been settled yet
+
+    // Seam index map and its grid: built once, then both sliders render any
+    // size directly
+    SeamIndexMap seamMap;
+    SeamIndexGrid seamGrid;
+    bool liveSeamMapResize = false;
+
+    // Optionally the map is built on a low-priority thread right after a
+    // load; its partial maps already serve the sizes they cover
+    bool precomputeSeamMap = false;
+    SeamMapPrecompute seamMapPrecompute;
+    std::string precomputeKey;      // cache key to store the finished map under, if new
+
+    // Results of full runs from the original image and seam maps, keyed by
+    // the original's content hash and the settings, so switching methods or
+    // targets back and forth does not carve the same thing twice
+    CarveCache carveCache;
+    uint64_t originalHash = 0;
+    std::string fullRunCacheKey;    // key of the running full run, if cacheable
+
+    // Compare: the checked methods carve the original to the target at
+    // once, each on its own thread, and are shown side by side
+    bool compareMethods[4] = { true, true, true, false };  // by methodIndex
+    MethodComparison methodComparison;
+    ComparisonSnapshot comparison;  // latest results, one per compared method
+    ImageTexture compareTex[4];     // by slot of comparison.results
+    bool showComparison = false;
 
     // Auto-run flags
     bool autoRunVertical = false;
@@ -201,21 +492,100 @@ int run_gui() {
     // Stats / status
     bool hasResizeStats = false;
     long long lastProcessingMs = 0;
+    MemoryStats lastResizeMemory;  // none (zero peak) for GPU runs
+
+    // Worker phase stats from the latest snapshot; Reset subtracts a baseline
+    SeamCarverStats carveStats;
+    SeamCarverStats carveStatsBaseline;
     int lastResizedWidth = 0;
     int lastResizedHeight = 0;
     int lastMethodIndex = 0;
     bool fullResizeRunning = false;
-    std::chrono::high_resolution_clock::time_point resizeStartTime;
 
     std::string guiStatusMessage;
 
+    // Saves are encoded on their own thread, in the order they were asked
+    // for, so a large PNG does not stall the frame
+    struct PendingSave {
+        std::string path;
+        std::future<void> done;
+    };
+    ThreadPool saveThread(1);
+    std::vector<PendingSave> pendingSaves;
+    EncodeOptions encodeOptions;
+    int pngCompression = 3;
+    int jpegQuality = 95;
+    int webpQuality = 90;
+    int saveFormat = 0;
+    const char* saveFormats[] = { ".png", ".jpg", ".webp" };
+
+    // Bring currentImage up to date with the GPU's working image
+    auto syncFromGpu = [&]() {
+        if (gpuImageStale) {
+            currentImage = gpuCarver.download();
+            gpuImageStale = false;
+        }
+    };
+
+    // New working image, carved from seamsRemoved on by the worker or the GPU
+    auto loadWorkingImage = [&](const cv::Mat& image, int removed) {
+        currentImage = image;
+        seamsRemoved = removed;
+        if (useGpuCarve) {
+            gpuRun = CarveRun::None;
+            gpuCarver.load(image);
+            gpuImageStale = false;
+            // present() writes full resolution, whatever the display limit
+            reserveTexture(imgTex, image.cols, image.rows);
+            gpuCarver.present(imgTex.id);
+            imgTex.width = imgTex.imageWidth = gpuCarver.width();
+            imgTex.height = imgTex.imageHeight = gpuCarver.height();
+        }
+        else {
+            worker.load(image, removed);
+        }
+    };
+
+    // Cache key of the seam map of the original with the current settings
+    auto seamMapKey = [&]() {
+        return CarveCache::key(originalHash, "seammap/" +
+            CarveCache::energySettings(carver->getPrecision(), carver->getEnergyFunction()));
+    };
+
+    // Seam map of the original in the background, from the cache if it
+    // has one (then only the grid is built)
+    auto startSeamMapPrecompute = [&]() {
+        SeamIndexMap known;
+        const std::string key = seamMapKey();
+        const bool cached = carveCache.findSeamMap(key, known) && known.minWidth == 1 && known.minHeight == 1;
+        precomputeKey = cached ? std::string() : key;
+        seamMapPrecompute.start(carver->originalImageView(), carver->getPrecision(), carver->getEnergyFunction(),
+                                cached ? known : SeamIndexMap());
+    };
+
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
 
-        ImGui_ImplOpenGL2_NewFrame();
+        ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
+        // Report the saves finished since the last frame
+        for (auto it = pendingSaves.begin(); it != pendingSaves.end();) {
+            if (it->done.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                ++it;
+                continue;
+            }
+            try {
+                it->done.get();
+                guiStatusMessage = "Saved resized image to: " + it->path;
+            }
+            catch (const std::exception& e) {
+                guiStatusMessage = e.what();
+            }
+            it = pendingSaves.erase(it);
+        }
+
         // Global dockspace over main viewport
         ImGui::DockSpaceOverViewport(0, ImGui::GetMainViewport());
 
@@ -225,14 +595,41 @@ int run_gui() {
         ImGui::Begin("Controls");
         ImGui::InputText("Image path", imagePath, IM_ARRAYSIZE(imagePath));
 
-        if (ImGui::Button("Load image")) {
+        bool loadRequested = ImGui::Button("Load image");
+        ImGui::SameLine();
+        if (ImGui::Checkbox("Precompute seam map", &precomputeSeamMap) && precomputeSeamMap &&
+            imageLoaded && carver && seamMap.empty() && !seamMapPrecompute.running()) {
+            startSeamMapPrecompute();
+        }
+        if (loadRequested) {
             try {
                 carver = std::make_unique<SeamCarver>(imagePath);
-                currentImage = carver->getOriginalImage().clone();
-                seamsRemoved = 0;
+                loadedPath = imagePath;
+                if (!readJpegHeader(loadedPath, loadedJpeg)) loadedJpeg = JpegHeader();
+                std::cout << "Loaded image with dimensions: " << carver->originalImageView().cols << "x"
+                          << carver->originalImageView().rows << std::endl;
+                carver->setPrecision(static_cast<EnergyPrecision>(precisionIndex));
+                carver->setEnergyFunction(static_cast<EnergyFunction>(energyFunctionIndex));
+                carver->setGraphQueue(static_cast<GraphQueue>(graphQueueIndex));
+                carver->setGraphSolver(static_cast<GraphSolver>(graphSolverIndex));
+                // Shares the carver's read-only original; nothing writes into it
+                if (useGpuCarve && carver->originalImageView().depth() != CV_8U) {
+                    useGpuCarve = false;
+                }
+                loadWorkingImage(carver->originalImageView(), 0);
+                seamMap = SeamIndexMap();
+                seamGrid = SeamIndexGrid();
+                liveSeamMapResize = false;
+                seamMapPrecompute.stop();
+                proxyWorker.stop();
+                proxyOriginal.release();
+                proxyShown = false;
+                proxyDragging = false;
 
                 originalWidth = currentImage.cols;
                 originalHeight = currentImage.rows;
+                originalHash = hashImage(currentImage);
+                fullRunCacheKey.clear();
                 targetWidth = originalWidth;
                 targetHeight = originalHeight;
                 targetWidthPercent = 100.0f;
@@ -245,6 +642,15 @@ int run_gui() {
                 hasResizeStats = false;
                 guiStatusMessage.clear();
 
+                // New image: size the texture to its original dimensions
+                imgTex.destroy();
+                overlaySeam.clear();
+                heatEnergy.release();
+                heatCost.release();
+                methodComparison.stop();
+                comparison = ComparisonSnapshot();
+                for (ImageTexture& tex : compareTex) tex.destroy();
+                showComparison = false;
                 if (!LoadTextureFromMat(currentImage, imgTex)) {
                     lastError = "Failed to upload texture from loaded image.";
                     imageLoaded = false;
@@ -252,6 +658,7 @@ int run_gui() {
                 else {
                     lastError.clear();
                     imageLoaded = true;
+                    if (precomputeSeamMap) startSeamMapPrecompute();
                 }
             }
             catch (const std::exception& e) {
@@ -266,129 +673,522 @@ int run_gui() {
         }
 
         if (imageLoaded && carver) {
+            // A proxy stays on screen only until its full-resolution run ends
+            if (proxyShown && !proxyDragging && !fullResizeRunning) {
+                proxyShown = false;
+            }
+
+            // Pick up the newest worker snapshot, if any; in GPU mode the
+            // idle worker's last snapshots are dropped
+            if (useGpuCarve) {
+                worker.poll();
+            }
+            else if (const CarveSnapshot* snap = worker.poll()) {
+                currentImage = snap->image;
+                seamsRemoved = snap->seamsRemoved;
+                lastSliceSeams = snap->sliceSeams;
+                historyFirst = snap->historyFirst;
+                historyLast = snap->historyLast;
+                autoRunVertical = snap->run == CarveRun::Vertical;
+                autoRunHorizontal = snap->run == CarveRun::Horizontal;
+                autoRunFull = snap->run == CarveRun::Full;
+                carveStats = snap->stats;
+                if (showHeatmap) {
+                    // The slot's planes are rewritten once it is handed back
+                    snap->energy.copyTo(heatEnergy);
+                    snap->cost.copyTo(heatCost);
+                    heatCostVertical = snap->costVertical;
+                    heatmapStale = true;
+                }
+                if (!snap->error.empty()) {
+                    lastError = snap->error;
+                }
+                if (!proxyShown) {
+                    LoadTextureFromMat(currentImage, imgTex);
+                    overlaySeam = snap->seam;
+                    overlaySeamVertical = snap->seamVertical;
+                }
+
+                if (fullResizeRunning && snap->lastRun == CarveRun::Full && snap->run == CarveRun::None) {
+                    fullResizeRunning = false;
+                    if (proxyShown) {
+                        // Full-resolution result replaces the proxy preview
+                        proxyShown = false;
+                        overlaySeam.clear();
+                        LoadTextureFromMat(currentImage, imgTex);
+                    }
+                    if (snap->completed && !fullRunCacheKey.empty()) {
+                        carveCache.storeResult(fullRunCacheKey, currentImage);
+                    }
+                    fullRunCacheKey.clear();
+                    if (snap->completed) {
+                        lastProcessingMs = (long long)snap->elapsedMs;
+                        lastResizedWidth = currentImage.cols;
+                        lastResizedHeight = currentImage.rows;
+                        lastMethodIndex = methodIndex;
+                        lastResizeMemory = snap->stats.memory;
+                        hasResizeStats = true;
+
+                        std::string methodStr =
+                            (methodIndex == 0) ? "DP" :
+                            (methodIndex == 1) ? "Greedy" :
+                            (methodIndex == 2) ? "Graph (Dijkstra)" : "Pyramid";
+
+                        guiStatusMessage = "Resize complete with " + methodStr +
+                            " to " + std::to_string(lastResizedWidth) + "x" +
+                            std::to_string(lastResizedHeight) + ".\n" +
+                            "Processing time: " + std::to_string(lastProcessingMs) + " ms.";
+                    }
+                }
+            }
+
             ImGui::Separator();
-            ImGui::Text("Current size: %d x %d", currentImage.cols, currentImage.rows);
+            ImGui::Text("Current size: %d x %d", useGpuCarve ? gpuCarver.width() : currentImage.cols,
+                        useGpuCarve ? gpuCarver.height() : currentImage.rows);
             ImGui::Text("Original:     %d x %d", originalWidth, originalHeight);
 
-            // Target width: slider (px) + input (percent)
+            // Target width: slider (px) + input (percent); up to twice the
+            // original, the extra is added by seam insertion
             ImGui::Text("Target width");
             ImGui::PushID("target_width");
-            bool widthChangedSlider = ImGui::SliderInt("px", &targetWidth, 1, originalWidth);
+            bool widthChangedSlider = ImGui::SliderInt("px", &targetWidth, 1, 2 * originalWidth);
+            bool widthSliderActive = ImGui::IsItemActive();
             ImGui::SameLine();
             ImGui::SetNextItemWidth(90.0f);
             bool widthChangedPercent = ImGui::InputFloat("%", &targetWidthPercent, 1.0f, 5.0f, "%.1f");
             ImGui::PopID();
 
             if (widthChangedSlider) {
-                targetWidth = std::max(1, std::min(targetWidth, originalWidth));
+                targetWidth = std::max(1, std::min(targetWidth, 2 * originalWidth));
                 targetWidthPercent = 100.0f * targetWidth / (float)originalWidth;
             }
             if (widthChangedPercent) {
                 if (targetWidthPercent < 1.0f) targetWidthPercent = 1.0f;
-                if (targetWidthPercent > 100.0f) targetWidthPercent = 100.0f;
+                if (targetWidthPercent > 200.0f) targetWidthPercent = 200.0f;
                 targetWidth = (int)std::round(originalWidth * targetWidthPercent / 100.0f);
-                targetWidth = std::max(1, std::min(targetWidth, originalWidth));
+                targetWidth = std::max(1, std::min(targetWidth, 2 * originalWidth));
             }
 
             // Target height: slider (px) + input (percent)
             ImGui::Text("Target height");
             ImGui::PushID("target_height");
-            bool heightChangedSlider = ImGui::SliderInt("px", &targetHeight, 1, originalHeight);
+            bool heightChangedSlider = ImGui::SliderInt("px", &targetHeight, 1, 2 * originalHeight);
+            bool heightSliderActive = ImGui::IsItemActive();
             ImGui::SameLine();
             ImGui::SetNextItemWidth(90.0f);
             bool heightChangedPercent = ImGui::InputFloat("%", &targetHeightPercent, 1.0f, 5.0f, "%.1f");
             ImGui::PopID();
 
             if (heightChangedSlider) {
-                targetHeight = std::max(1, std::min(targetHeight, originalHeight));
+                targetHeight = std::max(1, std::min(targetHeight, 2 * originalHeight));
                 targetHeightPercent = 100.0f * targetHeight / (float)originalHeight;
             }
             if (heightChangedPercent) {
                 if (targetHeightPercent < 1.0f) targetHeightPercent = 1.0f;
-                if (targetHeightPercent > 100.0f) targetHeightPercent = 100.0f;
+                if (targetHeightPercent > 200.0f) targetHeightPercent = 200.0f;
                 targetHeight = (int)std::round(originalHeight * targetHeightPercent / 100.0f);
-                targetHeight = std::max(1, std::min(targetHeight, originalHeight));
+                targetHeight = std::max(1, std::min(targetHeight, 2 * originalHeight));
             }
 
             ImGui::Text("Target %%: %.1f%% x %.1f%%  -> %d x %d",
                 targetWidthPercent, targetHeightPercent,
                 targetWidth, targetHeight);
 
+            // Cache key of a full run of the original image with the current
+            // settings; empty if the image has already been partly carved
+            auto fullRunKey = [&]() -> std::string {
+                if (currentImage.cols != originalWidth || currentImage.rows != originalHeight) {
+                    return std::string();
+                }
+                return CarveCache::key(originalHash,
+                    std::string(methodNames[methodIndex]) + "/p" + std::to_string(precisionIndex) +
+                    "/e" + std::to_string(energyModelIndex) + "/f" + std::to_string(energyFunctionIndex) +
+                    "/q" + std::to_string(graphQueueIndex) + "/g" + std::to_string(graphSolverIndex) +
+                    "/b" + std::to_string(greedyBeamWidth) +
+                    "/s" + std::to_string(greedyStarts) + (cheapestDirection && methodIndex == 0 ? "/cheapest/" : "/") +
+                    std::to_string(targetWidth) + "x" + std::to_string(targetHeight));
+            };
+
+            // Newest map of the background build; the grid arrives with the
+            // complete map
+            if (const SeamMapSnapshot* snap = seamMapPrecompute.poll()) {
+                if (!snap->error.empty()) {
+                    lastError = snap->error;
+                }
+                else {
+                    seamMap = snap->map;
+                    seamGrid = snap->grid;
+                    liveSeamMapResize = true;
+                    if (snap->complete) {
+                        if (!precomputeKey.empty()) {
+                            carveCache.storeSeamMap(precomputeKey, seamMap, carver->originalImageView());
+                        }
+                        guiStatusMessage = "Seam map precomputed in " +
+                            std::to_string(static_cast<long long>(snap->elapsedMs)) + " ms.";
+                    }
+                }
+            }
+
+            // Seam index map (offline carve, then instant retargeting)
+            if (ImGui::Button("Build seam map")) {
+                seamMapPrecompute.stop();
+                try {
+                    const std::string key = seamMapKey();
+                    auto start = std::chrono::high_resolution_clock::now();
+                    bool cached = carveCache.findSeamMap(key, seamMap) &&
+                                  seamMap.minWidth == 1 && seamMap.minHeight == 1;
+                    if (!cached) {
+                        seamMap = carver->buildSeamIndexMap(1, 1);
+                        carveCache.storeSeamMap(key, seamMap, carver->originalImageView());
+                    }
+                    // The grid's rungs are rebuilt from the (cached) map
+                    seamGrid = carver->buildSeamIndexGrid(seamMap);
+                    auto end = std::chrono::high_resolution_clock::now();
+                    guiStatusMessage = std::string(cached ? "Seam map loaded from cache in " : "Seam map built in ") +
+                        std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()) +
+                        " ms.";
+                }
+                catch (const std::exception& e) {
+                    lastError = e.what();
+                }
+            }
+            if (!seamMap.empty()) {
+                ImGui::SameLine();
+                ImGui::Checkbox("Live resize from seam map", &liveSeamMapResize);
+            }
+            if (seamMapPrecompute.running()) {
+                ImGui::Text("Precomputing seam map: covers %d x %d and up", seamMap.empty() ? originalWidth : seamMap.minWidth,
+                            seamMap.empty() ? originalHeight : seamMap.minHeight);
+            }
+
+            bool targetChanged = widthChangedSlider || widthChangedPercent ||
+                                 heightChangedSlider || heightChangedPercent;
+            // Sizes a partial map does not reach yet are carved live as usual
+            const bool mapCovers = liveSeamMapResize && !seamMap.empty() &&
+                                   targetWidth >= seamMap.minWidth && targetHeight >= seamMap.minHeight &&
+                                   targetWidth <= originalWidth && targetHeight <= originalHeight;
+            if (mapCovers && targetChanged) {
+                if (proxyDragging) {
+                    // The drag reached the map: no proxy or run on release
+                    proxyWorker.stop();
+                    proxyDragging = false;
+                    proxyShown = false;
+                }
+                autoRunVertical = false;
+                autoRunHorizontal = false;
+                autoRunFull = false;
+                fullResizeRunning = false;
+                try {
+                    currentImage = seamGrid.empty()
+                        ? carver->renderFromSeamIndexMap(seamMap, carver->originalImageView(), targetWidth, targetHeight)
+                        : carver->renderFromSeamIndexGrid(seamGrid, carver->originalImageView(), targetWidth,
+                                                          targetHeight);
+                    loadWorkingImage(currentImage, (originalWidth - targetWidth) + (originalHeight - targetHeight));
+                    overlaySeam.clear();
+                    LoadTextureFromMat(currentImage, imgTex);
+                }
+                catch (const std::exception& e) {
+                    lastError = e.what();
+                }
+            }
+
             ImGui::Separator();
             ImGui::Text("Seam method:");
             ImGui::Combo("Method", &methodIndex, methodNames, IM_ARRAYSIZE(methodNames));
+            if (ImGui::Combo("Precision", &precisionIndex, precisionNames, IM_ARRAYSIZE(precisionNames))) {
+                carver->setPrecision(static_cast<EnergyPrecision>(precisionIndex));
+            }
+            if (methodIndex == 0) {
+                ImGui::Combo("Energy", &energyModelIndex, energyModelNames, IM_ARRAYSIZE(energyModelNames));
+            }
+            // Forward energy has no per-pixel map
+            if ((methodIndex != 0 || energyModelIndex == 0) &&
+                ImGui::Combo("Energy function", &energyFunctionIndex, energyFunctionNames,
+                             IM_ARRAYSIZE(energyFunctionNames))) {
+                carver->setEnergyFunction(static_cast<EnergyFunction>(energyFunctionIndex));
+            }
+
+            // GPU carving: DP with backward per-pixel energy on 8-bit images
+            const bool gpuEligible = gpuCarver.available() && methodIndex == 0 && energyModelIndex == 0 &&
+                                     energyFunctionIndex != static_cast<int>(EnergyFunction::Saliency) &&
+                                     currentImage.depth() == CV_8U;
+            if (gpuCarver.available()) {
+                bool gpuMode = useGpuCarve;
+                ImGui::BeginDisabled(!gpuEligible && !useGpuCarve);
+                ImGui::Checkbox("Carve on GPU (compute shaders)", &gpuMode);
+                ImGui::EndDisabled();
+                if (gpuMode && !useGpuCarve) {
+                    worker.stop();
+                    proxyWorker.stop();
+                    proxyShown = false;
+                    proxyDragging = false;
+                    autoRunVertical = false;
+                    autoRunHorizontal = false;
+                    autoRunFull = false;
+                    fullResizeRunning = false;
+                    overlaySeam.clear();
+                    try {
+                        gpuCarver.setEnergyFunction(static_cast<EnergyFunction>(energyFunctionIndex));
+                        useGpuCarve = true;
+                        loadWorkingImage(currentImage, seamsRemoved);
+                    }
+                    catch (const std::exception& e) {
+                        lastError = e.what();
+                        useGpuCarve = false;
+                    }
+                }
+                else if (useGpuCarve && (!gpuMode || !gpuEligible)) {
+                    // Back to the worker with the GPU's image
+                    syncFromGpu();
+                    useGpuCarve = false;
+                    gpuRun = CarveRun::None;
+                    autoRunVertical = false;
+                    autoRunHorizontal = false;
+                    autoRunFull = false;
+                    loadWorkingImage(currentImage, seamsRemoved);
+                }
+                else if (useGpuCarve) {
+                    gpuCarver.setEnergyFunction(static_cast<EnergyFunction>(energyFunctionIndex));
+                }
+            }
+            if (methodIndex == 1 && ImGui::SliderInt("Beam width", &greedyBeamWidth, 1, 64)) {
+                carver->setGreedyBeamWidth(greedyBeamWidth);
+            }
+            if (methodIndex == 1 && greedyBeamWidth == 1 && ImGui::SliderInt("Greedy starts", &greedyStarts, 1, 64)) {
+                carver->setGreedyStarts(greedyStarts);
+            }
+            if (methodIndex == 2 &&
+                ImGui::Combo("Graph queue", &graphQueueIndex, graphQueueNames, IM_ARRAYSIZE(graphQueueNames))) {
+                // Bucket and radix queues only apply to fixed-point energy
+                carver->setGraphQueue(static_cast<GraphQueue>(graphQueueIndex));
+            }
+            if (methodIndex == 2 &&
+                ImGui::Combo("Graph solver", &graphSolverIndex, graphSolverNames, IM_ARRAYSIZE(graphSolverNames))) {
+                carver->setGraphSolver(static_cast<GraphSolver>(graphSolverIndex));
+            }
+
+            // Pyramid quality check: next vertical seam of the current image
+            // found both ways, by total energy and time
+            if (methodIndex == 3 && ImGui::Button("Compare with DP")) {
+                try {
+                    syncFromGpu();
+                    cv::Mat energy = carver->calculateEnergyFromGray(carver->toGray(currentImage));
+                    auto t0 = std::chrono::high_resolution_clock::now();
+                    std::vector<int> dpSeam = carver->findVerticalSeamDP(energy);
+                    auto t1 = std::chrono::high_resolution_clock::now();
+                    std::vector<int> pyramidSeam = carver->findVerticalSeamPyramid(energy);
+                    auto t2 = std::chrono::high_resolution_clock::now();
+
+                    double dpCost = carver->seamEnergy(energy, dpSeam, true);
+                    double pyramidCost = carver->seamEnergy(energy, pyramidSeam, true);
+                    double excess = dpCost > 0.0 ? 100.0 * (pyramidCost - dpCost) / dpCost : 0.0;
+                    char buf[256];
+                    std::snprintf(buf, sizeof(buf),
+                        "Seam energy: pyramid %.1f, DP %.1f (+%.1f%%).\n"
+                        "Seam search: pyramid %.2f ms, DP %.2f ms.",
+                        pyramidCost, dpCost, excess,
+                        std::chrono::duration<double, std::milli>(t2 - t1).count(),
+                        std::chrono::duration<double, std::milli>(t1 - t0).count());
+                    guiStatusMessage = buf;
+                }
+                catch (const std::exception& e) {
+                    lastError = e.what();
+                }
+            }
 
-            ImGui::Text("Direction for Step: %s",
+            const bool cheapestStep = cheapestDirection && methodIndex == 0 && !useGpuCarve;
+            ImGui::Text("Direction for Step: %s", cheapestStep ? "Cheapest" :
                 useVerticalForStep ? "Vertical (width)" : "Horizontal (height)");
             ImGui::SameLine();
             if (ImGui::Button("Toggle Step Direction")) {
                 useVerticalForStep = !useVerticalForStep;
             }
+            if (methodIndex == 0 && !useGpuCarve) {
+                ImGui::SameLine();
+                ImGui::Checkbox("Cheapest direction", &cheapestDirection);
+            }
+
+            if (useGpuCarve) {
+                ImGui::SetNextItemWidth(120.0f);
+                ImGui::SliderInt("GPU seams per frame", &gpuSeamsPerFrame, 1, 64);
+            }
+            else {
+                ImGui::Checkbox("Frame budget", &useFrameBudget);
+                if (useFrameBudget) {
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(120.0f);
+                    ImGui::SliderFloat("ms per frame", &frameBudgetMs, 1.0f, 30.0f, "%.0f");
+                }
+            }
 
             ImGui::Text("Seams removed: %d", seamsRemoved);
+            if (autoRunVertical || autoRunHorizontal || autoRunFull) {
+                ImGui::SameLine();
+                ImGui::Text("(%d last frame)", lastSliceSeams);
+            }
 
-            // Helper: one seam step either vertical or horizontal
-            auto stepSeamOnce = [&](bool vertical) -> bool {
-                if (!carver || currentImage.empty())
-                    return false;
+            // Settings for the next worker run
+            auto carveSettings = [&]() {
+                CarveSettings settings;
+                settings.method = static_cast<CarveMethod>(methodIndex);
+                settings.precision = static_cast<EnergyPrecision>(precisionIndex);
+                settings.energyModel = static_cast<EnergyModel>(energyModelIndex);
+                settings.energyFunction = static_cast<EnergyFunction>(energyFunctionIndex);
+                settings.graphQueue = static_cast<GraphQueue>(graphQueueIndex);
+                settings.graphSolver = static_cast<GraphSolver>(graphSolverIndex);
+                settings.greedyBeamWidth = greedyBeamWidth;
+                settings.greedyStarts = greedyStarts;
+                settings.targetWidth = targetWidth;
+                settings.targetHeight = targetHeight;
+                settings.stepVertical = useVerticalForStep;
+                settings.cheapestDirection = cheapestDirection && methodIndex == 0;
+                settings.frameBudgetMs = useFrameBudget ? frameBudgetMs : 0.0;
+                return settings;
+                };
 
-                // Stop conditions
-                if (vertical) {
-                    if (currentImage.cols <= targetWidth)
-                        return false;
+            // Runs go to the GPU in GPU mode, else to the worker
+            auto startRun = [&](CarveRun run) {
+                if (useGpuCarve) {
+                    gpuRun = run;
+                    gpuRunStart = std::chrono::steady_clock::now();
                 }
                 else {
-                    if (currentImage.rows <= targetHeight)
-                        return false;
+                    worker.start(run, carveSettings());
                 }
-
-                try {
-                    cv::Mat energy = carver->calculateEnergy(currentImage);
-                    std::vector<int> seam;
-
-                    // Pick method
-                    switch (methodIndex) {
-                    case 0: // DP
-                        seam = vertical
-                            ? carver->findVerticalSeamDP(energy)
-                            : carver->findHorizontalSeamDP(energy);
-                        break;
-                    case 1: // Greedy
-                        seam = vertical
-                            ? carver->findVerticalSeamGreedy(energy)
-                            : carver->findHorizontalSeamGreedy(energy);
-                        break;
-                    case 2: // Graph
-                    default:
-                        seam = vertical
-                            ? carver->findVerticalSeamGraphCut(energy)
-                            : carver->findHorizontalSeamGraphCut(energy);
-                        break;
+            };
+            auto stopRun = [&]() {
+                if (useGpuCarve) gpuRun = CarveRun::None;
+                else worker.stop();
+            };
+
+            // Every checked method from the original with the settings above;
+            // the main view and its worker are left alone
+            if (ImGui::CollapsingHeader("Compare methods")) {
+                const char* compareNames[] = { "DP##compare", "Greedy##compare", "Graph##compare", "Pyramid##compare" };
+                for (int m = 0; m < IM_ARRAYSIZE(compareNames); m++) {
+                    if (m) ImGui::SameLine();
+                    ImGui::Checkbox(compareNames[m], &compareMethods[m]);
+                }
+                if (methodComparison.running()) {
+                    if (ImGui::Button("Stop compare")) methodComparison.stop();
+                }
+                else if (ImGui::Button("Compare")) {
+                    std::vector<CarveMethod> methods;
+                    for (int m = 0; m < IM_ARRAYSIZE(compareNames); m++) {
+                        if (compareMethods[m]) methods.push_back(static_cast<CarveMethod>(m));
                     }
+                    if (methods.empty()) {
+                        guiStatusMessage = "Check at least one method to compare.";
+                    }
+                    else {
+                        for (ImageTexture& tex : compareTex) tex.destroy();
+                        comparison = ComparisonSnapshot();
+                        methodComparison.start(carver->originalImageView(), methods, carveSettings());
+                        showComparison = true;
+                    }
+                }
+                if (!comparison.results.empty()) {
+                    ImGui::SameLine();
+                    ImGui::Checkbox("Show results", &showComparison);
+                }
+            }
+            if (const ComparisonSnapshot* snap = methodComparison.poll()) {
+                // Upload each result once, when its method finishes
+                for (size_t k = 0; k < snap->results.size() && k < IM_ARRAYSIZE(compareTex); k++) {
+                    const bool wasDone = k < comparison.results.size() && comparison.results[k].done;
+                    if (snap->results[k].done && !wasDone && !snap->results[k].image.empty()) {
+                        LoadTextureFromMat(snap->results[k].image, compareTex[k]);
+                    }
+                }
+                comparison = *snap;
+                if (comparison.complete) guiStatusMessage = "Method comparison finished.";
+            }
 
-                    if (seam.empty())
-                        return false;
-
-                    // Visualize seam on current image
-                    cv::Mat vis = drawSeamOnImage(currentImage, seam, vertical);
-                    LoadTextureFromMat(vis, imgTex);
+            ImGui::BeginDisabled(useGpuCarve);
+            ImGui::Checkbox("Proxy preview while dragging", &useProxyPreview);
+            if (useProxyPreview) {
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(80.0f);
+                if (ImGui::Combo("Proxy scale", &proxyScaleIndex, proxyScaleNames, IM_ARRAYSIZE(proxyScaleNames))) {
+                    proxyOriginal.release();
+                }
+            }
+            ImGui::EndDisabled();
 
-                    // Remove the seam for the next step
-                    if (vertical) {
-                        currentImage = carver->removeVerticalSeam(currentImage, seam);
+            bool sliderDragged = widthSliderActive || heightSliderActive;
+            if (useProxyPreview && !useGpuCarve && !mapCovers && sliderDragged && targetChanged) {
+                if (!proxyDragging) {
+                    autoRunVertical = false;
+                    autoRunHorizontal = false;
+                    autoRunFull = false;
+                    fullResizeRunning = false;
+                    worker.stop();
+                }
+                bool reload = proxyOriginal.empty();
+                if (reload) {
+                    const int factor = 2 << proxyScaleIndex;
+                    // A JPEG decoded at the proxy scale: much less work than
+                    // scaling the full image
+                    const cv::Mat& original = carver->originalImageView();
+                    if (loadedJpeg.width == original.cols && loadedJpeg.height == original.rows) {
+                        try {
+                            proxyOriginal = imreadReduced(loadedPath, factor, loadedJpeg.channels);
+                        }
+                        catch (const std::exception&) {
+                            proxyOriginal.release();  // the file changed since
+                        }
                     }
-                    else {
-                        currentImage = carver->removeHorizontalSeam(currentImage, seam);
+                    if (proxyOriginal.empty() || proxyOriginal.channels() != original.channels()) {
+                        double scale = 1.0 / (double)factor;
+                        cv::resize(original, proxyOriginal, cv::Size(), scale, scale, cv::INTER_AREA);
                     }
+                }
 
-                    seamsRemoved++;
-                    return true;
+                CarveSettings settings = carveSettings();
+                settings.frameBudgetMs = 0.0;
+                settings.targetWidth = std::max(1,
+                    (int)std::lround((double)targetWidth * proxyOriginal.cols / originalWidth));
+                settings.targetHeight = std::max(1,
+                    (int)std::lround((double)targetHeight * proxyOriginal.rows / originalHeight));
+
+                // Keep carving the current proxy while the target only shrinks;
+                // the worker may already have reached the previous target.
+                // An enlarged proxy is never carved back down.
+                if (reload || !proxyShown ||
+                    settings.targetWidth > proxyTargetWidth || settings.targetHeight > proxyTargetHeight ||
+                    proxyTargetWidth > proxyOriginal.cols || proxyTargetHeight > proxyOriginal.rows) {
+                    proxyWorker.load(proxyOriginal);
                 }
-                catch (const std::exception& e) {
-                    lastError = e.what();
-                    return false;
+                proxyWorker.start(CarveRun::Full, settings);
+                proxyTargetWidth = settings.targetWidth;
+                proxyTargetHeight = settings.targetHeight;
+                proxyShown = true;
+                proxyDragging = true;
+            }
+
+            if (const CarveSnapshot* proxySnap = proxyWorker.poll()) {
+                if (proxyShown) {
+                    overlaySeam.clear();
+                    LoadTextureFromMat(proxySnap->image, imgTex);
                 }
-                };
+            }
+
+            // Slider released: carve the real image in the background
+            if (proxyDragging && !sliderDragged) {
+                proxyDragging = false;
+                proxyWorker.stop();
+                if (targetWidth > currentImage.cols || targetHeight > currentImage.rows ||
+                    currentImage.cols > originalWidth || currentImage.rows > originalHeight) {
+                    seamsRemoved = 0;
+                    worker.load(carver->originalImageView());
+                }
+                autoRunFull = true;
+                fullResizeRunning = true;
+                hasResizeStats = false;
+                guiStatusMessage.clear();
+                fullRunCacheKey = fullRunKey();
+                worker.start(CarveRun::Full, carveSettings());
+            }
 
             // Manual step (uses chosen direction & method)
             if (ImGui::Button("Step: show & remove next seam")) {
@@ -396,7 +1196,30 @@ int run_gui() {
                 autoRunHorizontal = false;
                 autoRunFull = false;
                 fullResizeRunning = false;
-                stepSeamOnce(useVerticalForStep);
+                startRun(CarveRun::Step);
+            }
+            ImGui::SameLine();
+            ImGui::BeginDisabled(useGpuCarve);
+            if (ImGui::Button("Undo seam") && seamsRemoved > historyFirst) {
+                autoRunVertical = false;
+                autoRunHorizontal = false;
+                autoRunFull = false;
+                fullResizeRunning = false;
+                worker.undo();
+            }
+            ImGui::EndDisabled();
+
+            // Timeline over the recorded seams; scrubbing reinserts or
+            // re-removes them without keeping any frame snapshots
+            if (historyLast > historyFirst && !useGpuCarve) {
+                int position = seamsRemoved;
+                if (ImGui::SliderInt("Timeline", &position, historyFirst, historyLast) && position != seamsRemoved) {
+                    autoRunVertical = false;
+                    autoRunHorizontal = false;
+                    autoRunFull = false;
+                    fullResizeRunning = false;
+                    worker.scrub(position);
+                }
             }
 
             // Run Vertical (auto)
@@ -405,6 +1228,8 @@ int run_gui() {
                 autoRunHorizontal = false;
                 autoRunFull = false;
                 fullResizeRunning = false;
+                if (autoRunVertical) startRun(CarveRun::Vertical);
+                else stopRun();
             }
             ImGui::SameLine();
             ImGui::Text(autoRunVertical ? "[Vertical running]" : "");
@@ -415,24 +1240,47 @@ int run_gui() {
                 autoRunVertical = false;
                 autoRunFull = false;
                 fullResizeRunning = false;
+                if (autoRunHorizontal) startRun(CarveRun::Horizontal);
+                else stopRun();
             }
             ImGui::SameLine();
             ImGui::Text(autoRunHorizontal ? "[Horizontal running]" : "");
 
             // Run Full (vertical then horizontal)
             if (ImGui::Button("Run Full")) {
-                if (!autoRunFull) {
+                cv::Mat cached;
+                fullRunCacheKey = fullRunKey();
+                if (!useGpuCarve && !autoRunFull && !fullRunCacheKey.empty() &&
+                    carveCache.findResult(fullRunCacheKey, cached)) {
+                    // Same image and settings carved before: show the stored result
+                    autoRunVertical = false;
+                    autoRunHorizontal = false;
+                    fullResizeRunning = false;
+                    fullRunCacheKey.clear();
+                    currentImage = cached;
+                    seamsRemoved = (originalWidth - cached.cols) + (originalHeight - cached.rows);
+                    worker.load(currentImage, seamsRemoved);
+                    overlaySeam.clear();
+                    LoadTextureFromMat(currentImage, imgTex);
+                    hasResizeStats = false;
+                    guiStatusMessage = "Resize to " + std::to_string(cached.cols) + "x" +
+                        std::to_string(cached.rows) + " loaded from cache.";
+                }
+                else if (!autoRunFull) {
                     autoRunFull = true;
                     autoRunVertical = false;
                     autoRunHorizontal = false;
                     fullResizeRunning = true;
-                    resizeStartTime = std::chrono::high_resolution_clock::now();
                     hasResizeStats = false;
                     guiStatusMessage.clear();
+                    if (useGpuCarve) fullRunCacheKey.clear();  // results are Float precision
+                    startRun(CarveRun::Full);
                 }
                 else {
                     autoRunFull = false;
                     fullResizeRunning = false;
+                    fullRunCacheKey.clear();
+                    stopRun();
                 }
             }
             ImGui::SameLine();
@@ -441,8 +1289,7 @@ int run_gui() {
             // Reset
             if (ImGui::Button("Reset image")) {
                 if (carver) {
-                    currentImage = carver->getOriginalImage().clone();
-                    seamsRemoved = 0;
+                    loadWorkingImage(carver->originalImageView(), 0);
                     targetWidth = originalWidth;
                     targetHeight = originalHeight;
                     targetWidthPercent = 100.0f;
@@ -455,12 +1302,17 @@ int run_gui() {
                     hasResizeStats = false;
                     guiStatusMessage.clear();
 
+                    proxyWorker.stop();
+                    proxyShown = false;
+                    proxyDragging = false;
+                    overlaySeam.clear();
                     LoadTextureFromMat(currentImage, imgTex);
                 }
             }
 
             // Save resized image
             if (ImGui::Button("Save resized image")) {
+                syncFromGpu();
                 if (!imageLoaded || currentImage.empty()) {
                     guiStatusMessage = "No resized image to save.";
                 }
@@ -477,83 +1329,34 @@ int run_gui() {
 
                         std::string methodStr =
                             (methodIndex == 0) ? "dp" :
-                            (methodIndex == 1) ? "greedy" : "graph";
-
-                        std::string outputFilename = outputDir + "/output_" + methodStr + "_" +
-                            std::to_string(wPctInt) + "w_" +
-                            std::to_string(hPctInt) + "h_" +
-                            std::to_string(currentImage.cols) + "x" +
-                            std::to_string(currentImage.rows) + ".png";
-
-                        bool ok = cv::imwrite(outputFilename, currentImage);
-                        if (ok) {
-                            guiStatusMessage = "Saved resized image to: " + outputFilename;
-                        }
-                        else {
-                            guiStatusMessage = "Failed to save image to: " + outputFilename;
-                        }
+                            (methodIndex == 1) ? "greedy" :
+                            (methodIndex == 2) ? "graph" : "pyramid";
+
+                        std::string outputFilename = outputDir + "/" + std::filesystem::path(guiOutputFilename(
+                            methodStr, wPctInt, hPctInt, currentImage.cols, currentImage.rows))
+                            .replace_extension(saveFormats[saveFormat]).string();
+
+                        // The worker may reuse currentImage's buffer meanwhile
+                        cv::Mat image = currentImage.clone();
+                        EncodeOptions encode = encodeOptions;
+                        pendingSaves.push_back({ outputFilename, saveThread.submit([outputFilename, image, encode] {
+                            writeImage(outputFilename, image, encode);
+                        }) });
+                        guiStatusMessage = "Saving resized image to: " + outputFilename;
                     }
                 }
             }
-
-            // ----------------------------------------------------------------
-            // Auto-run logic (one step per frame to keep visualization smooth)
-            // ----------------------------------------------------------------
-            if (autoRunVertical) {
-                bool progressed = stepSeamOnce(true);
-                if (!progressed) {
-                    autoRunVertical = false;
-                    if (!currentImage.empty())
-                        LoadTextureFromMat(currentImage, imgTex);
-                }
-            }
-
-            if (autoRunHorizontal) {
-                bool progressed = stepSeamOnce(false);
-                if (!progressed) {
-                    autoRunHorizontal = false;
-                    if (!currentImage.empty())
-                        LoadTextureFromMat(currentImage, imgTex);
-                }
-            }
-
-            if (autoRunFull) {
-                bool progressed = false;
-                if (currentImage.cols > targetWidth) {
-                    progressed = stepSeamOnce(true);  // vertical phase
-                }
-                else if (currentImage.rows > targetHeight) {
-                    progressed = stepSeamOnce(false); // horizontal phase
-                }
-
-                if (!progressed) {
-                    autoRunFull = false;
-                    if (!currentImage.empty())
-                        LoadTextureFromMat(currentImage, imgTex);
-
-                    if (fullResizeRunning) {
-                        auto end = std::chrono::high_resolution_clock::now();
-                        lastProcessingMs =
-                            std::chrono::duration_cast<std::chrono::milliseconds>(
-                                end - resizeStartTime).count();
-                        lastResizedWidth = currentImage.cols;
-                        lastResizedHeight = currentImage.rows;
-                        lastMethodIndex = methodIndex;
-                        hasResizeStats = true;
-
-                        std::string methodStr =
-                            (methodIndex == 0) ? "DP" :
-                            (methodIndex == 1) ? "Greedy" : "Graph (Dijkstra)";
-
-                        guiStatusMessage = "Resize complete with " + methodStr +
-                            " to " + std::to_string(lastResizedWidth) + "x" +
-                            std::to_string(lastResizedHeight) + ".\n" +
-                            "Processing time: " + std::to_string(lastProcessingMs) + " ms.";
-
-                        fullResizeRunning = false;
-                    }
-                }
+            if (ImGui::TreeNode("Encoding")) {
+                ImGui::Combo("Format", &saveFormat, saveFormats, IM_ARRAYSIZE(saveFormats));
+                // Higher compression: smaller files, slower saves
+                ImGui::SliderInt("PNG compression", &pngCompression, 0, 9);
+                ImGui::SliderInt("JPEG quality", &jpegQuality, 0, 100);
+                ImGui::SliderInt("WebP quality", &webpQuality, 1, 100);
+                ImGui::TreePop();
             }
+            encodeOptions.pngCompression = pngCompression;
+            encodeOptions.jpegQuality = jpegQuality;
+            encodeOptions.webpQuality = webpQuality;
 
             ImGui::Separator();
 
@@ -563,6 +1366,75 @@ int run_gui() {
                 ImGui::BulletText("Method: %s", mName);
                 ImGui::BulletText("Final size: %d x %d", lastResizedWidth, lastResizedHeight);
                 ImGui::BulletText("Processing time: %lld ms", lastProcessingMs);
+                const MemoryStats& m = lastResizeMemory;
+                if (m.peakBytes > 0) {
+                    const double mb = 1.0 / (1024.0 * 1024.0);
+                    ImGui::BulletText("Peak working memory: %.1f MB", m.peakBytes * mb);
+                    if (m.heapCounted) {
+                        ImGui::BulletText("Heap allocations: %llu (%.1f MB)", (unsigned long long)m.allocations,
+                                          m.allocatedBytes * mb);
+                    }
+                    ImGui::BulletText("Copied by removal: %.1f MB", m.removalBytes * mb);
+                    ImGui::BulletText("Copied by transposes: %.1f MB", m.transposeBytes * mb);
+                }
+            }
+
+            if (ImGui::CollapsingHeader("Heatmaps")) {
+                if (!gpuCarver.available()) {
+                    ImGui::TextUnformatted("Heatmaps are color-mapped in compute shaders (OpenGL 4.3).");
+                }
+                else {
+                    if (ImGui::Checkbox("Show heatmap", &showHeatmap)) {
+                        worker.setHeatmaps(showHeatmap);
+                        heatmapStale = true;
+                    }
+                    if (ImGui::Combo("Plane", &heatmapPlane, heatmapPlaneNames, IM_ARRAYSIZE(heatmapPlaneNames))) {
+                        heatmapStale = true;
+                    }
+                    if (ImGui::Checkbox("Log scale", &heatmapLog)) heatmapStale = true;
+                    if (useGpuCarve) ImGui::TextUnformatted("Shows the CPU worker's planes, not GPU runs.");
+                }
+            }
+
+            if (ImGui::CollapsingHeader("Phase stats")) {
+#if SEAMCARVER_STATS
+                // A new image starts a new worker carver with zeroed stats
+                for (int p = 0; p < SeamCarverStats::kPhases; p++) {
+                    if (carveStats.phases[p].calls < carveStatsBaseline.phases[p].calls) {
+                        carveStatsBaseline.reset();
+                        break;
+                    }
+                }
+                if (ImGui::BeginTable("phase_stats", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                    ImGui::TableSetupColumn("Phase");
+                    ImGui::TableSetupColumn("Calls");
+                    ImGui::TableSetupColumn("Total ms");
+                    ImGui::TableSetupColumn("Avg ms");
+                    ImGui::TableSetupColumn("Max ms");
+                    ImGui::TableHeadersRow();
+                    for (int p = 0; p < SeamCarverStats::kPhases; p++) {
+                        const SeamPhase phase = static_cast<SeamPhase>(p);
+                        PhaseStats s = phase == SeamPhase::TextureUpload ? uploadStats[phase] : carveStats[phase];
+                        if (phase != SeamPhase::TextureUpload) {
+                            s.calls -= carveStatsBaseline[phase].calls;
+                            s.totalMs -= carveStatsBaseline[phase].totalMs;
+                        }
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn(); ImGui::TextUnformatted(SeamCarverStats::name(phase));
+                        ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)s.calls);
+                        ImGui::TableNextColumn(); ImGui::Text("%.1f", s.totalMs);
+                        ImGui::TableNextColumn(); ImGui::Text("%.3f", s.calls ? s.totalMs / s.calls : 0.0);
+                        ImGui::TableNextColumn(); ImGui::Text("%.3f", s.maxMs);
+                    }
+                    ImGui::EndTable();
+                }
+                if (ImGui::Button("Reset stats")) {
+                    carveStatsBaseline = carveStats;
+                    uploadStats.reset();
+                }
+#else
+                ImGui::TextUnformatted("Built with SEAMCARVER_STATS off.");
+#endif
             }
 
             if (!guiStatusMessage.empty()) {
@@ -573,14 +1445,72 @@ int run_gui() {
 
         ImGui::End(); // Controls
 
+        // Let a frame-budgeted run carve its next slice
+        worker.frameTick();
+
+        // GPU runs queue a few seams per frame here and draw the result
+        // straight into the texture
+        if (useGpuCarve && gpuRun != CarveRun::None) {
+            int carved = 0;
+            bool done = false;
+            while (!done && carved < gpuSeamsPerFrame) {
+                const bool wantVertical = gpuCarver.width() > targetWidth;
+                const bool wantHorizontal = gpuCarver.height() > targetHeight;
+                bool vertical = true;
+                bool go = true;
+                switch (gpuRun) {
+                case CarveRun::Step:       vertical = useVerticalForStep; break;
+                case CarveRun::Vertical:   go = wantVertical; break;
+                case CarveRun::Horizontal: vertical = false; go = wantHorizontal; break;
+                default:                   vertical = wantVertical; go = wantVertical || wantHorizontal; break;
+                }
+                if (!go || !gpuCarver.removeSeam(vertical)) {
+                    done = true;
+                    break;
+                }
+                carved++;
+                done = gpuRun == CarveRun::Step;
+            }
+            seamsRemoved += carved;
+            lastSliceSeams = carved;
+            if (carved > 0) {
+                gpuCarver.present(imgTex.id);
+                imgTex.width = imgTex.imageWidth = gpuCarver.width();
+                imgTex.height = imgTex.imageHeight = gpuCarver.height();
+                gpuImageStale = true;
+            }
+            if (done) {
+                if (gpuRun == CarveRun::Full) {
+                    // Wall time, including the frames between slices
+                    lastProcessingMs = (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - gpuRunStart).count();
+                    lastResizedWidth = gpuCarver.width();
+                    lastResizedHeight = gpuCarver.height();
+                    lastMethodIndex = methodIndex;
+                    lastResizeMemory = MemoryStats();
+                    hasResizeStats = true;
+                    fullResizeRunning = false;
+                    guiStatusMessage = "GPU resize to " + std::to_string(lastResizedWidth) + "x" +
+                        std::to_string(lastResizedHeight) + " in " + std::to_string(lastProcessingMs) + " ms." +
+                        (targetWidth > lastResizedWidth || targetHeight > lastResizedHeight
+                            ? " GPU carving only reduces; seam insertion needs the CPU." : "");
+                }
+                gpuRun = CarveRun::None;
+                autoRunVertical = false;
+                autoRunHorizontal = false;
+                autoRunFull = false;
+            }
+        }
+
         // --------------------------------------------------------------------
         // Image window
         // --------------------------------------------------------------------
-        ImGui::Begin("Image");
+        ImGui::Begin("Image", nullptr, ImGuiWindowFlags_HorizontalScrollbar);
         if (imageLoaded && imgTex.id != 0) {
+            ImGui::Checkbox("Actual size", &actualSize);
             ImVec2 avail = ImGui::GetContentRegionAvail();
-            float aspect = (imgTex.height > 0)
-                ? (float)imgTex.height / (float)imgTex.width
+            float aspect = (imgTex.imageHeight > 0)
+                ? (float)imgTex.imageHeight / (float)imgTex.imageWidth
                 : 1.0f;
 
             float drawWidth = avail.x;
@@ -589,17 +1519,150 @@ int run_gui() {
                 drawHeight = avail.y;
                 drawWidth = drawHeight / aspect;
             }
+            if (actualSize) {
+                drawWidth = (float)imgTex.imageWidth;
+                drawHeight = (float)imgTex.imageHeight;
+            }
+
+            // Uploads follow the drawn size in framebuffer pixels; full
+            // resolution only at actual size. A larger limit than the
+            // texture was made for uploads the CPU image again.
+            const ImVec2 fbScale = ImGui::GetIO().DisplayFramebufferScale;
+            imgTex.limitWidth = actualSize ? 0 : std::max(1, (int)std::ceil(drawWidth * fbScale.x));
+            imgTex.limitHeight = actualSize ? 0 : std::max(1, (int)std::ceil(drawHeight * fbScale.y));
+            const cv::Size wanted = imgTex.uploadSize(imgTex.imageWidth, imgTex.imageHeight);
+            if (!useGpuCarve && !proxyShown && currentImage.cols == imgTex.imageWidth &&
+                currentImage.rows == imgTex.imageHeight && (wanted.width > imgTex.width || wanted.height > imgTex.height)) {
+                LoadTextureFromMat(currentImage, imgTex);
+            }
 
             ImGui::Image(
                 (void*)(intptr_t)imgTex.id,
-                ImVec2(drawWidth, drawHeight)
+                ImVec2(drawWidth, drawHeight),
+                ImVec2(0.0f, 0.0f),
+                imgTex.uvMax()
             );
+
+            // Seam overlay as a polyline through pixel centres: O(seam length)
+            // per frame instead of painting and re-uploading the image
+            if (!overlaySeam.empty() && imgTex.imageWidth > 0 && imgTex.imageHeight > 0) {
+                ImVec2 origin = ImGui::GetItemRectMin();
+                float sx = drawWidth / (float)imgTex.imageWidth;
+                float sy = drawHeight / (float)imgTex.imageHeight;
+                std::vector<ImVec2> points(overlaySeam.size());
+                for (size_t i = 0; i < overlaySeam.size(); ++i) {
+                    float along = (float)i + 0.5f;
+                    float across = (float)overlaySeam[i] + 0.5f;
+                    points[i] = overlaySeamVertical
+                        ? ImVec2(origin.x + across * sx, origin.y + along * sy)
+                        : ImVec2(origin.x + along * sx, origin.y + across * sy);
+                }
+                float thickness = std::max(1.0f, overlaySeamVertical ? sx : sy);
+                ImGui::GetWindowDrawList()->AddPolyline(points.data(), (int)points.size(),
+                    IM_COL32(255, 0, 0, 255), ImDrawFlags_None, thickness);
+            }
         }
         else {
             ImGui::Text("No image loaded yet.");
         }
         ImGui::End(); // Image
 
+        // --------------------------------------------------------------------
+        // Heatmap window: redrawn only when new planes arrive or the view
+        // changes, never converted on the CPU
+        // --------------------------------------------------------------------
+        if (showHeatmap && gpuCarver.available()) {
+            ImGui::Begin("Heatmap", &showHeatmap);
+            const cv::Mat& plane = heatmapPlane == 0 ? heatEnergy : heatCost;
+            const ImVec2 avail = ImGui::GetContentRegionAvail();
+            const ImVec2 fbScale = ImGui::GetIO().DisplayFramebufferScale;
+            heatTex.limitWidth = std::max(1, (int)std::ceil(avail.x * fbScale.x));
+            heatTex.limitHeight = std::max(1, (int)std::ceil(avail.y * fbScale.y));
+            if (heatTex.maxSize == 0) glGetIntegerv(GL_MAX_TEXTURE_SIZE, &heatTex.maxSize);
+            const cv::Size size = plane.empty() ? cv::Size() : heatTex.uploadSize(plane.cols, plane.rows);
+            if (!plane.empty() && (heatmapStale || size.width > heatTex.width || size.height > heatTex.height)) {
+                try {
+                    reserveTexture(heatTex, size.width, size.height);
+                    gpuCarver.presentHeatmap(plane, heatTex.id, size.width, size.height, heatmapLog);
+                    heatTex.width = size.width;
+                    heatTex.height = size.height;
+                    heatTex.imageWidth = plane.cols;
+                    heatTex.imageHeight = plane.rows;
+                }
+                catch (const std::exception& e) {
+                    lastError = e.what();
+                }
+                heatmapStale = false;
+            }
+            if (plane.empty() || heatTex.id == 0) {
+                ImGui::TextUnformatted("Waiting for the worker's next snapshot.");
+            }
+            else {
+                ImGui::Text("%s, %d x %d%s", heatmapPlaneNames[heatmapPlane], plane.cols, plane.rows,
+                            heatmapPlane == 1 ? (heatCostVertical ? " (vertical seams)" : " (horizontal seams)") : "");
+                const ImVec2 room = ImGui::GetContentRegionAvail();
+                const float scale = std::min(room.x / heatTex.imageWidth, room.y / heatTex.imageHeight);
+                ImGui::Image((void*)(intptr_t)heatTex.id,
+                             ImVec2(heatTex.imageWidth * scale, heatTex.imageHeight * scale),
+                             ImVec2(0.0f, 0.0f), heatTex.uvMax());
+            }
+            ImGui::End(); // Heatmap
+            if (!showHeatmap) worker.setHeatmaps(false);  // closed from its title bar
+        }
+
+        // --------------------------------------------------------------------
+        // Method comparison window
+        // --------------------------------------------------------------------
+        if (showComparison && !comparison.results.empty()) {
+            ImGui::Begin("Method comparison", &showComparison, ImGuiWindowFlags_HorizontalScrollbar);
+            if (ImGui::BeginTable("method_comparison", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Method");
+                ImGui::TableSetupColumn("Seams");
+                ImGui::TableSetupColumn("Time ms");
+                ImGui::TableSetupColumn("Seams/s");
+                ImGui::TableSetupColumn("Removed energy");
+                ImGui::TableHeadersRow();
+                for (const MethodResult& r : comparison.results) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(methodNames[static_cast<int>(r.method)]);
+                    ImGui::TableNextColumn();
+                    if (!r.error.empty()) ImGui::TextUnformatted(r.error.c_str());
+                    else if (r.done) ImGui::Text("%d", r.seamsDone);
+                    else ImGui::Text("%d / %d", r.seamsDone, r.seamsTotal);
+                    ImGui::TableNextColumn(); ImGui::Text("%.1f", r.elapsedMs);
+                    ImGui::TableNextColumn(); ImGui::Text("%.1f", r.seamsPerSecond());
+                    ImGui::TableNextColumn();
+                    if (r.energyKnown) ImGui::Text("%.1f", r.removedEnergy);
+                    else ImGui::TextUnformatted("- (forward energy)");
+                }
+                ImGui::EndTable();
+            }
+
+            // Results side by side at one scale, so their sizes compare too
+            const int shown = std::min<int>(static_cast<int>(comparison.results.size()), IM_ARRAYSIZE(compareTex));
+            const float spacing = ImGui::GetStyle().ItemSpacing.x;
+            const float slotWidth = std::max(64.0f, (ImGui::GetContentRegionAvail().x - spacing * (shown - 1)) / shown);
+            int widest = 1;
+            for (int k = 0; k < shown; k++) widest = std::max(widest, compareTex[k].imageWidth);
+            const float scale = slotWidth / (float)widest;
+            for (int k = 0; k < shown; k++) {
+                if (k) ImGui::SameLine();
+                ImGui::BeginGroup();
+                ImGui::TextUnformatted(methodNames[static_cast<int>(comparison.results[k].method)]);
+                const ImageTexture& tex = compareTex[k];
+                if (tex.id != 0) {
+                    ImGui::Image((void*)(intptr_t)tex.id, ImVec2(tex.imageWidth * scale, tex.imageHeight * scale),
+                                 ImVec2(0.0f, 0.0f), tex.uvMax());
+                }
+                else {
+                    ImGui::Dummy(ImVec2(slotWidth, 0.0f));
+                    ImGui::TextUnformatted(comparison.results[k].done ? "(no image)" : "Carving...");
+                }
+                ImGui::EndGroup();
+            }
+            ImGui::End(); // Method comparison
+        }
+
         // --------------------------------------------------------------------
         // Render
         // --------------------------------------------------------------------
@@ -610,14 +1673,18 @@ int run_gui() {
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         glfwSwapBuffers(window);
     }
 
     // Cleanup
     imgTex.destroy();
+    for (ImageTexture& tex : compareTex) tex.destroy();
+    heatTex.destroy();
+    uploadRing.destroy();
+    gpuCarver.destroy();
 
-    ImGui_ImplOpenGL2_Shutdown();
+    ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
     glfwDestroyWindow(window);
@@ -634,4 +1701,5 @@ int main(int argc, char** argv) {
     if (argc > 1 && std::string(argv[1]) == "--gui") {
         return run_gui();
     }
+    return run_cli(argc, argv);
 }
@@ -0,0 +1,116 @@
+#include "MethodComparison.h"
+#include <algorithm>
+#include <chrono>
+
+MethodComparison::~MethodComparison() {
+    stop();
+}
+
+void MethodComparison::start(const cv::Mat& image, const std::vector<CarveMethod>& methods,
+                             const CarveSettings& settings) {
+    stop();
+    cancel.reset();
+    const unsigned id = ++runs;
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        shared.results.assign(methods.size(), MethodResult());
+        for (size_t k = 0; k < methods.size(); k++) {
+            MethodResult& r = shared.results[k];
+            r.method = methods[k];
+            r.seamsTotal = std::max(0, image.cols - settings.targetWidth) + std::max(0, image.rows - settings.targetHeight);
+            r.energyKnown = methods[k] != CarveMethod::DP || settings.energyModel == EnergyModel::Backward;
+        }
+        shared.complete = methods.empty();
+        shared.run = id;
+        fresh = true;
+    }
+    if (methods.empty()) return;
+
+    // Concurrent methods share the cores instead of each taking all of them
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned perMethod = std::max(1u, cores / static_cast<unsigned>(methods.size()));
+    busy = static_cast<int>(methods.size());
+    for (size_t k = 0; k < methods.size(); k++) {
+        CarveSettings s = settings;
+        s.method = methods[k];
+        threads.emplace_back(&MethodComparison::carve, this, image, s, perMethod, k);
+    }
+}
+
+void MethodComparison::stop() {
+    cancel.cancel();
+    for (std::thread& t : threads) {
+        if (t.joinable()) t.join();
+    }
+    threads.clear();
+    runs++;  // results still unread are stale now
+}
+
+const ComparisonSnapshot* MethodComparison::poll() {
+    std::lock_guard<std::mutex> lock(resultMutex);
+    if (!fresh || shared.run != runs) return nullptr;
+    fresh = false;
+    front = shared;  // cv::Mat copies share the carved buffers
+    return &front;
+}
+
+void MethodComparison::carve(cv::Mat image, CarveSettings settings, unsigned threadCount, size_t slot) {
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+    // Called with resultMutex held
+    auto finish = [&](MethodResult& r) {
+        r.done = true;
+        shared.complete = std::all_of(shared.results.begin(), shared.results.end(),
+                                      [](const MethodResult& m) { return m.done; });
+    };
+    try {
+        CarveSession session(image);
+        session.setUndoLimit(0);  // one pass, never undone
+        applyCarveSettings(session, settings);
+        session.carver().setEnergyThreads(threadCount);
+        session.carver().setDPThreads(threadCount);
+        session.carver().setIncrementalEnergy(true);
+
+        int seams = 0;
+        for (;;) {
+            if (cancel.cancelled()) throw CarveCancelled();
+            const bool vertical = session.image().cols > settings.targetWidth;
+            if (!vertical && session.image().rows <= settings.targetHeight) break;
+            if (session.step(vertical).empty()) break;
+            seams++;
+
+            std::lock_guard<std::mutex> lock(resultMutex);
+            MethodResult& r = shared.results[slot];
+            r.seamsDone = seams;
+            r.elapsedMs = elapsed();
+            r.removedEnergy = session.removedEnergy();
+            fresh = true;
+        }
+        if (session.image().cols < settings.targetWidth || session.image().rows < settings.targetHeight) {
+            session.enlarge(settings.targetWidth, settings.targetHeight, &cancel);
+        }
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        MethodResult& r = shared.results[slot];
+        r.image = session.image();
+        r.seamsDone = seams;
+        r.elapsedMs = elapsed();
+        r.removedEnergy = session.removedEnergy();
+        finish(r);
+        fresh = true;
+    }
+    catch (const CarveCancelled&) {
+        // Replaced by a new run or stopped
+    }
+    catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        MethodResult& r = shared.results[slot];
+        r.error = e.what();
+        r.elapsedMs = elapsed();
+        finish(r);
+        fresh = true;
+    }
+    busy--;
+}
@@ -0,0 +1,84 @@
+#ifndef METHOD_COMPARISON_H
+#define METHOD_COMPARISON_H
+
+#include "CarveWorker.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Outcome of one method of a comparison run
+struct MethodResult {
+    CarveMethod method = CarveMethod::DP;
+    cv::Mat image;               // carved image, once done
+    int seamsDone = 0;           // removed so far (inserted seams not counted)
+    int seamsTotal = 0;
+    double elapsedMs = 0.0;      // wall time of the carve so far
+    double removedEnergy = 0.0;  // CarveSession::removedEnergy
+    bool energyKnown = true;     // false for forward-energy DP, which has no energy map
+    bool done = false;
+    std::string error;
+
+    // @brief Seams removed per second of wall time, 0 before the first.
+    double seamsPerSecond() const { return elapsedMs > 0.0 ? seamsDone * 1000.0 / elapsedMs : 0.0; }
+};
+
+// Newest state of a comparison run, one result per method in start() order
+struct ComparisonSnapshot {
+    std::vector<MethodResult> results;
+    bool complete = false;   // every method is done
+    unsigned run = 0;        // start() that produced it
+};
+
+/**
+ * @brief Carves one image with several seam finders at once, each on its
+ * own thread with its own session, so the UI can show the results side by
+ * side instead of running Reset and Run Full once per method. The image is
+ * carved width first, then height, then enlarged, like CarveRun::Full; the
+ * machine's cores are split between the methods.
+ */
+class MethodComparison {
+public:
+    MethodComparison() = default;
+    ~MethodComparison();
+
+    MethodComparison(const MethodComparison&) = delete;
+    MethodComparison& operator=(const MethodComparison&) = delete;
+
+    /**
+     * @brief Cancel any run and carve image to settings.targetWidth x
+     * settings.targetHeight with each of methods; settings.method is
+     * ignored. The buffer is shared and never written.
+     */
+    void start(const cv::Mat& image, const std::vector<CarveMethod>& methods, const CarveSettings& settings);
+
+    // @brief Cancel the run, if any, and wait for its threads.
+    void stop();
+
+    // @brief Whether any method is still carving.
+    bool running() const { return busy.load() > 0; }
+
+    /**
+     * @brief Fetch the newest snapshot if anything changed since the last
+     * poll(); never blocks on a carve. The returned snapshot stays valid
+     * until the next poll().
+     */
+    const ComparisonSnapshot* poll();
+
+private:
+    void carve(cv::Mat image, CarveSettings settings, unsigned threadCount, size_t slot);
+
+    std::vector<std::thread> threads;
+    unsigned runs = 0;  // start() calls; results of older runs are dropped
+    CancelToken cancel;
+    std::atomic<int> busy{ 0 };
+
+    // Methods -> UI (updated once per seam, so a mutex is fine)
+    std::mutex resultMutex;
+    ComparisonSnapshot shared;
+    bool fresh = false;
+    ComparisonSnapshot front;  // UI only
+};
+
+#endif // METHOD_COMPARISON_H
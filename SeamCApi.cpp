@@ -0,0 +1,202 @@
+#include "SeamCApi.h"
+#include "SeamCarver.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+struct seam_session {
+    std::unique_ptr<SeamCarver> carver;  // made by the first resize, then reset per source
+    cv::Mat result;                      // the last result, viewed by the caller's seam_image
+    CancelToken cancel;
+    std::string error;
+};
+
+namespace {
+
+// Thrown for caller mistakes: SEAM_INVALID_ARGUMENT
+struct InvalidArgument : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+int matType(const seam_image& image) {
+    int depth = -1;
+    switch (image.depth) {
+    case SEAM_DEPTH_U8: depth = CV_8U; break;
+    case SEAM_DEPTH_U16: depth = CV_16U; break;
+    case SEAM_DEPTH_F32: depth = CV_32F; break;
+    }
+    const int type = depth < 0 || image.channels < 1 || image.channels > 4 ? -1 : CV_MAKETYPE(depth, image.channels);
+    if (type < 0 || !SeamCarver::isSupportedImageType(type)) {
+        throw InvalidArgument("Unsupported pixel format: " + std::to_string(image.channels) + " channels of depth " +
+                              std::to_string(image.depth) + ".");
+    }
+    return type;
+}
+
+// Header over the caller's pixels, checked for a usable size and stride
+cv::Mat wrapImage(const seam_image* image, const char* what) {
+    if (!image || !image->pixels) throw InvalidArgument(std::string(what) + " has no pixels.");
+    const int type = matType(*image);
+    if (image->width < 1 || image->height < 1) throw InvalidArgument(std::string(what) + " is empty.");
+    if (image->stride < static_cast<size_t>(image->width) * CV_ELEM_SIZE(type)) {
+        throw InvalidArgument(std::string(what) + " has a stride shorter than a row.");
+    }
+    return cv::Mat(image->height, image->width, type, image->pixels, image->stride);
+}
+
+seam_image describe(const cv::Mat& m) {
+    seam_image image;
+    image.pixels = m.data;
+    image.width = m.cols;
+    image.height = m.rows;
+    image.stride = m.step[0];
+    image.channels = m.channels();
+    image.depth = m.depth() == CV_8U ? SEAM_DEPTH_U8 : m.depth() == CV_16U ? SEAM_DEPTH_U16 : SEAM_DEPTH_F32;
+    return image;
+}
+
+template <typename Enum>
+Enum checkedEnum(int32_t value, int32_t last, const char* what) {
+    if (value < 0 || value > last) throw InvalidArgument(std::string("Unknown ") + what + " " + std::to_string(value) + ".");
+    return static_cast<Enum>(value);
+}
+
+// ResizeOptions of the caller's options. Only the first options->size
+// bytes are read: fields a caller built against an older header does not
+// have keep their defaults.
+ResizeOptions resizeOptions(const seam_resize_options* from) {
+    seam_resize_options o;
+    seam_resize_options_init(&o, 0, 0);
+    if (from->size < offsetof(seam_resize_options, strategy)) throw InvalidArgument("Options were not initialised.");
+    std::memcpy(&o, from, std::min(from->size, sizeof(o)));
+
+    ResizeOptions options;
+    options.width = o.width;
+    options.height = o.height;
+    options.strategy = checkedEnum<SeamStrategy>(o.strategy, SEAM_STRATEGY_GRAPH_CUT, "strategy");
+    options.energyModel = checkedEnum<EnergyModel>(o.energy_model, SEAM_ENERGY_FORWARD, "energy model");
+    options.energyFunction = checkedEnum<EnergyFunction>(o.energy_function, SEAM_ENERGY_FN_FAST_SOBEL, "energy function");
+    options.precision = checkedEnum<EnergyPrecision>(o.precision, SEAM_PRECISION_FIXED16, "precision");
+    options.seamOrder = checkedEnum<SeamOrder>(o.seam_order, SEAM_ORDER_CHEAPEST, "seam order");
+    options.seamBatch = o.seam_batch;
+    options.incrementalEnergy = o.incremental != 0;
+    options.incrementalDP = o.incremental != 0;
+    options.energyThreads = std::max(1u, o.energy_threads);
+    options.dpThreads = std::max(1u, o.dp_threads);
+    options.seamStep = o.seam_step;
+    options.carveQuality = o.carve_quality;
+    options.borderTrim = o.border_trim;
+    if (o.region_width > 0 && o.region_height > 0) {
+        options.region = cv::Rect(o.region_x, o.region_y, o.region_width, o.region_height);
+    }
+    if (o.progress) {
+        seam_progress_fn fn = o.progress;
+        void* user = o.progress_user;
+        options.progress = [fn, user](const CarveProgress& p) { fn(user, p.seamsDone, p.seamsTotal, p.elapsedMs); };
+    }
+    return options;
+}
+
+// Masks of the caller's options; both stay empty when not given
+void resizeMasks(const seam_resize_options* from, cv::Mat& protect, cv::Mat& remove) {
+    if (from->size < offsetof(seam_resize_options, remove) + sizeof(from->remove)) return;
+    if (from->protect) protect = wrapImage(from->protect, "The protect mask");
+    if (from->remove) remove = wrapImage(from->remove, "The remove mask");
+}
+
+} // namespace
+
+extern "C" {
+
+int32_t seam_abi_version(void) {
+    return SEAM_ABI_VERSION;
+}
+
+void seam_resize_options_init(seam_resize_options* options, int32_t width, int32_t height) {
+    if (!options) return;
+    const ResizeOptions defaults;
+    std::memset(options, 0, sizeof(*options));
+    options->size = sizeof(*options);
+    options->width = width;
+    options->height = height;
+    options->strategy = static_cast<int32_t>(defaults.strategy);
+    options->energy_model = static_cast<int32_t>(defaults.energyModel);
+    options->energy_function = static_cast<int32_t>(defaults.energyFunction);
+    options->precision = static_cast<int32_t>(defaults.precision);
+    options->seam_order = static_cast<int32_t>(defaults.seamOrder);
+    options->seam_batch = defaults.seamBatch;
+    options->incremental = defaults.incrementalEnergy ? 1 : 0;
+    options->energy_threads = defaults.energyThreads;
+    options->dp_threads = defaults.dpThreads;
+    options->seam_step = defaults.seamStep;
+    options->carve_quality = defaults.carveQuality;
+    options->border_trim = defaults.borderTrim;
+}
+
+seam_session* seam_session_create(void) {
+    return new (std::nothrow) seam_session();
+}
+
+void seam_session_destroy(seam_session* session) {
+    delete session;
+}
+
+seam_status seam_resize(seam_session* session, const seam_image* source, const seam_resize_options* options,
+                        seam_image* result) {
+    if (!session) return SEAM_INVALID_ARGUMENT;
+    seam_status status = SEAM_OK;
+    try {
+        if (!options || !result) throw InvalidArgument("Options and result must not be null.");
+        session->result.release();
+        const cv::Mat pixels = wrapImage(source, "The source image");
+        ResizeOptions o = resizeOptions(options);
+        cv::Mat masks[2];
+        resizeMasks(options, masks[0], masks[1]);
+        o.cancel = &session->cancel;
+
+        if (session->carver) {
+            session->carver->reset(pixels.data, pixels.cols, pixels.rows, pixels.step[0], pixels.type());
+        } else {
+            session->carver = std::make_unique<SeamCarver>(pixels.data, pixels.cols, pixels.rows, pixels.step[0],
+                                                           pixels.type());
+        }
+        if (!masks[0].empty() || !masks[1].empty()) session->carver->setMask(masks[0], masks[1]);
+        session->result = session->carver->resize(o);
+        *result = describe(session->result);
+        session->error.clear();
+    }
+    catch (const InvalidArgument& e) {
+        session->error = e.what();
+        status = SEAM_INVALID_ARGUMENT;
+    }
+    catch (const CarveCancelled& e) {
+        session->error = e.what();
+        status = SEAM_CANCELLED;
+    }
+    catch (const std::exception& e) {
+        session->error = e.what();
+        status = SEAM_ERROR;
+    }
+    catch (...) {
+        session->error = "Unknown error.";
+        status = SEAM_ERROR;
+    }
+    // A cancel applies to one resize
+    session->cancel.reset();
+    return status;
+}
+
+void seam_session_cancel(seam_session* session) {
+    if (session) session->cancel.cancel();
+}
+
+const char* seam_session_error(const seam_session* session) {
+    return session ? session->error.c_str() : "No session.";
+}
+
+} // extern "C"
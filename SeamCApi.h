@@ -0,0 +1,158 @@
+#ifndef SEAM_C_API_H
+#define SEAM_C_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Plain C interface of the seamcarver library for FFI callers (Go, Rust,
+ * ...). Only the types below cross the boundary: no OpenCV or standard
+ * library types, no exceptions. Pixels are passed in caller-owned buffers
+ * with a row stride and are never copied on the way in; the result is a
+ * view of the session's own buffer, so it is not copied on the way out
+ * either.
+ *
+ * A session is not thread-safe: use one per thread. Only
+ * seam_session_cancel may be called from any thread.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped when a struct or signature below changes incompatibly */
+#define SEAM_ABI_VERSION 1
+
+typedef enum seam_status {
+    SEAM_OK = 0,
+    SEAM_INVALID_ARGUMENT = 1,  /* null pointers, unsupported formats, bad sizes */
+    SEAM_CANCELLED = 2,         /* seam_session_cancel was called */
+    SEAM_ERROR = 3              /* anything else; see seam_session_error */
+} seam_status;
+
+/* Element type of a pixel channel */
+typedef enum seam_depth {
+    SEAM_DEPTH_U8 = 0,
+    SEAM_DEPTH_U16 = 1,
+    SEAM_DEPTH_F32 = 2
+} seam_depth;
+
+/* SeamStrategy */
+typedef enum seam_strategy {
+    SEAM_STRATEGY_DP = 0,
+    SEAM_STRATEGY_GREEDY = 1,
+    SEAM_STRATEGY_PYRAMID = 2,
+    SEAM_STRATEGY_GRAPH_CUT = 3
+} seam_strategy;
+
+/* EnergyModel */
+typedef enum seam_energy_model {
+    SEAM_ENERGY_BACKWARD = 0,
+    SEAM_ENERGY_FORWARD = 1
+} seam_energy_model;
+
+/* EnergyFunction */
+typedef enum seam_energy_function {
+    SEAM_ENERGY_FN_SOBEL = 0,
+    SEAM_ENERGY_FN_SCHARR = 1,
+    SEAM_ENERGY_FN_DUAL_GRADIENT = 2,
+    SEAM_ENERGY_FN_L1_GRADIENT = 3,
+    SEAM_ENERGY_FN_SALIENCY = 4,
+    SEAM_ENERGY_FN_FAST_SOBEL = 5
+} seam_energy_function;
+
+/* EnergyPrecision */
+typedef enum seam_precision {
+    SEAM_PRECISION_DOUBLE = 0,
+    SEAM_PRECISION_FLOAT = 1,
+    SEAM_PRECISION_FIXED16 = 2
+} seam_precision;
+
+/* SeamOrder */
+typedef enum seam_order {
+    SEAM_ORDER_WIDTH_FIRST = 0,
+    SEAM_ORDER_OPTIMAL = 1,
+    SEAM_ORDER_CHEAPEST = 2
+} seam_order;
+
+/*
+ * An image in memory: height rows of width pixels, each of channels
+ * (1 gray, 3 BGR, 4 BGRA) values of depth, packed within a row; rows start
+ * stride bytes apart.
+ */
+typedef struct seam_image {
+    void* pixels;
+    int32_t width;
+    int32_t height;
+    size_t stride;
+    int32_t channels;
+    int32_t depth;      /* seam_depth */
+} seam_image;
+
+/* Called on the carving thread after every carve step */
+typedef void (*seam_progress_fn)(void* user, int32_t seams_done, int32_t seams_total, double elapsed_ms);
+
+/*
+ * Settings of seam_resize, the C form of ResizeOptions. Fill with
+ * seam_resize_options_init first: it sets size, which lets later library
+ * versions append fields without breaking older callers.
+ */
+typedef struct seam_resize_options {
+    size_t size;                    /* sizeof(seam_resize_options), set by init */
+    int32_t width;                  /* target size; larger than the image inserts seams */
+    int32_t height;
+    int32_t strategy;               /* seam_strategy */
+    int32_t energy_model;           /* seam_energy_model, DP only */
+    int32_t energy_function;        /* seam_energy_function */
+    int32_t precision;              /* seam_precision */
+    int32_t seam_order;             /* seam_order, DP only */
+    int32_t seam_batch;             /* DP seams per cost table; 0 adaptive */
+    int32_t incremental;            /* nonzero: incremental energy and DP */
+    uint32_t energy_threads;
+    uint32_t dp_threads;
+    int32_t seam_step;              /* 1..3, DP and greedy */
+    double carve_quality;           /* below 1: area-scale most of a large reduction first */
+    double border_trim;             /* 0 or above: crop flat borders first; -1 off */
+    int32_t region_x;               /* region_width/height 0: whole image */
+    int32_t region_y;
+    int32_t region_width;
+    int32_t region_height;
+    const seam_image* protect;      /* may be null; 1-channel U8 of the image size, nonzero = keep */
+    const seam_image* remove;       /* may be null; nonzero = carve first */
+    seam_progress_fn progress;      /* may be null */
+    void* progress_user;
+} seam_resize_options;
+
+typedef struct seam_session seam_session;
+
+/* SEAM_ABI_VERSION the library was built with */
+int32_t seam_abi_version(void);
+
+/* Defaults of ResizeOptions at the given size */
+void seam_resize_options_init(seam_resize_options* options, int32_t width, int32_t height);
+
+/* A session keeps the carver's working buffers between resizes. Null if out of memory. */
+seam_session* seam_session_create(void);
+void seam_session_destroy(seam_session* session);
+
+/*
+ * Carve source to options->width x options->height. source is read in
+ * place and must stay unchanged until the call returns; it is never
+ * written. On SEAM_OK result describes the carved image in the session's
+ * buffer (or source's pixels if nothing was carved), valid until the next
+ * seam_resize or seam_session_destroy of the session.
+ */
+seam_status seam_resize(seam_session* session, const seam_image* source, const seam_resize_options* options,
+                        seam_image* result);
+
+/* Stop the running (or next) resize of session with SEAM_CANCELLED. Any thread. */
+void seam_session_cancel(seam_session* session);
+
+/* Message of the last failed call on session, "" after a success. Owned by the session. */
+const char* seam_session_error(const seam_session* session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SEAM_C_API_H */
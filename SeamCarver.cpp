@@ -1,451 +1,4363 @@
 #include "SeamCarver.h"
-#include <iostream>
+#include "ThreadPool.h"
 #include <algorithm>
 #include <cmath>
 #include <queue>
+#include <cstring>
+#include <future>
+#include <tuple>
+#include <type_traits>
 
-SeamCarver::SeamCarver(const std::string& imagePath) {
-    image = cv::imread(imagePath);
-    if (image.empty()) {
+SeamCarver::SeamCarver(const std::string& imagePath)
+    : graphWorkspace(std::make_unique<GraphWorkspace>()), seamWorkspace(std::make_unique<SeamWorkspace>()) {
+    reset(imagePath);
+}
+
+SeamCarver::SeamCarver(const cv::Mat& img)
+    : graphWorkspace(std::make_unique<GraphWorkspace>()), seamWorkspace(std::make_unique<SeamWorkspace>()) {
+    reset(img);
+}
+
+SeamCarver::SeamCarver(cv::Mat&& img)
+    : graphWorkspace(std::make_unique<GraphWorkspace>()), seamWorkspace(std::make_unique<SeamWorkspace>()) {
+    reset(std::move(img));
+}
+
+SeamCarver::SeamCarver(uchar* pixels, int width, int height, size_t stride, int type)
+    : graphWorkspace(std::make_unique<GraphWorkspace>()), seamWorkspace(std::make_unique<SeamWorkspace>()) {
+    reset(pixels, width, height, stride, type);
+}
+
+SeamCarver::SeamCarver(const uchar* encoded, size_t size)
+    : graphWorkspace(std::make_unique<GraphWorkspace>()), seamWorkspace(std::make_unique<SeamWorkspace>()) {
+    reset(encoded, size);
+}
+
+void SeamCarver::reset(const std::string& imagePath) {
+    // Unchanged keeps 16-bit depth and the alpha channel of RGBA files
+    cv::Mat loaded = cv::imread(imagePath, cv::IMREAD_UNCHANGED);
+    if (loaded.empty()) {
         throw std::runtime_error("Could not load image from: " + imagePath);
     }
-    originalImage = image.clone();
-    std::cout << "Loaded image with dimensions: " << image.cols << "x" << image.rows << std::endl;
+    adoptImage(std::move(loaded));
+}
+
+void SeamCarver::reset(const cv::Mat& img) {
+    adoptImage(img.clone());
+}
+
+void SeamCarver::reset(cv::Mat&& img) {
+    adoptImage(std::move(img));
+}
+
+void SeamCarver::reset(uchar* pixels, int width, int height, size_t stride, int type) {
+    if (!pixels || width <= 0 || height <= 0) {
+        throw std::runtime_error("Invalid pixel buffer.");
+    }
+    // Header only: the caller's buffer backs originalImage
+    adoptImage(cv::Mat(height, width, type, pixels, stride));
+}
+
+void SeamCarver::reset(const uchar* encoded, size_t size) {
+    if (!encoded || size == 0) {
+        throw std::runtime_error("Empty encoded image buffer.");
+    }
+    cv::Mat buffer(1, static_cast<int>(size), CV_8U, const_cast<uchar*>(encoded));
+    cv::Mat decoded = cv::imdecode(buffer, cv::IMREAD_UNCHANGED);
+    if (decoded.empty()) {
+        throw std::runtime_error("Could not decode image from memory buffer.");
+    }
+    adoptImage(std::move(decoded));
+}
+
+// Depth of the energy maps produced at a precision
+static int energyDepth(EnergyPrecision precision) {
+    return precision == EnergyPrecision::Fixed16 ? CV_16U
+         : precision == EnergyPrecision::Float ? CV_32F : CV_64F;
+}
+
+// Depth of the Sobel gradients behind an energy map
+static int gradientDepth(EnergyPrecision precision) {
+    return precision == EnergyPrecision::Double ? CV_64F : CV_32F;
+}
+
+// Scratch planes of the per-seam kernels, kept by SeamCarver across calls.
+// Each backing is a byte buffer that only grows (see scratchPlane); the
+// image-sized ones are PageBuffers placed by setBufferPlacement, the rows
+// plain Mats.
+struct SeamCarver::SeamWorkspace {
+    PageBuffer costTable;     // padded DP cost table (backward or forward)
+    cv::Mat costRows;         // DP row minimum, or the two rolling cost rows
+    PageBuffer reverseTable;  // bottom-up half of the bidirectional DP
+    cv::Mat reverseRows;      // its row minimum
+    PageBuffer offsets;       // DP parent offsets
+    PageBuffer energy;        // scratchEnergy's map
+    PageBuffer gradX, gradY;  // Sobel gradients
+    PageBuffer magnitude;     // gradient magnitude before Fixed16 quantisation
+
+    // Drop the image-sized planes; they regrow under placement
+    void place(const BufferPlacement& placement) {
+        for (PageBuffer* b : { &costTable, &reverseTable, &offsets, &energy, &gradX, &gradY, &magnitude }) {
+            b->release();
+            b->setPlacement(placement);
+        }
+    }
+};
+
+// Continuous rows x cols header of the given type over backing. Carving
+// only shrinks the planes, so after the first seam these headers never
+// allocate, and a transposed plane reuses the same bytes.
+static cv::Mat scratchPlane(cv::Mat& backing, int rows, int cols, int type) {
+    const size_t bytes = static_cast<size_t>(rows) * cols * CV_ELEM_SIZE(type);
+    if (backing.total() < bytes) backing.create(1, static_cast<int>(bytes), CV_8U);
+    return cv::Mat(rows, cols, type, backing.data);
+}
+
+static cv::Mat scratchPlane(PageBuffer& backing, int rows, int cols, int type) {
+    return cv::Mat(rows, cols, type, backing.reserve(static_cast<size_t>(rows) * cols * CV_ELEM_SIZE(type)));
+}
+
+// Element type and channel count of a plane as compile-time constants, so
+// the per-pixel kernels move and convert whole pixels without a runtime
+// byte count or a depth switch per pixel
+template <typename T, int Cn>
+struct PixelFormat {
+    typedef T Elem;
+    static constexpr int channels = Cn;
+    static constexpr size_t size() { return sizeof(T) * Cn; }
+};
+
+// Any other plane type: seam removal only moves bytes, so it works from
+// the runtime pixel size
+struct AnyPixelFormat {
+    size_t bytes;
+    size_t size() const { return bytes; }
+};
+
+bool SeamCarver::isSupportedImageType(int type) {
+    switch (type) {
+    case CV_8UC1: case CV_8UC3: case CV_8UC4:
+    case CV_16UC1: case CV_16UC3: case CV_16UC4:
+    case CV_32FC1: case CV_32FC3: case CV_32FC4:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Call fn(PixelFormat<T, Cn>()) for an image type the carver supports;
+// throws for any other
+template <typename Fn>
+static auto dispatchImageFormat(int type, Fn&& fn) {
+    switch (type) {
+    case CV_8UC1: return fn(PixelFormat<uchar, 1>());
+    case CV_8UC3: return fn(PixelFormat<uchar, 3>());
+    case CV_8UC4: return fn(PixelFormat<uchar, 4>());
+    case CV_16UC1: return fn(PixelFormat<ushort, 1>());
+    case CV_16UC3: return fn(PixelFormat<ushort, 3>());
+    case CV_16UC4: return fn(PixelFormat<ushort, 4>());
+    case CV_32FC1: return fn(PixelFormat<float, 1>());
+    case CV_32FC3: return fn(PixelFormat<float, 3>());
+    case CV_32FC4: return fn(PixelFormat<float, 4>());
+    default:
+        throw std::runtime_error("Unsupported image type: expected 8-bit, 16-bit or float pixels "
+                                 "with 1, 3 or 4 channels.");
+    }
+}
+
+// Removal dispatch: the image formats plus the energy and index planes
+// carved alongside them, anything else by its runtime pixel size
+template <typename Fn>
+static auto dispatchPlaneFormat(const cv::Mat& plane, Fn&& fn) {
+    switch (plane.type()) {
+    case CV_32SC1: return fn(PixelFormat<int, 1>());
+    case CV_64FC1: return fn(PixelFormat<double, 1>());
+    default: break;
+    }
+    if (!SeamCarver::isSupportedImageType(plane.type())) {
+        return fn(AnyPixelFormat{ plane.elemSize() });
+    }
+    return dispatchImageFormat(plane.type(), fn);
+}
+
+// Scale from an image depth to the 8-bit range of the gray plane: 16-bit
+// values map 65535 -> 255 and float ones 1.0 -> 255
+static double byteScale(int depth) {
+    return depth == CV_16U ? 1.0 / 257 : depth == CV_32F || depth == CV_64F ? 255.0 : 1.0;
+}
+
+// One element in the 8-bit range, rounded like the convertTo in toGray
+static inline int toByte(uchar v) { return v; }
+static inline int toByte(ushort v) { return cv::saturate_cast<uchar>(v * static_cast<float>(1.0 / 257)); }
+static inline int toByte(float v) { return cv::saturate_cast<uchar>(v * 255.0f); }
+
+// Inverse of toByte for colors given in the 8-bit range
+template <typename T> static inline T fromByte(double v);
+template <> inline uchar fromByte<uchar>(double v) { return cv::saturate_cast<uchar>(v); }
+template <> inline ushort fromByte<ushort>(double v) { return cv::saturate_cast<ushort>(v * 257); }
+template <> inline float fromByte<float>(double v) { return static_cast<float>(v / 255); }
+
+EnergyPrecision SeamCarver::precisionFor(const cv::Mat& gray) const {
+    // Nor can CV_16U hold the mask energies
+    if (precision == EnergyPrecision::Fixed16 &&
+        (!mask.empty() || std::max(gray.rows, gray.cols) > kMaxFixedSeamLength)) {
+        return EnergyPrecision::Float;
+    }
+    return precision;
+}
+
+cv::Mat SeamCarver::takeInitialEnergy(const cv::Mat& gray) {
+    cv::Mat energy;
+    std::swap(energy, initialEnergy);
+    if (energy.size() != gray.size() || energy.depth() != energyDepth(precisionFor(gray)) || energy.channels() != 1) {
+        energy.release();
+    }
+    return energy;
+}
+
+void SeamCarver::adoptImage(cv::Mat img) {
+    if (img.empty()) {
+        throw std::runtime_error("Cannot construct SeamCarver from an empty image.");
+    }
+    if (!isSupportedImageType(img.type())) {
+        throw std::runtime_error("Unsupported image type: expected 8-bit, 16-bit or float pixels "
+                                 "with 1, 3 or 4 channels.");
+    }
+    // Carving never writes into image (every resize works on its own copy),
+    // so the working and original image can share one buffer
+    image = std::move(img);
+    originalImage = image;
+    grayImage = toGray(image);
+    initialEnergy.release();
+    mask = SeamMask();
+}
+
+void SeamCarver::setMask(const cv::Mat& protect, const cv::Mat& remove) {
+    SeamMask m(protect, remove);
+    if (!m.empty() && m.size() != image.size()) {
+        throw std::runtime_error("Mask does not match the image size.");
+    }
+    mask = std::move(m);
+}
+
+// Out of line because GraphWorkspace is only complete in this file
+SeamCarver::~SeamCarver() = default;
+SeamCarver::SeamCarver(SeamCarver&&) noexcept = default;
+SeamCarver& SeamCarver::operator=(SeamCarver&&) noexcept = default;
+
+namespace {
+thread_local HeapCounter heapCounter;
+bool heapCountingOn = false;
+} // namespace
+
+HeapCounter& threadHeapCounter() { return heapCounter; }
+bool heapCountingLinked() { return heapCountingOn; }
+void setHeapCountingLinked() { heapCountingOn = true; }
+
+void SeamCarver::setBufferPlacement(const BufferPlacement& placement) {
+    bufferPlacement = placement;
+    for (SeamWorkspace* ws : { seamWorkspace.get(), crossWorkspace.get() }) {
+        if (ws) ws->place(placement);
+    }
+}
+
+size_t SeamCarver::workspaceBytes() const {
+    size_t bytes = 0;
+    for (const SeamWorkspace* ws : { seamWorkspace.get(), crossWorkspace.get() }) {
+        if (!ws) continue;
+        bytes += ws->costRows.total() * ws->costRows.elemSize();
+        bytes += ws->reverseRows.total() * ws->reverseRows.elemSize();
+        for (const PageBuffer* b : { &ws->costTable, &ws->reverseTable, &ws->offsets, &ws->energy, &ws->gradX,
+                                     &ws->gradY, &ws->magnitude }) {
+            bytes += b->size();
+        }
+    }
+    return bytes;
+}
+
+void SeamCarver::sampleMemory(std::initializer_list<const cv::Mat*> planes) {
+    size_t bytes = workspaceBytes();
+    for (const cv::Mat* m : planes) bytes += m->total() * m->elemSize();
+    phaseStats.memory.peakBytes = std::max(phaseStats.memory.peakBytes, bytes);
+}
+
+cv::Mat SeamCarver::calculateEnergy(const cv::Mat& img) {
+    return calculateEnergyFromGray(toGray(img));
+}
+
+cv::Mat SeamCarver::toGray(const cv::Mat& img) {
+    if (img.type() == CV_8UC1) {
+        return img;
+    }
+    SEAM_PHASE(&phaseStats, Gray);
+    // 16-bit and float images are scaled to 8 bits first, so every depth
+    // gets the same energy range and the 8-bit forward and fused DP
+    cv::Mat bytes = img;
+    if (img.depth() != CV_8U) {
+        img.convertTo(bytes, CV_8U, byteScale(img.depth()));
+    }
+    if (bytes.channels() == 1) {
+        return bytes;
+    }
+    cv::Mat gray;
+    cv::cvtColor(bytes, gray, bytes.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    return gray;
+}
+
+// Cumulative cost type for each supported energy depth. Fixed-point energy
+// is stored as 16-bit and accumulated in 32 bits so the DP never overflows
+// for realistic image heights.
+template <typename T> struct SeamCost { typedef T type; };
+template <> struct SeamCost<ushort> { typedef int type; };
+
+// Call fn(T()) with T the element type of a single-channel energy map
+template <typename Fn>
+static auto dispatchEnergyDepth(const cv::Mat& energy, Fn&& fn) {
+    switch (energy.depth()) {
+    case CV_64F: return fn(double());
+    case CV_32F: return fn(float());
+    case CV_16U:
+        // The CV_32S cost of a longer seam could overflow
+        if (std::max(energy.rows, energy.cols) > SeamCarver::kMaxFixedSeamLength) {
+            throw std::runtime_error("CV_16U energy map too large for the Fixed16 cost table (use Float).");
+        }
+        return fn(ushort());
+    default:
+        throw std::runtime_error("Unsupported energy map depth (expected CV_64F, CV_32F or CV_16U).");
+    }
+}
+
+// Reflect-101 border index, matching cv::BORDER_DEFAULT used by cv::Sobel
+static inline int reflect101(int p, int n) {
+    if (n == 1) return 0;
+    if (p < 0) return -p;
+    if (p >= n) return 2 * n - p - 2;
+    return p;
+}
+
+// Energy kernels: gradient magnitude of a 3x3 gray neighbourhood g[row][col].
+// They are template arguments of the per-pixel loops below, so each kernel
+// is inlined into the loop that uses it.
+struct SobelEnergy {
+    static double at(const int (&g)[3][3]) {
+        double gx = (g[0][2] - g[0][0]) + 2 * (g[1][2] - g[1][0]) + (g[2][2] - g[2][0]);
+        double gy = (g[2][0] - g[0][0]) + 2 * (g[2][1] - g[0][1]) + (g[2][2] - g[0][2]);
+        return std::sqrt(gx * gx + gy * gy);
+    }
+};
+
+// Scharr weights sum to 16 instead of Sobel's 4; dividing by 4 keeps the
+// magnitudes in the Sobel range so Fixed16 maps do not saturate.
+struct ScharrEnergy {
+    static double at(const int (&g)[3][3]) {
+        double gx = 3 * (g[0][2] - g[0][0]) + 10 * (g[1][2] - g[1][0]) + 3 * (g[2][2] - g[2][0]);
+        double gy = 3 * (g[2][0] - g[0][0]) + 10 * (g[2][1] - g[0][1]) + 3 * (g[2][2] - g[0][2]);
+        return 0.25 * std::sqrt(gx * gx + gy * gy);
+    }
+};
+
+// Central differences of the four direct neighbours
+struct DualGradientEnergy {
+    static double at(const int (&g)[3][3]) {
+        double dx = g[1][2] - g[1][0];
+        double dy = g[2][1] - g[0][1];
+        return std::sqrt(dx * dx + dy * dy);
+    }
+};
+
+// L1 norm of the central differences: integer-only
+struct L1GradientEnergy {
+    static double at(const int (&g)[3][3]) {
+        return std::abs(g[1][2] - g[1][0]) + std::abs(g[2][1] - g[0][1]);
+    }
+};
+
+// Sobel without the sqrt: max + min / 2 of the absolute gradients, which
+// keeps the maps in the Sobel range (Fixed16 stores it exactly)
+struct FastSobelEnergy {
+    static int twice(int a0, int a1, int a2, int b0, int b2, int c0, int c1, int c2) {
+        const int gx = std::abs((a2 - a0) + 2 * (b2 - b0) + (c2 - c0));
+        const int gy = std::abs((c0 - a0) + 2 * (c1 - a1) + (c2 - a2));
+        return 2 * std::max(gx, gy) + std::min(gx, gy);
+    }
+    static double at(const int (&g)[3][3]) {
+        return 0.5 * twice(g[0][0], g[0][1], g[0][2], g[1][0], g[1][2], g[2][0], g[2][1], g[2][2]);
+    }
+};
+
+// Call fn(K()) with K the kernel of a per-pixel energy function. Saliency
+// weighting is applied to the whole Sobel map afterwards.
+template <typename Fn>
+static auto dispatchEnergyFunction(EnergyFunction function, Fn&& fn) {
+    switch (function) {
+    case EnergyFunction::Scharr: return fn(ScharrEnergy());
+    case EnergyFunction::DualGradient: return fn(DualGradientEnergy());
+    case EnergyFunction::L1Gradient: return fn(L1GradientEnergy());
+    case EnergyFunction::FastSobel: return fn(FastSobelEnergy());
+    case EnergyFunction::Sobel:
+    case EnergyFunction::Saliency:
+    default: return fn(SobelEnergy());
+    }
+}
+
+// Round a magnitude to the element type of an energy map, exactly like the
+// cv::magnitude / convertTo path of calculateEnergyFromGray
+template <typename T>
+static inline T quantizeEnergy(double mag) {
+    return static_cast<T>(mag);
+}
+
+template <>
+inline ushort quantizeEnergy<ushort>(double mag) {
+    return cv::saturate_cast<ushort>(static_cast<float>(mag) * SeamCarver::kFixedEnergyScale);
+}
+
+// Twice a FastSobel value as an energy element, equal to quantizeEnergy
+template <typename T>
+static inline T fastSobelEnergy(int twice) { return static_cast<T>(0.5 * twice); }
+template <>
+inline float fastSobelEnergy<float>(int twice) { return 0.5f * twice; }
+template <>
+inline ushort fastSobelEnergy<ushort>(int twice) {
+    static_assert(SeamCarver::kFixedEnergyScale == 16.0f, "twice * 8 is the Fixed16 value");
+    return static_cast<ushort>(twice * 8);  // at most 3060 * 8, no saturation
+}
+
+// FastSobel row: the interior is one branch-free integer loop over three
+// row pointers, which the compiler vectorises
+template <typename T>
+static inline void fastSobelRow(const cv::Mat& gray, int r, T* out) {
+    const int cols = gray.cols;
+    const uchar* a = gray.ptr<uchar>(reflect101(r - 1, gray.rows));
+    const uchar* b = gray.ptr<uchar>(r);
+    const uchar* c = gray.ptr<uchar>(reflect101(r + 1, gray.rows));
+    auto edge = [&](int j) {
+        const int l = reflect101(j - 1, cols);
+        const int rt = reflect101(j + 1, cols);
+        out[j] = fastSobelEnergy<T>(FastSobelEnergy::twice(a[l], a[j], a[rt], b[l], b[rt], c[l], c[j], c[rt]));
+    };
+    edge(0);
+    for (int j = 1; j < cols - 1; j++) {
+        out[j] = fastSobelEnergy<T>(FastSobelEnergy::twice(a[j - 1], a[j], a[j + 1], b[j - 1], b[j + 1],
+                                                           c[j - 1], c[j], c[j + 1]));
+    }
+    if (cols > 1) edge(cols - 1);
+}
+
+// Energy of gray row r with kernel K into out[0..cols)
+template <typename K, typename T>
+static inline void kernelEnergyRow(const cv::Mat& gray, int r, T* out) {
+    if constexpr (std::is_same<K, FastSobelEnergy>::value) {
+        fastSobelRow(gray, r, out);
+        return;
+    }
+    const int cols = gray.cols;
+    const uchar* rowPtr[3] = {
+        gray.ptr<uchar>(reflect101(r - 1, gray.rows)),
+        gray.ptr<uchar>(r),
+        gray.ptr<uchar>(reflect101(r + 1, gray.rows))
+    };
+    int g[3][3];
+    for (int j = 0; j < cols; j++) {
+        // Only the first and last column need the reflected index
+        const int left = j > 0 ? j - 1 : reflect101(j - 1, cols);
+        const int right = j + 1 < cols ? j + 1 : reflect101(j + 1, cols);
+        for (int dr = 0; dr < 3; dr++) {
+            g[dr][0] = rowPtr[dr][left];
+            g[dr][1] = rowPtr[dr][j];
+            g[dr][2] = rowPtr[dr][right];
+        }
+        out[j] = quantizeEnergy<T>(K::at(g));
+    }
+}
+
+// Energy of gray column c with kernel K into out[0..rows)
+template <typename K, typename T>
+static inline void kernelEnergyColumn(const cv::Mat& gray, int c, T* out) {
+    const int rows = gray.rows;
+    const int col[3] = { reflect101(c - 1, gray.cols), c, reflect101(c + 1, gray.cols) };
+    int g[3][3];
+    for (int i = 0; i < rows; i++) {
+        const uchar* rowPtr[3] = {
+            gray.ptr<uchar>(i > 0 ? i - 1 : reflect101(i - 1, rows)),
+            gray.ptr<uchar>(i),
+            gray.ptr<uchar>(i + 1 < rows ? i + 1 : reflect101(i + 1, rows))
+        };
+        for (int dr = 0; dr < 3; dr++) {
+            for (int dc = 0; dc < 3; dc++) g[dr][dc] = rowPtr[dr][col[dc]];
+        }
+        out[i] = quantizeEnergy<T>(K::at(g));
+    }
+}
+
+// Energy of gray rows [r0, r1) into the same rows of energy (allocated by
+// the caller). The Sobel input gets a one-row halo on each side that is not
+// an image border, so a band matches the full-map result exactly.
+static void energyRows(const cv::Mat& gray, cv::Mat& energy, int r0, int r1,
+                       EnergyPrecision precision, EnergyFunction function) {
+    if (function != EnergyFunction::Sobel && function != EnergyFunction::Saliency) {
+        // Row loop with the kernel inlined; reads its halo rows directly
+        dispatchEnergyFunction(function, [&](auto kernel) {
+            typedef decltype(kernel) K;
+            dispatchEnergyDepth(energy, [&](auto tag) {
+                typedef decltype(tag) T;
+                for (int r = r0; r < r1; r++) {
+                    kernelEnergyRow<K>(gray, r, energy.ptr<T>(r));
+                }
+            });
+        });
+        return;
+    }
+
+    const int h0 = std::max(0, r0 - 1);
+    const int h1 = std::min(gray.rows, r1 + 1);
+    const int gradDepth = gradientDepth(precision);
+    const int border = cv::BORDER_DEFAULT | cv::BORDER_ISOLATED;
+    cv::Mat band = gray.rowRange(h0, h1);
+    cv::Mat sobelX, sobelY, magnitude;
+    cv::Sobel(band, sobelX, gradDepth, 1, 0, 3, 1, 0, border);
+    cv::Sobel(band, sobelY, gradDepth, 0, 1, 3, 1, 0, border);
+    cv::magnitude(sobelX, sobelY, magnitude);
+
+    cv::Mat inner = magnitude.rowRange(r0 - h0, r1 - h0);
+    if (precision == EnergyPrecision::Fixed16) {
+        inner.convertTo(energy.rowRange(r0, r1), CV_16U, SeamCarver::kFixedEnergyScale);
+    } else {
+        inner.copyTo(energy.rowRange(r0, r1));
+    }
+}
+
+void SeamCarver::setEnergyThreads(unsigned threads) {
+    energyThreads = std::max(1u, threads);
+    resizeHelperPool();
+}
+
+void SeamCarver::setDPThreads(unsigned threads) {
+    dpThreads = std::max(1u, threads);
+    resizeHelperPool();
+}
+
+void SeamCarver::setThreadPool(std::shared_ptr<ThreadPool> pool) {
+    sharedPool = pool != nullptr;
+    helperPool = std::move(pool);
+    resizeHelperPool();
+}
+
+void SeamCarver::resizeHelperPool() {
+    if (sharedPool) return;
+    // The calling thread always takes one share of the work itself
+    unsigned helpers = std::max(energyThreads, dpThreads) - 1;
+    if (helpers == 0) {
+        helperPool.reset();
+    } else if (!helperPool || helperPool->size() != helpers) {
+        helperPool = std::make_shared<ThreadPool>(helpers);
+    }
+}
+
+// Run fn(0..count-1) with fn(0) on the calling thread and the rest on
+// pool, each share a span named name in trace (if any). A worker of pool
+// helps with the queued shares while it waits
+template <typename Fn>
+static void runShares(ThreadPool& pool, int count, const Fn& fn, SeamTrace* trace = nullptr,
+                      const char* name = "share") {
+    auto share = [&fn, trace, name](int k) {
+        TraceSpan span(trace, name, "thread");
+        span.arg("share", k);
+        fn(k);
+    };
+    // The queued shares reference share and fn until they are all done
+    std::vector<std::future<void>> pending;
+    std::exception_ptr error;
+    try {
+        for (int k = 1; k < count; k++) {
+            pending.push_back(pool.submit([&share, k] { share(k); }));
+        }
+        share(0);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    pool.waitAll(pending, error);
+}
+
+// Frequency-tuned saliency (Achanta et al. 2009) of a gray plane: distance of
+// the slightly blurred image from its mean intensity, turned into a weight
+// in [1 / (1 + kSaliencyGain), 1] so weighted maps stay in the Sobel range.
+// The gradient map (CV_64F) is scaled by it and stored at the given precision.
+static cv::Mat saliencyWeighted(const cv::Mat& gray, const cv::Mat& gradient, EnergyPrecision precision) {
+    cv::Mat blurred;
+    cv::GaussianBlur(gray, blurred, cv::Size(5, 5), 0, 0, cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
+    const double meanIntensity = cv::mean(gray)[0];
+    const double gain = SeamCarver::kSaliencyGain;
+
+    cv::Mat energy(gray.size(), energyDepth(precision));
+    dispatchEnergyDepth(energy, [&](auto tag) {
+        typedef decltype(tag) T;
+        for (int r = 0; r < gray.rows; r++) {
+            const uchar* b = blurred.ptr<uchar>(r);
+            const double* grad = gradient.ptr<double>(r);
+            T* out = energy.ptr<T>(r);
+            for (int c = 0; c < gray.cols; c++) {
+                double saliency = std::abs(b[c] - meanIntensity) / 255.0;
+                out[c] = quantizeEnergy<T>(grad[c] * (1.0 + gain * saliency) / (1.0 + gain));
+            }
+        }
+    });
+    return energy;
+}
+
+// Sobel energy of gray into energy (gray's size, the precision's depth).
+// sobelX, sobelY and magnitude are the temporaries; OpenCV writes into them
+// in place when they already have the gradient size and depth.
+static void sobelEnergy(const cv::Mat& gray, cv::Mat& energy, EnergyPrecision precision,
+                        cv::Mat& sobelX, cv::Mat& sobelY, cv::Mat& magnitude) {
+    // Apply Sobel filter to get gradients in x and y directions.
+    // Sobel straight from 8-bit input into CV_64F is exact, so there is
+    // no need to convert the plane to double first.
+    // BORDER_ISOLATED keeps the filter from reading past the ROI of a plane
+    // that was carved in place (see removeVerticalSeamInPlace).
+    const int gradDepth = gradientDepth(precision);
+    const int border = cv::BORDER_DEFAULT | cv::BORDER_ISOLATED;
+    cv::Sobel(gray, sobelX, gradDepth, 1, 0, 3, 1, 0, border);  // Gradient in X direction
+    cv::Sobel(gray, sobelY, gradDepth, 0, 1, 3, 1, 0, border);  // Gradient in Y direction
+
+    // Calculate gradient magnitude as energy; Fixed16 quantises it
+    if (precision == EnergyPrecision::Fixed16) {
+        cv::magnitude(sobelX, sobelY, magnitude);
+        magnitude.convertTo(energy, CV_16U, SeamCarver::kFixedEnergyScale);
+    } else {
+        cv::magnitude(sobelX, sobelY, energy);
+    }
+}
+
+cv::Mat SeamCarver::calculateEnergyFromGray(const cv::Mat& gray) {
+    SEAM_PHASE(&phaseStats, Energy);
+    if (energyFunction == EnergyFunction::Saliency) {
+        return saliencyWeighted(gray, gradientEnergy(gray, EnergyPrecision::Double, EnergyFunction::Sobel),
+                                precisionFor(gray));
+    }
+    return gradientEnergy(gray, precisionFor(gray), energyFunction);
+}
+
+cv::Mat SeamCarver::gradientEnergy(const cv::Mat& gray, EnergyPrecision precision, EnergyFunction function) {
+    const int bands = std::min<int>(energyThreads, gray.rows / kMinEnergyBandRows);
+    if (bands > 1) {
+        // Strip-parallel: one row band per thread
+        cv::Mat energy(gray.size(), energyDepth(precision));
+        auto bandStart = [&](int b) { return static_cast<int>(static_cast<long long>(gray.rows) * b / bands); };
+        runShares(*helperPool, bands, [&](int b) {
+            energyRows(gray, energy, bandStart(b), bandStart(b + 1), precision, function);
+        }, phaseStats.trace, "energy band");
+        return energy;
+    }
+    cv::Mat energy(gray.size(), energyDepth(precision));
+    if (function != EnergyFunction::Sobel) {
+        energyRows(gray, energy, 0, gray.rows, precision, function);
+    } else {
+        cv::Mat sobelX, sobelY, magnitude;
+        sobelEnergy(gray, energy, precision, sobelX, sobelY, magnitude);
+    }
+    return energy;
+}
+
+cv::Mat SeamCarver::scratchEnergy(const cv::Mat& gray) {
+    if (energyFunction == EnergyFunction::Saliency ||
+        std::min<int>(energyThreads, gray.rows / kMinEnergyBandRows) > 1) {
+        return calculateEnergyFromGray(gray);
+    }
+    SEAM_PHASE(&phaseStats, Energy);
+    SeamWorkspace& ws = *seamWorkspace;
+    const EnergyPrecision mapPrecision = precisionFor(gray);
+    cv::Mat energy = scratchPlane(ws.energy, gray.rows, gray.cols, energyDepth(mapPrecision));
+    if (energyFunction != EnergyFunction::Sobel) {
+        energyRows(gray, energy, 0, gray.rows, mapPrecision, energyFunction);
+    } else {
+        const int gradDepth = gradientDepth(mapPrecision);
+        cv::Mat sobelX = scratchPlane(ws.gradX, gray.rows, gray.cols, gradDepth);
+        cv::Mat sobelY = scratchPlane(ws.gradY, gray.rows, gray.cols, gradDepth);
+        cv::Mat magnitude = scratchPlane(ws.magnitude, gray.rows, gray.cols, gradDepth);
+        sobelEnergy(gray, energy, mapPrecision, sobelX, sobelY, magnitude);
+    }
+    return energy;
+}
+
+// Gray value of a pixel of format F, as toGray computes it: scaled to 8
+// bits, then BGR(A) weighted with cv::cvtColor's fixed-point weights
+template <typename F>
+static inline int grayAt(const cv::Mat& img, int r, int c) {
+    const typename F::Elem* px = img.ptr<typename F::Elem>(r) + c * F::channels;
+    if (F::channels == 1) {
+        return toByte(px[0]);
+    }
+    return (toByte(px[0]) * 1868 + toByte(px[1]) * 9617 + toByte(px[2]) * 4899 + (1 << 13)) >> 14;
+}
+
+// Kernel K at a single pixel, identical to calculateEnergy
+template <typename K, typename F>
+static double energyAt(const cv::Mat& img, int r, int c) {
+    const int rows = img.rows;
+    const int cols = img.cols;
+    int g[3][3];
+    for (int dr = -1; dr <= 1; ++dr) {
+        int rr = reflect101(r + dr, rows);
+        for (int dc = -1; dc <= 1; ++dc) {
+            g[dr + 1][dc + 1] = grayAt<F>(img, rr, reflect101(c + dc, cols));
+        }
+    }
+    return K::at(g);
+}
+
+// Store a gradient magnitude into an energy map, rounding exactly like
+// calculateEnergy does for the map's precision
+static inline void storeEnergy(cv::Mat& energy, int r, int c, double mag) {
+    switch (energy.depth()) {
+    case CV_32F:
+        energy.at<float>(r, c) = quantizeEnergy<float>(mag);
+        break;
+    case CV_16U:
+        energy.at<ushort>(r, c) = quantizeEnergy<ushort>(mag);
+        break;
+    default:
+        energy.at<double>(r, c) = mag;
+        break;
+    }
+}
+
+// Recompute the energy band around a removed vertical seam in rows
+// [i0, i1). newEnergy must already have the seam removed.
+template <typename K, typename F>
+static void patchVerticalSeamBand(cv::Mat& newEnergy, const cv::Mat& carvedImg,
+                                  const std::vector<int>& seam, int i0, int i1) {
+    int rows = newEnergy.rows;
+    int cols = newEnergy.cols;
+
+    // A pixel keeps its energy unless its 3x3 window straddles the seam in
+    // any of the rows it reads, i.e. columns [min(seam)-1, max(seam)] over
+    // rows i-1..i+1 (seam moves at most one column per row).
+    for (int i = i0; i < i1; i++) {
+        int lo = seam[i];
+        int hi = seam[i];
+        for (int r = std::max(0, i - 1); r <= std::min(rows - 1, i + 1); r++) {
+            lo = std::min(lo, seam[r]);
+            hi = std::max(hi, seam[r]);
+        }
+        lo = std::max(0, lo - 1);
+        hi = std::min(cols - 1, hi);
+
+        for (int j = lo; j <= hi; j++) {
+            storeEnergy(newEnergy, i, j, energyAt<K, F>(carvedImg, i, j));
+        }
+    }
+}
+
+// Horizontal counterpart of patchVerticalSeamBand, in columns [j0, j1)
+template <typename K, typename F>
+static void patchHorizontalSeamBand(cv::Mat& newEnergy, const cv::Mat& carvedImg,
+                                    const std::vector<int>& seam, int j0, int j1) {
+    int rows = newEnergy.rows;
+    int cols = newEnergy.cols;
+
+    // Same band as the vertical case, with rows and columns swapped
+    for (int j = j0; j < j1; j++) {
+        int lo = seam[j];
+        int hi = seam[j];
+        for (int c = std::max(0, j - 1); c <= std::min(cols - 1, j + 1); c++) {
+            lo = std::min(lo, seam[c]);
+            hi = std::max(hi, seam[c]);
+        }
+        lo = std::max(0, lo - 1);
+        hi = std::min(rows - 1, hi);
+
+        for (int i = lo; i <= hi; i++) {
+            storeEnergy(newEnergy, i, j, energyAt<K, F>(carvedImg, i, j));
+        }
+    }
+}
+
+// Patch the energy of the seam's rows (columns) [lo, hi) with a local kernel
+static void patchSeamLines(cv::Mat& energy, const cv::Mat& carvedImg, const std::vector<int>& seam,
+                           bool isVertical, int lo, int hi, EnergyFunction function) {
+    dispatchEnergyFunction(function, [&](auto kernel) {
+        dispatchImageFormat(carvedImg.type(), [&](auto format) {
+            typedef decltype(kernel) K;
+            typedef decltype(format) F;
+            if (isVertical) {
+                patchVerticalSeamBand<K, F>(energy, carvedImg, seam, lo, hi);
+            } else {
+                patchHorizontalSeamBand<K, F>(energy, carvedImg, seam, lo, hi);
+            }
+        });
+    });
+}
+
+// Saliency depends on the image mean, so its map is recomputed in full;
+// the local kernels only patch the band around the seam
+void SeamCarver::patchEnergyAfterSeam(cv::Mat& energy, const cv::Mat& carvedImg,
+                                      const std::vector<int>& seam, bool isVertical) {
+    if (energyFunction == EnergyFunction::Saliency) {
+        energy = calculateEnergy(carvedImg);
+        return;
+    }
+    SEAM_PHASE(&phaseStats, Energy);
+    patchSeamLines(energy, carvedImg, seam, isVertical, 0, isVertical ? energy.rows : energy.cols, energyFunction);
+}
+
+cv::Mat SeamCarver::updateEnergyAfterVerticalSeam(const cv::Mat& energy, const cv::Mat& carvedImg,
+                                                  const std::vector<int>& seam) {
+    // Shift the unaffected energy values exactly like the image pixels
+    cv::Mat newEnergy = removeVerticalSeam(energy, seam);
+    patchEnergyAfterSeam(newEnergy, carvedImg, seam, true);
+    return newEnergy;
+}
+
+cv::Mat SeamCarver::updateEnergyAfterHorizontalSeam(const cv::Mat& energy, const cv::Mat& carvedImg,
+                                                    const std::vector<int>& seam) {
+    cv::Mat newEnergy = removeHorizontalSeam(energy, seam);
+    patchEnergyAfterSeam(newEnergy, carvedImg, seam, false);
+    return newEnergy;
+}
+
+void SeamCarver::updateEnergyAfterVerticalSeamInPlace(cv::Mat& energy, const cv::Mat& carvedImg,
+                                                     const std::vector<int>& seam) {
+    removeVerticalSeamInPlace(energy, seam);
+    patchEnergyAfterSeam(energy, carvedImg, seam, true);
+}
+
+void SeamCarver::updateEnergyAfterHorizontalSeamInPlace(cv::Mat& energy, const cv::Mat& carvedImg,
+                                                       const std::vector<int>& seam) {
+    removeHorizontalSeamInPlace(energy, seam);
+    patchEnergyAfterSeam(energy, carvedImg, seam, false);
+}
+
+// Largest representable cost, used as the out-of-image sentinel
+template <typename Acc>
+static inline Acc costInfinity() {
+    return std::numeric_limits<Acc>::has_infinity
+        ? std::numeric_limits<Acc>::infinity()
+        : std::numeric_limits<Acc>::max();
+}
+
+// Read-only view of an energy map as seam "layers": rows for vertical seams,
+// columns for horizontal seams. Specialising the finders on the direction
+// lets horizontal seams walk the map in place instead of transposing it.
+template <typename T, bool Vertical>
+struct LayerView {
+    const uchar* data;
+    size_t step;
+    int layers;  // seam length
+    int width;   // positions per layer
+
+    explicit LayerView(const cv::Mat& m)
+        : data(m.data), step(m.step),
+          layers(Vertical ? m.rows : m.cols), width(Vertical ? m.cols : m.rows) {}
+
+    T operator()(int layer, int pos) const {
+        return Vertical ? reinterpret_cast<const T*>(data + layer * step)[pos]
+                        : reinterpret_cast<const T*>(data + pos * step)[layer];
+    }
+};
+
+// Fill rows [firstRow, rows) of a padded vertical cost table from the row
+// above:
+//   dp[i][j] = e[i][j] + min(dp[i-1][j-1], dp[i-1][j], dp[i-1][j+1])
+// as whole-row cv::min / cv::add calls, which OpenCV runs through its
+// runtime-dispatched SIMD kernels (AVX2/SSE on x86, NEON on ARM).
+// minPrev holds the row minimum; it is written in place when it already
+// has 1 x cols elements of the cost depth. With a seam step (setSeamStep)
+// above 1 the table has Step sentinels on each side and the minimum runs
+// over all 2 * Step + 1 parents.
+template <int Step = 1>
+static void fillCostRowsVertical(cv::Mat& dp, const cv::Mat& energy, int firstRow, cv::Mat& minPrev) {
+    const int cols = energy.cols;
+    const int accDepth = dp.depth();
+    for (int i = firstRow; i < energy.rows; i++) {
+        cv::Mat prev = dp.row(i - 1);
+        cv::min(prev.colRange(0, cols), prev.colRange(1, cols + 1), minPrev);   // left / up
+        for (int k = 2; k <= 2 * Step; k++) {
+            cv::min(minPrev, prev.colRange(k, cols + k), minPrev);              // right (and wider)
+        }
+        cv::add(energy.row(i), minPrev, dp.row(i).colRange(Step, cols + Step), cv::noArray(), accDepth);
+    }
+}
+
+// Cheapest of the 2 * Step + 1 parents around above[0]
+template <int Step, typename Acc>
+static inline Acc minParent(const Acc* above) {
+    Acc best = std::min(std::min(above[-1], above[0]), above[1]);
+    for (int d = 2; d <= Step; d++) best = std::min(best, std::min(above[-d], above[d]));
+    return best;
+}
+
+// Set the pad sentinel columns on each side of a padded cost table to value
+template <typename Acc>
+static void fillSentinels(cv::Mat& dp, Acc value, int pad = 1) {
+    const int last = dp.cols - 1;
+    for (int i = 0; i < dp.rows; i++) {
+        Acc* row = dp.ptr<Acc>(i);
+        for (int k = 0; k < pad; k++) {
+            row[k] = value;
+            row[last - k] = value;
+        }
+    }
+}
+
+// Forward DP pass: cumulative cost table of the given energy map into dp,
+// a layers x (width + 2 * Step) plane of the cost depth. minPrev is the
+// row minimum of the vertical fill (see fillCostRowsVertical).
+template <typename T, bool Vertical, int Step = 1>
+static void fillCostTableDP(const cv::Mat& energy, cv::Mat& dp, cv::Mat& minPrev) {
+    typedef typename SeamCost<T>::type Acc;
+    const int accDepth = cv::DataType<Acc>::depth;
+    LayerView<T, Vertical> e(energy);
+    int rows = e.layers;
+    int cols = e.width;
+    
+    // The table has Step sentinel columns on each side. The sentinels hold
+    // +inf so the row update needs no border branches: column j of the
+    // image lives at column j+Step of the table. For horizontal seams the table
+    // is stored layer-major (one table row per image column). Every other
+    // entry is written below.
+    fillSentinels(dp, costInfinity<Acc>(), Step);
+    
+    if (Vertical) {
+        // Initialize first row, then fill the table row by row
+        energy.row(0).convertTo(dp.row(0).colRange(Step, cols + Step), accDepth);
+        fillCostRowsVertical<Step>(dp, energy, 1, minPrev);
+    }
+    else {
+        // Same recurrence one image column at a time, reading the energy
+        // column in place
+        Acc* first = dp.ptr<Acc>(0) + Step;
+        for (int j = 0; j < cols; j++) {
+            first[j] = e(0, j);
+        }
+        for (int i = 1; i < rows; i++) {
+            const Acc* prev = dp.ptr<Acc>(i - 1) + Step;
+            Acc* cur = dp.ptr<Acc>(i) + Step;
+            for (int j = 0; j < cols; j++) {
+                cur[j] = e(i, j) + minParent<Step>(prev + j);
+            }
+        }
+    }
+}
+
+// Cost table in its own buffer, for callers that keep or batch it
+template <typename T, bool Vertical>
+static cv::Mat costTableDP(const cv::Mat& energy) {
+    typedef typename SeamCost<T>::type Acc;
+    LayerView<T, Vertical> e(energy);
+    cv::Mat dp(e.layers, e.width + 2, cv::DataType<Acc>::depth);
+    cv::Mat minPrev;
+    fillCostTableDP<T, Vertical>(energy, dp, minPrev);
+    return dp;
+}
+
+// Backtrack the cheapest seam through a padded cost table into seam
+template <typename Acc, int Step = 1>
+static void backtrackDP(const cv::Mat& dp, std::vector<int>& seam) {
+    int rows = dp.rows;
+    int cols = dp.cols - 2 * Step;
+    
+    // Backtrack to find the seam path
+    seam.resize(rows);
+    
+    // Start from minimum energy pixel in last row (seamEndIndex)
+    int j = seamEndIndex(dp.ptr<Acc>(rows - 1) + Step, cols);
+    seam[rows-1] = j;
+    
+    // At each step, find which parent in the previous row led to current position
+    for (int i = rows - 2; i >= 0; i--) {
+        // We're at column j in row i+1
+        // Find which column in row i could have led here
+        // Candidates: j-1 (moved diagonal-right), j (moved down), j+1 (moved diagonal-left)
+        // The sentinels are never smaller than a real neighbour.
+        const Acc* prev = dp.ptr<Acc>(i) + Step;
+        j += seamParentStep<Step>(prev + j);
+        seam[i] = j;
+    }
+}
+
+// Bottom-up counterpart of fillCostTableDP: layer r of dp holds the
+// cheapest cost from layer layers - 1 - r of energy to its last layer
+template <typename T, bool Vertical>
+static void fillCostTableUpDP(const cv::Mat& energy, cv::Mat& dp, cv::Mat& minPrev) {
+    typedef typename SeamCost<T>::type Acc;
+    const int accDepth = cv::DataType<Acc>::depth;
+    LayerView<T, Vertical> e(energy);
+    const int rows = e.layers;
+    const int cols = e.width;
+    fillSentinels(dp, costInfinity<Acc>());
+    if (Vertical) {
+        energy.row(rows - 1).convertTo(dp.row(0).colRange(1, cols + 1), accDepth);
+        for (int r = 1; r < rows; r++) {
+            cv::Mat prev = dp.row(r - 1);
+            cv::min(prev.colRange(0, cols), prev.colRange(1, cols + 1), minPrev);
+            cv::min(minPrev, prev.colRange(2, cols + 2), minPrev);
+            cv::add(energy.row(rows - 1 - r), minPrev, dp.row(r).colRange(1, cols + 1), cv::noArray(), accDepth);
+        }
+    }
+    else {
+        Acc* first = dp.ptr<Acc>(0) + 1;
+        for (int j = 0; j < cols; j++) {
+            first[j] = e(rows - 1, j);
+        }
+        for (int r = 1; r < rows; r++) {
+            const Acc* prev = dp.ptr<Acc>(r - 1) + 1;
+            Acc* cur = dp.ptr<Acc>(r) + 1;
+            for (int j = 0; j < cols; j++) {
+                cur[j] = e(rows - 1 - r, j) + std::min(std::min(prev[j - 1], prev[j]), prev[j + 1]);
+            }
+        }
+    }
+}
+
+// Meet-in-the-middle DP (SeamCarver::setBidirectionalDP): layers
+// [0, upper) filled top-down here and [upper, layers) bottom-up on pool at
+// the same time, joined at the cheapest pixel of layer upper plus its
+// parent above. Needs at least two layers.
+template <typename T, bool Vertical>
+static void seamBidirectionalDP(const cv::Mat& energy, SeamCarver::SeamWorkspace& ws, ThreadPool& pool,
+                                std::vector<int>& seam, SeamCarverStats* stats) {
+    typedef typename SeamCost<T>::type Acc;
+    const int accDepth = cv::DataType<Acc>::depth;
+    const int layers = Vertical ? energy.rows : energy.cols;
+    const int width = Vertical ? energy.cols : energy.rows;
+    const int upper = layers / 2;
+    const int lower = layers - upper;
+    const cv::Mat upperEnergy = Vertical ? energy.rowRange(0, upper) : energy.colRange(0, upper);
+    const cv::Mat lowerEnergy = Vertical ? energy.rowRange(upper, layers) : energy.colRange(upper, layers);
+    cv::Mat top = scratchPlane(ws.costTable, upper, width + 2, accDepth);
+    cv::Mat bottom = scratchPlane(ws.reverseTable, lower, width + 2, accDepth);
+    {
+        SEAM_PHASE(stats, DPForward);
+        runShares(pool, 2, [&](int k) {
+            if (k == 0) fillCostTableDP<T, Vertical>(upperEnergy, top, ws.costRows);
+            else fillCostTableUpDP<T, Vertical>(lowerEnergy, bottom, ws.reverseRows);
+        }, stats ? stats->trace : nullptr, "DP half");
+    }
+    SEAM_PHASE(stats, Backtrack);
+    // Each pixel of layer upper with its parent above (seamParentOffset);
+    // the first cheapest pair wins
+    const Acc* above = top.ptr<Acc>(upper - 1) + 1;
+    const Acc* below = bottom.ptr<Acc>(lower - 1) + 1;
+    int join = 0;
+    Acc best = Acc();
+    for (int j = 0; j < width; j++) {
+        const Acc total = above[j + seamParentOffset(above[j - 1], above[j], above[j + 1])] + below[j];
+        if (j == 0 || total < best) {
+            best = total;
+            join = j;
+        }
+    }
+    seam.resize(layers);
+    seam[upper] = join;
+    int j = join;
+    for (int i = upper - 1; i >= 0; i--) {
+        const Acc* prev = top.ptr<Acc>(i) + 1;
+        j += seamParentOffset(prev[j - 1], prev[j], prev[j + 1]);
+        seam[i] = j;
+    }
+    j = join;
+    for (int i = upper + 1; i < layers; i++) {
+        const Acc* next = bottom.ptr<Acc>(layers - 1 - i) + 1;
+        j += seamParentOffset(next[j - 1], next[j], next[j + 1]);
+        seam[i] = j;
+    }
+}
+
+template <typename T, bool Vertical, int Step = 1>
+static void seamDP(const cv::Mat& energy, SeamCarver::SeamWorkspace& ws, std::vector<int>& seam,
+                   SeamCarverStats* stats) {
+    typedef typename SeamCost<T>::type Acc;
+    const int accDepth = cv::DataType<Acc>::depth;
+    LayerView<T, Vertical> e(energy);
+    cv::Mat dp = scratchPlane(ws.costTable, e.layers, e.width + 2 * Step, accDepth);
+    {
+        SEAM_PHASE(stats, DPForward);
+        cv::Mat minPrev = scratchPlane(ws.costRows, 1, e.width, accDepth);
+        fillCostTableDP<T, Vertical, Step>(energy, dp, minPrev);
+    }
+    SEAM_PHASE(stats, Backtrack);
+    backtrackDP<Acc, Step>(dp, seam);
+}
+
+// Update a vertical cost table after a seam was removed. energy is the map
+// of the carved image. Outside a cone below the seam every entry equals the
+// old one shifted like the pixels: in row i the energy only changed around
+// the seam (columns [min(seam)-1, max(seam)] over rows i-1..i+1), the shift
+// changes which parents a column sees only next to seam[i-1], and a changed
+// entry dirties its three children. The table is shifted in place and just
+// the cone is recomputed; once the cone spans most of the width the
+// remaining rows are filled with the whole-row kernel, its row minimum in
+// the workspace.
+template <typename T>
+static void updateCostTableVertical(cv::Mat& dp, const cv::Mat& energy, const std::vector<int>& seam,
+                                    SeamCarver::SeamWorkspace& ws) {
+    typedef typename SeamCost<T>::type Acc;
+    const int rows = energy.rows;
+    const int cols = energy.cols;
+    const int fullWidth = cols - cols / 4;
+    LayerView<T, true> e(energy);
+
+    // Drop the seam from the padded table: column j lives at j+1, so the
+    // right sentinel slides into its new place with it
+    for (int i = 0; i < rows; i++) {
+        Acc* row = dp.ptr<Acc>(i);
+        std::memmove(row + seam[i] + 1, row + seam[i] + 2, (cols + 1 - seam[i]) * sizeof(Acc));
+    }
+    dp = dp.colRange(0, cols + 2);
+
+    int lo = 0, hi = -1;  // dirty columns of the previous row (empty)
+    for (int i = 0; i < rows; i++) {
+        int a = seam[i];
+        int b = seam[i];
+        for (int r = std::max(0, i - 1); r <= std::min(rows - 1, i + 1); r++) {
+            a = std::min(a, seam[r]);
+            b = std::max(b, seam[r]);
+        }
+        int dlo = a - 2;
+        int dhi = b + 1;
+        if (hi >= lo) {
+            dlo = std::min(dlo, lo - 1);
+            dhi = std::max(dhi, hi + 1);
+        }
+        lo = std::max(0, dlo);
+        hi = std::min(cols - 1, dhi);
+
+        if (i > 0 && hi - lo + 1 >= fullWidth) {
+            cv::Mat minPrev = scratchPlane(ws.costRows, 1, cols, cv::DataType<Acc>::depth);
+            fillCostRowsVertical(dp, energy, i, minPrev);
+            return;
+        }
+
+        Acc* cur = dp.ptr<Acc>(i) + 1;
+        if (i == 0) {
+            for (int j = lo; j <= hi; j++) cur[j] = e(0, j);
+            continue;
+        }
+        const Acc* prev = dp.ptr<Acc>(i - 1) + 1;
+        for (int j = lo; j <= hi; j++) {
+            cur[j] = e(i, j) + std::min(std::min(prev[j - 1], prev[j]), prev[j + 1]);
+        }
+    }
+}
+
+// DP variant that records a -1/0/+1 parent offset per pixel during the
+// forward pass and keeps only two rolling rows of cumulative cost, so the
+// working set is about 1 byte per pixel instead of a full cost table.
+// With a seam step the offsets run from -Step to +Step.
+template <typename T, bool Vertical, int Step = 1>
+static void seamDPBackpointers(const cv::Mat& energy, SeamCarver::SeamWorkspace& ws, std::vector<int>& seam,
+                               SeamCarverStats* stats) {
+    typedef typename SeamCost<T>::type Acc;
+    const int accDepth = cv::DataType<Acc>::depth;
+    LayerView<T, Vertical> e(energy);
+    int rows = e.layers;
+    int cols = e.width;
+
+    // Two padded cost rows (+inf sentinels at both ends) and the offset plane
+    cv::Mat costRows = scratchPlane(ws.costRows, 2, cols + 2 * Step, accDepth);
+    cv::Mat offsets = scratchPlane(ws.offsets, rows, cols, CV_8S);
+    fillSentinels(costRows, costInfinity<Acc>(), Step);
+
+    Acc* prev = costRows.ptr<Acc>(0) + Step;
+    Acc* cur = costRows.ptr<Acc>(1) + Step;
+
+    {
+        SEAM_PHASE(stats, DPForward);
+        for (int j = 0; j < cols; j++) {
+            prev[j] = e(0, j);
+        }
+
+        for (int i = 1; i < rows; i++) {
+            schar* off = offsets.ptr<schar>(i);
+            for (int j = 0; j < cols; j++) {
+                // Same preference as the full-table backtrack: seamParentStep
+                const schar o = static_cast<schar>(seamParentStep<Step>(prev + j));
+                cur[j] = e(i, j) + prev[j + o];
+                off[j] = o;
+            }
+            std::swap(prev, cur);
+        }
+    }
+
+    // Start from minimum cost pixel in last row (first minimum)
+    SEAM_PHASE(stats, Backtrack);
+    seam.resize(rows);
+    int j = seamEndIndex(prev, cols);
+    seam[rows - 1] = j;
+
+    // Follow the stored offsets back up
+    for (int i = rows - 1; i > 0; i--) {
+        j += offsets.at<schar>(i, j);
+        seam[i - 1] = j;
+    }
+}
+
+// fn(std::integral_constant<int, step>) for a seam step of 1..kMaxSeamStep
+template <typename Fn>
+static void dispatchSeamStep(int step, Fn&& fn) {
+    static_assert(SeamCarver::kMaxSeamStep == 3, "dispatchSeamStep covers steps 1 to 3");
+    switch (step) {
+    case 2: fn(std::integral_constant<int, 2>()); break;
+    case 3: fn(std::integral_constant<int, 3>()); break;
+    default: fn(std::integral_constant<int, 1>()); break;
+    }
+}
+
+// Seam into seam, with the tables in ws; stats (may be null) receives the
+// DPForward and Backtrack times. step is the seam step (setSeamStep).
+template <bool Vertical>
+static void findSeamDP(const cv::Mat& energy, DPStorage storage, SeamCarver::SeamWorkspace& ws,
+                       std::vector<int>& seam, SeamCarverStats* stats = nullptr, int step = 1) {
+    dispatchEnergyDepth(energy, [&](auto tag) {
+        typedef decltype(tag) T;
+        dispatchSeamStep(step, [&](auto s) {
+            constexpr int Step = decltype(s)::value;
+            if (storage == DPStorage::Backpointers) {
+                seamDPBackpointers<T, Vertical, Step>(energy, ws, seam, stats);
+            } else {
+                seamDP<T, Vertical, Step>(energy, ws, seam, stats);
+            }
+        });
+    });
+}
+
+// Backward-energy DP with the energy computed layer by layer inside the DP
+// loop: kernel K fills one energy layer, the rolling cost rows and parent
+// offsets are updated from it, and no energy map is ever built. Per pixel
+// the pass reads one gray byte and writes one offset byte, where the map
+// path writes and re-reads a full energy element. Values, costs and
+// tie-breaking match calculateEnergyFromGray + seamDPBackpointers.
+// Storage is the caller's: scratch holds two cost rows of the layer width
+// + 2 * Step and one energy layer, offsets layers x width bytes, and seam
+// one index per layer.
+//
+// The DP over rows x cols energy layers, layer i read from layer(i)
+template <typename T, int Step = 1, typename Layer>
+static void layeredSeamPass(int rows, int cols, const Layer& layer, double* scratch, schar* offsets, int* seam) {
+    typedef typename SeamCost<T>::type Acc;
+    static_assert(sizeof(Acc) <= sizeof(double) && sizeof(T) <= sizeof(double),
+                  "fused DP scratch holds one double per element");
+    // Two padded cost rows with Step +inf sentinels at each end
+    const size_t padded = static_cast<size_t>(cols) + 2 * Step;
+    Acc* prev = reinterpret_cast<Acc*>(scratch) + Step;
+    Acc* cur = reinterpret_cast<Acc*>(scratch + padded) + Step;
+    for (int k = 1; k <= Step; k++) {
+        prev[-k] = prev[cols - 1 + k] = cur[-k] = cur[cols - 1 + k] = costInfinity<Acc>();
+    }
+
+    const T* e = layer(0);
+    for (int j = 0; j < cols; j++) {
+        prev[j] = e[j];
+    }
+    for (int i = 1; i < rows; i++) {
+        e = layer(i);
+        schar* off = offsets + static_cast<size_t>(i) * cols;
+        for (int j = 0; j < cols; j++) {
+            const schar o = static_cast<schar>(seamParentStep<Step>(prev + j));
+            cur[j] = e[j] + prev[j + o];
+            off[j] = o;
+        }
+        std::swap(prev, cur);
+    }
+
+    int j = seamEndIndex(prev, cols);
+    seam[rows - 1] = j;
+    for (int i = rows - 1; i > 0; i--) {
+        j += offsets[static_cast<size_t>(i) * cols + j];
+        seam[i - 1] = j;
+    }
+}
+
+// The fused pass: each layer is computed from gray into the scratch's
+// energy layer, after the two cost rows
+template <typename K, typename T, bool Vertical, int Step = 1>
+static void fusedSeamPass(const cv::Mat& gray, double* scratch, schar* offsets, int* seam) {
+    const int rows = Vertical ? gray.rows : gray.cols;
+    const int cols = Vertical ? gray.cols : gray.rows;
+    T* e = reinterpret_cast<T*>(scratch + 2 * (static_cast<size_t>(cols) + 2 * Step));
+    layeredSeamPass<T, Step>(rows, cols, [&](int i) -> const T* {
+        if (Vertical) {
+            kernelEnergyRow<K>(gray, i, e);
+        } else {
+            kernelEnergyColumn<K>(gray, i, e);
+        }
+        return e;
+    }, scratch, offsets, seam);
+}
+
+// fusedSeamPass on working storage kept by the caller across seams; it
+// only grows
+template <typename K, typename T, bool Vertical, int Step = 1>
+static void seamFusedDP(const cv::Mat& gray, std::vector<double>& scratch, std::vector<schar>& offsets,
+                        std::vector<int>& seam) {
+    const int rows = Vertical ? gray.rows : gray.cols;
+    const int cols = Vertical ? gray.cols : gray.rows;
+    const size_t padded = static_cast<size_t>(cols) + 2 * Step;
+    if (scratch.size() < 2 * padded + cols) scratch.resize(2 * padded + cols);
+    if (offsets.size() < static_cast<size_t>(rows) * cols) offsets.resize(static_cast<size_t>(rows) * cols);
+    seam.resize(rows);
+    fusedSeamPass<K, T, Vertical, Step>(gray, scratch.data(), offsets.data(), seam.data());
+}
+
+template <bool Vertical>
+static void findSeamFusedDP(const cv::Mat& gray, EnergyPrecision precision, EnergyFunction function, int step,
+                            std::vector<double>& scratch, std::vector<schar>& offsets, std::vector<int>& seam) {
+    if (gray.type() != CV_8UC1) {
+        throw std::runtime_error("Fused energy DP needs a CV_8U gray plane (see SeamCarver::toGray).");
+    }
+    dispatchEnergyFunction(function, [&](auto kernel) {
+        typedef decltype(kernel) K;
+        dispatchSeamStep(step, [&](auto s) {
+            constexpr int Step = decltype(s)::value;
+            switch (precision) {
+            case EnergyPrecision::Float: seamFusedDP<K, float, Vertical, Step>(gray, scratch, offsets, seam); break;
+            case EnergyPrecision::Fixed16: seamFusedDP<K, ushort, Vertical, Step>(gray, scratch, offsets, seam); break;
+            case EnergyPrecision::Double:
+            default: seamFusedDP<K, double, Vertical, Step>(gray, scratch, offsets, seam); break;
+            }
+        });
+    });
+}
+
+std::vector<int> SeamCarver::findVerticalSeamFusedDP(const cv::Mat& gray) {
+    std::vector<int> seam;
+    findVerticalSeamFusedDP(gray, seam);
+    return seam;
+}
+
+void SeamCarver::findVerticalSeamFusedDP(const cv::Mat& gray, std::vector<int>& seam) {
+    if (energyFunction == EnergyFunction::Saliency) {
+        findVerticalSeamDP(calculateEnergyFromGray(gray), seam);
+        return;
+    }
+    SEAM_PHASE(&phaseStats, DPForward);
+    findSeamFusedDP<true>(gray, precisionFor(gray), energyFunction, seamStep, fusedScratch, fusedOffsets, seam);
+}
+
+std::vector<int> SeamCarver::findHorizontalSeamFusedDP(const cv::Mat& gray) {
+    std::vector<int> seam;
+    findHorizontalSeamFusedDP(gray, seam);
+    return seam;
+}
+
+void SeamCarver::findHorizontalSeamFusedDP(const cv::Mat& gray, std::vector<int>& seam) {
+    if (energyFunction == EnergyFunction::Saliency) {
+        findHorizontalSeamDP(calculateEnergyFromGray(gray), seam);
+        return;
+    }
+    SEAM_PHASE(&phaseStats, DPForward);
+    findSeamFusedDP<false>(gray, precisionFor(gray), energyFunction, seamStep, fusedScratch, fusedOffsets, seam);
+}
+
+// Up to k pixel-disjoint seams from a single cumulative cost table. Last-layer
+// pixels are tried in order of increasing cost; each backtrack follows the
+// cheapest parent not taken by an earlier seam (same preference as seamDP)
+// and is dropped if it gets boxed in. The first seam is the optimal one.
+// step(i, j, p) is the transition cost from (i, p) to (i + 1, j) that the
+// table added on top of the predecessor's cost.
+template <typename Acc, typename Step>
+static std::vector<std::vector<int>> seamsFromCostTable(const cv::Mat& dp, int k, const Step& step) {
+    int rows = dp.rows;
+    int cols = dp.cols - 2;
+
+    std::vector<std::vector<int>> seams;
+    if (k <= 0) {
+        return seams;
+    }
+
+    const Acc* lastRow = dp.ptr<Acc>(rows - 1) + 1;
+    std::vector<int> order(cols);
+    for (int j = 0; j < cols; j++) order[j] = j;
+    std::stable_sort(order.begin(), order.end(),
+                     [lastRow](int a, int b) { return lastRow[a] < lastRow[b]; });
+
+    std::vector<uchar> used(static_cast<size_t>(rows) * cols, 0);
+    std::vector<int> seam(rows);
+    for (int start : order) {
+        if (static_cast<int>(seams.size()) == k) break;
+        if (used[static_cast<size_t>(rows - 1) * cols + start]) continue;
+
+        int j = start;
+        seam[rows - 1] = j;
+        bool ok = true;
+        for (int i = rows - 2; i >= 0 && ok; i--) {
+            const Acc* prev = dp.ptr<Acc>(i) + 1;
+            const uchar* taken = used.data() + static_cast<size_t>(i) * cols;
+            int bestJ = -1;
+            const int candidates[3] = { j, j - 1, j + 1 };  // up, left, right
+            Acc best = Acc(0);
+            for (int c : candidates) {
+                if (c < 0 || c >= cols || taken[c]) continue;
+                Acc cost = prev[c] + step(i, j, c);
+                if (bestJ < 0 || cost < best) {
+                    bestJ = c;
+                    best = cost;
+                }
+            }
+            ok = bestJ >= 0;
+            j = bestJ;
+            seam[i] = j;
+        }
+        if (!ok) continue;
+
+        for (int i = 0; i < rows; i++) {
+            used[static_cast<size_t>(i) * cols + seam[i]] = 1;
+        }
+        seams.push_back(seam);
+    }
+    return seams;
+}
+
+template <typename T, bool Vertical>
+static std::vector<std::vector<int>> seamsDPBatch(const cv::Mat& energy, int k) {
+    typedef typename SeamCost<T>::type Acc;
+    // A pixel's own energy does not depend on the parent the path came from
+    return seamsFromCostTable<Acc>(costTableDP<T, Vertical>(energy), k,
+                                   [](int, int, int) { return Acc(0); });
+}
+
+// Forward energy (Rubinstein, Shamir and Avidan 2008): instead of the energy
+// of the removed pixel, a step costs the intensity differences of the pixels
+// that become neighbours once it is gone. The costs are read from the gray
+// plane inside the DP update, so no energy or cost planes are built.
+// Outside the image a neighbour is replaced by the pixel itself.
+template <bool Vertical>
+struct ForwardEnergyCost {
+    LayerView<uchar, Vertical> g;
+
+    explicit ForwardEnergyCost(const cv::Mat& gray) : g(gray) {}
+
+    // Cost of entering (i, j) from (i - 1, p), p in j-1..j+1
+    int operator()(int i, int j, int p) const {
+        int left = g(i, j > 0 ? j - 1 : j);
+        int right = g(i, j + 1 < g.width ? j + 1 : j);
+        int cost = std::abs(right - left);
+        if (p < j) cost += std::abs(g(i - 1, j) - left);
+        else if (p > j) cost += std::abs(g(i - 1, j) - right);
+        return cost;
+    }
+};
+
+// Padded cost table of the forward-energy seams (CV_32S, layers x
+// (width + 2)) into dp. The sentinels are large enough to lose every
+// comparison without overflowing when a step cost is added.
+template <bool Vertical>
+static void fillCostTableForward(const cv::Mat& gray, cv::Mat& dp) {
+    ForwardEnergyCost<Vertical> cost(gray);
+    const int rows = cost.g.layers;
+    const int cols = cost.g.width;
+    fillSentinels(dp, std::numeric_limits<int>::max() / 2);
+
+    int* first = dp.ptr<int>(0) + 1;
+    for (int j = 0; j < cols; j++) {
+        first[j] = 0;
+    }
+    for (int i = 1; i < rows; i++) {
+        const int* prev = dp.ptr<int>(i - 1) + 1;
+        int* cur = dp.ptr<int>(i) + 1;
+        for (int j = 0; j < cols; j++) {
+            // Same three terms as ForwardEnergyCost, sharing the up cost
+            int left = cost.g(i, j > 0 ? j - 1 : j);
+            int right = cost.g(i, j + 1 < cols ? j + 1 : j);
+            int above = cost.g(i - 1, j);
+            int up = std::abs(right - left);
+            cur[j] = std::min(std::min(prev[j - 1] + up + std::abs(above - left), prev[j] + up),
+                              prev[j + 1] + up + std::abs(above - right));
+        }
+    }
+}
+
+template <bool Vertical>
+static cv::Mat costTableForward(const cv::Mat& gray) {
+    LayerView<uchar, Vertical> g(gray);
+    cv::Mat dp(g.layers, g.width + 2, CV_32S);
+    fillCostTableForward<Vertical>(gray, dp);
+    return dp;
+}
+
+template <bool Vertical>
+static cv::Mat forwardGray(const cv::Mat& gray) {
+    if (gray.type() != CV_8UC1) {
+        throw std::runtime_error("Forward energy needs a CV_8U gray plane (see SeamCarver::toGray).");
+    }
+    return gray;
+}
+
+template <bool Vertical>
+static void seamForwardDP(const cv::Mat& gray, SeamCarver::SeamWorkspace& ws, std::vector<int>& seam,
+                          SeamCarverStats* stats) {
+    ForwardEnergyCost<Vertical> cost(forwardGray<Vertical>(gray));
+    cv::Mat dp = scratchPlane(ws.costTable, cost.g.layers, cost.g.width + 2, CV_32S);
+    {
+        SEAM_PHASE(stats, DPForward);
+        fillCostTableForward<Vertical>(gray, dp);
+    }
+    SEAM_PHASE(stats, Backtrack);
+    const int rows = dp.rows;
+    const int cols = dp.cols - 2;
+
+    seam.resize(rows);
+    const int* last = dp.ptr<int>(rows - 1) + 1;
+    int j = seamEndIndex(last, cols);
+    seam[rows - 1] = j;
+    // Same tie-breaking as backtrackDP (seamParentOffset)
+    const int none = std::numeric_limits<int>::max();
+    for (int i = rows - 1; i > 0; i--) {
+        const int* prev = dp.ptr<int>(i - 1) + 1;
+        j += seamParentOffset(j > 0 ? prev[j - 1] + cost(i, j, j - 1) : none, prev[j] + cost(i, j, j),
+                              j + 1 < cols ? prev[j + 1] + cost(i, j, j + 1) : none);
+        seam[i - 1] = j;
+    }
+}
+
+template <bool Vertical>
+static std::vector<std::vector<int>> seamsForwardDP(const cv::Mat& gray, int k) {
+    ForwardEnergyCost<Vertical> cost(forwardGray<Vertical>(gray));
+    return seamsFromCostTable<int>(costTableForward<Vertical>(gray), k,
+                                   [&cost](int i, int j, int p) { return cost(i + 1, j, p); });
+}
+
+std::vector<int> SeamCarver::findVerticalSeamForwardDP(const cv::Mat& gray) {
+    std::vector<int> seam;
+    findVerticalSeamForwardDP(gray, seam);
+    return seam;
+}
+
+void SeamCarver::findVerticalSeamForwardDP(const cv::Mat& gray, std::vector<int>& seam) {
+    seamForwardDP<true>(gray, *seamWorkspace, seam, &phaseStats);
+}
+
+std::vector<int> SeamCarver::findHorizontalSeamForwardDP(const cv::Mat& gray) {
+    std::vector<int> seam;
+    findHorizontalSeamForwardDP(gray, seam);
+    return seam;
+}
+
+void SeamCarver::findHorizontalSeamForwardDP(const cv::Mat& gray, std::vector<int>& seam) {
+    seamForwardDP<false>(gray, *seamWorkspace, seam, &phaseStats);
+}
+
+// Batches count their table fill and all backtracks as DPForward
+std::vector<std::vector<int>> SeamCarver::findVerticalSeamsForwardDP(const cv::Mat& gray, int k) {
+    SEAM_PHASE(&phaseStats, DPForward);
+    return seamsForwardDP<true>(gray, k);
+}
+
+std::vector<std::vector<int>> SeamCarver::findHorizontalSeamsForwardDP(const cv::Mat& gray, int k) {
+    SEAM_PHASE(&phaseStats, DPForward);
+    return seamsForwardDP<false>(gray, k);
+}
+
+std::vector<std::vector<int>> SeamCarver::findVerticalSeamsDP(const cv::Mat& energy, int k) {
+    SEAM_PHASE(&phaseStats, DPForward);
+    return dispatchEnergyDepth(energy, [&](auto tag) {
+        return seamsDPBatch<decltype(tag), true>(energy, k);
+    });
+}
+
+std::vector<std::vector<int>> SeamCarver::findHorizontalSeamsDP(const cv::Mat& energy, int k) {
+    SEAM_PHASE(&phaseStats, DPForward);
+    return dispatchEnergyDepth(energy, [&](auto tag) {
+        return seamsDPBatch<decltype(tag), false>(energy, k);
+    });
+}
+
+// Entry points for the cost table kept across seams by resizeImage
+static cv::Mat verticalCostTable(const cv::Mat& energy) {
+    return dispatchEnergyDepth(energy, [&](auto tag) {
+        return costTableDP<decltype(tag), true>(energy);
+    });
+}
+
+static void backtrackCostTable(const cv::Mat& dp, const cv::Mat& energy, std::vector<int>& seam) {
+    dispatchEnergyDepth(energy, [&](auto tag) {
+        backtrackDP<typename SeamCost<decltype(tag)>::type>(dp, seam);
+    });
+}
+
+static void updateVerticalCostTable(cv::Mat& dp, const cv::Mat& energy, const std::vector<int>& seam,
+                                    SeamCarver::SeamWorkspace& ws) {
+    dispatchEnergyDepth(energy, [&](auto tag) {
+        updateCostTableVertical<decltype(tag)>(dp, energy, seam, ws);
+    });
+}
+
+// Multithreaded fill of rows [firstRow, rows) of a padded vertical cost
+// table. The columns are split into one chunk per thread and the rows are
+// processed in tiles of up to kDPTileRows rows, with two synchronisation
+// points per tile instead of one per row:
+//  1. each chunk fills a trapezoid that loses one column per row at its
+//     inner edges, so it needs nothing from its neighbours;
+//  2. the inverted triangles left at the inner chunk edges are filled from
+//     the trapezoid rows on both sides.
+// Every entry is computed with the same recurrence as the serial fill.
+template <typename T>
+static void fillCostRowsParallel(cv::Mat& dp, const cv::Mat& energy, int firstRow,
+                                 ThreadPool& pool, int chunks, SeamTrace* trace) {
+    typedef typename SeamCost<T>::type Acc;
+    const int rows = energy.rows;
+    const int cols = energy.cols;
+    LayerView<T, true> e(energy);
+
+    std::vector<int> edge(chunks + 1);  // chunk k covers [edge[k], edge[k+1])
+    for (int k = 0; k <= chunks; k++) {
+        edge[k] = static_cast<int>(static_cast<long long>(cols) * k / chunks);
+    }
+    // Triangles of neighbouring edges must not meet
+    const int tileRows = std::max(1, std::min(SeamCarver::kDPTileRows, (cols / chunks) / 2));
+
+    auto fillRow = [&](int i, int lo, int hi) {
+        const Acc* prev = dp.ptr<Acc>(i - 1) + 1;
+        Acc* cur = dp.ptr<Acc>(i) + 1;
+        for (int j = lo; j < hi; j++) {
+            cur[j] = e(i, j) + std::min(std::min(prev[j - 1], prev[j]), prev[j + 1]);
+        }
+    };
+
+    for (int top = firstRow; top < rows; top += tileRows) {
+        const int bottom = std::min(rows, top + tileRows);
+        runShares(pool, chunks, [&](int k) {
+            for (int i = top; i < bottom; i++) {
+                int t = i - top;
+                fillRow(i, k == 0 ? 0 : edge[k] + t, k == chunks - 1 ? cols : edge[k + 1] - t);
+            }
+        }, trace, "DP trapezoid");
+        runShares(pool, chunks - 1, [&](int k) {
+            const int b = edge[k + 1];
+            for (int i = top + 1; i < bottom; i++) {
+                int t = i - top;
+                fillRow(i, b - t, b + t);
+            }
+        }, trace, "DP triangle");
+    }
+}
+
+std::vector<int> SeamCarver::findVerticalSeamDP(const cv::Mat& energy) {
+    std::vector<int> seam;
+    findVerticalSeamDP(energy, seam);
+    return seam;
+}
+
+void SeamCarver::findVerticalSeamDP(const cv::Mat& energy, std::vector<int>& seam) {
+    // Wider seam steps take the single-threaded DP
+    const int chunks = seamStep == 1 ? std::min<int>(dpThreads, energy.cols / kMinDPChunkColumns) : 1;
+    if (seamStep == 1 && bidirectionalDP && dpThreads > 1 && chunks < 3 && energy.rows > 1) {
+        dispatchEnergyDepth(energy, [&](auto tag) {
+            seamBidirectionalDP<decltype(tag), true>(energy, *seamWorkspace, *helperPool, seam, &phaseStats);
+        });
+        return;
+    }
+    if (chunks > 1 && energy.rows > 1) {
+        dispatchEnergyDepth(energy, [&](auto tag) {
+            typedef decltype(tag) T;
+            typedef typename SeamCost<T>::type Acc;
+            const int accDepth = cv::DataType<Acc>::depth;
+            cv::Mat dp = scratchPlane(seamWorkspace->costTable, energy.rows, energy.cols + 2, accDepth);
+            {
+                SEAM_PHASE(&phaseStats, DPForward);
+                fillSentinels(dp, costInfinity<Acc>());
+                energy.row(0).convertTo(dp.row(0).colRange(1, energy.cols + 1), accDepth);
+                fillCostRowsParallel<T>(dp, energy, 1, *helperPool, chunks, phaseStats.trace);
+            }
+            SEAM_PHASE(&phaseStats, Backtrack);
+            backtrackDP<Acc>(dp, seam);
+        });
+        return;
+    }
+    findSeamDP<true>(energy, dpStorage, *seamWorkspace, seam, &phaseStats, seamStep);
+}
+
+template <typename T, bool Vertical, int Step = 1>
+static void seamGreedy(const cv::Mat& energy, std::vector<int>& seam) {
+    LayerView<T, Vertical> e(energy);
+    int rows = e.layers;
+    int cols = e.width;
+    
+    seam.resize(rows);
+    
+    // Start from minimum energy pixel in first row (first minimum wins)
+    int j = 0;
+    for (int c = 1; c < cols; c++) {
+        if (e(0, c) < e(0, j)) j = c;
+    }
+    seam[0] = j;
+    
+    // Greedy selection: at each row, choose minimum among 3 neighbors
+    for (int i = 1; i < rows; i++) {
+        T minEnergy = e(i, j);
+        int minJ = j;
+        
+        // Check diagonal-left
+        if (j > 0) {
+            T leftEnergy = e(i, j-1);
+            if (leftEnergy < minEnergy) {
+                minEnergy = leftEnergy;
+                minJ = j - 1;
+            }
+        }
+        
+        // Check diagonal-right
+        if (j < cols - 1) {
+            T rightEnergy = e(i, j+1);
+            if (rightEnergy < minEnergy) {
+                minEnergy = rightEnergy;
+                minJ = j + 1;
+            }
+        }
+        
+        // Farther neighbours with a seam step, nearer ones first
+        for (int d = 2; d <= Step; d++) {
+            if (j - d >= 0 && e(i, j - d) < minEnergy) {
+                minEnergy = e(i, j - d);
+                minJ = j - d;
+            }
+            if (j + d < cols && e(i, j + d) < minEnergy) {
+                minEnergy = e(i, j + d);
+                minJ = j + d;
+            }
+        }
+        
+        j = minJ;
+        seam[i] = j;
+    }
+}
+
+// Greedy walks from `starts` columns of the first layer at once: the start
+// columns are the minima of equal strata of the first layer, so the plain
+// greedy start is always among them. The walks advance in lockstep, one
+// layer for all lanes per step, which keeps the per-layer loop branch-light
+// and vectorisable. The cheapest whole walk wins (first lane on ties).
+template <typename T, bool Vertical>
+static std::vector<int> seamGreedyMultiStart(const cv::Mat& energy, int starts) {
+    typedef typename SeamCost<T>::type Acc;
+    LayerView<T, Vertical> e(energy);
+    const int layers = e.layers;
+    const int cols = e.width;
+    const int lanes = std::min(starts, cols);
+
+    std::vector<int> paths(static_cast<size_t>(layers) * lanes);  // paths[i * lanes + l]
+    std::vector<Acc> cost(lanes);
+    for (int l = 0; l < lanes; l++) {
+        const int lo = static_cast<int>(static_cast<long long>(cols) * l / lanes);
+        const int hi = static_cast<int>(static_cast<long long>(cols) * (l + 1) / lanes);
+        int j = lo;
+        for (int c = lo + 1; c < hi; c++) {
+            if (e(0, c) < e(0, j)) j = c;
+        }
+        paths[l] = j;
+        cost[l] = e(0, j);
+    }
+
+    for (int i = 1; i < layers; i++) {
+        const int* prev = &paths[static_cast<size_t>(i - 1) * lanes];
+        int* cur = &paths[static_cast<size_t>(i) * lanes];
+        for (int l = 0; l < lanes; l++) {
+            // Same choice as seamGreedy: centre, then strictly lower left, then right
+            const int j = prev[l];
+            int minJ = j;
+            T minEnergy = e(i, j);
+            if (j > 0 && e(i, j - 1) < minEnergy) { minJ = j - 1; minEnergy = e(i, j - 1); }
+            if (j < cols - 1 && e(i, j + 1) < minEnergy) { minJ = j + 1; minEnergy = e(i, j + 1); }
+            cur[l] = minJ;
+            cost[l] += minEnergy;
+        }
+    }
+
+    const int best = static_cast<int>(std::min_element(cost.begin(), cost.end()) - cost.begin());
+    std::vector<int> seam(layers);
+    for (int i = 0; i < layers; i++) seam[i] = paths[static_cast<size_t>(i) * lanes + best];
+    return seam;
+}
+
+// Beam search over greedy walks: every layer keeps the `width` cheapest
+// partial seams, at most one per column, and extends each by its three
+// neighbours. Ties go to the lower cost, then the lower column.
+template <typename T, bool Vertical>
+static std::vector<int> seamBeam(const cv::Mat& energy, int width) {
+    typedef typename SeamCost<T>::type Acc;
+    LayerView<T, Vertical> e(energy);
+    const int layers = e.layers;
+    const int cols = e.width;
+    width = std::min(width, cols);
+
+    struct Node {
+        Acc cost;
+        int col;
+        int parent;  // index into the previous layer's beam
+    };
+    auto cheaper = [](const Node& a, const Node& b) {
+        return a.cost < b.cost || (a.cost == b.cost && a.col < b.col);
+    };
+
+    // nodes[i * width + k] = k-th partial seam of layer i
+    std::vector<Node> nodes(static_cast<size_t>(layers) * width);
+    std::vector<Node> candidates;
+    candidates.reserve(std::max(cols, 3 * width));
+    for (int c = 0; c < cols; c++) {
+        candidates.push_back({ static_cast<Acc>(e(0, c)), c, -1 });
+    }
+    auto keepBest = [&](Node* beam) {
+        std::partial_sort(candidates.begin(), candidates.begin() + width, candidates.end(), cheaper);
+        std::copy(candidates.begin(), candidates.begin() + width, beam);
+    };
+    keepBest(nodes.data());
+    int beamSize = width;
+
+    for (int i = 1; i < layers; i++) {
+        const Node* prev = &nodes[static_cast<size_t>(i - 1) * width];
+        candidates.clear();
+        for (int k = 0; k < beamSize; k++) {
+            for (int c = std::max(0, prev[k].col - 1); c <= std::min(cols - 1, prev[k].col + 1); c++) {
+                candidates.push_back({ prev[k].cost + e(i, c), c, k });
+            }
+        }
+        // One partial seam per column: the rest could only follow it
+        std::sort(candidates.begin(), candidates.end(), [&](const Node& a, const Node& b) {
+            return a.col < b.col || (a.col == b.col && cheaper(a, b));
+        });
+        candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                                     [](const Node& a, const Node& b) { return a.col == b.col; }),
+                         candidates.end());
+        const int kept = std::min<int>(width, static_cast<int>(candidates.size()));
+        std::partial_sort(candidates.begin(), candidates.begin() + kept, candidates.end(), cheaper);
+        std::copy(candidates.begin(), candidates.begin() + kept, &nodes[static_cast<size_t>(i) * width]);
+        beamSize = kept;
+    }
+
+    std::vector<int> seam(layers);
+    int k = 0;  // the final beam is sorted, so its first seam is the cheapest
+    for (int i = layers - 1; i >= 0; i--) {
+        const Node& node = nodes[static_cast<size_t>(i) * width + k];
+        seam[i] = node.col;
+        k = node.parent;
+    }
+    return seam;
+}
+
+// Greedy seam of the carver's settings into seam. Only the plain walk
+// reuses seam's storage and follows the seam step; beams and multiple
+// starts keep per-call buffers.
+template <bool Vertical>
+static void findSeamGreedy(const cv::Mat& energy, int beamWidth, int starts, int step, std::vector<int>& seam) {
+    dispatchEnergyDepth(energy, [&](auto tag) {
+        typedef decltype(tag) T;
+        if (beamWidth > 1) seam = seamBeam<T, Vertical>(energy, beamWidth);
+        else if (starts > 1) seam = seamGreedyMultiStart<T, Vertical>(energy, starts);
+        else dispatchSeamStep(step, [&](auto s) { seamGreedy<T, Vertical, decltype(s)::value>(energy, seam); });
+    });
+}
+
+std::vector<int> SeamCarver::findVerticalSeamGreedy(const cv::Mat& energy) {
+    std::vector<int> seam;
+    findVerticalSeamGreedy(energy, seam);
+    return seam;
+}
+
+void SeamCarver::findVerticalSeamGreedy(const cv::Mat& energy, std::vector<int>& seam) {
+    SEAM_PHASE(&phaseStats, DPForward);
+    findSeamGreedy<true>(energy, greedyBeamWidth, greedyStarts, seamStep, seam);
+}
+
+std::vector<int> SeamCarver::findHorizontalSeamDP(const cv::Mat& energy) {
+    std::vector<int> seam;
+    findHorizontalSeamDP(energy, seam);
+    return seam;
+}
+
+void SeamCarver::findHorizontalSeamDP(const cv::Mat& energy, std::vector<int>& seam) {
+    if (seamStep == 1 && bidirectionalDP && dpThreads > 1 && energy.cols > 1) {
+        dispatchEnergyDepth(energy, [&](auto tag) {
+            seamBidirectionalDP<decltype(tag), false>(energy, *seamWorkspace, *helperPool, seam, &phaseStats);
+        });
+        return;
+    }
+    // Walk the energy map column by column, no transpose
+    findSeamDP<false>(energy, dpStorage, *seamWorkspace, seam, &phaseStats, seamStep);
+}
+
+bool SeamCarver::findCheapestSeamDP(const cv::Mat& energy, int verticalLeft, int horizontalLeft,
+                                    std::vector<int>& seam) {
+    if (horizontalLeft <= 0) {
+        findVerticalSeamDP(energy, seam);
+        return true;
+    }
+    if (verticalLeft <= 0) {
+        findHorizontalSeamDP(energy, seam);
+        return false;
+    }
+    // The helper pool is sized for the energy and DP threads; the second
+    // search needs just one worker, which any pool has
+    if (!helperPool) helperPool = std::make_shared<ThreadPool>(1);
+    if (!crossWorkspace) {
+        crossWorkspace = std::make_unique<SeamWorkspace>();
+        crossWorkspace->place(bufferPlacement);
+    }
+
+    TraceSpan span(phaseStats.trace, "cheapest seam", "seam");
+    std::vector<int> horizontal;
+    std::vector<std::future<void>> across;
+    across.push_back(helperPool->submit([&] {
+        findSeamDP<false>(energy, dpStorage, *crossWorkspace, horizontal, nullptr, seamStep);
+    }));
+    // The helper reads energy and writes horizontal until it is done
+    std::exception_ptr error;
+    try {
+        findSeamDP<true>(energy, dpStorage, *seamWorkspace, seam, &phaseStats, seamStep);
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    helperPool->waitAll(across, error);
+
+    const double vCost = seamEnergy(energy, seam, true);
+    const double hCost = seamEnergy(energy, horizontal, false);
+    if (vCost * horizontalLeft <= hCost * verticalLeft) return true;
+    seam.swap(horizontal);
+    return false;
+}
+
+std::vector<int> SeamCarver::findHorizontalSeamGreedy(const cv::Mat& energy) {
+    std::vector<int> seam;
+    findHorizontalSeamGreedy(energy, seam);
+    return seam;
+}
+
+void SeamCarver::findHorizontalSeamGreedy(const cv::Mat& energy, std::vector<int>& seam) {
+    SEAM_PHASE(&phaseStats, DPForward);
+    findSeamGreedy<false>(energy, greedyBeamWidth, greedyStarts, seamStep, seam);
+}
+
+// DP recurrence restricted to a corridor: layer i only holds positions
+// [lo[i], lo[i] + n) around centre[i]. Positions outside the corridor are
+// +inf. Returns an empty seam if the corridor does not connect top to bottom.
+template <typename T, bool Vertical>
+static std::vector<int> corridorSeamDP(const cv::Mat& energy, const std::vector<int>& centre, int radius) {
+    typedef typename SeamCost<T>::type Acc;
+    LayerView<T, Vertical> e(energy);
+    const int layers = e.layers;
+    const int n = std::min(2 * radius + 1, e.width);
+    const Acc inf = costInfinity<Acc>();
+
+    std::vector<int> lo(layers);
+    for (int i = 0; i < layers; i++) {
+        lo[i] = std::max(0, std::min(centre[i] - radius, e.width - n));
+    }
+    std::vector<Acc> cost(static_cast<size_t>(layers) * n);
+    auto layer = [&](int i) { return cost.data() + static_cast<size_t>(i) * n; };
+
+    for (int k = 0; k < n; k++) {
+        layer(0)[k] = e(0, lo[0] + k);
+    }
+    for (int i = 1; i < layers; i++) {
+        const Acc* prev = layer(i - 1);
+        Acc* cur = layer(i);
+        const int shift = lo[i] - lo[i - 1];  // prev index of cur[k] is k + shift
+        for (int k = 0; k < n; k++) {
+            Acc best = inf;
+            for (int d = -1; d <= 1; d++) {
+                int pk = k + shift + d;
+                if (pk >= 0 && pk < n) best = std::min(best, prev[pk]);
+            }
+            cur[k] = best == inf ? inf : static_cast<Acc>(e(i, lo[i] + k) + best);
+        }
+    }
+
+    // Backtrack with the same tie-breaking as backtrackDP
+    const Acc* last = layer(layers - 1);
+    int k = seamEndIndex(last, n);
+    if (last[k] == inf) return {};
+    std::vector<int> seam(layers);
+    int j = lo[layers - 1] + k;
+    seam[layers - 1] = j;
+    for (int i = layers - 2; i >= 0; i--) {
+        const Acc* prev = layer(i);
+        auto at = [&](int col) {
+            int pk = col - lo[i];
+            return pk >= 0 && pk < n ? prev[pk] : inf;
+        };
+        j += seamParentOffset(j > 0 ? at(j - 1) : inf, at(j), j + 1 < e.width ? at(j + 1) : inf);
+        seam[i] = j;
+    }
+    return seam;
+}
+
+// Coarse-to-fine seam search: the energy map is averaged down by 2 per level
+// (CV_32F), the coarsest level is solved with the full DP, and each finer
+// level reruns the DP only inside a corridor around the upsampled seam.
+template <bool Vertical>
+static std::vector<int> findSeamPyramid(const cv::Mat& energy, int levels, int radius, DPStorage storage,
+                                        SeamCarver::SeamWorkspace& ws) {
+    auto fullDP = [&](const cv::Mat& map) {
+        std::vector<int> seam;
+        findSeamDP<Vertical>(map, storage, ws, seam);
+        return seam;
+    };
+    const int minWidth = 4 * radius;
+    std::vector<cv::Mat> pyramid;  // pyramid[l] is 2^(l+1) times smaller than energy
+    cv::Mat level = energy;
+    for (int l = 0; l < levels; l++) {
+        int width = Vertical ? level.cols : level.rows;
+        int layers = Vertical ? level.rows : level.cols;
+        if (width / 2 < minWidth || layers / 2 < 2) break;
+        cv::Mat src = level;
+        if (src.depth() != CV_32F) level.convertTo(src, CV_32F);
+        cv::Mat down;
+        cv::resize(src, down, cv::Size((src.cols + 1) / 2, (src.rows + 1) / 2), 0, 0, cv::INTER_AREA);
+        pyramid.push_back(down);
+        level = down;
+    }
+    if (pyramid.empty()) return fullDP(energy);
+
+    std::vector<int> seam = fullDP(pyramid.back());
+    for (int l = static_cast<int>(pyramid.size()) - 2; l >= -1; l--) {
+        const cv::Mat& coarse = pyramid[l + 1];
+        const cv::Mat& fine = l >= 0 ? pyramid[l] : energy;
+        const int coarseLayers = Vertical ? coarse.rows : coarse.cols;
+        const int coarseWidth = Vertical ? coarse.cols : coarse.rows;
+        const int fineLayers = Vertical ? fine.rows : fine.cols;
+        const int fineWidth = Vertical ? fine.cols : fine.rows;
+
+        // Centre of the fine span covered by each coarse seam pixel
+        std::vector<int> centre(fineLayers);
+        for (int i = 0; i < fineLayers; i++) {
+            int c = seam[std::min(coarseLayers - 1, i * coarseLayers / fineLayers)];
+            centre[i] = std::min(fineWidth - 1, (2 * c + 1) * fineWidth / (2 * coarseWidth));
+        }
+        seam = dispatchEnergyDepth(fine, [&](auto tag) {
+            return corridorSeamDP<decltype(tag), Vertical>(fine, centre, radius);
+        });
+        if (seam.empty()) return fullDP(energy);
+    }
+    return seam;
+}
+
+std::vector<int> SeamCarver::findVerticalSeamPyramid(const cv::Mat& energy) {
+    SEAM_PHASE(&phaseStats, DPForward);
+    return findSeamPyramid<true>(energy, pyramidLevels, pyramidCorridor, dpStorage, *seamWorkspace);
+}
+
+std::vector<int> SeamCarver::findHorizontalSeamPyramid(const cv::Mat& energy) {
+    SEAM_PHASE(&phaseStats, DPForward);
+    return findSeamPyramid<false>(energy, pyramidLevels, pyramidCorridor, dpStorage, *seamWorkspace);
+}
+
+std::vector<int> SeamCarver::findVerticalSeamInCorridor(const cv::Mat& energy, const std::vector<int>& centre,
+                                                        int radius) {
+    std::vector<int> seam;
+    if (static_cast<int>(centre.size()) == energy.rows && radius > 0) {
+        SEAM_PHASE(&phaseStats, DPForward);
+        seam = dispatchEnergyDepth(energy, [&](auto tag) {
+            return corridorSeamDP<decltype(tag), true>(energy, centre, radius);
+        });
+    }
+    if (seam.empty()) findVerticalSeamDP(energy, seam);
+    return seam;
+}
+
+std::vector<int> SeamCarver::findHorizontalSeamInCorridor(const cv::Mat& energy, const std::vector<int>& centre,
+                                                          int radius) {
+    std::vector<int> seam;
+    if (static_cast<int>(centre.size()) == energy.cols && radius > 0) {
+        SEAM_PHASE(&phaseStats, DPForward);
+        seam = dispatchEnergyDepth(energy, [&](auto tag) {
+            return corridorSeamDP<decltype(tag), false>(energy, centre, radius);
+        });
+    }
+    if (seam.empty()) findHorizontalSeamDP(energy, seam);
+    return seam;
+}
+
+cv::Mat SeamCarver::costTable(const cv::Mat& energy, bool isVertical) const {
+    return dispatchEnergyDepth(energy, [&](auto tag) {
+        typedef decltype(tag) T;
+        // Drop the sentinel columns; horizontal tables are stored one
+        // image column per row
+        cv::Mat table;
+        if (isVertical) {
+            table = costTableDP<T, true>(energy).colRange(1, energy.cols + 1).clone();
+        } else {
+            const cv::Mat dp = costTableDP<T, false>(energy);
+            cv::transpose(dp.colRange(1, energy.rows + 1), table);
+        }
+        return table;
+    });
+}
+
+double SeamCarver::seamEnergy(const cv::Mat& energy, const std::vector<int>& seam, bool isVertical) const {
+    return dispatchEnergyDepth(energy, [&](auto tag) {
+        typedef decltype(tag) T;
+        double total = 0.0;
+        for (int i = 0; i < static_cast<int>(seam.size()); i++) {
+            total += isVertical ? energy.at<T>(i, seam[i]) : energy.at<T>(seam[i], i);
+        }
+        return total;
+    });
+}
+
+// Min-priority queues for the Dijkstra seam search. All share the interface
+// clear / push / empty / pop and keep their storage between searches.
+
+// Binary heap over std::vector, any cost type
+template <typename Acc>
+struct BinaryHeapQueue {
+    struct Node {
+        int v;
+        Acc d;
+        bool operator<(const Node& o) const { return d > o.d; } // min-heap
+    };
+    std::vector<Node> heap;
+
+    void clear() { heap.clear(); }
+    bool empty() const { return heap.empty(); }
+    void push(int v, Acc d) {
+        heap.push_back({ v, d });
+        std::push_heap(heap.begin(), heap.end());
+    }
+    void pop(int& v, Acc& d) {
+        std::pop_heap(heap.begin(), heap.end());
+        v = heap.back().v;
+        d = heap.back().d;
+        heap.pop_back();
+    }
+};
+
+// Dial's bucket queue for integer costs. Dijkstra pops in non-decreasing
+// order and every edge weight fits a ushort (Fixed16 energy), so all queued
+// keys lie in [cursor, cursor + 65535] and a ring of 65536 buckets suffices.
+struct BucketQueue {
+    static constexpr int kBuckets = 1 << 16;
+    std::vector<std::vector<int>> ring;
+    int cursor = 0;
+    size_t count = 0;
+
+    void clear() {
+        if (ring.empty()) {
+            ring.resize(kBuckets);
+        }
+        if (count != 0) {
+            for (std::vector<int>& b : ring) b.clear();
+        }
+        cursor = 0;
+        count = 0;
+    }
+    bool empty() const { return count == 0; }
+    void push(int v, int d) {
+        ring[d & (kBuckets - 1)].push_back(v);
+        ++count;
+    }
+    void pop(int& v, int& d) {
+        while (ring[cursor & (kBuckets - 1)].empty()) ++cursor;
+        std::vector<int>& b = ring[cursor & (kBuckets - 1)];
+        v = b.back();
+        b.pop_back();
+        d = cursor;
+        --count;
+    }
+};
+
+// Radix heap for non-negative integer costs: keys are binned by the highest
+// bit in which they differ from the last popped key, and a bin is only
+// redistributed when everything below it is empty.
+struct RadixQueue {
+    struct Node {
+        int v;
+        unsigned d;
+    };
+    std::vector<Node> bins[33];
+    unsigned last = 0;
+    size_t count = 0;
+
+    static int binOf(unsigned x) {
+        int n = 0;
+        while (x) { x >>= 1; ++n; }
+        return n;
+    }
+    void clear() {
+        for (std::vector<Node>& b : bins) b.clear();
+        last = 0;
+        count = 0;
+    }
+    bool empty() const { return count == 0; }
+    void push(int v, int d) {
+        bins[binOf(static_cast<unsigned>(d) ^ last)].push_back({ v, static_cast<unsigned>(d) });
+        ++count;
+    }
+    void pop(int& v, int& d) {
+        if (bins[0].empty()) {
+            int i = 1;
+            while (bins[i].empty()) ++i;
+            unsigned newLast = bins[i][0].d;
+            for (const Node& n : bins[i]) newLast = std::min(newLast, n.d);
+            last = newLast;
+            for (const Node& n : bins[i]) bins[binOf(n.d ^ last)].push_back(n);
+            bins[i].clear();
+        }
+        v = bins[0].back().v;
+        d = static_cast<int>(bins[0].back().d);
+        bins[0].pop_back();
+        --count;
+    }
+};
+
+// Parent links of the graph seam search. Every edge goes down one layer
+// and at most one position sideways, so a parent is set as the offset dc
+// of its position from the child's: node v of a layer width wide has
+// parent v - width + dc. get returns -1 for the source.
+
+// Node id per pixel (GraphStorage::Full)
+struct NodeParents {
+    std::vector<int> ids;
+
+    void reset(size_t nodes) { ids.resize(nodes); }
+    void setSource(int v) { ids[v] = -1; }
+    void set(int v, int width, int dc) { ids[v] = v - width + dc; }
+    int get(int v, int width) const { (void)width; return ids[v]; }
+};
+
+// 2-bit codes dc + 1, four pixels per byte, 3 for the source
+// (GraphStorage::Compact)
+struct PackedParents {
+    std::vector<uint8_t> codes;
+
+    void reset(size_t nodes) { codes.resize((nodes + 3) / 4); }
+    void setSource(int v) { store(v, 3); }
+    void set(int v, int width, int dc) { (void)width; store(v, dc + 1); }
+    int get(int v, int width) const {
+        const int code = (codes[v >> 2] >> ((v & 3) * 2)) & 3;
+        return code == 3 ? -1 : v - width + code - 1;
+    }
+
+private:
+    void store(int v, int code) {
+        uint8_t& b = codes[v >> 2];
+        const int shift = (v & 3) * 2;
+        b = static_cast<uint8_t>((b & ~(3 << shift)) | (code << shift));
+    }
+};
+
+// Reusable buffers for one run of the graph seam search
+template <typename Acc, typename Parents>
+struct DijkstraBuffers {
+    typedef Acc Cost;
+    std::vector<Acc> dist;
+    Parents parents;
+    std::vector<Acc> remaining;  // A*: lower bound of the layers below each layer
+    std::vector<int> marks;      // label repair: row each column was listed for
+    BinaryHeapQueue<Acc> heap;
+};
+
+// Distance type of the compact node state: floating point distances are
+// kept as float (4-byte distances and 8-byte heap entries)
+template <typename Acc> struct CompactCost { typedef Acc type; };
+template <> struct CompactCost<double> { typedef float type; };
+
+// Graph search buffers kept by SeamCarver across calls, one set per cost
+// type and node state, so a seam search reuses last call's allocations
+struct SeamCarver::GraphWorkspace {
+    std::tuple<DijkstraBuffers<double, NodeParents>, DijkstraBuffers<float, NodeParents>,
+               DijkstraBuffers<int, NodeParents>, DijkstraBuffers<float, PackedParents>,
+               DijkstraBuffers<int, PackedParents>> buffers;
+    BucketQueue bucket;
+    RadixQueue radix;
+
+    template <typename Acc, typename Parents>
+    DijkstraBuffers<Acc, Parents>& get() { return std::get<DijkstraBuffers<Acc, Parents>>(buffers); }
+
+    // Call fn(buffers) with the buffers of energy cost type Acc in storage
+    template <typename Acc, typename Fn>
+    void with(GraphStorage storage, Fn&& fn) {
+        if (storage == GraphStorage::Compact) fn(get<typename CompactCost<Acc>::type, PackedParents>());
+        else fn(get<Acc, NodeParents>());
+    }
+};
+
+// Edge weights of the seam graph. Entering pixel (layer, to) from
+// (layer-1, from) costs the energy of the entered pixel; the virtual source
+// reaches the first layer at the energy of each pixel. Solvers only see this
+// interface, so costs that depend on the edge (e.g. forward energy) can be
+// plugged in without touching them.
+template <typename T, bool Vertical>
+struct PixelEnergyCost {
+    LayerView<T, Vertical> e;
+
+    explicit PixelEnergyCost(const cv::Mat& energy) : e(energy) {}
+    int layers() const { return e.layers; }
+    int width() const { return e.width; }
+    T source(int pos) const { return e(0, pos); }
+    T edge(int layer, int from, int to) const { (void)from; return e(layer, to); }
+    // Cheapest edge into layer (a bound for A*)
+    T lowest(int layer) const {
+        T m = e(layer, 0);
+        for (int pos = 1; pos < e.width; pos++) m = std::min(m, e(layer, pos));
+        return m;
+    }
+};
+
+// Walk the parent links back from the chosen last-layer pixel into seam.
+// Leaves seam empty if the links do not form one pixel per layer.
+template <typename Parents>
+static void tracePath(const Parents& parents, int last, int layers, int width, std::vector<int>& seam) {
+    seam.resize(layers);
+    int cur = last;
+    for (int r = layers - 1; r >= 0; --r) {
+        if (cur < 0 || cur / width != r) {
+            seam.clear();
+            return;
+        }
+        seam[r] = cur % width;
+        cur = parents.get(cur, width);
+    }
+}
+
+// Whether a path of cost nd from the parent at offset dc should replace
+// v's label: it is cheaper, or as cheap through a parent seamParentOffset
+// prefers. The parents then follow the DP's tie-breaking once every
+// parent on a cheapest path has been relaxed.
+template <typename Acc, typename Parents>
+static inline bool betterLabel(Acc nd, Acc current, const Parents& parents, int v, int width, int dc) {
+    if (nd < current) return true;
+    return nd == current && seamParentRank(dc) < seamParentRank(parents.get(v, width) - (v - width));
+}
+
+// Graph-based seam: Dijkstra shortest path on a layered pixel graph.
+// The graph is implicit: the neighbours of pixel (r, c) are (r+1, c-1..c+1),
+// a virtual source feeds the top row and every bottom-row pixel reaches the
+// virtual sink at no extra cost. Popping the first bottom-row pixel
+// therefore settles the sink. The search goes on through the keys equal to
+// the sink's, so every pixel of every cheapest seam relaxes its children
+// and the seam ends at the first cheapest bottom pixel: the same seam as
+// the DP's on the same costs (seamParentOffset).
+// Leaves seam empty if no valid path was found.
+// With aStar the queue is keyed by distance plus remaining[layer], the sum
+// of the cheapest edge into every later layer. Each edge costs at least its
+// layer's cheapest, so the bound is consistent: keys still pop in
+// non-decreasing order (the integer queues stay valid, since a key grows by
+// at most one edge weight) and the first bottom-row pixel popped is optimal.
+// The bounds are stored less that of layer 0, which orders the keys the
+// same but starts them at the top-row costs, as without the bound.
+template <typename Acc, typename Parents, typename Cost, typename Queue>
+static void seamDijkstra(const Cost& cost, DijkstraBuffers<Acc, Parents>& buf, Queue& pq, std::vector<int>& seam,
+                         bool aStar = false) {
+    const int rows = cost.layers();
+    const int cols = cost.width();
+    const int numPixels = rows * cols;
+
+    const Acc INF = costInfinity<Acc>();
+    buf.dist.assign(numPixels, INF);
+    buf.parents.reset(numPixels);
+    buf.remaining.assign(rows, Acc(0));
+    pq.clear();
+
+    std::vector<Acc>& dist = buf.dist;
+    Parents& parents = buf.parents;
+    std::vector<Acc>& remaining = buf.remaining;
+    if (aStar) {
+        for (int r = rows - 2; r >= 0; --r) {
+            remaining[r] = remaining[r + 1] + static_cast<Acc>(cost.lowest(r + 1));
+        }
+        const Acc first = remaining[0];
+        for (Acc& b : remaining) b -= first;
+    }
+
+    // Source edges: top row pixels start at their own cost
+    for (int c = 0; c < cols; ++c) {
+        dist[c] = cost.source(c);
+        parents.setSource(c);
+        pq.push(c, dist[c] + remaining[0]);
+    }
+
+    int last = -1;
+    Acc sinkKey = INF;
+    while (!pq.empty()) {
+        int u;
+        Acc key;
+        pq.pop(u, key);
+        if (last != -1 && key > sinkKey) break;  // every tie is settled
+
+        int r = u / cols;
+        int c = u - r * cols;
+        // Stale entry: u was reached more cheaply after it was queued
+        if (key > dist[u] + remaining[r]) continue;
+        const Acc du = dist[u];
+        if (r == rows - 1) {
+            // Sink reached through this pixel; ties go to the first column
+            if (last == -1 || u < last) last = u;
+            sinkKey = key;
+            continue;
+        }
+
+        // Edges to the next row (downwards, 3-connected)
+        int c0 = std::max(c - 1, 0);
+        int c1 = std::min(c + 1, cols - 1);
+        for (int nc = c0; nc <= c1; ++nc) {
+            int v = u + cols + (nc - c);
+            Acc nd = du + static_cast<Acc>(cost.edge(r + 1, c, nc));
+            if (betterLabel(nd, dist[v], parents, v, cols, c - nc)) {
+                const bool cheaper = nd < dist[v];
+                dist[v] = nd;
+                parents.set(v, cols, c - nc);
+                if (cheaper) pq.push(v, nd + remaining[r + 1]);
+            }
+        }
+    }
+
+    if (last == -1) {
+        seam.clear();
+        return;
+    }
+    tracePath(parents, last, rows, cols, seam);
+}
+
+// Same graph solved by relaxing the layers in topological order. The seam
+// graph is a layered DAG, so one pass over the edges finds every shortest
+// distance without a priority queue. Every parent is relaxed, so the
+// parents and the sink follow seamParentOffset exactly.
+template <typename Acc, typename Parents, typename Cost>
+static void seamDagRelaxation(const Cost& cost, DijkstraBuffers<Acc, Parents>& buf, std::vector<int>& seam) {
+    const int rows = cost.layers();
+    const int cols = cost.width();
+    const int numPixels = rows * cols;
+
+    buf.dist.assign(numPixels, costInfinity<Acc>());
+    buf.parents.reset(numPixels);
+    Acc* dist = buf.dist.data();
+    Parents& parents = buf.parents;
+
+    for (int c = 0; c < cols; ++c) {
+        dist[c] = cost.source(c);
+        parents.setSource(c);
+    }
+
+    for (int r = 0; r < rows - 1; ++r) {
+        const Acc* du = dist + r * cols;
+        Acc* dv = dist + (r + 1) * cols;
+        const int next = (r + 1) * cols;
+        for (int c = 0; c < cols; ++c) {
+            int c0 = std::max(c - 1, 0);
+            int c1 = std::min(c + 1, cols - 1);
+            for (int nc = c0; nc <= c1; ++nc) {
+                Acc nd = du[c] + static_cast<Acc>(cost.edge(r + 1, c, nc));
+                if (betterLabel(nd, dv[nc], parents, next + nc, cols, c - nc)) {
+                    dv[nc] = nd;
+                    parents.set(next + nc, cols, c - nc);
+                }
+            }
+        }
+    }
+
+    // Sink: cheapest last-layer pixel (first one on ties)
+    int lastCol = seamEndIndex(dist + (rows - 1) * cols, cols);
+    tracePath(parents, (rows - 1) * cols + lastCol, rows, cols, seam);
+}
+
+// Vertical seam from the labels of a carve's previous search, repaired
+// after removed was carved out of energy instead of searched from scratch.
+// buf.dist must hold every pixel's distance from the source in the
+// uncarved layout (seamDagRelaxation leaves them so; the early-exit
+// searches do not). The labels are shifted like the pixels, and only
+// labels that can have changed are recomputed: new seeds where the energy
+// or the parents changed (the same columns as updateCostTableVertical),
+// plus the children of every label that did change. Unlike the cost table
+// cone, the repair stops wherever a recomputed label comes out equal.
+// Once a row has most of its width to recompute, the rest of the rows are
+// relaxed in full. The seam is then traced from the labels with the
+// tie-breaking of seamParentOffset, which seamDagRelaxation's parents follow.
+template <typename T, typename Acc, typename Parents>
+static void repairSeamGraphLabels(const cv::Mat& energy, DijkstraBuffers<Acc, Parents>& buf,
+                                  const std::vector<int>& removed, std::vector<int>& seam) {
+    const int rows = energy.rows;
+    const int cols = energy.cols;
+    const int fullWidth = cols - cols / 4;
+    LayerView<T, true> e(energy);
+
+    // Row i moves from i * (cols + 1) to i * cols, never past its source
+    Acc* dist = buf.dist.data();
+    for (int i = 0; i < rows; i++) {
+        const Acc* from = dist + i * (cols + 1);
+        Acc* to = dist + i * cols;
+        std::memmove(to, from, removed[i] * sizeof(Acc));
+        std::memmove(to + removed[i], from + removed[i] + 1, (cols - removed[i]) * sizeof(Acc));
+    }
+    buf.dist.resize(static_cast<size_t>(rows) * cols);
+    dist = buf.dist.data();
+
+    // stamp[j] == i: column j is already listed for row i
+    std::vector<int>& stamp = buf.marks;
+    stamp.assign(cols, -1);
+    std::vector<int> todo, next;
+    auto list = [&](std::vector<int>& out, int row, int j) {
+        if (j < 0 || j >= cols || stamp[j] == row) return;
+        stamp[j] = row;
+        out.push_back(j);
+    };
+
+    int firstFull = rows;
+    for (int i = 0; i < rows; i++) {
+        int a = removed[i];
+        int b = removed[i];
+        for (int r = std::max(0, i - 1); r <= std::min(rows - 1, i + 1); r++) {
+            a = std::min(a, removed[r]);
+            b = std::max(b, removed[r]);
+        }
+        for (int j = a - 2; j <= b + 1; j++) list(todo, i, j);
+        if (i > 0 && static_cast<int>(todo.size()) >= fullWidth) {
+            firstFull = i;
+            break;
+        }
+
+        Acc* cur = dist + i * cols;
+        const Acc* prev = cur - cols;
+        next.clear();
+        for (int j : todo) {
+            Acc d = static_cast<Acc>(e(i, j));
+            if (i > 0) {
+                Acc m = prev[j];
+                if (j > 0) m = std::min(m, prev[j - 1]);
+                if (j + 1 < cols) m = std::min(m, prev[j + 1]);
+                d += m;
+            }
+            if (d != cur[j]) {
+                cur[j] = d;
+                if (i + 1 < rows) {
+                    list(next, i + 1, j - 1);
+                    list(next, i + 1, j);
+                    list(next, i + 1, j + 1);
+                }
+            }
+        }
+        todo.swap(next);
+    }
+    for (int i = firstFull; i < rows; i++) {
+        Acc* cur = dist + i * cols;
+        const Acc* prev = cur - cols;
+        for (int j = 0; j < cols; j++) {
+            Acc m = prev[j];
+            if (j > 0) m = std::min(m, prev[j - 1]);
+            if (j + 1 < cols) m = std::min(m, prev[j + 1]);
+            cur[j] = static_cast<Acc>(e(i, j)) + m;
+        }
+    }
+
+    int c = seamEndIndex(dist + (rows - 1) * cols, cols);
+    seam.resize(rows);
+    seam[rows - 1] = c;
+    const Acc inf = costInfinity<Acc>();
+    for (int i = rows - 1; i > 0; i--) {
+        const Acc* prev = dist + (i - 1) * cols;
+        c += seamParentOffset(c > 0 ? prev[c - 1] : inf, prev[c], c + 1 < cols ? prev[c + 1] : inf);
+        seam[i - 1] = c;
+    }
+}
+
+template <bool Vertical>
+static void findSeamGraphCut(const cv::Mat& energy, GraphSolver solver, GraphQueue queue, GraphStorage storage,
+                             SeamCarver::GraphWorkspace& ws, std::vector<int>& seam) {
+    dispatchEnergyDepth(energy, [&](auto tag) {
+        typedef decltype(tag) T;
+        PixelEnergyCost<T, Vertical> cost(energy);
+        ws.with<typename SeamCost<T>::type>(storage, [&](auto& buf) {
+            typedef typename std::decay_t<decltype(buf)>::Cost Acc;
+            if (solver == GraphSolver::DagRelaxation) {
+                seamDagRelaxation(cost, buf, seam);
+                return;
+            }
+            // Monotone integer queues need integer costs; others use the heap
+            const bool aStar = solver == GraphSolver::AStar;
+            if constexpr (std::is_same<Acc, int>::value) {
+                if (queue == GraphQueue::Bucket) return seamDijkstra(cost, buf, ws.bucket, seam, aStar);
+                if (queue == GraphQueue::Radix) return seamDijkstra(cost, buf, ws.radix, seam, aStar);
+            }
+            seamDijkstra(cost, buf, buf.heap, seam, aStar);
+        });
+    });
+}
+
+std::vector<int> SeamCarver::findVerticalSeamGraphCut(const cv::Mat& energy) {
+    std::vector<int> seam;
+    findVerticalSeamGraphCut(energy, seam);
+    return seam;
+}
+
+void SeamCarver::findVerticalSeamGraphCut(const cv::Mat& energy, std::vector<int>& seam) {
+    {
+        SEAM_PHASE(&phaseStats, DPForward);
+        findSeamGraphCut<true>(energy, graphSolver, graphQueue, graphStorage, *graphWorkspace, seam);
+    }
+    if (seam.empty()) {
+        // Fallback: if for some reason the graph search failed, use DP seam
+        TraceSpan span(phaseStats.trace, "graph fallback to DP", "seam");
+        findVerticalSeamDP(energy, seam);
+    }
+}
+
+std::vector<int> SeamCarver::findHorizontalSeamGraphCut(const cv::Mat& energy) {
+    std::vector<int> seam;
+    findHorizontalSeamGraphCut(energy, seam);
+    return seam;
+}
+
+void SeamCarver::findVerticalSeamGraphLabels(const cv::Mat& energy, const std::vector<int>& removed,
+                                              std::vector<int>& seam) {
+    SEAM_PHASE(&phaseStats, DPForward);
+    dispatchEnergyDepth(energy, [&](auto tag) {
+        typedef decltype(tag) T;
+        graphWorkspace->with<typename SeamCost<T>::type>(graphStorage, [&](auto& buf) {
+            if (removed.empty()) {
+                seamDagRelaxation(PixelEnergyCost<T, true>(energy), buf, seam);
+            } else {
+                repairSeamGraphLabels<T>(energy, buf, removed, seam);
+            }
+        });
+    });
+}
+
+// Horizontal seam: same layered graph with image columns as layers
+void SeamCarver::findHorizontalSeamGraphCut(const cv::Mat& energy, std::vector<int>& seam) {
+    {
+        SEAM_PHASE(&phaseStats, DPForward);
+        findSeamGraphCut<false>(energy, graphSolver, graphQueue, graphStorage, *graphWorkspace, seam);
+    }
+    if (seam.empty()) {
+        TraceSpan span(phaseStats.trace, "graph fallback to DP", "seam");
+        findHorizontalSeamDP(energy, seam);
+    }
+}
+
+// Copy-on-write for the working planes of a carve: plane starts as a header
+// of source, which must not change, and gets its own copy before the first
+// in-place removal
+static void detachPlane(cv::Mat& plane, const cv::Mat& source) {
+    if (plane.data == source.data) plane = source.clone();
+}
+
+// Replace every non-empty plane by its transpose. Used to run a horizontal
+// carving phase as vertical seams over transposed planes.
+static void transposePlanes(std::initializer_list<cv::Mat*> planes, MemoryStats& memory) {
+    for (cv::Mat* plane : planes) {
+        if (plane->empty()) continue;
+        cv::Mat transposed;
+        cv::transpose(*plane, transposed);
+        memory.transposeBytes += plane->total() * plane->elemSize();
+        *plane = transposed;
+    }
+}
+
+static size_t planeBytes(const cv::Mat& plane) {
+    return plane.total() * plane.elemSize();
+}
+
+// Bytes an in-place removal of seams moves: on every line the kept pixels
+// past the first removed one shift towards it
+static uint64_t shiftedBytes(const cv::Mat& plane, const std::vector<std::vector<int>>& seams, bool vertical) {
+    if (seams.empty()) return 0;
+    const int length = vertical ? plane.cols : plane.rows;
+    const int k = static_cast<int>(seams.size());
+    uint64_t pixels = 0;
+    for (size_t i = 0; i < seams[0].size(); i++) {
+        int first = length;
+        for (const std::vector<int>& s : seams) first = std::min(first, s[i]);
+        pixels += std::max(0, length - first - k);
+    }
+    return pixels * plane.elemSize();
+}
+
+static uint64_t shiftedBytes(const cv::Mat& plane, const std::vector<int>& seam, bool vertical) {
+    const int length = vertical ? plane.cols : plane.rows;
+    uint64_t pixels = 0;
+    for (int s : seam) pixels += std::max(0, length - 1 - s);
+    return pixels * plane.elemSize();
+}
+
+
+// Seam removal kernels for one pixel format. For the image formats
+// F::size() is a constant, so the per-pixel copies compile to a single
+// load and store and the row shifts to a memmove of known element size.
+// Interleaved pixels move as whole runs of bytes, so the image stays
+// interleaved: carving B, G and R as separate planes takes three copies
+// per run (seam_bench RemoveVerticalSeam vs RemoveVerticalSeam/Planar, and
+// the horizontal pair), and the energy is computed from the gray plane
+// anyway.
+template <typename F>
+static void removeVerticalSeamCopy(const cv::Mat& img, cv::Mat& out, const std::vector<int>& seam, F format) {
+    const size_t es = format.size();
+    for (int i = 0; i < img.rows; i++) {
+        const uchar* src = img.ptr<uchar>(i);
+        uchar* dst = out.ptr<uchar>(i);
+        const size_t left = seam[i] * es;
+        // Pixels before the seam, then the ones after it
+        std::memcpy(dst, src, left);
+        std::memcpy(dst + left, src + left + es, (img.cols - 1 - seam[i]) * es);
+    }
+}
+
+template <typename F>
+static void removeHorizontalSeamCopy(const cv::Mat& img, cv::Mat& out, const std::vector<int>& seam, F format) {
+    const size_t es = format.size();
+    const int cols = img.cols;
+    // Row i of the result takes row i above the seam and row i + 1 at or
+    // below it; each run of columns on one side is a single copy
+    for (int i = 0; i < out.rows; i++) {
+        const uchar* above = img.ptr<uchar>(i);
+        const uchar* below = img.ptr<uchar>(i + 1);
+        uchar* dst = out.ptr<uchar>(i);
+        int j = 0;
+        while (j < cols) {
+            const bool shifted = seam[j] <= i;
+            int runStart = j;
+            while (j < cols && (seam[j] <= i) == shifted) {
+                j++;
+            }
+            std::memcpy(dst + runStart * es, (shifted ? below : above) + runStart * es, (j - runStart) * es);
+        }
+    }
+}
+
+// In-place removal from rows [r0, r1)
+template <typename F>
+static void removeVerticalSeamShift(cv::Mat& img, const std::vector<int>& seam, F format, int r0, int r1) {
+    const size_t es = format.size();
+    const int cols = img.cols;
+    for (int i = r0; i < r1; i++) {
+        int seamCol = seam[i];
+        
+        // Shift the pixels after the seam one position left
+        if (seamCol < cols - 1) {
+            uchar* row = img.ptr<uchar>(i);
+            std::memmove(row + seamCol * es, row + (seamCol + 1) * es, (cols - 1 - seamCol) * es);
+        }
+    }
+}
+
+// In-place removal from columns [c0, c1)
+template <typename F>
+static void removeHorizontalSeamShift(cv::Mat& img, const std::vector<int>& seam, F format, int c0, int c1) {
+    const size_t es = format.size();
+    const int rows = img.rows;
+    const int cols = c1;
+    int minRow = *std::min_element(seam.begin() + c0, seam.begin() + c1);
+    
+    // Walk rows top to bottom so each copy is a contiguous run within a row:
+    // in row i every column whose seam is at or above i takes the pixel below.
+    for (int i = minRow; i < rows - 1; i++) {
+        uchar* dst = img.ptr<uchar>(i);
+        const uchar* src = img.ptr<uchar>(i + 1);
+        int j = c0;
+        while (j < cols) {
+            if (seam[j] > i) {
+                j++;
+                continue;
+            }
+            int runStart = j;
+            while (j < cols && seam[j] <= i) {
+                j++;
+            }
+            std::memcpy(dst + runStart * es, src + runStart * es, (j - runStart) * es);
+        }
+    }
+}
+
+template <typename F>
+static void removeVerticalSeamsShift(cv::Mat& img, const std::vector<std::vector<int>>& seams, F format) {
+    const size_t es = format.size();
+    const int cols = img.cols;
+    const int k = static_cast<int>(seams.size());
+    std::vector<int> removed(k);
+    
+    for (int i = 0; i < img.rows; i++) {
+        for (int s = 0; s < k; s++) removed[s] = seams[s][i];
+        std::sort(removed.begin(), removed.end());
+        
+        // Close each gap in one pass: the run between the s-th and (s+1)-th
+        // removed pixel moves left by s+1
+        uchar* row = img.ptr<uchar>(i);
+        for (int s = 0; s < k; s++) {
+            int runStart = removed[s] + 1;
+            int runEnd = (s + 1 < k) ? removed[s + 1] : cols;
+            if (runEnd > runStart) {
+                std::memmove(row + (runStart - s - 1) * es, row + runStart * es, (runEnd - runStart) * es);
+            }
+        }
+    }
+}
+
+// Copying counterpart of removeVerticalSeamsShift: each row of out is the
+// runs of src between its sorted removed pixels
+template <typename F>
+static void removeVerticalSeamsCopy(const cv::Mat& src, cv::Mat& out, const std::vector<std::vector<int>>& seams,
+                                    F format) {
+    const size_t es = format.size();
+    const int k = static_cast<int>(seams.size());
+    std::vector<int> removed(k);
+    
+    for (int i = 0; i < src.rows; i++) {
+        for (int s = 0; s < k; s++) removed[s] = seams[s][i];
+        std::sort(removed.begin(), removed.end());
+        
+        const uchar* from = src.ptr<uchar>(i);
+        uchar* to = out.ptr<uchar>(i);
+        int runStart = 0;
+        for (int s = 0; s <= k; s++) {
+            int runEnd = s < k ? removed[s] : src.cols;
+            std::memcpy(to, from + runStart * es, (runEnd - runStart) * es);
+            to += (runEnd - runStart) * es;
+            runStart = runEnd + 1;
+        }
+    }
+}
+
+// Remove k horizontal seams in one top-to-bottom sweep over the rows: in
+// column j, row r of src moves up by the number of seams above it there.
+// Pixels of one row with the same shift are copied as one run. dst may be
+// src itself, since every pixel moves onto one the sweep has already read.
+template <typename F>
+static void compactHorizontalSeams(const cv::Mat& src, cv::Mat& dst, const std::vector<std::vector<int>>& seams,
+                                   F format) {
+    const size_t es = format.size();
+    const int cols = src.cols;
+    const int k = static_cast<int>(seams.size());
+    const bool inPlace = src.data == dst.data;
+    
+    // Sorted removed rows of each column; shift[j] of them lie above the
+    // current row
+    std::vector<int> removed(static_cast<size_t>(k) * cols);
+    int firstRow = src.rows;
+    for (int j = 0; j < cols; j++) {
+        int* r = removed.data() + static_cast<size_t>(j) * k;
+        for (int s = 0; s < k; s++) r[s] = seams[s][j];
+        std::sort(r, r + k);
+        firstRow = std::min(firstRow, r[0]);
+    }
+    std::vector<int> shift(cols, 0);
+    auto removedAt = [&](int j, int r) { return shift[j] < k && removed[static_cast<size_t>(j) * k + shift[j]] == r; };
+    
+    for (int r = inPlace ? firstRow : 0; r < src.rows; r++) {
+        const uchar* from = src.ptr<uchar>(r);
+        int j = 0;
+        while (j < cols) {
+            if (removedAt(j, r)) {
+                shift[j++]++;
+                continue;
+            }
+            const int s = shift[j];
+            int runStart = j++;
+            while (j < cols && shift[j] == s && !removedAt(j, r)) {
+                j++;
+            }
+            if (s > 0 || !inPlace) {
+                std::memcpy(dst.ptr<uchar>(r - s) + runStart * es, from + runStart * es, (j - runStart) * es);
+            }
+        }
+    }
+}
+
+cv::Mat SeamCarver::removeVerticalSeam(const cv::Mat& img, const std::vector<int>& seam) {
+    SEAM_PHASE(&phaseStats, Removal);
+    // Create new image with one less column
+    cv::Mat newImage(img.rows, img.cols - 1, img.type());
+    dispatchPlaneFormat(img, [&](auto format) { removeVerticalSeamCopy(img, newImage, seam, format); });
+    phaseStats.memory.removalBytes += planeBytes(newImage);
+    return newImage;
+}
+
+cv::Mat SeamCarver::removeHorizontalSeam(const cv::Mat& img, const std::vector<int>& seam) {
+    SEAM_PHASE(&phaseStats, Removal);
+    // Create new image with one less row
+    cv::Mat newImage(img.rows - 1, img.cols, img.type());
+    dispatchPlaneFormat(img, [&](auto format) { removeHorizontalSeamCopy(img, newImage, seam, format); });
+    phaseStats.memory.removalBytes += planeBytes(newImage);
+    return newImage;
+}
+
+void SeamCarver::removeVerticalSeamInPlace(cv::Mat& img, const std::vector<int>& seam) {
+    SEAM_PHASE(&phaseStats, Removal);
+    dispatchPlaneFormat(img, [&](auto format) { removeVerticalSeamShift(img, seam, format, 0, img.rows); });
+    phaseStats.memory.removalBytes += shiftedBytes(img, seam, true);
+    // Shrink the logical width; the allocation and row stride stay the same
+    img = img.colRange(0, img.cols - 1);
+}
+
+void SeamCarver::removeHorizontalSeamInPlace(cv::Mat& img, const std::vector<int>& seam) {
+    SEAM_PHASE(&phaseStats, Removal);
+    dispatchPlaneFormat(img, [&](auto format) { removeHorizontalSeamShift(img, seam, format, 0, img.cols); });
+    phaseStats.memory.removalBytes += shiftedBytes(img, seam, false);
+    // Shrink the logical height over the same allocation
+    img = img.rowRange(0, img.rows - 1);
+}
+
+// In-place removal from the seam's rows (columns) [lo, hi) of plane
+static void removeSeamLines(cv::Mat& plane, const std::vector<int>& seam, bool vertical, int lo, int hi) {
+    dispatchPlaneFormat(plane, [&](auto format) {
+        if (vertical) removeVerticalSeamShift(plane, seam, format, lo, hi);
+        else removeHorizontalSeamShift(plane, seam, format, lo, hi);
+    });
+}
+
+void SeamCarver::removeSeamFromPlanes(cv::Mat* img, cv::Mat& gray, cv::Mat* energy,
+                                      const std::vector<int>& seam, bool vertical) {
+    const int lines = vertical ? gray.rows : gray.cols;
+    const int bands = std::min<int>(energyThreads, lines / kMinRemovalBandLines);
+    if (bands <= 1) {
+        if (vertical) {
+            if (img) removeVerticalSeamInPlace(*img, seam);
+            removeVerticalSeamInPlace(gray, seam);
+            if (energy) updateEnergyAfterVerticalSeamInPlace(*energy, gray, seam);
+        } else {
+            if (img) removeHorizontalSeamInPlace(*img, seam);
+            removeHorizontalSeamInPlace(gray, seam);
+            if (energy) updateEnergyAfterHorizontalSeamInPlace(*energy, gray, seam);
+        }
+        return;
+    }
+
+    SEAM_PHASE(&phaseStats, Removal);
+    auto carved = [vertical](const cv::Mat& plane) {
+        return vertical ? plane.colRange(0, plane.cols - 1) : plane.rowRange(0, plane.rows - 1);
+    };
+    const bool patch = energy && energyFunction != EnergyFunction::Saliency;
+    cv::Mat carvedGray = carved(gray);
+    cv::Mat carvedEnergy = energy ? carved(*energy) : cv::Mat();
+    for (const cv::Mat* plane : { img, &gray, energy }) {
+        if (plane) phaseStats.memory.removalBytes += shiftedBytes(*plane, seam, vertical);
+    }
+    auto bandStart = [&](int b) { return static_cast<int>(static_cast<long long>(lines) * b / bands); };
+    runShares(*helperPool, bands, [&](int b) {
+        const int lo = bandStart(b);
+        const int hi = bandStart(b + 1);
+        if (img) removeSeamLines(*img, seam, vertical, lo, hi);
+        removeSeamLines(gray, seam, vertical, lo, hi);
+        if (energy) removeSeamLines(*energy, seam, vertical, lo, hi);
+        // The first and last line of a band read the neighbouring bands'
+        // gray lines, which may not be carved yet; they are patched below
+        if (patch) {
+            patchSeamLines(carvedEnergy, carvedGray, seam, vertical, lo + (b > 0), hi - (b + 1 < bands),
+                           energyFunction);
+        }
+    }, phaseStats.trace, "removal band");
+    for (int b = 1; patch && b < bands; b++) {
+        patchSeamLines(carvedEnergy, carvedGray, seam, vertical, bandStart(b) - 1, bandStart(b) + 1, energyFunction);
+    }
+
+    if (img) *img = carved(*img);
+    gray = carvedGray;
+    if (energy) {
+        *energy = carvedEnergy;
+        if (!patch) *energy = calculateEnergyFromGray(gray);
+    }
+}
+
+// Seams removed from the gray plane but not yet from the image
+// (SeamCarver::setLazyRemoval), in image coordinates. Each line keeps the
+// sorted image positions it has lost, so a seam in the carved coordinates
+// maps to image positions in O(pending) per line.
+class PendingSeams {
+public:
+    bool empty() const { return list.empty(); }
+    int size() const { return static_cast<int>(list.size()); }
+    const std::vector<std::vector<int>>& seams() const { return list; }
+
+    void add(const std::vector<int>& seam) {
+        if (lost.size() < seam.size()) lost.resize(seam.size());
+        std::vector<int> mapped(seam.size());
+        for (size_t i = 0; i < seam.size(); i++) {
+            std::vector<int>& line = lost[i];
+            int at = seam[i];
+            size_t k = 0;
+            while (k < line.size() && line[k] <= at) {
+                at++;
+                k++;
+            }
+            line.insert(line.begin() + k, at);
+            mapped[i] = at;
+        }
+        list.push_back(std::move(mapped));
+    }
+
+    void clear() {
+        list.clear();
+        for (std::vector<int>& line : lost) line.clear();
+    }
+
+private:
+    std::vector<std::vector<int>> list;
+    std::vector<std::vector<int>> lost;
+};
+
+cv::Mat SeamCarver::removeVerticalSeams(const cv::Mat& img, const std::vector<std::vector<int>>& seams) {
+    SEAM_PHASE(&phaseStats, Removal);
+    cv::Mat newImage(img.rows, img.cols - static_cast<int>(seams.size()), img.type());
+    dispatchPlaneFormat(img, [&](auto format) { removeVerticalSeamsCopy(img, newImage, seams, format); });
+    phaseStats.memory.removalBytes += planeBytes(newImage);
+    return newImage;
+}
+
+cv::Mat SeamCarver::removeHorizontalSeams(const cv::Mat& img, const std::vector<std::vector<int>>& seams) {
+    SEAM_PHASE(&phaseStats, Removal);
+    cv::Mat newImage(img.rows - static_cast<int>(seams.size()), img.cols, img.type());
+    phaseStats.memory.removalBytes += planeBytes(newImage);
+    if (seams.empty()) {
+        img.copyTo(newImage);
+        return newImage;
+    }
+    dispatchPlaneFormat(img, [&](auto format) { compactHorizontalSeams(img, newImage, seams, format); });
+    return newImage;
+}
+
+void SeamCarver::removeVerticalSeamsInPlace(cv::Mat& img, const std::vector<std::vector<int>>& seams) {
+    SEAM_PHASE(&phaseStats, Removal);
+    if (seams.empty()) return;
+    dispatchPlaneFormat(img, [&](auto format) { removeVerticalSeamsShift(img, seams, format); });
+    phaseStats.memory.removalBytes += shiftedBytes(img, seams, true);
+    img = img.colRange(0, img.cols - static_cast<int>(seams.size()));
+}
+
+void SeamCarver::removeHorizontalSeamsInPlace(cv::Mat& img, const std::vector<std::vector<int>>& seams) {
+    SEAM_PHASE(&phaseStats, Removal);
+    if (seams.empty()) return;
+    dispatchPlaneFormat(img, [&](auto format) { compactHorizontalSeams(img, img, seams, format); });
+    phaseStats.memory.removalBytes += shiftedBytes(img, seams, false);
+    img = img.rowRange(0, img.rows - static_cast<int>(seams.size()));
+}
+
+int SeamCarver::seamBatchFor(int remaining, int layerWidth) const {
+    // Batches share the 3-connected table of multiSeamDP
+    if (seamStep > 1) return 1;
+    int batch = seamBatchSize;
+    if (batch == kAdaptiveSeamBatch) {
+        // Take at most 5% of the width per pass and never more than half of
+        // what is left, so the last seams are found one at a time
+        batch = std::min(remaining / 2, layerWidth / 20);
+    }
+    return std::max(1, std::min(batch, remaining));
+}
+
+ResizeOptions SeamCarver::resizeOptions(int width, int height, SeamStrategy strategy) const {
+    ResizeOptions options;
+    options.width = width;
+    options.height = height;
+    options.strategy = strategy;
+    options.energyModel = energyModel;
+    options.energyFunction = energyFunction;
+    options.precision = precision;
+    options.seamOrder = seamOrder;
+    options.seamBatch = seamBatchSize;
+    options.incrementalEnergy = incrementalEnergy;
+    options.incrementalDP = incrementalDP;
+    options.energyThreads = energyThreads;
+    options.dpThreads = dpThreads;
+    options.bidirectionalDP = bidirectionalDP;
+    options.lazyRemoval = lazyRemoval;
+    options.seamStep = seamStep;
+    return options;
+}
+
+cv::Mat SeamCarver::resizeImage(int newWidth, int newHeight, bool useDP) {
+    return resize(resizeOptions(newWidth, newHeight, useDP ? SeamStrategy::DP : SeamStrategy::Greedy));
+}
+
+cv::Mat SeamCarver::resizeImagePyramid(int newWidth, int newHeight) {
+    return resize(resizeOptions(newWidth, newHeight, SeamStrategy::Pyramid));
+}
+
+cv::Mat SeamCarver::resizeImageGraphCut(int newWidth, int newHeight) {
+    return resize(resizeOptions(newWidth, newHeight, SeamStrategy::GraphCut));
+}
+
+// Activates progress and cancellation for one public call. Calls nested
+// inside it (a resize enlarging) count towards the same run. The heap
+// allocations of the calling thread during the call go to the memory stats.
+class SeamCarver::RunScope {
+public:
+    RunScope(SeamCarver& carver, const ProgressCallback& progress, const CancelToken* cancel, int seamsTotal)
+        : carver(carver), heapStart(threadHeapCounter()) {
+        ActiveRun& run = carver.activeRun;
+        run.progress = progress ? &progress : nullptr;
+        run.cancel = cancel;
+        run.start = std::chrono::steady_clock::now();
+        run.seamsTotal = seamsTotal;
+        run.seamsDone = 0;
+        carver.checkCancelled();
+    }
+    ~RunScope() {
+        carver.activeRun = ActiveRun();
+        const HeapCounter& now = threadHeapCounter();
+        MemoryStats& memory = carver.phaseStats.memory;
+        memory.allocations += now.allocations - heapStart.allocations;
+        memory.allocatedBytes += now.bytes - heapStart.bytes;
+        memory.heapCounted = heapCountingLinked();
+    }
+    RunScope(const RunScope&) = delete;
+    RunScope& operator=(const RunScope&) = delete;
+
+private:
+    SeamCarver& carver;
+    HeapCounter heapStart;
+};
+
+void SeamCarver::seamsCarved(int seams) {
+    if (activeRun.progress) {
+        activeRun.seamsDone += seams;
+        CarveProgress p;
+        p.seamsDone = activeRun.seamsDone;
+        p.seamsTotal = activeRun.seamsTotal;
+        p.elapsedMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - activeRun.start).count();
+        (*activeRun.progress)(p);
+    }
+    checkCancelled();
+}
+
+cv::Size SeamCarver::hybridScaleSize(int width, int height, double quality) {
+    const cv::Size current = image.size();
+    const double q = std::min(std::max(quality, 0.0), 1.0);
+    if (q >= 1.0 || (width >= current.width && height >= current.height)) return current;
+
+    // Low-energy share of the image, from a copy of at most the probe side
+    cv::Mat probe = image;
+    const double shrink = static_cast<double>(kHybridProbeSide) / std::max(current.width, current.height);
+    if (shrink < 1.0) {
+        cv::resize(image, probe, cv::Size(std::max(1, (int)std::lround(current.width * shrink)),
+                                          std::max(1, (int)std::lround(current.height * shrink))),
+                   0, 0, cv::INTER_AREA);
+    }
+    const cv::Mat energy = calculateEnergyFromGray(toGray(probe));
+    const double lowShare = dispatchEnergyDepth(energy, [&](auto tag) {
+        typedef decltype(tag) T;
+        double sum = 0.0;
+        for (int r = 0; r < energy.rows; r++) {
+            const T* e = energy.ptr<T>(r);
+            for (int c = 0; c < energy.cols; c++) sum += e[c];
+        }
+        const double mean = sum / energy.total();
+        size_t low = 0;
+        for (int r = 0; r < energy.rows; r++) {
+            const T* e = energy.ptr<T>(r);
+            for (int c = 0; c < energy.cols; c++) low += e[c] < mean;
+        }
+        return static_cast<double>(low) / energy.total();
+    });
+
+    const double carveShare = std::min(q * lowShare, kMaxHybridCarveShare);
+    auto side = [&](int target, int size) {
+        if (target >= size) return size;
+        return std::min(size, std::max(target, (int)std::lround(target / (1.0 - carveShare))));
+    };
+    return cv::Size(side(width, current.width), side(height, current.height));
+}
+
+cv::Size SeamCarver::hybridScaleBound(cv::Size source, int width, int height, double quality) {
+    const double q = std::min(std::max(quality, 0.0), 1.0);
+    if (q >= 1.0 || (width >= source.width && height >= source.height)) return source;
+    // The low-energy share is at most 1
+    const double carveShare = std::min(q, kMaxHybridCarveShare);
+    auto side = [&](int target, int size) {
+        if (target >= size) return size;
+        return std::min(size, std::max(target, (int)std::lround(target / (1.0 - carveShare))));
+    };
+    return cv::Size(side(width, source.width), side(height, source.height));
+}
+
+void SeamCarver::scaleWorkingImage(cv::Size size) {
+    log(LogLevel::Info, "Scaling from (", image.cols, "x", image.rows, ") to (", size.width, "x", size.height,
+        ") before carving");
+    cv::Mat scaled;
+    cv::resize(image, scaled, size, 0, 0, cv::INTER_AREA);
+    image = scaled;
+    grayImage = toGray(image);
+    initialEnergy.release();  // of the unscaled image
+    if (!mask.empty()) {
+        cv::Mat planes[2] = { mask.protectPlane(), mask.removePlane() };
+        for (cv::Mat& plane : planes) cv::resize(plane, plane, size, 0, 0, cv::INTER_NEAREST);
+        mask = SeamMask(planes[0], planes[1]);
+    }
+}
+
+cv::Rect SeamCarver::flatBorderCrop(int width, int height, double maxEnergy) {
+    const cv::Rect full(0, 0, image.cols, image.rows);
+    const int trimCols = image.cols - width;
+    const int trimRows = image.rows - height;
+    if (maxEnergy < 0.0 || (trimCols <= 0 && trimRows <= 0)) return full;
+
+    cv::Mat energy = calculateEnergyFromGray(grayImage);
+    cv::Mat flat = energy;
+    if (!mask.empty()) {
+        flat = energy.clone();
+        mask.applyTo(flat);
+    }
+    const double limit = energy.depth() == CV_16U ? maxEnergy * kFixedEnergyScale : maxEnergy;
+    // Highest energy of every column and row
+    std::vector<double> colMax(energy.cols, -std::numeric_limits<double>::infinity());
+    std::vector<double> rowMax(energy.rows, -std::numeric_limits<double>::infinity());
+    dispatchEnergyDepth(flat, [&](auto tag) {
+        typedef decltype(tag) T;
+        for (int r = 0; r < flat.rows; r++) {
+            const T* e = flat.ptr<T>(r);
+            for (int c = 0; c < flat.cols; c++) {
+                const double v = static_cast<double>(e[c]);
+                if (v > colMax[c]) colMax[c] = v;
+                if (v > rowMax[r]) rowMax[r] = v;
+            }
+        }
+        return 0;
+    });
+
+    // [first, second] trimmed from the two ends of a side: from the flat
+    // runs at each end, up to trim in all, split as evenly as they allow
+    auto split = [limit](const std::vector<double>& line, int trim) {
+        const int n = static_cast<int>(line.size());
+        int head = 0;
+        while (head < n && line[head] <= limit) head++;
+        int tail = 0;
+        while (tail < n && line[n - 1 - tail] <= limit) tail++;
+        const int take = std::max(0, std::min(trim, head + tail));
+        const int last = std::min(tail, take - std::min(head, (take + 1) / 2));
+        return std::make_pair(take - last, last);
+    };
+    cv::Rect roi = full;
+    if (trimCols > 0) {
+        const std::pair<int, int> cols = split(colMax, trimCols);
+        roi.x = cols.first;
+        roi.width -= cols.first + cols.second;
+    }
+    if (trimRows > 0) {
+        const std::pair<int, int> rows = split(rowMax, trimRows);
+        roi.y = rows.first;
+        roi.height -= rows.first + rows.second;
+    }
+    if (roi == full && initialEnergy.empty()) initialEnergy = energy;
+    return roi;
+}
+
+void SeamCarver::cropWorkingImage(cv::Rect roi) {
+    log(LogLevel::Info, "Cropping flat borders from (", image.cols, "x", image.rows, ") to (", roi.width, "x",
+        roi.height, ") before carving");
+    image = image(roi);
+    grayImage = grayImage(roi).clone();  // the seam finders walk its rows contiguously
+    initialEnergy.release();  // its border pixels differ from the crop's
+    if (!mask.empty()) {
+        mask = SeamMask(mask.protectPlane()(roi), mask.removePlane()(roi));
+    }
+}
+
+// whole with its columns (vertical) or rows band replaced by part, which
+// is narrower along that axis
+static cv::Mat replaceBand(const cv::Mat& whole, cv::Range band, const cv::Mat& part, bool vertical) {
+    const int removed = band.size() - (vertical ? part.cols : part.rows);
+    cv::Mat out = vertical ? cv::Mat(whole.rows, whole.cols - removed, whole.type())
+                           : cv::Mat(whole.rows - removed, whole.cols, whole.type());
+    const int length = vertical ? whole.cols : whole.rows;
+    auto span = [vertical](const cv::Mat& m, int start, int end) {
+        return vertical ? m.colRange(start, end) : m.rowRange(start, end);
+    };
+    const int end = band.start + (band.size() - removed);
+    span(whole, 0, band.start).copyTo(span(out, 0, band.start));
+    part.copyTo(span(out, band.start, end));
+    span(whole, band.end, length).copyTo(span(out, end, length - removed));
+    return out;
+}
+
+void SeamCarver::carveBand(SeamStrategy strategy, cv::Range band, int seams, bool vertical) {
+    const cv::Mat source = image;
+    const cv::Mat sourceGray = grayImage;
+    const SeamMask sourceMask = mask;
+    auto cut = [&](const cv::Mat& m) { return vertical ? m.colRange(band) : m.rowRange(band); };
+    // Copies keep the band's rows contiguous for the seam finders
+    image = cut(source).clone();
+    grayImage = cut(sourceGray).clone();
+    if (!sourceMask.empty()) mask = SeamMask(cut(sourceMask.protectPlane()), cut(sourceMask.removePlane()));
+    initialEnergy.release();  // of the whole image
+    log(LogLevel::Info, "Carving ", vertical ? "columns " : "rows ", band.start, "-", band.end, " only");
+    carveWith(strategy, image.cols - (vertical ? seams : 0), image.rows - (vertical ? 0 : seams));
+
+    const cv::Mat carved = image;
+    image = replaceBand(source, band, carved, vertical);
+    grayImage = replaceBand(sourceGray, band, grayImage, vertical);
+    if (!sourceMask.empty()) {
+        mask = SeamMask(replaceBand(sourceMask.protectPlane(), band, mask.protectPlane(), vertical),
+                        replaceBand(sourceMask.removePlane(), band, mask.removePlane(), vertical));
+    }
+}
+
+void SeamCarver::applyResizeSettings(const ResizeOptions& options) {
+    energyModel = options.energyModel;
+    energyFunction = options.energyFunction;
+    precision = options.precision;
+    seamOrder = options.seamOrder;
+    setSeamBatchSize(options.seamBatch);
+    incrementalEnergy = options.incrementalEnergy;
+    incrementalDP = options.incrementalDP;
+    setEnergyThreads(options.energyThreads);
+    setDPThreads(options.dpThreads);
+    bidirectionalDP = options.bidirectionalDP;
+    setLazyRemoval(options.lazyRemoval);
+    setSeamStep(options.seamStep);
+}
+
+cv::Mat SeamCarver::carveWith(SeamStrategy strategy, int newWidth, int newHeight) {
+    switch (strategy) {
+    case SeamStrategy::DP:
+        return carveTo<SeamStrategy::DP>(newWidth, newHeight);
+    case SeamStrategy::Greedy:
+        return carveTo<SeamStrategy::Greedy>(newWidth, newHeight);
+    case SeamStrategy::Pyramid:
+        return carveTo<SeamStrategy::Pyramid>(newWidth, newHeight);
+    case SeamStrategy::GraphCut:
+    default:
+        return carveTo<SeamStrategy::GraphCut>(newWidth, newHeight);
+    }
+}
+
+cv::Mat SeamCarver::resize(const ResizeOptions& options) {
+    applyResizeSettings(options);
+    if (!options.region.empty()) {
+        const cv::Rect& region = options.region;
+        if ((region & cv::Rect(0, 0, image.cols, image.rows)) != region) {
+            throw std::runtime_error("The carve region must lie inside the " + std::to_string(image.cols) + "x" +
+                                     std::to_string(image.rows) + " image.");
+        }
+        const int seamsV = image.cols - options.width;
+        const int seamsH = image.rows - options.height;
+        if (seamsV < 0 || seamsH < 0 || seamsV >= region.width || seamsH >= region.height) {
+            throw std::runtime_error("A carve region only reduces, by less than its own size: " +
+                                     std::to_string(region.width) + "x" + std::to_string(region.height) + ".");
+        }
+        RunScope run(*this, options.progress, options.cancel, seamsV + seamsH);
+        if (seamsV > 0) carveBand(options.strategy, cv::Range(region.x, region.x + region.width), seamsV, true);
+        if (seamsH > 0) carveBand(options.strategy, cv::Range(region.y, region.y + region.height), seamsH, false);
+        return image;
+    }
+    if (options.carveQuality < 1.0) {
+        const cv::Size scaled = hybridScaleSize(options.width, options.height, options.carveQuality);
+        if (scaled != image.size()) scaleWorkingImage(scaled);
+    }
+    if (options.borderTrim >= 0.0) {
+        const cv::Rect roi = flatBorderCrop(options.width, options.height, options.borderTrim);
+        if (roi.size() != image.size()) cropWorkingImage(roi);
+    }
+
+    RunScope run(*this, options.progress, options.cancel,
+                 std::abs(image.cols - options.width) + std::abs(image.rows - options.height));
+    return carveWith(options.strategy, options.width, options.height);
+}
+
+void SeamCarver::resizeSizes(const std::vector<cv::Size>& sizes, const ResizeOptions& options,
+                             const SizeCallback& emit) {
+    if (sizes.empty()) return;
+    // Largest first; equal sizes keep their list order
+    std::vector<size_t> order(sizes.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return sizes[a].width != sizes[b].width ? sizes[a].width > sizes[b].width
+                                                : sizes[a].height > sizes[b].height;
+    });
+    cv::Size previous = image.size();
+    for (size_t k : order) {
+        const cv::Size& s = sizes[k];
+        if (s.width < 1 || s.height < 1 || s.width > image.cols || s.height > image.rows) {
+            throw std::runtime_error("Sizes of one carve must fit the image: " + std::to_string(s.width) + "x" +
+                                     std::to_string(s.height) + " does not.");
+        }
+        if (s.height > previous.height) {
+            throw std::runtime_error("Sizes of one carve must shrink in width and height together.");
+        }
+        previous = s;
+    }
+
+    applyResizeSettings(options);
+    RunScope run(*this, options.progress, options.cancel,
+                 (image.cols - previous.width) + (image.rows - previous.height));
+    for (size_t k : order) {
+        emit(k, carveWith(options.strategy, sizes[k].width, sizes[k].height));
+    }
+}
+
+// The overloads with progress run the same options as the plain calls
+cv::Mat SeamCarver::resizeImage(int newWidth, int newHeight, bool useDP,
+                                const ProgressCallback& progress, const CancelToken* cancel) {
+    ResizeOptions options = resizeOptions(newWidth, newHeight, useDP ? SeamStrategy::DP : SeamStrategy::Greedy);
+    options.progress = progress;
+    options.cancel = cancel;
+    return resize(options);
+}
+
+cv::Mat SeamCarver::resizeImagePyramid(int newWidth, int newHeight,
+                                       const ProgressCallback& progress, const CancelToken* cancel) {
+    ResizeOptions options = resizeOptions(newWidth, newHeight, SeamStrategy::Pyramid);
+    options.progress = progress;
+    options.cancel = cancel;
+    return resize(options);
+}
+
+cv::Mat SeamCarver::resizeImageGraphCut(int newWidth, int newHeight,
+                                        const ProgressCallback& progress, const CancelToken* cancel) {
+    ResizeOptions options = resizeOptions(newWidth, newHeight, SeamStrategy::GraphCut);
+    options.progress = progress;
+    options.cancel = cancel;
+    return resize(options);
+}
+
+cv::Mat SeamCarver::enlargeImage(const cv::Mat& img, int newWidth, int newHeight,
+                                 const ProgressCallback& progress, const CancelToken* cancel) {
+    RunScope run(*this, progress, cancel, std::max(0, newWidth - img.cols) + std::max(0, newHeight - img.rows));
+    return enlargeImage(img, newWidth, newHeight);
+}
+
+// Sum of the energy map along a seam
+static double seamEnergySum(const cv::Mat& energy, const std::vector<int>& seam, bool vertical) {
+    return dispatchEnergyDepth(energy, [&](auto tag) {
+        typedef decltype(tag) T;
+        double sum = 0.0;
+        for (int k = 0; k < static_cast<int>(seam.size()); k++) {
+            sum += vertical ? energy.at<T>(k, seam[k]) : energy.at<T>(seam[k], k);
+        }
+        return sum;
+    });
+}
+
+std::vector<bool> SeamCarver::optimalSeamOrder(const cv::Mat& gray, int removeVertical, int removeHorizontal) {
+    const int R = removeHorizontal;
+    const int C = removeVertical;
+
+    // One cell of the transport map: the gray plane with r horizontal and
+    // c vertical seams removed, its total cost, and the seams leaving it
+    struct Cell {
+        cv::Mat gray;
+        double cost = 0.0;
+        std::vector<int> vSeam, hSeam;
+        double vCost = 0.0, hCost = 0.0;
+    };
+    auto prepare = [&](Cell& cell, int r, int c) {
+        cv::Mat energy = calculateEnergyFromGray(cell.gray);
+        if (c < C) {
+            cell.vSeam = findVerticalSeamDP(energy);
+            cell.vCost = seamEnergySum(energy, cell.vSeam, true);
+        }
+        if (r < R) {
+            cell.hSeam = findHorizontalSeamDP(energy);
+            cell.hCost = seamEnergySum(energy, cell.hSeam, false);
+        }
+    };
+
+    // choice(r, c) = 1 when cell (r, c) was reached by a vertical seam
+    cv::Mat choice(R + 1, C + 1, CV_8U, cv::Scalar::all(0));
+    std::vector<Cell> frontier(C + 1);
+    for (int r = 0; r <= R; r++) {
+        for (int c = 0; c <= C; c++) {
+            Cell next;
+            const bool fromLeft = c > 0 &&
+                (r == 0 || frontier[c - 1].cost + frontier[c - 1].vCost < frontier[c].cost + frontier[c].hCost);
+            if (r == 0 && c == 0) {
+                next.gray = gray.clone();
+            } else if (fromLeft) {
+                // The left cell is still needed by the next row
+                const Cell& left = frontier[c - 1];
+                next.gray = left.gray.clone();
+                next.cost = left.cost + left.vCost;
+                removeVerticalSeamInPlace(next.gray, left.vSeam);
+                choice.at<uchar>(r, c) = 1;
+            } else {
+                // The cell above is replaced by this one, so its plane is reused
+                Cell& above = frontier[c];
+                next.gray = above.gray;
+                next.cost = above.cost + above.hCost;
+                removeHorizontalSeamInPlace(next.gray, above.hSeam);
+            }
+            prepare(next, r, c);
+            frontier[c] = std::move(next);
+        }
+    }
+
+    std::vector<bool> order(R + C);
+    for (int r = R, c = C, k = R + C - 1; k >= 0; k--) {
+        order[k] = choice.at<uchar>(r, c) != 0;
+        if (order[k]) c--; else r--;
+    }
+    return order;
+}
+
+// Working storage of SeamCarver::carveSmall, one per thread and made on
+// its first small carve: sized for kSmallImageSide, so no carve after that
+// allocates any of it
+struct SmallCarveArena {
+    static constexpr int kSide = SeamCarver::kSmallImageSide;
+    alignas(64) uchar gray[kSide * kSide];       // row stride kSide
+    alignas(64) uchar grayT[kSide * kSide];      // the transposed plane of the horizontal phase
+    alignas(64) double energy[kSide * kSide];    // row stride kSide elements of the precision
+    alignas(64) schar offsets[kSide * kSide];    // layeredSeamPass parents
+    alignas(64) double scratch[2 * (kSide + 2 * SeamCarver::kMaxSeamStep)];  // layeredSeamPass cost rows
+    std::vector<int> seam;                       // capacity kSide
+
+    SmallCarveArena() { seam.reserve(kSide); }
+};
+
+static SmallCarveArena& smallCarveArena() {
+    static thread_local std::unique_ptr<SmallCarveArena> arena;
+    if (!arena) arena = std::make_unique<SmallCarveArena>();
+    return *arena;
+}
+
+// Carve the arena planes gray and energy (its kernel K map at precision
+// T) and img by vertical seams to newWidth columns, calling carved() after
+// each seam. Rows are shifted in place and the energy patched around the
+// seam, as the incremental carve does; the planes become their leading
+// columns.
+template <typename K, typename T, int Step, typename Fn>
+static void carveSmallColumns(cv::Mat& gray, cv::Mat& energy, cv::Mat& img, int newWidth, SmallCarveArena& arena,
+                              const Fn& carved) {
+    typedef PixelFormat<uchar, 1> GrayFormat;
+    const size_t pixel = img.elemSize();
+    std::vector<int>& seam = arena.seam;
+    seam.resize(gray.rows);
+    while (gray.cols > newWidth) {
+        layeredSeamPass<T, Step>(energy.rows, energy.cols, [&](int i) { return energy.ptr<T>(i); }, arena.scratch,
+                                 arena.offsets, seam.data());
+        const int last = gray.cols - 1;
+        for (int r = 0; r < gray.rows; r++) {
+            const int c = seam[r];
+            uchar* g = gray.ptr<uchar>(r);
+            std::memmove(g + c, g + c + 1, last - c);
+            T* e = energy.ptr<T>(r);
+            std::memmove(e + c, e + c + 1, (last - c) * sizeof(T));
+            uchar* p = img.ptr<uchar>(r);
+            std::memmove(p + c * pixel, p + (c + 1) * pixel, (last - c) * pixel);
+        }
+        gray = gray.colRange(0, last);
+        energy = energy.colRange(0, last);
+        img = img.colRange(0, last);
+        patchVerticalSeamBand<K, GrayFormat>(energy, gray, seam, 0, gray.rows);
+        carved();
+    }
 }
 
-cv::Mat SeamCarver::calculateEnergy(const cv::Mat& img) {
-    // Convert to grayscale for energy calculation
-    cv::Mat gray;
-    cv::cvtColor(img, gray, cv::COLOR_BGR2GRAY);
-    
-    // Convert to double precision for calculation
-    gray.convertTo(gray, CV_64F);
-    
-    // Apply Sobel filter to get gradients in x and y directions
-    cv::Mat sobelX, sobelY;
-    cv::Sobel(gray, sobelX, CV_64F, 1, 0, 3);  // Gradient in X direction
-    cv::Sobel(gray, sobelY, CV_64F, 0, 1, 3);  // Gradient in Y direction
-    
-    // Calculate gradient magnitude as energy
-    cv::Mat energy;
-    cv::magnitude(sobelX, sobelY, energy);
-    
+// Kernel K map of gray at precision T into the arena
+template <typename K, typename T>
+static cv::Mat smallEnergyMap(const cv::Mat& gray, SmallCarveArena& arena) {
+    cv::Mat energy(gray.rows, gray.cols, cv::DataType<T>::depth, arena.energy, SmallCarveArena::kSide * sizeof(T));
+    for (int r = 0; r < gray.rows; r++) kernelEnergyRow<K>(gray, r, energy.ptr<T>(r));
     return energy;
 }
 
-std::vector<int> SeamCarver::findVerticalSeamDP(const cv::Mat& energy) {
-    int rows = energy.rows;
-    int cols = energy.cols;
-    
-    // Create DP table
-    cv::Mat dp = cv::Mat::zeros(rows, cols, CV_64F);
+cv::Mat SeamCarver::carveSmall(int newWidth, int newHeight) {
+    TraceSpan span(phaseStats.trace, "small carve", "seam");
+    log(LogLevel::Info, "Removing ", image.cols - newWidth, " vertical and ", image.rows - newHeight,
+        " horizontal seams on the small-image path...");
+    SmallCarveArena& arena = smallCarveArena();
+    cv::Mat gray(grayImage.rows, grayImage.cols, CV_8UC1, arena.gray, SmallCarveArena::kSide);
+    grayImage.copyTo(gray);
+    cv::Mat img = image.clone();
+    dispatchEnergyFunction(energyFunction, [&](auto kernel) {
+        typedef decltype(kernel) K;
+        auto carve = [&](auto tag, auto step) {
+            typedef decltype(tag) T;
+            constexpr int Step = decltype(step)::value;
+            auto carved = [this] { seamsCarved(1); };
+            SEAM_PHASE(&phaseStats, DPForward);
+            if (newWidth < gray.cols) {
+                cv::Mat energy = smallEnergyMap<K, T>(gray, arena);
+                carveSmallColumns<K, T, Step>(gray, energy, img, newWidth, arena, carved);
+            }
+            if (newHeight < gray.rows) {
+                // Horizontal seams as vertical ones of the transposed planes
+                cv::Mat grayT(gray.cols, gray.rows, CV_8UC1, arena.grayT, SmallCarveArena::kSide);
+                cv::transpose(gray, grayT);
+                cv::Mat imgT;
+                cv::transpose(img, imgT);
+                cv::Mat energy = smallEnergyMap<K, T>(grayT, arena);
+                carveSmallColumns<K, T, Step>(grayT, energy, imgT, newHeight, arena, carved);
+                gray = cv::Mat(grayT.cols, grayT.rows, CV_8UC1, arena.gray, SmallCarveArena::kSide);
+                cv::transpose(grayT, gray);
+                cv::transpose(imgT, img);
+            }
+        };
+        dispatchSeamStep(seamStep, [&](auto step) {
+            switch (precision) {
+            case EnergyPrecision::Float: carve(float(), step); break;
+            case EnergyPrecision::Fixed16: carve(ushort(), step); break;
+            case EnergyPrecision::Double:
+            default: carve(double(), step); break;
+            }
+        });
+    });
+    log(LogLevel::Info, "Resizing complete!");
+    image = img;
+    grayImage = gray.clone();  // off the arena
+    return image;
+}
+
+// One instance per strategy: the seam finder and everything that only
+// applies to DP are fixed at compile time
+template <SeamStrategy Strategy>
+cv::Mat SeamCarver::carveTo(int newWidth, int newHeight) {
+    constexpr bool useDP = Strategy == SeamStrategy::DP;
+    static const char* const kMethodNames[] = { "Dynamic Programming", "Greedy", "Pyramid", "Graph cut" };
+    // Shared until carveStep removes the first seam (see detachPlane), so
+    // enlarging or an unchanged size never copies the image
+    cv::Mat currentImage = image;
+    cv::Mat currentGray = grayImage;
+    int currentHeight = currentImage.rows;
+    int currentWidth = currentImage.cols;
     
-    // Initialize first row
-    for (int j = 0; j < cols; j++) {
-        dp.at<double>(0, j) = energy.at<double>(0, j);
+    log(LogLevel::Info, "Resizing from (", currentWidth, "x", currentHeight,
+        ") to (", newWidth, "x", newHeight, ")");
+    log(LogLevel::Info, "Using method: ", kMethodNames[static_cast<int>(Strategy)]);
+
+    // Forward-energy DP reads its costs from the gray plane: no energy map.
+    // A mask needs a map to fold into, so it falls back to backward energy.
+    const bool forward = useDP && energyModel == EnergyModel::Forward && mask.empty();
+    const bool useEnergy = !forward;
+
+    // Without incremental updates or threads, single DP seams are found
+    // with the energy computed inside the DP loop instead of a map
+    const bool fused = useDP && !forward && !incrementalEnergy && !incrementalDP &&
+                       energyThreads == 1 && dpThreads == 1 && energyFunction != EnergyFunction::Saliency &&
+                       mask.empty();
+    if (fused && smallImagePath && seamBatchSize == 1 && seamOrder == SeamOrder::WidthFirst &&
+        currentWidth <= kSmallImageSide && currentHeight <= kSmallImageSide && newWidth <= currentWidth &&
+        newHeight <= currentHeight && (newWidth < currentWidth || newHeight < currentHeight)) {
+        return carveSmall(newWidth, newHeight);
+    }
+    SeamMask currentMask = mask;
+
+    // With incremental energy the map is computed once and then patched
+    // along every removed seam. A seeded map (setInitialEnergy) stands in
+    // for the first computation.
+    cv::Mat energy = takeInitialEnergy(currentGray);
+    if (!useEnergy) energy.release();
+    bool seeded = !energy.empty();
+    if (useEnergy && incrementalEnergy && !seeded && (currentWidth > newWidth || currentHeight > newHeight)) {
+        energy = calculateEnergyFromGray(currentGray);
     }
+
+    // One carving step over the current planes: a single seam, or with
+    // batching a set of disjoint DP seams from one cost table. The batch is
+    // removed together and the energy recomputed afterwards.
+    // Returns the number of seams removed.
+    //
+    // With incremental DP the vertical cost table survives between steps:
+    // it is brought up to date with the previous seam and the current
+    // energy, and only its dirty cone is recomputed.
+    //
+    // Single seams are written into one buffer for the whole carve and the
+    // per-seam energy map lives in the seam workspace, so in steady state a
+    // single-threaded step allocates nothing.
+    cv::Mat costTable;
+    std::vector<int> tableSeam;  // seam not yet applied to costTable or the graph labels
+    std::vector<int> seam;
+
+    // Single seams marked in currentImage but not yet removed from it
+    // (setLazyRemoval). A pass still on the original image is copied out
+    // carved instead of being detached and then shifted.
+    PendingSeams pending;
+    bool pendingVertical = true;
+    auto compactImage = [&] {
+        if (pending.empty()) return;
+        TraceSpan span(phaseStats.trace, "compaction", "seam");
+        span.arg("seams", pending.size());
+        if (currentImage.data == image.data) {
+            currentImage = pendingVertical ? removeVerticalSeams(currentImage, pending.seams())
+                                           : removeHorizontalSeams(currentImage, pending.seams());
+        } else if (pendingVertical) {
+            removeVerticalSeamsInPlace(currentImage, pending.seams());
+        } else {
+            removeHorizontalSeamsInPlace(currentImage, pending.seams());
+        }
+        pending.clear();
+    };
+    // The image of a single-seam step, or null once the step's seam is
+    // marked in pending instead
+    auto stepImage = [&](bool vertical) -> cv::Mat* {
+        if (lazyRemoval <= 1) {
+            detachPlane(currentImage, image);
+            return &currentImage;
+        }
+        if (!pending.empty() && pendingVertical != vertical) compactImage();
+        pendingVertical = vertical;
+        return nullptr;
+    };
+    auto markSeam = [&](cv::Mat* img) {
+        if (img) return;
+        pending.add(seam);
+        if (pending.size() >= lazyRemoval) compactImage();
+    };
+    // Graph cut needs non-negative costs: a masked map is searched as its
+    // shifted copy (SeamMask::applyShiftedTo)
+    cv::Mat shiftedEnergy;
+    auto graphEnergy = [&]() -> const cv::Mat& {
+        if (currentMask.empty()) return energy;
+        currentMask.applyShiftedTo(energy, shiftedEnergy);
+        return shiftedEnergy;
+    };
+    auto findSeam = [&](bool vertical) {
+        if constexpr (Strategy == SeamStrategy::DP) {
+            if (forward) {
+                if (vertical) findVerticalSeamForwardDP(currentGray, seam);
+                else findHorizontalSeamForwardDP(currentGray, seam);
+            } else if (fused) {
+                if (vertical) findVerticalSeamFusedDP(currentGray, seam);
+                else findHorizontalSeamFusedDP(currentGray, seam);
+            } else {
+                if (vertical) findVerticalSeamDP(energy, seam);
+                else findHorizontalSeamDP(energy, seam);
+            }
+        } else if constexpr (Strategy == SeamStrategy::Greedy) {
+            if (vertical) findVerticalSeamGreedy(energy, seam);
+            else findHorizontalSeamGreedy(energy, seam);
+        } else if constexpr (Strategy == SeamStrategy::Pyramid) {
+            seam = vertical ? findVerticalSeamPyramid(energy) : findHorizontalSeamPyramid(energy);
+        } else {
+            if (vertical) findVerticalSeamGraphCut(graphEnergy(), seam);
+            else findHorizontalSeamGraphCut(graphEnergy(), seam);
+        }
+    };
+    auto carveStep = [&](bool vertical, int remaining) -> int {
+        int batch = useDP ? seamBatchFor(remaining, vertical ? currentGray.cols : currentGray.rows) : 1;
+        // vertical is in plane coordinates: a transposed horizontal step
+        // traces as vertical
+        TraceSpan span(phaseStats.trace, vertical ? "vertical step" : "horizontal step", "seam");
+        span.arg("remaining", remaining);
+        span.arg("batch", batch);
+        detachPlane(currentGray, grayImage);
+        if (useEnergy && !incrementalEnergy && !seeded && !(fused && batch == 1)) {
+            energy = scratchEnergy(currentGray);
+        }
+        seeded = false;
+        // Only masked pixels are written, and they are overwritten rather
+        // than accumulated, so patched maps can take it again every step
+        currentMask.applyTo(energy);
+        if (batch > 1 || !vertical) {
+            costTable.release();
+            tableSeam.clear();
+        }
+        if (batch > 1) {
+            compactImage();
+            detachPlane(currentImage, image);
+            std::vector<std::vector<int>> seams;
+            if (vertical) {
+                seams = forward ? findVerticalSeamsForwardDP(currentGray, batch) : findVerticalSeamsDP(energy, batch);
+                removeVerticalSeamsInPlace(currentImage, seams);
+                removeVerticalSeamsInPlace(currentGray, seams);
+                currentMask.removeVerticalSeams(seams);
+            } else {
+                seams = forward ? findHorizontalSeamsForwardDP(currentGray, batch) : findHorizontalSeamsDP(energy, batch);
+                removeHorizontalSeamsInPlace(currentImage, seams);
+                removeHorizontalSeamsInPlace(currentGray, seams);
+                currentMask.removeHorizontalSeams(seams);
+            }
+            if (useEnergy && incrementalEnergy) energy = calculateEnergyFromGray(currentGray);
+            sampleMemory({ &currentImage, &currentGray, &energy, &costTable });
+            return static_cast<int>(seams.size());
+        }
+        
+        if (vertical) {
+            if (useDP && incrementalDP && !forward && seamStep == 1) {
+                {
+                    SEAM_PHASE(&phaseStats, DPForward);
+                    if (costTable.empty()) {
+                        costTable = verticalCostTable(energy);
+                    } else {
+                        updateVerticalCostTable(costTable, energy, tableSeam, *seamWorkspace);
+                    }
+                }
+                SEAM_PHASE(&phaseStats, Backtrack);
+                backtrackCostTable(costTable, energy, seam);
+                tableSeam = seam;
+            } else if (Strategy == SeamStrategy::GraphCut && incrementalDP) {
+                // tableSeam empty: no labels yet, search in full
+                findVerticalSeamGraphLabels(graphEnergy(), tableSeam, seam);
+                tableSeam = seam;
+            } else {
+                findSeam(true);
+            }
+            cv::Mat* img = stepImage(true);
+            removeSeamFromPlanes(img, currentGray, useEnergy && incrementalEnergy ? &energy : nullptr, seam, true);
+            markSeam(img);
+            currentMask.removeVerticalSeam(seam);
+        } else {
+            findSeam(false);
+            cv::Mat* img = stepImage(false);
+            removeSeamFromPlanes(img, currentGray, useEnergy && incrementalEnergy ? &energy : nullptr, seam, false);
+            markSeam(img);
+            currentMask.removeHorizontalSeam(seam);
+        }
+        sampleMemory({ &currentImage, &currentGray, &energy, &costTable });
+        return 1;
+    };
     
-    // Fill the DP table row by row
-    for (int i = 1; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            double currentEnergy = energy.at<double>(i, j);
-            
-            // Find minimum of three possible previous pixels
-            double minPrevEnergy = dp.at<double>(i-1, j);  // Directly above
-            
-            // Diagonal-left (if exists)
-            if (j > 0) {
-                minPrevEnergy = std::min(minPrevEnergy, dp.at<double>(i-1, j-1));
+    // Remove vertical seams (reduce width)
+    int numVerticalSeams = currentWidth - newWidth;
+    int numHorizontalSeams = currentHeight - newHeight;
+    if (useDP && seamOrder == SeamOrder::Optimal && numVerticalSeams > 0 && numHorizontalSeams > 0) {
+        // Interleave both directions single seam by single seam in the
+        // order of least total energy
+        log(LogLevel::Info, "Optimising the order of ", numVerticalSeams, " vertical and ",
+            numHorizontalSeams, " horizontal seams...");
+        std::vector<bool> order = optimalSeamOrder(currentGray, numVerticalSeams, numHorizontalSeams);
+        for (size_t k = 0; k < order.size(); k++) {
+            carveStep(order[k], 1);
+            seamsCarved(1);
+            if ((k + 1) % 10 == 0 || k + 1 == order.size()) {
+                log(LogLevel::Debug, "  Removed ", k + 1, "/", order.size(), " seams");
             }
-            
-            // Diagonal-right (if exists)
-            if (j < cols - 1) {
-                minPrevEnergy = std::min(minPrevEnergy, dp.at<double>(i-1, j+1));
+        }
+        numVerticalSeams = numHorizontalSeams = 0;
+    }
+    if (Strategy == SeamStrategy::DP && !forward && seamOrder == SeamOrder::Cheapest &&
+        numVerticalSeams > 0 && numHorizontalSeams > 0) {
+        // Both seams of every step from one energy map; the steps run
+        // untransposed, and whichever axis is left over finishes below
+        log(LogLevel::Info, "Removing ", numVerticalSeams, " vertical and ", numHorizontalSeams,
+            " horizontal seams, cheapest first...");
+        costTable.release();
+        tableSeam.clear();
+        compactImage();
+        int carved = 0;
+        while (numVerticalSeams > 0 && numHorizontalSeams > 0) {
+            detachPlane(currentImage, image);
+            detachPlane(currentGray, grayImage);
+            if (!incrementalEnergy && !seeded) energy = scratchEnergy(currentGray);
+            seeded = false;
+            currentMask.applyTo(energy);
+            const bool vertical = findCheapestSeamDP(energy, numVerticalSeams, numHorizontalSeams, seam);
+            removeSeamFromPlanes(&currentImage, currentGray, incrementalEnergy ? &energy : nullptr, seam, vertical);
+            if (vertical) {
+                currentMask.removeVerticalSeam(seam);
+                numVerticalSeams--;
+            } else {
+                currentMask.removeHorizontalSeam(seam);
+                numHorizontalSeams--;
             }
+            sampleMemory({ &currentImage, &currentGray, &energy });
+            seamsCarved(1);
+            if (++carved % 10 == 0) {
+                log(LogLevel::Debug, "  Removed ", carved, " seams (", numVerticalSeams, " vertical and ",
+                    numHorizontalSeams, " horizontal left)");
+            }
+        }
+    }
+    if (numVerticalSeams > 0) {
+        log(LogLevel::Info, "Removing ", numVerticalSeams, " vertical seams...");
+        for (int i = 0; i < numVerticalSeams; ) {
+            int before = i;
+            i += carveStep(true, numVerticalSeams - i);
+            seamsCarved(i - before);
             
-            dp.at<double>(i, j) = currentEnergy + minPrevEnergy;
+            if (i / 10 != before / 10 || i == numVerticalSeams) {
+                log(LogLevel::Debug, "  Removed ", i, "/", numVerticalSeams, " vertical seams");
+            }
         }
     }
     
-    // Backtrack to find the seam path
-    std::vector<int> seam(rows);
-    
-    // Start from minimum energy pixel in last row
-    double minVal;
-    cv::Point minLoc;
-    cv::minMaxLoc(dp.row(rows-1), &minVal, nullptr, &minLoc, nullptr);
-    int j = minLoc.x;
-    seam[rows-1] = j;
-    
-    // At each step, find which parent in the previous row led to current position
-    for (int i = rows - 2; i >= 0; i--) {
-        // We're at column j in row i+1
-        // Find which column in row i could have led here
-        // Candidates: j-1 (moved diagonal-right), j (moved down), j+1 (moved diagonal-left)
-        
-        int bestJ = j;  // Default: came from directly above
-        double bestEnergy = dp.at<double>(i, j);
+    // Remove horizontal seams (reduce height)
+    if (numHorizontalSeams > 0) {
+        log(LogLevel::Info, "Removing ", numHorizontalSeams, " horizontal seams...");
         
-        // Check if coming from diagonal-left (j-1) is better
-        if (j > 0) {
-            double leftEnergy = dp.at<double>(i, j-1);
-            if (leftEnergy < bestEnergy) {
-                bestEnergy = leftEnergy;
-                bestJ = j - 1;
-            }
+        // In the transposed layout a horizontal seam of the image is a
+        // vertical seam of the planes, removed with contiguous row shifts
+        const bool transposed = transposeHorizontalPhase;
+        compactImage();
+        if (transposed) {
+            transposePlanes({ &currentImage, &currentGray, &energy }, phaseStats.memory);
+            currentMask.transpose();
         }
+        costTable.release();
+        tableSeam.clear();
         
-        // Check if coming from diagonal-right (j+1) is better
-        if (j < cols - 1) {
-            double rightEnergy = dp.at<double>(i, j+1);
-            if (rightEnergy < bestEnergy) {
-                bestEnergy = rightEnergy;
-                bestJ = j + 1;
+        for (int i = 0; i < numHorizontalSeams; ) {
+            int before = i;
+            i += carveStep(transposed, numHorizontalSeams - i);
+            seamsCarved(i - before);
+            
+            if (i / 10 != before / 10 || i == numHorizontalSeams) {
+                log(LogLevel::Debug, "  Removed ", i, "/", numHorizontalSeams, " horizontal seams");
             }
         }
         
-        j = bestJ;
-        seam[i] = j;
+        compactImage();
+        if (transposed) {
+            transposePlanes({ &currentImage, &currentGray }, phaseStats.memory);
+            currentMask.transpose();
+        }
     }
+    compactImage();
     
-    return seam;
+    // Enlarge with inserted seams
+    if (newWidth > currentImage.cols || newHeight > currentImage.rows) {
+        currentImage = enlargeImage(currentImage, std::max(newWidth, currentImage.cols),
+                                    std::max(newHeight, currentImage.rows));
+        currentGray = toGray(currentImage).clone();
+        currentMask = SeamMask();  // inserted seams have no mask bits
+    }
+
+    log(LogLevel::Info, "Resizing complete!");
+    image = currentImage;
+    grayImage = currentGray;
+    mask = currentMask;
+    return currentImage;
 }
 
-std::vector<int> SeamCarver::findVerticalSeamGreedy(const cv::Mat& energy) {
-    int rows = energy.rows;
-    int cols = energy.cols;
-    
-    std::vector<int> seam(rows);
-    
-    // Start from minimum energy pixel in first row
-    double minVal;
-    cv::Point minLoc;
-    cv::minMaxLoc(energy.row(0), &minVal, nullptr, &minLoc, nullptr);
-    int j = minLoc.x;
-    seam[0] = j;
-    
-    // Greedy selection: at each row, choose minimum among 3 neighbors
-    for (int i = 1; i < rows; i++) {
-        double minEnergy = energy.at<double>(i, j);
-        int minJ = j;
-        
-        // Check diagonal-left
-        if (j > 0) {
-            double leftEnergy = energy.at<double>(i, j-1);
-            if (leftEnergy < minEnergy) {
-                minEnergy = leftEnergy;
-                minJ = j - 1;
-            }
+cv::Mat SeamCarver::removeObject(bool restoreSize) {
+    cv::Mat currentImage = image;
+    cv::Mat currentGray = grayImage;
+    SeamMask currentMask = mask;
+    const int startWidth = currentImage.cols;
+    const int startHeight = currentImage.rows;
+
+    log(LogLevel::Info, "Removing object of ", currentMask.remainingRemove(), " pixels...");
+    cv::Mat energy = takeInitialEnergy(currentGray);
+    bool fresh = !energy.empty();
+    int seams = 0;
+    std::vector<int> vertical, horizontal;  // reused by every step
+    while (currentMask.remainingRemove() > 0) {
+        TraceSpan span(phaseStats.trace, "object step", "seam");
+        span.arg("remaining", currentMask.remainingRemove());
+        if (!fresh && !incrementalEnergy) {
+            energy = scratchEnergy(currentGray);
+        } else if (!fresh && energy.empty()) {
+            energy = calculateEnergyFromGray(currentGray);  // patched in place from now on
         }
-        
-        // Check diagonal-right
-        if (j < cols - 1) {
-            double rightEnergy = energy.at<double>(i, j+1);
-            if (rightEnergy < minEnergy) {
-                minEnergy = rightEnergy;
-                minJ = j + 1;
+        fresh = false;
+        if (currentGray.cols <= 1 && currentGray.rows <= 1) {
+            throw std::runtime_error("Object removal would remove the whole image.");
+        }
+        currentMask.applyTo(energy);
+
+        // Take the direction whose seam is cheaper per pixel
+        findVerticalSeamDP(energy, vertical);
+        findHorizontalSeamDP(energy, horizontal);
+        const bool useVertical = currentGray.cols > 1 &&
+            (currentGray.rows <= 1 || seamEnergySum(energy, vertical, true) / currentGray.rows <=
+                                      seamEnergySum(energy, horizontal, false) / currentGray.cols);
+        const int before = currentMask.remainingRemove();
+        detachPlane(currentImage, image);
+        detachPlane(currentGray, grayImage);
+        if (useVertical) {
+            removeSeamFromPlanes(&currentImage, currentGray, incrementalEnergy ? &energy : nullptr, vertical, true);
+            currentMask.removeVerticalSeam(vertical);
+        } else {
+            removeSeamFromPlanes(&currentImage, currentGray, incrementalEnergy ? &energy : nullptr, horizontal, false);
+            currentMask.removeHorizontalSeam(horizontal);
+        }
+        seams++;
+        if (currentMask.remainingRemove() == before) {
+            // Protected pixels can wall the rest in; without them the
+            // cheapest seam misses the object only where the energy along
+            // every way through it outweighs kProtectEnergy
+            if (cv::countNonZero(currentMask.protectPlane()) > 0) {
+                throw std::runtime_error("Object removal is blocked by the protect mask.");
             }
+            throw std::runtime_error("Object removal stalled: every seam through the remaining " +
+                                     std::to_string(before) + " pixels costs more than one around them.");
         }
-        
-        j = minJ;
-        seam[i] = j;
     }
-    
-    return seam;
-}
+    log(LogLevel::Info, "  Removed the object with ", seams, " seams (",
+        startWidth - currentImage.cols, " vertical, ", startHeight - currentImage.rows, " horizontal)");
 
-std::vector<int> SeamCarver::findHorizontalSeamDP(const cv::Mat& energy) {
-    // Transpose energy map, find vertical seam, return as horizontal
-    cv::Mat transposedEnergy;
-    cv::transpose(energy, transposedEnergy);
-    return findVerticalSeamDP(transposedEnergy);
+    if (restoreSize && (currentImage.cols < startWidth || currentImage.rows < startHeight)) {
+        currentImage = enlargeImage(currentImage, startWidth, startHeight);
+        currentGray = toGray(currentImage).clone();
+        currentMask = SeamMask();  // inserted seams have no mask bits
+    }
+    image = currentImage;
+    grayImage = currentGray;
+    mask = currentMask;
+    return currentImage;
 }
 
-std::vector<int> SeamCarver::findHorizontalSeamGreedy(const cv::Mat& energy) {
-    // Transpose energy map, find vertical seam, return as horizontal
-    cv::Mat transposedEnergy;
-    cv::transpose(energy, transposedEnergy);
-    return findVerticalSeamGreedy(transposedEnergy);
+cv::Mat SeamCarver::verticalRemovalOrder(const cv::Mat& gray, int minCols) {
+    RemovalOrder state = startRemovalOrder(gray);
+    continueRemovalOrder(state, minCols, gray.cols);
+    return state.order;
 }
 
-// Graph-based vertical seam: Dijkstra shortest path on a layered pixel graph
-std::vector<int> SeamCarver::findVerticalSeamGraphCut(const cv::Mat& energy) {
-    // Graph-based shortest path (Dijkstra) formulation
-    // energy: CV_64F, size rows x cols
-    const int rows = energy.rows;
-    const int cols = energy.cols;
-    const int numPixels = rows * cols;
-    const int src = numPixels;
-    const int dst = numPixels + 1;
-    const int numNodes = numPixels + 2;
+SeamCarver::RemovalOrder SeamCarver::startRemovalOrder(const cv::Mat& gray) {
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+    RemovalOrder state;
+    state.order = cv::Mat(rows, cols, CV_32S, cv::Scalar::all(SeamIndexMap::kKept));
+    
+    // origin[i][j] = source column of the pixel now at (i, j); carved with
+    // the gray plane so each seam can be traced back to the source
+    state.origin = cv::Mat(rows, cols, CV_32S);
+    for (int i = 0; i < rows; i++) {
+        int* o = state.origin.ptr<int>(i);
+        for (int j = 0; j < cols; j++) o[j] = j;
+    }
+    
+    state.gray = gray.clone();
+    state.energy = calculateEnergyFromGray(state.gray);
+    return state;
+}
 
-    struct Edge {
-        int to;
-        double w;
-    };
-    std::vector<std::vector<Edge>> adj(numNodes);
+void SeamCarver::continueRemovalOrder(RemovalOrder& state, int minCols, int seams) {
+    const int rows = state.order.rows;
+    std::vector<int> seam;
+    for (int n = 0; n < seams && state.gray.cols > minCols; n++) {
+        checkCancelled();
+        findVerticalSeamDP(state.energy, seam);
+        for (int i = 0; i < rows; i++) {
+            state.order.at<int>(i, state.origin.at<int>(i, seam[i])) = state.removed;
+        }
+        removeVerticalSeamInPlace(state.origin, seam);
+        removeVerticalSeamInPlace(state.gray, seam);
+        updateEnergyAfterVerticalSeamInPlace(state.energy, state.gray, seam);
+        state.removed++;
+    }
+}
 
-    auto idx = [cols](int r, int c) { return r * cols + c; };
+// Rounded mean of two elements of an inserted seam pixel
+template <typename T>
+static inline T averageOf(T a, T b) { return static_cast<T>((a + b + 1) >> 1); }
+static inline float averageOf(float a, float b) { return (a + b) * 0.5f; }
 
-    // Edges from src to top row pixels, weight = energy of that pixel
-    for (int c = 0; c < cols; ++c) {
-        double w = energy.at<double>(0, c);
-        adj[src].push_back({ idx(0, c), w });
+// Duplicate the k seams of order[] (values < k) of the first srcCols
+// columns of dst, in place: each seam pixel is followed by the average of
+// itself and its right neighbour. Rows are rewritten right to left, so
+// every pixel moves right and is read before anything lands on it.
+template <typename F>
+static void duplicateVerticalSeams(cv::Mat& dst, int srcCols, const cv::Mat& order, int k) {
+    typedef typename F::Elem T;
+    const int cn = F::channels;
+    T pixel[cn];
+    T right[cn];
+    for (int i = 0; i < dst.rows; i++) {
+        T* row = dst.ptr<T>(i);
+        const int* o = order.ptr<int>(i);
+        int out = srcCols + k - 1;
+        std::memcpy(right, row + (srcCols - 1) * cn, sizeof(right));  // last column has no right neighbour
+        for (int j = srcCols - 1; j >= 0; j--) {
+            std::memcpy(pixel, row + j * cn, sizeof(pixel));
+            if (o[j] < k) {
+                T* copy = row + out * cn;
+                for (int c = 0; c < cn; c++) copy[c] = averageOf(pixel[c], right[c]);
+                out--;
+            }
+            std::memcpy(row + out * cn, pixel, sizeof(pixel));
+            out--;
+            std::memcpy(right, pixel, sizeof(pixel));
+        }
     }
+}
 
-    // Edges between rows (downwards, 3-connected)
-    for (int r = 0; r < rows - 1; ++r) {
-        for (int c = 0; c < cols; ++c) {
-            int u = idx(r, c);
-            for (int dc = -1; dc <= 1; ++dc) {
-                int nc = c + dc;
-                if (nc < 0 || nc >= cols) continue;
-                int v = idx(r + 1, nc);
-                double w = energy.at<double>(r + 1, nc);
-                adj[u].push_back({ v, w });
+// Horizontal counterpart of duplicateVerticalSeams: columns are rewritten
+// bottom to top, the copy goes below the seam pixel
+template <typename F>
+static void duplicateHorizontalSeams(cv::Mat& dst, int srcRows, const cv::Mat& order, int k) {
+    typedef typename F::Elem T;
+    const int cn = F::channels;
+    T pixel[cn];
+    T below[cn];
+    for (int j = 0; j < dst.cols; j++) {
+        auto at = [&](int i) { return dst.ptr<T>(i) + j * cn; };
+        int out = srcRows + k - 1;
+        std::memcpy(below, at(srcRows - 1), sizeof(below));
+        for (int i = srcRows - 1; i >= 0; i--) {
+            std::memcpy(pixel, at(i), sizeof(pixel));
+            if (order.at<int>(i, j) < k) {
+                T* copy = at(out);
+                for (int c = 0; c < cn; c++) copy[c] = averageOf(pixel[c], below[c]);
+                out--;
             }
+            std::memcpy(at(out), pixel, sizeof(pixel));
+            out--;
+            std::memcpy(below, pixel, sizeof(pixel));
         }
     }
+}
 
-    // Edges from bottom row to dst with zero extra cost
-    for (int c = 0; c < cols; ++c) {
-        int u = idx(rows - 1, c);
-        adj[u].push_back({ dst, 0.0 });
+cv::Mat SeamCarver::enlargeImage(const cv::Mat& img, int newWidth, int newHeight) {
+    if (img.empty() || !isSupportedImageType(img.type())) {
+        throw std::runtime_error("Seam insertion needs an 8-bit, 16-bit or float image with 1, 3 or 4 channels.");
+    }
+    if (newWidth < img.cols || newHeight < img.rows) {
+        throw std::runtime_error("Seam insertion can only enlarge the image.");
     }
 
-    // Dijkstra
-    const double INF = std::numeric_limits<double>::infinity();
-    std::vector<double> dist(numNodes, INF);
-    std::vector<int> parent(numNodes, -1);
+    // Every pass inserts into a view of one buffer of the final size
+    cv::Mat buffer(newHeight, newWidth, img.type());
+    img.copyTo(buffer(cv::Rect(0, 0, img.cols, img.rows)));
+    sampleMemory({ &buffer });
+    int cols = img.cols;
+    int rows = img.rows;
 
-    struct Node {
-        int v;
-        double d;
-        bool operator<(const Node& o) const { return d > o.d; } // min-heap
+    auto passSize = [](int remaining, int size) {
+        return std::min(remaining, std::max(1, static_cast<int>(size * kMaxSeamInsertFraction)));
     };
 
-    std::priority_queue<Node> pq;
-    dist[src] = 0.0;
-    pq.push({ src, 0.0 });
-
-    while (!pq.empty()) {
-        Node cur = pq.top();
-        pq.pop();
-        int u = cur.v;
-        double du = cur.d;
-
-        if (du > dist[u]) continue;
-        if (u == dst) break;
-
-        for (const auto& e : adj[u]) {
-            int v = e.to;
-            double nd = du + e.w;
-            if (nd < dist[v]) {
-                dist[v] = nd;
-                parent[v] = u;
-                pq.push({ v, nd });
-            }
-        }
-    }
-
-    // Reconstruct path from src to dst
-    std::vector<int> seam(rows, 0);
-
-    int cur = parent[dst];
-    if (cur == -1) {
-        // Fallback: if for some reason Dijkstra failed, use DP seam
-        return findVerticalSeamDP(energy);
+    if (cols < newWidth) {
+        log(LogLevel::Info, "Inserting ", newWidth - cols, " vertical seams...");
     }
-
-    std::vector<int> pathPixels;
-    while (cur != -1 && cur != src) {
-        pathPixels.push_back(cur);
-        cur = parent[cur];
+    while (cols < newWidth) {
+        // The k seams a carve would remove first, all in source coordinates
+        const int k = passSize(newWidth - cols, cols);
+        cv::Mat order = verticalRemovalOrder(toGray(buffer(cv::Rect(0, 0, cols, rows))), cols - k);
+        cv::Mat target = buffer(cv::Rect(0, 0, cols + k, rows));
+        dispatchImageFormat(target.type(), [&](auto format) {
+            duplicateVerticalSeams<decltype(format)>(target, cols, order, k);
+        });
+        cols += k;
+        seamsCarved(k);
     }
-    std::reverse(pathPixels.begin(), pathPixels.end());
 
-    // In this construction we expect exactly one pixel per row
-    if ((int)pathPixels.size() != rows) {
-        return findVerticalSeamDP(energy);
+    if (rows < newHeight) {
+        log(LogLevel::Info, "Inserting ", newHeight - rows, " horizontal seams...");
     }
-
-    for (int r = 0; r < rows; ++r) {
-        int id = pathPixels[r];
-        int c = id % cols;
-        seam[r] = c;
+    while (rows < newHeight) {
+        const int k = passSize(newHeight - rows, rows);
+        cv::Mat grayT, order;
+        cv::transpose(toGray(buffer(cv::Rect(0, 0, cols, rows))), grayT);
+        cv::transpose(verticalRemovalOrder(grayT, rows - k), order);
+        phaseStats.memory.transposeBytes += planeBytes(grayT) + planeBytes(order);
+        cv::Mat target = buffer(cv::Rect(0, 0, cols, rows + k));
+        dispatchImageFormat(target.type(), [&](auto format) {
+            duplicateHorizontalSeams<decltype(format)>(target, rows, order, k);
+        });
+        rows += k;
+        seamsCarved(k);
     }
-    return seam;
+    return buffer;
 }
 
-// Horizontal seam = vertical on transposed energy
-std::vector<int> SeamCarver::findHorizontalSeamGraphCut(const cv::Mat& energy) {
-    cv::Mat transposed;
-    cv::transpose(energy, transposed);
-    // For a transposed (cols x rows) energy, we get seam[row'] = col'
-    // which corresponds to seam[col] = row in the original image.
-    return findVerticalSeamGraphCut(transposed);
-}
-
-// Resize using graph-based seams
-cv::Mat SeamCarver::resizeImageGraphCut(int newWidth, int newHeight) {
-    cv::Mat currentImage = image.clone();
-    int currentHeight = currentImage.rows;
-    int currentWidth = currentImage.cols;
-
-    int removeVertical = currentWidth - newWidth;
-    int removeHorizontal = currentHeight - newHeight;
-
-    if (removeVertical < 0 || removeHorizontal < 0) {
-        throw std::runtime_error(
-            "Graph-cut version only supports shrinking (no expansion).");
+SeamIndexMap SeamCarver::buildSeamIndexMap(int minWidth, int minHeight) {
+    if (minWidth < 1 || minWidth > image.cols || minHeight < 1 || minHeight > image.rows) {
+        throw std::runtime_error("Seam index map minimum size must be within the image size.");
     }
+    
+    SeamIndexMap map;
+    map.minWidth = minWidth;
+    map.minHeight = minHeight;
+    map.vertical = verticalRemovalOrder(grayImage, minWidth);
+    
+    // Horizontal seams are vertical seams of the transposed plane
+    cv::Mat grayT;
+    cv::transpose(grayImage, grayT);
+    cv::transpose(verticalRemovalOrder(grayT, minHeight), map.horizontal);
+    phaseStats.memory.transposeBytes += planeBytes(grayT) + planeBytes(map.horizontal);
+    return map;
+}
 
-    // Remove vertical seams
-    for (int k = 0; k < removeVertical; ++k) {
-        cv::Mat energy = calculateEnergy(currentImage);
-        auto seam = findVerticalSeamGraphCut(energy);
-        currentImage = removeVerticalSeam(currentImage, seam);
+SeamIndexMap SeamCarver::buildSeamIndexMap(int minWidth, int minHeight, int chunk, const SeamMapCallback& partial,
+                                           const CancelToken* cancel) {
+    if (minWidth < 1 || minWidth > image.cols || minHeight < 1 || minHeight > image.rows) {
+        throw std::runtime_error("Seam index map minimum size must be within the image size.");
     }
+    RunScope run(*this, ProgressCallback(), cancel, (image.cols - minWidth) + (image.rows - minHeight));
+    chunk = std::max(chunk, 1);
 
-    // Remove horizontal seams
-    for (int k = 0; k < removeHorizontal; ++k) {
-        cv::Mat energy = calculateEnergy(currentImage);
-        auto seam = findHorizontalSeamGraphCut(energy);
-        currentImage = removeHorizontalSeam(currentImage, seam);
+    cv::Mat grayT;
+    cv::transpose(grayImage, grayT);
+    phaseStats.memory.transposeBytes += planeBytes(grayT);
+    RemovalOrder vertical = startRemovalOrder(grayImage);
+    RemovalOrder horizontal = startRemovalOrder(grayT);
+    auto current = [&]() {
+        SeamIndexMap map;
+        map.minWidth = vertical.gray.cols;
+        map.minHeight = horizontal.gray.cols;
+        map.vertical = vertical.order;
+        cv::transpose(horizontal.order, map.horizontal);
+        phaseStats.memory.transposeBytes += planeBytes(map.horizontal);
+        return map;
+    };
+    for (;;) {
+        continueRemovalOrder(vertical, minWidth, chunk);
+        continueRemovalOrder(horizontal, minHeight, chunk);
+        if (vertical.gray.cols == minWidth && horizontal.gray.cols == minHeight) break;
+        if (partial) {
+            // The orders keep growing, so the partial map gets a copy
+            SeamIndexMap map = current();
+            map.vertical = map.vertical.clone();
+            partial(map);
+        }
     }
-
-    return currentImage;
+    return current();
 }
 
-
-cv::Mat SeamCarver::removeVerticalSeam(const cv::Mat& img, const std::vector<int>& seam) {
-    int rows = img.rows;
-    int cols = img.cols;
+cv::Mat SeamCarver::renderFromSeamIndexMap(const SeamIndexMap& map, const cv::Mat& source,
+                                           int width, int height) {
+    if (map.empty() || source.size() != map.vertical.size()) {
+        throw std::runtime_error("Seam index map does not match the source image.");
+    }
+    if (width < map.minWidth || width > source.cols || height < map.minHeight || height > source.rows) {
+        throw std::runtime_error("Target size is outside the range covered by the seam index map.");
+    }
     
-    // Create new image with one less column
-    cv::Mat newImage(rows, cols - 1, img.type());
+    const int rows = source.rows;
+    const int removeVertical = source.cols - width;
+    const int removeHorizontal = rows - height;
+    const size_t elemSize = source.elemSize();
     
+    // Width: keep the pixels of each row that the first removeVertical
+    // seams did not take, carrying their horizontal order along
+    cv::Mat narrowed(rows, width, source.type());
+    cv::Mat hOrder(rows, width, CV_32S);
     for (int i = 0; i < rows; i++) {
-        int seamCol = seam[i];
-        
-        // Copy pixels before the seam
-        if (seamCol > 0) {
-            img.row(i).colRange(0, seamCol).copyTo(newImage.row(i).colRange(0, seamCol));
-        }
-        
-        // Copy pixels after the seam
-        if (seamCol < cols - 1) {
-            img.row(i).colRange(seamCol + 1, cols).copyTo(
-                newImage.row(i).colRange(seamCol, cols - 1));
+        const int* v = map.vertical.ptr<int>(i);
+        const int* h = map.horizontal.ptr<int>(i);
+        const uchar* src = source.ptr<uchar>(i);
+        uchar* dst = narrowed.ptr<uchar>(i);
+        int* ho = hOrder.ptr<int>(i);
+        int o = 0;
+        for (int j = 0; j < source.cols; j++) {
+            if (v[j] >= removeVertical) {
+                std::memcpy(dst + o * elemSize, src + j * elemSize, elemSize);
+                ho[o++] = h[j];
+            }
         }
     }
+    if (removeHorizontal == 0) {
+        return narrowed;
+    }
     
-    return newImage;
-}
-
-cv::Mat SeamCarver::removeHorizontalSeam(const cv::Mat& img, const std::vector<int>& seam) {
-    int rows = img.rows;
-    int cols = img.cols;
-    
-    // Create new image with one less row
-    cv::Mat newImage(rows - 1, cols, img.type());
-    
-    for (int j = 0; j < cols; j++) {
-        int seamRow = seam[j];
-        
-        // Copy pixels before the seam
-        if (seamRow > 0) {
-            img.col(j).rowRange(0, seamRow).copyTo(newImage.col(j).rowRange(0, seamRow));
+    // Height: drop the removeHorizontal earliest-removed pixels per column
+    // (exactly the first removeHorizontal seams when the width is untouched)
+    cv::Mat out(height, width, source.type());
+    std::vector<long long> keys(rows);
+    for (int j = 0; j < width; j++) {
+        for (int i = 0; i < rows; i++) {
+            keys[i] = (static_cast<long long>(hOrder.at<int>(i, j)) << 32) | i;
         }
-        
-        // Copy pixels after the seam
-        if (seamRow < rows - 1) {
-            img.col(j).rowRange(seamRow + 1, rows).copyTo(
-                newImage.col(j).rowRange(seamRow, rows - 1));
+        std::nth_element(keys.begin(), keys.begin() + (removeHorizontal - 1), keys.end());
+        long long cut = keys[removeHorizontal - 1];
+        int o = 0;
+        for (int i = 0; i < rows; i++) {
+            long long key = (static_cast<long long>(hOrder.at<int>(i, j)) << 32) | i;
+            if (key > cut) {
+                std::memcpy(out.ptr<uchar>(o++) + j * elemSize, narrowed.ptr<uchar>(i) + j * elemSize, elemSize);
+            }
         }
     }
-    
-    return newImage;
+    return out;
 }
 
-cv::Mat SeamCarver::resizeImage(int newWidth, int newHeight, bool useDP) {
-    cv::Mat currentImage = image.clone();
-    int currentHeight = currentImage.rows;
-    int currentWidth = currentImage.cols;
-    
-    std::cout << "Resizing from (" << currentWidth << "x" << currentHeight 
-              << ") to (" << newWidth << "x" << newHeight << ")" << std::endl;
-    std::cout << "Using method: " << (useDP ? "Dynamic Programming" : "Greedy") << std::endl;
-    
-    // Remove vertical seams (reduce width)
-    int numVerticalSeams = currentWidth - newWidth;
-    if (numVerticalSeams > 0) {
-        std::cout << "Removing " << numVerticalSeams << " vertical seams..." << std::endl;
-        for (int i = 0; i < numVerticalSeams; i++) {
-            cv::Mat energy = calculateEnergy(currentImage);
-            
-            std::vector<int> seam;
-            if (useDP) {
-                seam = findVerticalSeamDP(energy);
-            } else {
-                seam = findVerticalSeamGreedy(energy);
+SeamIndexGrid SeamCarver::buildSeamIndexGrid(const SeamIndexMap& map, int levels, const CancelToken* cancel) {
+    if (map.empty() || map.vertical.size() != grayImage.size()) {
+        throw std::runtime_error("Seam index map does not match the image.");
+    }
+    RunScope run(*this, ProgressCallback(), cancel, 0);
+    const int cols = grayImage.cols;
+    const int rows = grayImage.rows;
+    levels = std::max(1, std::min(levels, cols - map.minWidth + 1));
+
+    SeamIndexGrid grid;
+    grid.map = map;
+    for (int k = 0; k < levels; k++) {
+        const int w = levels == 1 ? cols
+                                  : cols - static_cast<int>(static_cast<long long>(k) * (cols - map.minWidth) / (levels - 1));
+        if (!grid.widths.empty() && grid.widths.back() == w) continue;
+        grid.widths.push_back(w);
+    }
+
+    // Rung 0 is the unnarrowed image, whose horizontal order the map holds
+    grid.horizontal.push_back(map.horizontal);
+    cv::Mat grayT;
+    for (size_t k = 1; k < grid.widths.size(); k++) {
+        cv::transpose(renderFromSeamIndexMap(map, grayImage, grid.widths[k], rows), grayT);
+        cv::Mat order;
+        cv::transpose(verticalRemovalOrder(grayT, map.minHeight), order);
+        phaseStats.memory.transposeBytes += planeBytes(grayT) + planeBytes(order);
+        grid.horizontal.push_back(order);
+        log(LogLevel::Debug, "Seam grid rung ", k, "/", grid.widths.size() - 1, " at width ", grid.widths[k]);
+    }
+    return grid;
+}
+
+cv::Mat SeamCarver::renderFromSeamIndexGrid(const SeamIndexGrid& grid, const cv::Mat& source,
+                                            int width, int height) {
+    const SeamIndexMap& map = grid.map;
+    if (grid.empty() || source.size() != map.vertical.size()) {
+        throw std::runtime_error("Seam index grid does not match the source image.");
+    }
+    if (width < map.minWidth || width > source.cols || height < map.minHeight || height > source.rows) {
+        throw std::runtime_error("Target size is outside the range covered by the seam index grid.");
+    }
+
+    // The narrowest rung that still holds the target width
+    size_t k = 0;
+    while (k + 1 < grid.widths.size() && grid.widths[k + 1] >= width) k++;
+    const int rungWidth = grid.widths[k];
+    const int rungCut = source.cols - rungWidth;
+    const int removeHorizontal = source.rows - height;
+    const cv::Mat& hOrder = grid.horizontal[k];
+    const size_t elemSize = source.elemSize();
+
+    // One pass over the source: the pixels of the rung image go up by the
+    // pixels the first removeHorizontal seams took above them in their
+    // rung column (exactly one per seam, as the seams are connected there)
+    cv::Mat rung(height, rungWidth, source.type());
+    cv::Mat vOrder;
+    if (rungWidth > width) vOrder.create(height, rungWidth, CV_32S);
+    std::vector<int> removedAbove(rungWidth, 0);
+    for (int i = 0; i < source.rows; i++) {
+        const int* v = map.vertical.ptr<int>(i);
+        const int* h = hOrder.ptr<int>(i);
+        const uchar* src = source.ptr<uchar>(i);
+        int c = 0;
+        for (int j = 0; j < source.cols; j++) {
+            if (v[j] < rungCut) continue;
+            if (h[c] < removeHorizontal) {
+                removedAbove[c]++;
             }
-            
-            currentImage = removeVerticalSeam(currentImage, seam);
-            
-            if ((i + 1) % 10 == 0 || (i + 1) == numVerticalSeams) {
-                std::cout << "  Removed " << (i + 1) << "/" << numVerticalSeams 
-                          << " vertical seams" << std::endl;
+            else {
+                const int r = i - removedAbove[c];
+                std::memcpy(rung.ptr<uchar>(r) + c * elemSize, src + j * elemSize, elemSize);
+                if (!vOrder.empty()) vOrder.at<int>(r, c) = v[j];
             }
+            c++;
         }
     }
-    
-    // Remove horizontal seams (reduce height)
-    int numHorizontalSeams = currentHeight - newHeight;
-    if (numHorizontalSeams > 0) {
-        std::cout << "Removing " << numHorizontalSeams << " horizontal seams..." << std::endl;
-        for (int i = 0; i < numHorizontalSeams; i++) {
-            cv::Mat energy = calculateEnergy(currentImage);
-            
-            std::vector<int> seam;
-            if (useDP) {
-                seam = findHorizontalSeamDP(energy);
-            } else {
-                seam = findHorizontalSeamGreedy(energy);
-            }
-            
-            currentImage = removeHorizontalSeam(currentImage, seam);
-            
-            if ((i + 1) % 10 == 0 || (i + 1) == numHorizontalSeams) {
-                std::cout << "  Removed " << (i + 1) << "/" << numHorizontalSeams 
-                          << " horizontal seams" << std::endl;
+    if (rungWidth == width) {
+        return rung;
+    }
+
+    // Between rungs: drop the earliest-removed pixels left in each row
+    const int removeVertical = rungWidth - width;
+    cv::Mat out(height, width, source.type());
+    std::vector<long long> keys(rungWidth);
+    for (int i = 0; i < height; i++) {
+        const int* v = vOrder.ptr<int>(i);
+        for (int c = 0; c < rungWidth; c++) keys[c] = (static_cast<long long>(v[c]) << 32) | c;
+        std::nth_element(keys.begin(), keys.begin() + (removeVertical - 1), keys.end());
+        const long long cut = keys[removeVertical - 1];
+        const uchar* src = rung.ptr<uchar>(i);
+        uchar* dst = out.ptr<uchar>(i);
+        int o = 0;
+        for (int c = 0; c < rungWidth; c++) {
+            if (((static_cast<long long>(v[c]) << 32) | c) > cut) {
+                std::memcpy(dst + o++ * elemSize, src + c * elemSize, elemSize);
             }
         }
     }
-    
-    std::cout << "Resizing complete!" << std::endl;
-    image = currentImage;
-    return currentImage;
+    return out;
 }
 
-cv::Mat SeamCarver::visualizeSeam(const std::vector<int>& seam, bool isVertical) {
-    cv::Mat visImage = image.clone();
+template <typename F>
+static void overlaySeamPixels(cv::Mat& img, const std::vector<int>& seam, bool isVertical,
+                              const cv::Scalar& color) {
+    typedef typename F::Elem T;
+    T pixel[F::channels];
+    for (int k = 0; k < F::channels; k++) {
+        pixel[k] = fromByte<T>(color[k]);
+    }
     
-    if (isVertical) {
-        for (int i = 0; i < static_cast<int>(seam.size()); i++) {
-            int j = seam[i];
-            if (j >= 0 && j < visImage.cols && i >= 0 && i < visImage.rows) {
-                visImage.at<cv::Vec3b>(i, j) = cv::Vec3b(0, 0, 255);  // Red color in BGR
-            }
-        }
-    } else {
-        for (int j = 0; j < static_cast<int>(seam.size()); j++) {
-            int i = seam[j];
-            if (i >= 0 && i < visImage.rows && j >= 0 && j < visImage.cols) {
-                visImage.at<cv::Vec3b>(i, j) = cv::Vec3b(0, 0, 255);  // Red color in BGR
-            }
+    // Only the seam pixels are touched
+    for (int t = 0; t < static_cast<int>(seam.size()); t++) {
+        int i = isVertical ? t : seam[t];
+        int j = isVertical ? seam[t] : t;
+        if (i >= 0 && i < img.rows && j >= 0 && j < img.cols) {
+            std::memcpy(img.ptr<T>(i) + j * F::channels, pixel, sizeof(pixel));
         }
     }
-    
+}
+
+void SeamCarver::overlaySeam(cv::Mat& img, const std::vector<int>& seam, bool isVertical,
+                             const cv::Scalar& color) const {
+    dispatchImageFormat(img.type(), [&](auto format) {
+        overlaySeamPixels<decltype(format)>(img, seam, isVertical, color);
+    });
+}
+
+cv::Mat SeamCarver::visualizeSeam(const std::vector<int>& seam, bool isVertical) {
+    cv::Mat visImage = image.clone();
+    overlaySeam(visImage, seam, isVertical);
     return visImage;
 }
\ No newline at end of file
@@ -1,10 +1,269 @@
 #ifndef SEAM_CARVER_H
 #define SEAM_CARVER_H
 
+#include "SeamLog.h"
+#include "SeamMask.h"
+#include "SeamMemory.h"
+#include "SeamProgress.h"
+#include "SeamStats.h"
 #include <opencv2/opencv.hpp>
+#include <chrono>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <limits>
+#include <memory>
+#include <algorithm>
+#include <initializer_list>
+
+/**
+ * @brief Numeric precision of the energy -> DP -> backtrack pipeline.
+ *  - Double:  CV_64F energy, double cumulative cost (reference)
+ *  - Float:   CV_32F energy, float cumulative cost
+ *  - Fixed16: CV_16U energy scaled by SeamCarver::kFixedEnergyScale,
+ *             32-bit integer cumulative cost; images with a side longer
+ *             than SeamCarver::kMaxFixedSeamLength carve at Float
+ */
+enum class EnergyPrecision {
+    Double,
+    Float,
+    Fixed16
+};
+
+/**
+ * @brief Seam cost model of the DP seam finders used by resizeImage.
+ *  - Backward: sum of the removed pixels' gradient energy (calculateEnergy)
+ *  - Forward:  intensity differences of the pixels that become neighbours
+ *              when the seam is removed, computed inside the DP update
+ */
+enum class EnergyModel {
+    Backward,
+    Forward
+};
+
+/**
+ * @brief Order of the seams when resizeImage shrinks both dimensions.
+ *  - WidthFirst: all vertical seams, then all horizontal ones
+ *  - Optimal:    the interleaving of least total seam energy, from the
+ *                transport map of Avidan & Shamir (optimalSeamOrder)
+ *  - Cheapest:   per step, the cheaper of the best vertical and the best
+ *                horizontal seam, searched at once (findCheapestSeamDP);
+ *                a greedy take on Optimal at about one search per seam
+ */
+enum class SeamOrder {
+    WidthFirst,
+    Optimal,
+    Cheapest
+};
+
+/**
+ * @brief Per-pixel energy of the backward seam cost (calculateEnergy).
+ *  - Sobel:        3x3 Sobel gradient magnitude (reference)
+ *  - Scharr:       3x3 Scharr gradient magnitude, scaled to the Sobel range
+ *  - DualGradient: magnitude of the central differences
+ *  - L1Gradient:   |dx| + |dy| of the central differences, the cheapest
+ *  - Saliency:     Sobel magnitude weighted by frequency-tuned saliency
+ *  - FastSobel:    Sobel with max(|gx|,|gy|) + min(|gx|,|gy|) / 2 in place
+ *                  of the magnitude: integer-only, at most 12% above it
+ * Forward energy is a seam cost model rather than a map (EnergyModel).
+ */
+enum class EnergyFunction {
+    Sobel,
+    Scharr,
+    DualGradient,
+    L1Gradient,
+    Saliency,
+    FastSobel
+};
+
+/**
+ * @brief Tie-breaking rule of every minimal-seam search. The DP in all of
+ * its storage modes and thread counts, the fused, pyramid, streaming and
+ * OpenCL paths and the graph solvers all follow it, so they return the
+ * same seam for the same costs:
+ *  - the seam ends at the first (lowest index) cheapest last-layer pixel;
+ *  - from each pixel it steps back to the parent straight above, unless
+ *    the left one is strictly cheaper, unless the right one is strictly
+ *    cheaper than both (seamParentOffset).
+ * Costs are compared as the accumulated values the search computes, so
+ * the result does not depend on evaluation order; only a different
+ * precision may break a near-tie the other way.
+ */
+template <typename Acc>
+inline int seamParentOffset(const Acc& left, const Acc& up, const Acc& right) {
+    int offset = 0;
+    Acc best = up;
+    if (left < best) { best = left; offset = -1; }
+    if (right < best) offset = 1;
+    return offset;
+}
+
+/**
+ * @brief seamParentOffset for seams that move up to Step positions per
+ * layer ((2 * Step + 1)-connected, SeamCarver::setSeamStep). above points
+ * at the parent straight above, with Step readable costs on each side. A
+ * farther parent wins only if strictly cheaper than every nearer one, and
+ * of the two at one distance the left is tried first, so
+ * seamParentStep<1> is seamParentOffset.
+ */
+template <int Step, typename Acc>
+inline int seamParentStep(const Acc* above) {
+    int offset = 0;
+    Acc best = above[0];
+    for (int d = 1; d <= Step; d++) {
+        if (above[-d] < best) { best = above[-d]; offset = -d; }
+        if (above[d] < best) { best = above[d]; offset = d; }
+    }
+    return offset;
+}
+
+// @brief Order of preference of a parent offset under seamParentOffset.
+inline int seamParentRank(int offset) {
+    return offset == 0 ? 0 : offset < 0 ? 1 : 2;
+}
+
+// @brief Index of the first cheapest of count costs: where a seam ends.
+template <typename Acc>
+inline int seamEndIndex(const Acc* costs, int count) {
+    return static_cast<int>(std::min_element(costs, costs + count) - costs);
+}
+
+/**
+ * @brief Working storage of the DP seam finder.
+ *  - FullTable:    full cumulative cost table, backtrack re-reads it
+ *  - Backpointers: two rolling cost rows plus an int8 parent offset plane
+ *                  (~1 byte per pixel), backtrack just follows the offsets
+ */
+enum class DPStorage {
+    FullTable,
+    Backpointers
+};
+
+/**
+ * @brief Shortest-path solver used by the graph seam finders.
+ *  - Dijkstra:      binary-heap Dijkstra, valid for any non-negative edge cost
+ *  - DagRelaxation: relax the layered seam DAG in topological order
+ *                   (one pass, no priority queue)
+ *  - AStar:         Dijkstra guided by the sum of the per-row minimum
+ *                   energies of the rows left, a consistent lower bound, so
+ *                   clear low-energy corridors settle far fewer pixels
+ * All three return the DP's seam on the same costs (seamParentOffset);
+ * A* on floating-point costs up to the rounding of its bound.
+ */
+enum class GraphSolver {
+    Dijkstra,
+    DagRelaxation,
+    AStar
+};
+
+/**
+ * @brief Priority queue used by the Dijkstra graph solver.
+ *  - BinaryHeap: std::vector binary heap, works for every precision
+ *  - Bucket:     Dial's monotone bucket queue (Fixed16 energy only)
+ *  - Radix:      radix heap over integer keys (Fixed16 energy only)
+ * Floating-point energy always uses the binary heap.
+ */
+enum class GraphQueue {
+    BinaryHeap,
+    Bucket,
+    Radix
+};
+
+/**
+ * @brief Node state of the graph seam finders.
+ *  - Full:    distances of the precision's cost type and a node id parent
+ *             per pixel; 12 bytes per pixel with double energy, plus
+ *             16-byte heap entries
+ *  - Compact: float distances for double energy, a 2-bit parent column
+ *             offset per pixel (the parent layer is implied) and 8-byte
+ *             heap entries; under 4.3 bytes per pixel. With double energy
+ *             seams may differ where float rounding breaks near-ties
+ */
+enum class GraphStorage {
+    Full,
+    Compact
+};
+
+/**
+ * @brief Seam finder of SeamCarver::resize.
+ *  - DP:       exact minimum seam (backward or forward energy model)
+ *  - Greedy:   cheapest neighbour per row (beam and multi-start settings)
+ *  - Pyramid:  coarse-to-fine DP over an energy pyramid
+ *  - GraphCut: shortest path on the pixel graph (graph solver settings)
+ */
+enum class SeamStrategy {
+    DP,
+    Greedy,
+    Pyramid,
+    GraphCut
+};
+
+/**
+ * @brief Everything SeamCarver::resize needs besides the image. The carving
+ * fields become the carver's settings, as if set with the matching setters
+ * (setPrecision, setSeamBatchSize, ...); settings of one finder only (beam
+ * width, pyramid levels, graph solver) stay as set on the carver.
+ */
+struct ResizeOptions {
+    int width = 0;   // target size; larger than the image = seam insertion
+    int height = 0;
+    SeamStrategy strategy = SeamStrategy::DP;
+    EnergyModel energyModel = EnergyModel::Backward;  // DP only
+    EnergyFunction energyFunction = EnergyFunction::Sobel;
+    EnergyPrecision precision = EnergyPrecision::Double;
+    SeamOrder seamOrder = SeamOrder::WidthFirst;      // DP only
+    int seamBatch = 1;                                // DP only; or SeamCarver::kAdaptiveSeamBatch
+    bool incrementalEnergy = false;
+    bool incrementalDP = false;
+    unsigned energyThreads = 1;
+    unsigned dpThreads = 1;
+    bool bidirectionalDP = false;
+    int lazyRemoval = 0;                              // SeamCarver::setLazyRemoval
+    int seamStep = 1;                                 // DP and greedy; SeamCarver::setSeamStep
+    double carveQuality = 1.0;                        // below 1: scale first (SeamCarver::hybridScaleSize)
+    double borderTrim = -1.0;                         // 0 or above: crop flat borders first (SeamCarver::flatBorderCrop)
+    cv::Rect region;                                  // empty: whole image; else seams stay inside (SeamCarver::resize)
+    ProgressCallback progress;                        // may be empty
+    const CancelToken* cancel = nullptr;              // may be null
+};
+
+/**
+ * @brief Removal order of every pixel of a source image, recorded by
+ * SeamCarver::buildSeamIndexMap. Any size between the minimum and the source
+ * size can then be rendered with one filter pass, without energy or DP work.
+ */
+struct SeamIndexMap {
+    // Order value of pixels that no seam removed
+    static constexpr int kKept = std::numeric_limits<int>::max();
+
+    cv::Mat vertical;    // CV_32S, source size: index of the vertical seam that removed the pixel
+    cv::Mat horizontal;  // CV_32S, source size: index of the horizontal seam that removed the pixel
+    int minWidth = 0;    // narrowest renderable width
+    int minHeight = 0;   // lowest renderable height
+
+    bool empty() const { return vertical.empty(); }
+};
+
+/**
+ * @brief Two-dimensional lookup of any width x height below the source,
+ * built by SeamCarver::buildSeamIndexGrid from a SeamIndexMap. The path to
+ * a size is fixed: vertical seams of the map first, then horizontal seams
+ * carved from the narrowed image. The horizontal order is recorded at a
+ * ladder of widths, so a target on the ladder renders exactly as that
+ * path carves it, and one between two rungs loses its last few columns
+ * per row by vertical order. Costs one int plane per rung.
+ */
+struct SeamIndexGrid {
+    static constexpr int kDefaultLevels = 16;
+
+    SeamIndexMap map;                 // vertical order of the source; horizontal is rung 0
+    std::vector<int> widths;          // rung widths, from the source width down to map.minWidth
+    std::vector<cv::Mat> horizontal;  // CV_32S, rows x widths[k]: horizontal order at rung k
+
+    bool empty() const { return widths.empty(); }
+};
+
+class ThreadPool;
 
 /**
  * @brief SeamCarver class for content-aware image resizing
@@ -12,67 +271,676 @@
  * Implements seam carving algorithm using:
  *  - Dynamic Programming (DP)
  *  - Greedy
+ *  - Coarse-to-fine DP over an energy pyramid
  *  - Graph-based shortest path (Dijkstra on a pixel graph)
  */
 class SeamCarver {
 public:
+    // setSeamBatchSize value that sizes each batch from the remaining work
+    static constexpr int kAdaptiveSeamBatch = 0;
+
+    // Smallest corridor half-width accepted by setPyramidCorridor
+    static constexpr int kMinPyramidCorridor = 2;
+
+    // Widest seam step instantiated (setSeamStep)
+    static constexpr int kMaxSeamStep = 3;
+
+    // Longest side of the images resize carves on the small-image path
+    // (setSmallImagePath)
+    static constexpr int kSmallImageSide = 256;
+
+    // Largest share of the current width (height) enlargeImage inserts per
+    // pass; more seams from one carve would pile up in one flat region
+    static constexpr double kMaxSeamInsertFraction = 0.5;
+
+    // Largest share of a hybrid resize's intermediate size left to carving,
+    // and the longest side of the copy its energy share is measured on
+    static constexpr double kMaxHybridCarveShare = 0.9;
+    static constexpr int kHybridProbeSide = 256;
+
+    // Rows per band below which calculateEnergyFromGray uses fewer threads
+    static constexpr int kMinEnergyBandRows = 64;
+
+    // Rows (columns) per band below which a carve removes a seam with fewer
+    // threads; a band is only a few microseconds of row shifts
+    static constexpr int kMinRemovalBandLines = 256;
+
+    // Columns per chunk below which findVerticalSeamDP uses fewer threads,
+    // and rows per synchronisation step of the parallel DP
+    static constexpr int kMinDPChunkColumns = 512;
+    static constexpr int kDPTileRows = 32;
+
+    // Strength of the saliency weighting of EnergyFunction::Saliency: the
+    // least salient pixels keep 1 / (1 + gain) of their gradient energy
+    static constexpr double kSaliencyGain = 4.0;
+
+    // Scale applied to gradient magnitudes in EnergyPrecision::Fixed16 mode.
+    // The largest Sobel magnitude (~1443) still fits in 16 bits.
+    static constexpr float kFixedEnergyScale = 16.0f;
+
+    // Longest seam (rows of a vertical, columns of a horizontal one) whose
+    // Fixed16 cost fits the CV_32S table even if every pixel is 65535
+    static constexpr int kMaxFixedSeamLength = std::numeric_limits<int>::max() / 65535;
+
     /**
      * @brief Construct from an image file on disk.
      */
     explicit SeamCarver(const std::string& imagePath);
 
+    /**
+     * @brief Construct from an already decoded BGR image (deep copied).
+     */
+    explicit SeamCarver(const cv::Mat& img);
+
+    /**
+     * @brief Construct from a decoded BGR image, taking over its buffer
+     * without copying.
+     */
+    explicit SeamCarver(cv::Mat&& img);
+
+    /**
+     * @brief Wrap caller-owned pixels without copying (zero-copy).
+     * The buffer must outlive the carver and stay unchanged; carving
+     * never writes into it.
+     * @param pixels first pixel of the top row
+     * @param stride bytes between the starts of consecutive rows
+     * @param type   OpenCV pixel type (CV_8UC3 for BGR), see isSupportedImageType
+     */
+    SeamCarver(uchar* pixels, int width, int height, size_t stride, int type);
+
+    /**
+     * @brief Construct from an encoded image (PNG, JPEG, ...) held in memory.
+     */
+    SeamCarver(const uchar* encoded, size_t size);
+
+    /**
+     * @brief Replace the image with a new one; the constructor overloads
+     * take the same arguments. Settings and reusable buffers are kept.
+     */
+    void reset(const std::string& imagePath);
+    void reset(const cv::Mat& img);
+    void reset(cv::Mat&& img);
+    void reset(uchar* pixels, int width, int height, size_t stride, int type);
+    void reset(const uchar* encoded, size_t size);
+
+    /**
+     * @brief Pixel types a carver accepts: 8-bit, 16-bit and float, with 1
+     * (gray), 3 (BGR) or 4 (BGRA) channels. Removal, energy patching,
+     * overlay and insertion have kernels specialised for each of them; the
+     * constructors throw std::runtime_error for any other type.
+     */
+    static bool isSupportedImageType(int type);
+
+    ~SeamCarver();
+    SeamCarver(SeamCarver&&) noexcept;
+    SeamCarver& operator=(SeamCarver&&) noexcept;
+
     /**
      * @brief Compute gradient-based energy map for an image.
-     * The result is CV_64F, same size as input.
+     * The result has the depth selected by setPrecision (CV_64F by default),
+     * same size as input, and uses the kernel selected by setEnergyFunction.
      */
     cv::Mat calculateEnergy(const cv::Mat& img);
 
+    /**
+     * @brief Convert an image to the CV_8U grayscale plane used for energy.
+     * 16-bit and float images are scaled to 8 bits first (65535 and 1.0
+     * map to 255).
+     */
+    cv::Mat toGray(const cv::Mat& img);
+
+    /**
+     * @brief Compute the energy map from an already converted grayscale plane.
+     * Same result as calculateEnergy on the color image, without the color
+     * conversion.
+     */
+    cv::Mat calculateEnergyFromGray(const cv::Mat& gray);
+
+    /**
+     * @brief Select the per-pixel energy (Sobel by default). The choice is a
+     * template parameter of the energy loops, so no kernel costs a call per
+     * pixel. All seam methods use it; forward-energy DP does not.
+     */
+    void setEnergyFunction(EnergyFunction function) { energyFunction = function; }
+    EnergyFunction getEnergyFunction() const { return energyFunction; }
+
+    /**
+     * @brief Remove a vertical seam from an energy map and recompute only the
+     * pixels whose 3x3 neighbourhood touched the seam. Saliency-weighted
+     * maps depend on the whole image and are recomputed in full.
+     * @param energy    energy of the image before the seam was removed
+     * @param carvedImg image (or CV_8U gray plane) after the seam was removed
+     * @param seam      seam[row] = removed column index
+     * @return energy map matching carvedImg
+     */
+    cv::Mat updateEnergyAfterVerticalSeam(const cv::Mat& energy, const cv::Mat& carvedImg,
+                                          const std::vector<int>& seam);
+
+    /**
+     * @brief Horizontal counterpart of updateEnergyAfterVerticalSeam.
+     * @param seam seam[col] = removed row index
+     */
+    cv::Mat updateEnergyAfterHorizontalSeam(const cv::Mat& energy, const cv::Mat& carvedImg,
+                                            const std::vector<int>& seam);
+
+    /**
+     * @brief In-place versions of the energy updates above: the seam is
+     * removed from energy within its existing buffer (see
+     * removeVerticalSeamInPlace) before the band is recomputed.
+     */
+    void updateEnergyAfterVerticalSeamInPlace(cv::Mat& energy, const cv::Mat& carvedImg,
+                                              const std::vector<int>& seam);
+    void updateEnergyAfterHorizontalSeamInPlace(cv::Mat& energy, const cv::Mat& carvedImg,
+                                                const std::vector<int>& seam);
+
+    /**
+     * @brief Keep the energy map alive across seams in resizeImage and
+     * resizeImageGraphCut instead of recomputing it from scratch.
+     */
+    void setIncrementalEnergy(bool enabled) { incrementalEnergy = enabled; }
+    bool isIncrementalEnergy() const { return incrementalEnergy; }
+
+    /**
+     * @brief Energy map of the current image (e.g. from a CarveCache) for
+     * the next resizeImage / resizeImagePyramid / resizeImageGraphCut to
+     * start from instead of computing it. Used once, and only if it has the
+     * image size and the depth of the current precision; the carver may
+     * modify it.
+     */
+    void setInitialEnergy(cv::Mat energy) { initialEnergy = std::move(energy); }
+
+    /**
+     * @brief Calls and wall time per hot-path phase (SeamPhase) since
+     * construction or resetStats, from this carver's own thread; helper
+     * threads are covered by the span of the call that waits for them.
+     * All zero when built with SEAMCARVER_STATS=0, where the timers
+     * compile to nothing; the memory counters (MemoryStats) are kept.
+     */
+    const SeamCarverStats& stats() const { return phaseStats; }
+    void resetStats() { phaseStats.reset(); }
+    // @brief Zero only the memory counters, e.g. to account one run.
+    void resetMemoryStats() { phaseStats.memory = MemoryStats(); }
+
+    // @brief Raise the peak of the memory stats to the seam workspaces plus
+    // planes. Called after every carving step, and by callers driving the
+    // seam finders themselves (CarveSession) with their own planes.
+    void sampleMemory(std::initializer_list<const cv::Mat*> planes);
+
+    // @brief Bytes held by the scratch planes of the seam kernels. They only
+    // grow, so the growth across a call is what the call allocated.
+    size_t workspaceBytes() const;
+
+    /**
+     * @brief Record a span per seam step and per phase (and per helper
+     * thread share of the parallel energy and DP) into trace, or stop with
+     * nullptr. Not owned; one trace may be shared by carvers on several
+     * threads. Phase spans are compiled out with SEAMCARVER_STATS=0.
+     */
+    void setTrace(SeamTrace* trace) { phaseStats.trace = trace; }
+    SeamTrace* getTrace() const { return phaseStats.trace; }
+
+    /**
+     * @brief Send log messages up to level to logger (e.g. streamLogger).
+     * Without a logger the carver is silent, and messages above the level
+     * are never formatted, so the carving loops do no I/O.
+     */
+    void setLogger(SeamLogger logger, LogLevel level = LogLevel::Info) {
+        this->logger = std::move(logger);
+        logLevel = this->logger ? level : LogLevel::Silent;
+    }
+    LogLevel getLogLevel() const { return logLevel; }
+
+    /**
+     * @brief Regions to preserve and to carve first (CV_8UC1 of the image
+     * size, nonzero = marked; either may be empty). Kept bit-packed
+     * (SeamMask) and carved with the image, so it follows resizeImage and
+     * resizeImagePyramid; it is dropped when seams are inserted. Before each
+     * seam search the marked pixels' energy is overwritten with
+     * +/-SeamMask::kProtectEnergy; graph cut, which needs non-negative
+     * costs, searches the equivalent shifted map (SeamMask::applyShiftedTo).
+     * Under EnergyPrecision::Fixed16 energy maps are made at Float while a
+     * mask is set.
+     * DP resizes fall back from forward to backward energy and from the
+     * fused DP to the map path while a mask is set. Replaced on reset.
+     */
+    void setMask(const cv::Mat& protect, const cv::Mat& remove);
+    void clearMask() { mask = SeamMask(); }
+    const SeamMask& getMask() const { return mask; }
+
+    /**
+     * @brief Object removal: carve DP seams until no pixel of the remove
+     * mask is left, each step taking the vertical or horizontal seam of
+     * lower mean energy. The loop ends on the mask's running count, so no
+     * step rescans it. With restoreSize the image is enlarged back to its
+     * size with enlargeImage. Like resizeImage the result becomes the
+     * current image. Throws std::runtime_error if a step removes none of
+     * the marked pixels (protected pixels wall them in, or no seam through
+     * them is cheaper than one around them) or the object covers the image.
+     */
+    cv::Mat removeObject(bool restoreSize = false);
+
+    /**
+     * @brief Threads used by calculateEnergy / calculateEnergyFromGray
+     * (default 1). Full recomputes are split into row bands with one-row
+     * halos, each band at least kMinEnergyBandRows tall; the result is
+     * identical to the single-threaded map. Carves also remove each seam
+     * and patch the incremental energy in bands of at least
+     * kMinRemovalBandLines rows (columns). The carver keeps threads - 1
+     * helper threads alive for this.
+     */
+    void setEnergyThreads(unsigned threads);
+    unsigned getEnergyThreads() const { return energyThreads; }
+
+    /**
+     * @brief Threads used by findVerticalSeamDP (default 1). Wide maps are
+     * split into column chunks of at least kMinDPChunkColumns, filled in
+     * trapezoidal tiles of kDPTileRows rows so threads synchronise twice
+     * per tile rather than once per row. Uses the full cost table whatever
+     * the DP storage mode; the seam is unchanged. Shares its helper threads
+     * with setEnergyThreads.
+     */
+    void setDPThreads(unsigned threads);
+    unsigned getDPThreads() const { return dpThreads; }
+
+    /**
+     * @brief Find single DP seams from both ends at once (default off):
+     * the upper half of the map is filled top-down on the calling thread
+     * while a helper fills the lower half bottom-up, and the seam is the
+     * cheapest pair of neighbouring pixels across the middle, traced out
+     * through both tables. That halves a seam's critical path on two cores
+     * with a single synchronisation, where the column chunks of
+     * setDPThreads need two per kDPTileRows rows and a wide map. Used by
+     * findVerticalSeamDP and findHorizontalSeamDP when dpThreads is at
+     * least 2 and the map splits into fewer than three column chunks. The
+     * seam is a cheapest one, but a tie (or a float near-tie, the halves
+     * being summed apart) may be broken differently from the one-way DP.
+     */
+    void setBidirectionalDP(bool enabled) { bidirectionalDP = enabled; }
+    bool isBidirectionalDP() const { return bidirectionalDP; }
+
+    /**
+     * @brief Run the helper shares of the energy, DP and removal kernels on
+     * pool instead of the carver's own helper threads; nullptr goes back
+     * to them. The pool may be shared with other carvers and with the jobs
+     * calling this one: the thread counts still set how many shares a
+     * kernel is split into, and a carver running on a pool worker carves
+     * its own queued shares while it waits for the others, so idle workers
+     * take over the rest (see ThreadPool).
+     */
+    void setThreadPool(std::shared_ptr<ThreadPool> pool);
+
+    /**
+     * @brief Select the precision of energy maps produced by calculateEnergy.
+     * All seam finders accept CV_64F, CV_32F and CV_16U energy maps and use
+     * the matching cumulative cost type. Fixed16 maps of images with a side
+     * longer than kMaxFixedSeamLength, or while a mask is set, are made at
+     * Float instead; the seam finders throw std::runtime_error on a CV_16U
+     * map longer than that.
+     */
+    void setPrecision(EnergyPrecision p) { precision = p; }
+    EnergyPrecision getPrecision() const { return precision; }
+
+    /**
+     * @brief Select the DP working storage. Both modes return the same seam.
+     */
+    void setDPStorage(DPStorage storage) { dpStorage = storage; }
+    DPStorage getDPStorage() const { return dpStorage; }
+
+    /**
+     * @brief Placement of the large scratch planes of the seam kernels (DP
+     * cost tables, parent offsets, energy and gradient maps; see
+     * BufferPlacement). Huge pages cut the TLB misses of the DP's row
+     * sweeps over large images, and a NUMA node keeps a pinned batch
+     * worker's planes in its local memory. The planes held so far are
+     * dropped and regrow under the new placement; the defaults allocate as
+     * before. Results are identical.
+     */
+    void setBufferPlacement(const BufferPlacement& placement);
+    const BufferPlacement& getBufferPlacement() const { return bufferPlacement; }
+
+    /**
+     * @brief Run the height-reduction phase of resizeImage and
+     * resizeImageGraphCut on transposed image/gray/energy planes, so each
+     * horizontal seam is removed with contiguous row shifts. The planes are
+     * transposed once per phase. On by default; results are identical.
+     */
+    void setTransposeHorizontalPhase(bool enabled) { transposeHorizontalPhase = enabled; }
+    bool isTransposeHorizontalPhase() const { return transposeHorizontalPhase; }
+
+    /**
+     * @brief Carve images of at most kSmallImageSide per side (thumbnails,
+     * avatars) on a path of their own when resize would use the fused DP
+     * for every seam (DP strategy, backward energy, one seam per pass,
+     * width-first order, one thread, no mask, no saliency) and only
+     * reduces. The gray plane, energy map, parent offsets, cost rows and
+     * seam live in fixed-size arrays kept per thread, and the kernel and
+     * precision are compile-time parameters. The map, which fits in cache
+     * at this size, is computed once per direction and patched around
+     * every seam instead of being recomputed inside each DP pass; the
+     * image is only allocated for the result and the horizontal phase's
+     * transposes. On by default; results are identical.
+     */
+    void setSmallImagePath(bool enabled) { smallImagePath = enabled; }
+    bool isSmallImagePath() const { return smallImagePath; }
+
+    /**
+     * @brief Number of seams resizeImage removes per DP pass (DP method only).
+     * 1 (default) recomputes energy and DP after every seam. Larger values
+     * take that many pixel-disjoint seams from one cost table, removing them
+     * together before recomputing: roughly k times fewer full passes for a
+     * slightly worse seam set. kAdaptiveSeamBatch picks the size per pass.
+     */
+    void setSeamBatchSize(int k) { seamBatchSize = std::max(k, kAdaptiveSeamBatch); }
+    int getSeamBatchSize() const { return seamBatchSize; }
+
+    /**
+     * @brief Keep the DP cost table across seams in resizeImage (DP method,
+     * one seam per pass) and recompute only the cone below each removed seam,
+     * falling back to full rows once the cone covers most of the width. Uses
+     * the full table whatever the DP storage mode; seams are unchanged.
+     * The graph method likewise keeps every pixel's distance label between
+     * vertical seams and repairs only the labels the last seam changed;
+     * its seams are then those of GraphSolver::DagRelaxation whatever the
+     * solver set (the same cost as the other solvers').
+     */
+    void setIncrementalDP(bool enabled) { incrementalDP = enabled; }
+    bool isIncrementalDP() const { return incrementalDP; }
+
+    /**
+     * @brief Defer removing single seams from the image in resize: up to
+     * seams seams (default 0, and 1: none) are only marked per row, and the
+     * image is compacted in one pass over its rows, moving each row as the
+     * runs between its marked pixels, when that many are pending, before a
+     * batch or a transpose and before the result is returned. The seam
+     * search and the energy read the gray plane and energy map, which are
+     * still carved per seam, so nothing reads the image in between. A
+     * marked seam costs O(pending) per row to place in image columns, so a
+     * pass trades that against moving the image once per seam; the result
+     * is identical. Not used by the cheapest-direction order.
+     */
+    void setLazyRemoval(int seams) { lazyRemoval = std::max(seams, 0); }
+    int getLazyRemoval() const { return lazyRemoval; }
+
     // ----- DP seam finding -----
 
     /**
      * @brief Find minimal-energy vertical seam using DP.
-     * @param energy CV_64F energy image
+     * @param energy energy image (CV_64F, CV_32F or CV_16U)
      * @return seam[row] = column index of seam pixel in that row
      */
     std::vector<int> findVerticalSeamDP(const cv::Mat& energy);
 
+    /**
+     * @brief findVerticalSeamDP writing into seam. The cost table and rows
+     * come from the carver's seam workspace, so with seam kept across calls
+     * a single-threaded search allocates nothing once the buffers have
+     * grown to the first (largest) map. Every finder with a seam parameter
+     * works this way.
+     */
+    void findVerticalSeamDP(const cv::Mat& energy, std::vector<int>& seam);
+
     /**
      * @brief Find minimal-energy horizontal seam using DP.
-     * Implemented via transpose + vertical DP.
-     * @param energy CV_64F energy image
+     * Walks the energy map column by column, without transposing it.
+     * @param energy energy image (CV_64F, CV_32F or CV_16U)
      * @return seam[col] = row index of seam pixel in that column
      */
     std::vector<int> findHorizontalSeamDP(const cv::Mat& energy);
+    void findHorizontalSeamDP(const cv::Mat& energy, std::vector<int>& seam);
+
+    /**
+     * @brief Find the best vertical and the best horizontal DP seam of
+     * energy at the same time, the horizontal one on a helper thread with
+     * its own tables, and keep the one to remove next: the lower seam
+     * energy per seam still to remove on its axis, so the axis with more
+     * seams left wins near-ties. With no seams left on one axis only the
+     * other is searched. Phase stats time the vertical search only.
+     * @param verticalLeft   seams still to remove from the width
+     * @param horizontalLeft seams still to remove from the height
+     * @return true if seam is vertical (seam[row] = column), false if it
+     *         is horizontal (seam[col] = row)
+     */
+    bool findCheapestSeamDP(const cv::Mat& energy, int verticalLeft, int horizontalLeft, std::vector<int>& seam);
+
+    /**
+     * @brief Find up to k pixel-disjoint low-cost vertical seams from a single
+     * DP cost table (always the full table, whatever the DP storage mode).
+     * The first seam is the one findVerticalSeamDP returns; all seams index
+     * the input energy map.
+     */
+    std::vector<std::vector<int>> findVerticalSeamsDP(const cv::Mat& energy, int k);
+
+    /**
+     * @brief Horizontal counterpart of findVerticalSeamsDP.
+     */
+    std::vector<std::vector<int>> findHorizontalSeamsDP(const cv::Mat& energy, int k);
+
+    /**
+     * @brief Find the minimal-energy vertical seam straight from the gray
+     * plane: every energy row is computed inside the DP loop and consumed
+     * at once, so no energy map is built and the pass streams the gray
+     * plane plus a 1-byte parent offset per pixel. Same seam as
+     * findVerticalSeamDP on calculateEnergyFromGray(gray). The working
+     * buffers are kept by the carver between calls. Single-threaded;
+     * saliency-weighted energy falls back to the map.
+     * @param gray CV_8U gray plane (see toGray)
+     */
+    std::vector<int> findVerticalSeamFusedDP(const cv::Mat& gray);
+    void findVerticalSeamFusedDP(const cv::Mat& gray, std::vector<int>& seam);
+
+    /**
+     * @brief Horizontal counterpart of findVerticalSeamFusedDP.
+     */
+    std::vector<int> findHorizontalSeamFusedDP(const cv::Mat& gray);
+    void findHorizontalSeamFusedDP(const cv::Mat& gray, std::vector<int>& seam);
+
+    /**
+     * @brief Select the cost model of resizeImage's DP seams (backward by
+     * default). Forward seams need no energy map, so incremental energy
+     * and incremental DP do not apply to them; seam batching does. Other
+     * seam methods always use backward energy.
+     */
+    void setEnergyModel(EnergyModel model) { energyModel = model; }
+    EnergyModel getEnergyModel() const { return energyModel; }
+
+    /**
+     * @brief Select the seam order of resizeImage's DP (width first by
+     * default). The optimal and cheapest orders remove one seam per step,
+     * so seam batching does not apply while both dimensions shrink. The
+     * cheapest order compares backward energy seams; with forward energy
+     * it removes width first.
+     */
+    void setSeamOrder(SeamOrder order) { seamOrder = order; }
+    SeamOrder getSeamOrder() const { return seamOrder; }
+
+    /**
+     * @brief Interleaving of removeVertical vertical and removeHorizontal
+     * horizontal DP seams of least total energy (true = vertical seam).
+     * Fills the transport map T(r, c) = min(T(r-1, c) + E(horizontal seam),
+     * T(r, c-1) + E(vertical seam)) row by row, keeping only the frontier
+     * of one gray plane per column and one byte of choice per cell, so
+     * memory grows with removeVertical gray planes rather than with the
+     * whole map. Runs one energy map and two DPs per cell. Seam costs are
+     * backward energy of the current precision and energy function.
+     */
+    std::vector<bool> optimalSeamOrder(const cv::Mat& gray, int removeVertical, int removeHorizontal);
+
+    /**
+     * @brief Find the vertical seam of least forward energy, with the step
+     * costs computed from the gray plane inside the DP row update.
+     * @param gray CV_8U gray plane (see toGray)
+     * @return seam[row] = column index
+     */
+    std::vector<int> findVerticalSeamForwardDP(const cv::Mat& gray);
+    void findVerticalSeamForwardDP(const cv::Mat& gray, std::vector<int>& seam);
+
+    /**
+     * @brief Horizontal counterpart of findVerticalSeamForwardDP.
+     * @return seam[col] = row index
+     */
+    std::vector<int> findHorizontalSeamForwardDP(const cv::Mat& gray);
+    void findHorizontalSeamForwardDP(const cv::Mat& gray, std::vector<int>& seam);
+
+    /**
+     * @brief Forward-energy counterparts of findVerticalSeamsDP /
+     * findHorizontalSeamsDP: up to k pixel-disjoint seams from one table.
+     */
+    std::vector<std::vector<int>> findVerticalSeamsForwardDP(const cv::Mat& gray, int k);
+    std::vector<std::vector<int>> findHorizontalSeamsForwardDP(const cv::Mat& gray, int k);
 
     // ----- Greedy seam finding -----
 
     /**
-     * @brief Find a vertical seam using a simple greedy walk.
+     * @brief Find a vertical seam using a simple greedy walk, or a beam
+     * search when setGreedyBeamWidth is above 1.
      */
     std::vector<int> findVerticalSeamGreedy(const cv::Mat& energy);
+    void findVerticalSeamGreedy(const cv::Mat& energy, std::vector<int>& seam);
 
     /**
      * @brief Find a horizontal seam using greedy walk.
      */
     std::vector<int> findHorizontalSeamGreedy(const cv::Mat& energy);
+    void findHorizontalSeamGreedy(const cv::Mat& energy, std::vector<int>& seam);
+
+    /**
+     * @brief Partial seams the greedy finders keep per row (default 1, the
+     * plain greedy walk). A beam of width B starts from the B cheapest
+     * pixels of the first row and keeps the B cheapest extensions, one per
+     * column, at every row: O(H * B log B) between greedy's O(H) and the
+     * DP's O(W * H). A beam as wide as the image finds the DP seam.
+     */
+    void setGreedyBeamWidth(int width) { greedyBeamWidth = std::max(width, 1); }
+    int getGreedyBeamWidth() const { return greedyBeamWidth; }
+
+    /**
+     * @brief Independent greedy walks per seam (default 1), started from
+     * the minima of equal strata of the first row and advanced in lockstep;
+     * the cheapest walk is returned, so it is never worse than the plain
+     * greedy seam. A cheaper knob than the beam width, which takes
+     * precedence when both are set.
+     */
+    void setGreedyStarts(int starts) { greedyStarts = std::max(starts, 1); }
+    int getGreedyStarts() const { return greedyStarts; }
+
+    // ----- Seam connectivity -----
+
+    /**
+     * @brief Largest move of a seam between two layers, 1 to kMaxSeamStep:
+     * the default 1 is the usual 3 parents per pixel, 2 gives 5 and 3 gives
+     * 7. Wider seams follow diagonal structure more cheaply. Each step is
+     * its own instantiation of the backward-energy DP (both storages, the
+     * fused and the small-image path) and of the plain greedy walk, so the
+     * parent loops unroll and step 1 runs the same code as before; ties
+     * follow seamParentStep. With a step above 1 the DP runs on one thread
+     * and one seam per pass, without incremental or bidirectional DP; the
+     * forward cost model, the greedy beam and multiple starts, the pyramid
+     * and the graph finders stay 3-connected.
+     */
+    void setSeamStep(int step) { seamStep = std::min(std::max(step, 1), kMaxSeamStep); }
+    int getSeamStep() const { return seamStep; }
+
+    // ----- Coarse-to-fine (pyramid) seam finding -----
+
+    /**
+     * @brief Number of pyramid levels below full resolution (default 3).
+     * Each level halves the energy map; fewer levels are used when a level
+     * would get narrower than four corridor widths. 0 is plain DP.
+     */
+    void setPyramidLevels(int levels) { pyramidLevels = std::max(levels, 0); }
+    int getPyramidLevels() const { return pyramidLevels; }
+
+    /**
+     * @brief Half-width of the corridor searched around the upsampled seam
+     * at each finer level (default 4, at least kMinPyramidCorridor).
+     */
+    void setPyramidCorridor(int radius) { pyramidCorridor = std::max(radius, kMinPyramidCorridor); }
+    int getPyramidCorridor() const { return pyramidCorridor; }
+
+    /**
+     * @brief Find a vertical seam coarse to fine: full DP on the coarsest
+     * level of an averaged energy pyramid, then DP within the corridor
+     * around the upsampled seam at each finer level. Roughly
+     * O(H * corridor) seam work at full resolution instead of O(W * H); the
+     * seam may cost more than findVerticalSeamDP's.
+     * @param energy energy image (CV_64F, CV_32F or CV_16U)
+     */
+    std::vector<int> findVerticalSeamPyramid(const cv::Mat& energy);
+
+    /**
+     * @brief Horizontal counterpart of findVerticalSeamPyramid.
+     */
+    std::vector<int> findHorizontalSeamPyramid(const cv::Mat& energy);
+
+    /**
+     * @brief DP within the corridor of half-width radius around centre
+     * (one column per row), e.g. the same seam of the previous video
+     * frame: O(H * radius) instead of O(W * H). Falls back to
+     * findVerticalSeamDP when centre does not have one entry per row or
+     * the corridor does not connect top to bottom.
+     */
+    std::vector<int> findVerticalSeamInCorridor(const cv::Mat& energy, const std::vector<int>& centre, int radius);
+
+    /**
+     * @brief Horizontal counterpart of findVerticalSeamInCorridor
+     * (centre has one row per column).
+     */
+    std::vector<int> findHorizontalSeamInCorridor(const cv::Mat& energy, const std::vector<int>& centre, int radius);
+
+    /**
+     * @brief Total energy of a seam, for comparing seam finders.
+     */
+    double seamEnergy(const cv::Mat& energy, const std::vector<int>& seam, bool isVertical) const;
+
+    /**
+     * @brief Cumulative cost table of the backward-energy DP over energy,
+     * for inspecting where the search spends its cost: entry (r, c) is the
+     * cheapest cost of a seam from the first row (column for horizontal
+     * seams) to pixel (r, c). Same size as energy, of the DP's cost depth
+     * (CV_64F, CV_32F or CV_32S by precision), with the adjacent-pixel
+     * connectivity whatever getSeamStep says.
+     */
+    cv::Mat costTable(const cv::Mat& energy, bool isVertical) const;
 
     // ----- Graph-cut seam finding -----
     // Model the image as a layered graph and run Dijkstra to find
     // the minimum-cost s->t path; this is equivalent to computing a
     // seam via a generic graph shortest-path method rather than DP.
+    // The graph is implicit (neighbours are generated from row/column)
+    // and the Dijkstra buffers are reused across calls.
+
+    /**
+     * @brief Select the solver of the graph formulation (Dijkstra by default).
+     */
+    void setGraphSolver(GraphSolver solver) { graphSolver = solver; }
+    GraphSolver getGraphSolver() const { return graphSolver; }
+
+    /**
+     * @brief Select the Dijkstra priority queue (binary heap by default).
+     */
+    void setGraphQueue(GraphQueue queue) { graphQueue = queue; }
+    GraphQueue getGraphQueue() const { return graphQueue; }
+
+    /**
+     * @brief Select the node state of the graph solvers (full by default).
+     */
+    void setGraphStorage(GraphStorage storage) { graphStorage = storage; }
+    GraphStorage getGraphStorage() const { return graphStorage; }
 
     /**
      * @brief Find vertical seam using a graph shortest-path formulation.
-     * @param energy CV_64F energy image
+     * @param energy energy image (CV_64F, CV_32F or CV_16U)
      * @return seam[row] = column index
      */
     std::vector<int> findVerticalSeamGraphCut(const cv::Mat& energy);
+    void findVerticalSeamGraphCut(const cv::Mat& energy, std::vector<int>& seam);
 
     /**
      * @brief Find horizontal seam using graph formulation.
-     * Implemented via transpose + vertical graph search.
+     * Uses image columns as graph layers, without transposing the map.
      */
     std::vector<int> findHorizontalSeamGraphCut(const cv::Mat& energy);
+    void findHorizontalSeamGraphCut(const cv::Mat& energy, std::vector<int>& seam);
 
     // ----- Image modification -----
 
@@ -87,22 +955,249 @@ public:
     cv::Mat removeHorizontalSeam(const cv::Mat& img, const std::vector<int>& seam);
 
     /**
-     * @brief Resize the internal image using DP or greedy seams.
+     * @brief Remove a vertical seam without reallocating: pixels right of the
+     * seam are shifted left inside the existing buffer and img becomes a
+     * one column narrower ROI over the same allocation.
+     */
+    void removeVerticalSeamInPlace(cv::Mat& img, const std::vector<int>& seam);
+
+    /**
+     * @brief Remove a horizontal seam without reallocating: pixels below the
+     * seam move up one row and img becomes a one row shorter ROI.
+     */
+    void removeHorizontalSeamInPlace(cv::Mat& img, const std::vector<int>& seam);
+
+    /**
+     * @brief Remove a set of pixel-disjoint vertical seams (all indexed in
+     * img as given) into a new image, in one pass: each row is copied as
+     * the runs between its sorted seam pixels.
+     */
+    cv::Mat removeVerticalSeams(const cv::Mat& img, const std::vector<std::vector<int>>& seams);
+
+    /**
+     * @brief Remove a set of pixel-disjoint horizontal seams into a new
+     * image, in one sweep over the rows.
+     */
+    cv::Mat removeHorizontalSeams(const cv::Mat& img, const std::vector<std::vector<int>>& seams);
+
+    /**
+     * @brief Remove a set of pixel-disjoint vertical seams at once (all
+     * indexed in img as given), in place. img loses seams.size() columns.
+     */
+    void removeVerticalSeamsInPlace(cv::Mat& img, const std::vector<std::vector<int>>& seams);
+
+    /**
+     * @brief Remove a set of pixel-disjoint horizontal seams at once, in
+     * place, in one sweep over the rows (see removeHorizontalSeams).
+     */
+    void removeHorizontalSeamsInPlace(cv::Mat& img, const std::vector<std::vector<int>>& seams);
+
+    /**
+     * @brief Enlarge img by seam insertion (Avidan & Shamir): the k seams a
+     * DP carve would remove first are found in one carve of a copy, and all
+     * of them are duplicated in a single pass, each seam pixel followed by
+     * the average of itself and its next neighbour. Every pass works in
+     * place inside one buffer allocated at the final size. Targets more
+     * than kMaxSeamInsertFraction larger take several passes.
+     * @param img image of a supported type (isSupportedImageType);
+     *            newWidth >= img.cols, newHeight >= img.rows
+     */
+    cv::Mat enlargeImage(const cv::Mat& img, int newWidth, int newHeight);
+
+    /**
+     * @brief enlargeImage reporting each insertion pass to progress (may
+     * be empty) and checking cancel (may be null) before every pass.
+     * Throws CarveCancelled once cancel is set.
+     */
+    cv::Mat enlargeImage(const cv::Mat& img, int newWidth, int newHeight,
+                         const ProgressCallback& progress, const CancelToken* cancel = nullptr);
+
+    /**
+     * @brief Resize the internal image to options.width x options.height:
+     * the options are applied to the carver, then one carving loop
+     * specialised for the strategy shrinks and enlarges the image. The
+     * result becomes the current image. Progress and cancellation work as
+     * for the resizeImage overload taking them. The result shares its
+     * buffer with the carver (with the original when nothing was carved):
+     * clone it before writing into it.
+     *
+     * With a non-empty options.region, vertical seams stay inside its
+     * columns and horizontal seams inside its rows: the column band (all
+     * rows) is carved on its own, the pixels beside it only move over, and
+     * then the row band of the result. Energy and DP cover the bands only,
+     * so the work scales with them instead of the image; seams at a band
+     * edge see the band's border as the image's. Reduction only, by less
+     * than the band's size; throws std::runtime_error for a region outside
+     * the image or a size it cannot reach. carveQuality and borderTrim are
+     * not used.
+     */
+    cv::Mat resize(const ResizeOptions& options);
+
+    // @brief ResizeOptions of the carver's current settings, for a target
+    // size and strategy, with no progress callback or cancel token.
+    ResizeOptions resizeOptions(int width, int height, SeamStrategy strategy) const;
+
+    /**
+     * @brief Size a hybrid resize (ResizeOptions::carveQuality below 1)
+     * scales the current image to with cv::INTER_AREA before carving the
+     * rest of the way to width x height.
+     *
+     * Seams are cheap to remove only from low-energy content, so each
+     * reduced side leaves to carving at most the low-energy share L of the
+     * image (pixels below the mean energy, measured on a small copy) times
+     * quality q: the intermediate side is min(side, target / (1 - q * L)),
+     * with q * L capped at kMaxHybridCarveShare. q = 0 only scales; the
+     * closer the image is to flat and q to 1, the more is carved. Enlarged
+     * sides are not scaled.
+     */
+    cv::Size hybridScaleSize(int width, int height, double quality);
+
+    /**
+     * @brief Largest size hybridScaleSize can return for a source of size
+     * source, whatever its content: each reduced side at
+     * target / (1 - min(q, kMaxHybridCarveShare)). A decoder may shrink the
+     * source to it up front (SeamDecode.h) without changing the result's
+     * size or carving more.
+     */
+    static cv::Size hybridScaleBound(cv::Size source, int width, int height, double quality);
+
+    /**
+     * @brief Region a resize with ResizeOptions::borderTrim = maxEnergy
+     * crops the current image to before carving the rest of the way to
+     * width x height.
+     *
+     * From one energy map of the image, the border columns (rows) whose
+     * energy stays at or below maxEnergy from one end to the other are
+     * flat, like a studio background: removing one is what the first seams
+     * would do anyway, at a cost of near zero. Up to the columns (rows) to
+     * be removed are cropped, split between the two sides as evenly as
+     * their flat runs allow. maxEnergy is a gradient magnitude, compared
+     * scaled on EnergyPrecision::Fixed16 maps; a protected pixel is never
+     * flat and a pixel marked for removal always is. Enlarged sides are not
+     * cropped. If nothing is cropped the map is kept for the resize to
+     * start from (setInitialEnergy) unless one is set already.
+     */
+    cv::Rect flatBorderCrop(int width, int height, double maxEnergy);
+
+    // Receives each size of resizeSizes: its index in the list and the
+    // image, which shares its buffer with the carver like resize's result
+    typedef std::function<void(size_t index, const cv::Mat& image)> SizeCallback;
+
+    /**
+     * @brief Carve through several reductions in one run and pass each to
+     * emit as the carve reaches it, largest first (e.g. the widths of a
+     * responsive image set). Each size continues from the one before, so
+     * the whole set costs one carve down to the smallest; each step is
+     * carved as resize(options) would carve it from the size before.
+     * options.width, height and carveQuality are not used. The sizes must
+     * shrink together (no size wider but lower than another) and be no
+     * larger than the current image; throws std::runtime_error otherwise.
+     * Progress counts the seams of the whole set; on CarveCancelled the
+     * sizes emitted so far stay valid. The smallest becomes the current
+     * image.
+     */
+    void resizeSizes(const std::vector<cv::Size>& sizes, const ResizeOptions& options, const SizeCallback& emit);
+
+    /**
+     * @brief Resize the internal image using DP or greedy seams. A
+     * dimension that grows is enlarged by seam insertion (enlargeImage)
+     * once the shrinking dimension has been carved.
      * @param newWidth  desired width
      * @param newHeight desired height
      * @param useDP true = DP, false = greedy
+     * Same as resize(resizeOptions(newWidth, newHeight, DP or Greedy)).
      */
     cv::Mat resizeImage(int newWidth, int newHeight, bool useDP);
 
+    /**
+     * @brief resizeImage reporting progress (may be empty) after every
+     * carve step and checking cancel (may be null) between seams. A
+     * cancelled resize throws CarveCancelled and leaves the image as it
+     * was before the call.
+     */
+    cv::Mat resizeImage(int newWidth, int newHeight, bool useDP,
+                        const ProgressCallback& progress, const CancelToken* cancel = nullptr);
+
+    /**
+     * @brief Resize the internal image using pyramid seams.
+     */
+    cv::Mat resizeImagePyramid(int newWidth, int newHeight);
+    cv::Mat resizeImagePyramid(int newWidth, int newHeight,
+                               const ProgressCallback& progress, const CancelToken* cancel = nullptr);
+
     /**
      * @brief Resize the internal image using the graph-based seam finder.
-     * Only shrinking (newWidth <= originalWidth, newHeight <= originalHeight)
-     * is supported.
+     * Growing dimensions are enlarged with enlargeImage, whose seams come
+     * from the DP. Like the other resizes the result becomes the current
+     * image.
      */
     cv::Mat resizeImageGraphCut(int newWidth, int newHeight);
+    cv::Mat resizeImageGraphCut(int newWidth, int newHeight,
+                                const ProgressCallback& progress, const CancelToken* cancel = nullptr);
 
     /**
-     * @brief Visualize a single seam in red over the current image.
+     * @brief Carve the current image offline down to minWidth x minHeight and
+     * record when each pixel was removed. Vertical and horizontal seams
+     * are carved independently from the full image with DP.
+     */
+    SeamIndexMap buildSeamIndexMap(int minWidth, int minHeight);
+
+    // Receives a map covering the sizes carved so far
+    typedef std::function<void(const SeamIndexMap& partial)> SeamMapCallback;
+
+    /**
+     * @brief buildSeamIndexMap in stages, for a background precompute. Both
+     * orders are carved alternately, chunk seams at a time, and after every
+     * chunk but the last partial gets a map whose minWidth and minHeight
+     * are the sizes reached so far. A partial map renders width-only and
+     * height-only sizes as the complete map does; when both shrink, the
+     * height pass can only drop pixels the partial map has ordered, so the
+     * per-column approximation may differ. The result equals the one-call
+     * build. Throws CarveCancelled if cancel is set.
+     */
+    SeamIndexMap buildSeamIndexMap(int minWidth, int minHeight, int chunk, const SeamMapCallback& partial,
+                                   const CancelToken* cancel = nullptr);
+
+    /**
+     * @brief Render source (the image the map was built from) at the given
+     * size from a seam index map. Width-only and height-only targets match
+     * resizeImage with DP seams; when both shrink, the height pass drops the
+     * earliest-removed pixels left in each column after the width pass.
+     */
+    cv::Mat renderFromSeamIndexMap(const SeamIndexMap& map, const cv::Mat& source,
+                                   int width, int height);
+
+    /**
+     * @brief Extend map (built from the current image) to a grid of up to
+     * levels widths spread evenly from the image width to map.minWidth. Each
+     * rung carves the horizontal seams of the image narrowed by the map, so
+     * building costs about one horizontal map per rung. Throws
+     * CarveCancelled if cancel is set.
+     */
+    SeamIndexGrid buildSeamIndexGrid(const SeamIndexMap& map, int levels = SeamIndexGrid::kDefaultLevels,
+                                     const CancelToken* cancel = nullptr);
+
+    /**
+     * @brief Render source (the image the grid was built from) at any size
+     * the grid's map covers with one gather pass over the source: exact on
+     * the grid's widths (see SeamIndexGrid), and without the per-column
+     * approximation of renderFromSeamIndexMap when both sizes shrink.
+     */
+    cv::Mat renderFromSeamIndexGrid(const SeamIndexGrid& grid, const cv::Mat& source,
+                                    int width, int height);
+
+    /**
+     * @brief Paint a seam into img in place (only the seam pixels are
+     * written). Cheapest on an image that is about to lose that seam.
+     * @param img   image of a supported type (isSupportedImageType)
+     * @param color BGR(A) color in the 8-bit range (scaled to 65535 for
+     *              16-bit and 1.0 for float images), red by default
+     */
+    void overlaySeam(cv::Mat& img, const std::vector<int>& seam, bool isVertical,
+                     const cv::Scalar& color = cv::Scalar(0, 0, 255, 255)) const;
+
+    /**
+     * @brief Visualize a single seam in red over a copy of the current image.
      * @param seam      seam indices
      * @param isVertical true for vertical (one column index per row),
      *                   false for horizontal (one row index per column)
@@ -115,9 +1210,173 @@ public:
     // @brief Get the original, unmodified image.
     cv::Mat getOriginalImage() const { return originalImage.clone(); }
 
+    // @brief Get the grayscale plane matching the current working image.
+    cv::Mat getGrayImage() const { return grayImage.clone(); }
+
+    // Read-only views without a copy. The headers share the carver's
+    // buffers: do not write through them, and they follow the next
+    // resize/reset only if fetched again.
+    const cv::Mat& imageView() const { return image; }
+    const cv::Mat& originalImageView() const { return originalImage; }
+    const cv::Mat& grayImageView() const { return grayImage; }
+
+    // Dijkstra buffers reused by the graph seam finders, and the scratch
+    // planes of the DP and energy kernels (both defined in SeamCarver.cpp)
+    struct GraphWorkspace;
+    struct SeamWorkspace;
+
 private:
+    // Carving loop of resize, once per strategy (SeamCarver.cpp only)
+    template <SeamStrategy Strategy>
+    cv::Mat carveTo(int newWidth, int newHeight);
+    cv::Mat carveWith(SeamStrategy strategy, int newWidth, int newHeight);
+
+    // The carving fields of options as the carver's settings
+    void applyResizeSettings(const ResizeOptions& options);
+
+    // The precision energy maps of gray are made at: precision, but Float
+    // where a Fixed16 cost could overflow or a mask is set
+    EnergyPrecision precisionFor(const cv::Mat& gray) const;
+
+    // The seeded initial energy if it fits gray and the precision, else empty
+    cv::Mat takeInitialEnergy(const cv::Mat& gray);
+
+    // Install img as the working and original image and derive the gray plane
+    void adoptImage(cv::Mat img);
+
+    // Area-scale the working image, its gray plane and the mask to size
+    // (first step of a hybrid resize); the original image is kept
+    void scaleWorkingImage(cv::Size size);
+
+    // Crop the working image, its gray plane and the mask to roi (first
+    // step of a border-trimmed resize); the original image is kept
+    void cropWorkingImage(cv::Rect roi);
+
+    // carveTo on the small-image path (setSmallImagePath); the caller
+    // checked that it applies
+    cv::Mat carveSmall(int newWidth, int newHeight);
+
+    // resize with options.region: carve seams seams out of the column
+    // (vertical) or row band of the working image and put the rest back
+    // around it
+    void carveBand(SeamStrategy strategy, cv::Range band, int seams, bool vertical);
+
+    // Batch size for the next DP pass given the seams still to remove
+    int seamBatchFor(int remaining, int layerWidth) const;
+
+    // Energy map of gray with the given precision and per-pixel kernel
+    cv::Mat gradientEnergy(const cv::Mat& gray, EnergyPrecision precision, EnergyFunction function);
+
+    // calculateEnergyFromGray into the seam workspace: the map is only valid
+    // until the next call. Threaded and saliency energy still allocate.
+    cv::Mat scratchEnergy(const cv::Mat& gray);
+
+    // Remove seam from the image (unless img is null: removal deferred),
+    // its gray plane and, when energy is set, the incrementally patched
+    // energy map. With setEnergyThreads > 1 the rows (columns) are split
+    // into bands, each carved and patched by one thread in a single pass;
+    // patched maps are unchanged.
+    void removeSeamFromPlanes(cv::Mat* img, cv::Mat& gray, cv::Mat* energy,
+                              const std::vector<int>& seam, bool vertical);
+
+    // Recompute the energy around a seam already removed from energy
+    void patchEnergyAfterSeam(cv::Mat& energy, const cv::Mat& carvedImg,
+                              const std::vector<int>& seam, bool isVertical);
+
+    // Keep max(energyThreads, dpThreads) - 1 helper threads, unless the
+    // pool is shared
+    void resizeHelperPool();
+
+    // Vertical DP seam removal order of a gray plane carved to minCols columns
+    cv::Mat verticalRemovalOrder(const cv::Mat& gray, int minCols);
+
+    // verticalRemovalOrder in progress; removed seams are recorded in order
+    struct RemovalOrder {
+        cv::Mat order;   // CV_32S, source size
+        cv::Mat origin;  // source column of every pixel left
+        cv::Mat gray;
+        cv::Mat energy;
+        int removed = 0;
+    };
+    RemovalOrder startRemovalOrder(const cv::Mat& gray);
+    // Carve up to seams more seams, stopping at minCols columns
+    void continueRemovalOrder(RemovalOrder& state, int minCols, int seams);
+
+    // Vertical graph seam whose distance labels stay in the graph workspace
+    // across a carve: all computed if removed is empty, else repaired after
+    // removed (the previous seam) was carved out of energy
+    void findVerticalSeamGraphLabels(const cv::Mat& energy, const std::vector<int>& removed,
+                                     std::vector<int>& seam);
+
+    // Progress and cancellation of the public call in progress, set for
+    // its duration by a RunScope; inactive (all null) otherwise
+    class RunScope;
+    struct ActiveRun {
+        const ProgressCallback* progress = nullptr;
+        const CancelToken* cancel = nullptr;
+        std::chrono::steady_clock::time_point start;
+        int seamsTotal = 0;
+        int seamsDone = 0;
+    };
+
+    // Count seams carved by the active run, report them and throw
+    // CarveCancelled if it was cancelled
+    void seamsCarved(int seams);
+    void checkCancelled() const {
+        if (activeRun.cancel && activeRun.cancel->cancelled()) throw CarveCancelled();
+    }
+
+    // Format and send one message if level is enabled
+    template <typename... Args>
+    void log(LogLevel level, const Args&... args) const {
+        if (level > logLevel) return;
+        std::ostringstream os;
+        (os << ... << args);
+        logger(level, os.str());
+    }
+
+    // image, originalImage and grayImage are never written in place: a
+    // resize carves copies made on its first removal, so until then all
+    // three may share one buffer
     cv::Mat image;          // Current working image
     cv::Mat originalImage;  // Original image (preserved)
+    cv::Mat grayImage;      // CV_8U gray plane, carved together with image
+    cv::Mat initialEnergy;  // setInitialEnergy, consumed by the next resize
+    SeamMask mask;          // setMask, carved together with image
+    SeamCarverStats phaseStats;
+    SeamLogger logger;
+    LogLevel logLevel = LogLevel::Silent;
+    ActiveRun activeRun;
+    bool incrementalEnergy = false;  // Patch the energy map per seam
+    EnergyPrecision precision = EnergyPrecision::Double;
+    EnergyModel energyModel = EnergyModel::Backward;
+    SeamOrder seamOrder = SeamOrder::WidthFirst;
+    EnergyFunction energyFunction = EnergyFunction::Sobel;
+    DPStorage dpStorage = DPStorage::FullTable;
+    bool transposeHorizontalPhase = true;
+    bool smallImagePath = true;
+    GraphSolver graphSolver = GraphSolver::Dijkstra;
+    GraphQueue graphQueue = GraphQueue::BinaryHeap;
+    GraphStorage graphStorage = GraphStorage::Full;
+    int seamBatchSize = 1;
+    bool incrementalDP = false;      // Patch the DP cost table per seam
+    int lazyRemoval = 0;             // seams pending in the image (setLazyRemoval)
+    int greedyBeamWidth = 1;
+    int greedyStarts = 1;
+    int seamStep = 1;                // largest column step between seam layers (setSeamStep)
+    int pyramidLevels = 3;
+    int pyramidCorridor = 4;
+    unsigned energyThreads = 1;
+    unsigned dpThreads = 1;
+    bool bidirectionalDP = false;
+    std::shared_ptr<ThreadPool> helperPool;  // shared by parallel energy and DP
+    bool sharedPool = false;                 // helperPool set by setThreadPool
+    std::unique_ptr<GraphWorkspace> graphWorkspace;
+    std::unique_ptr<SeamWorkspace> seamWorkspace;
+    std::unique_ptr<SeamWorkspace> crossWorkspace;  // findCheapestSeamDP's horizontal search, on first use
+    BufferPlacement bufferPlacement;  // of both workspaces' planes (setBufferPlacement)
+    std::vector<double> fusedScratch;  // fused DP cost rows and energy layer
+    std::vector<schar> fusedOffsets;   // fused DP parent offsets
 };
 
 #endif // SEAM_CARVER_H
@@ -0,0 +1,140 @@
+#include "SeamDecode.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+// Frame header of a JPEG read through byte() (-1 at the end) and skip(n)
+// (false past the end)
+template <typename Byte, typename Skip>
+bool parseJpegHeader(Byte byte, Skip skip, JpegHeader& header) {
+    auto word = [&]() {
+        const int hi = byte();
+        const int lo = byte();
+        return hi < 0 || lo < 0 ? -1 : (hi << 8) | lo;
+    };
+    if (byte() != 0xFF || byte() != 0xD8) return false;
+    for (;;) {
+        int marker = byte();
+        if (marker != 0xFF) return false;
+        while (marker == 0xFF) marker = byte();  // fill bytes
+        if (marker < 0 || marker == 0xD9 || marker == 0xDA) return false;  // no frame before the scan
+        // Standalone markers carry no length
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) continue;
+        const int length = word();
+        if (length < 2) return false;
+        // SOF0..SOF15 but DHT, JPG and DAC
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            byte();  // sample precision
+            header.height = word();
+            header.width = word();
+            header.channels = byte();
+            return header.width > 0 && header.height > 0 && header.channels > 0;
+        }
+        if (!skip(length - 2)) return false;
+    }
+}
+
+// Little- and big-endian fields of an encoded header
+uint32_t le(const unsigned char* p, int bytes) {
+    uint32_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+uint32_t be32(const unsigned char* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+} // namespace
+
+bool readJpegHeader(const std::string& path, JpegHeader& header) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    return parseJpegHeader([&in]() { return in.get(); },  // EOF on a short file
+                           [&in](int n) { return static_cast<bool>(in.seekg(n, std::ios::cur)); }, header);
+}
+
+bool readEncodedHeader(const std::string& data, EncodedHeader& header) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+    const size_t size = data.size();
+    header = EncodedHeader();
+    if (size >= 26 && std::memcmp(p, "\x89PNG\r\n\x1a\n", 8) == 0 && std::memcmp(p + 12, "IHDR", 4) == 0) {
+        const int colourType = p[25];
+        header.width = static_cast<int>(std::min<uint32_t>(be32(p + 16), INT32_MAX));
+        header.height = static_cast<int>(std::min<uint32_t>(be32(p + 20), INT32_MAX));
+        header.channels = colourType == 0 ? 1 : colourType == 2 ? 3 : 4;  // a palette may expand to BGRA
+        header.bytesPerSample = p[24] == 16 ? 2 : 1;
+    }
+    else if (size >= 2 && p[0] == 0xFF && p[1] == 0xD8) {
+        size_t at = 0;
+        JpegHeader jpeg;
+        const bool ok = parseJpegHeader([&]() { return at < size ? static_cast<int>(p[at++]) : -1; },
+                                        [&](int n) { at += static_cast<size_t>(n); return at <= size; }, jpeg);
+        if (!ok) return false;
+        header.width = jpeg.width;
+        header.height = jpeg.height;
+        header.channels = jpeg.channels;
+    }
+    else if (size >= 30 && p[0] == 'B' && p[1] == 'M') {
+        header.width = std::abs(static_cast<int32_t>(le(p + 18, 4)));
+        header.height = std::abs(static_cast<int32_t>(le(p + 22, 4)));  // negative: top-down rows
+        header.channels = le(p + 28, 2) == 32 ? 4 : 3;
+    }
+    else if (size >= 30 && std::memcmp(p, "RIFF", 4) == 0 && std::memcmp(p + 8, "WEBP", 4) == 0) {
+        if (std::memcmp(p + 12, "VP8X", 4) == 0) {
+            header.width = static_cast<int>(le(p + 24, 3)) + 1;
+            header.height = static_cast<int>(le(p + 27, 3)) + 1;
+        }
+        else if (std::memcmp(p + 12, "VP8 ", 4) == 0) {
+            header.width = static_cast<int>(le(p + 26, 2) & 0x3FFF);
+            header.height = static_cast<int>(le(p + 28, 2) & 0x3FFF);
+        }
+        else if (std::memcmp(p + 12, "VP8L", 4) == 0) {
+            const uint32_t bits = le(p + 21, 4);
+            header.width = static_cast<int>(bits & 0x3FFF) + 1;
+            header.height = static_cast<int>((bits >> 14) & 0x3FFF) + 1;
+        }
+        else {
+            return false;
+        }
+        header.channels = 4;
+    }
+    else {
+        return false;
+    }
+    return header.width > 0 && header.height > 0 && header.channels > 0;
+}
+
+int reducedDecodeFactor(cv::Size source, cv::Size minimum) {
+    for (int factor = 8; factor > 1; factor /= 2) {
+        if ((source.width + factor - 1) / factor >= minimum.width &&
+            (source.height + factor - 1) / factor >= minimum.height) {
+            return factor;
+        }
+    }
+    return 1;
+}
+
+cv::Mat imreadReduced(const std::string& path, int factor, int channels) {
+    int flags = cv::IMREAD_UNCHANGED;
+    if (factor != 1) {
+        const bool grey = channels == 1;
+        switch (factor) {
+        case 2: flags = grey ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2; break;
+        case 4: flags = grey ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4; break;
+        case 8: flags = grey ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8; break;
+        default: throw std::runtime_error("Reduced decoding needs a factor of 1, 2, 4 or 8.");
+        }
+        flags |= cv::IMREAD_IGNORE_ORIENTATION;
+    }
+    cv::Mat decoded = cv::imread(path, flags);
+    if (decoded.empty()) {
+        throw std::runtime_error("Could not load image from: " + path);
+    }
+    return decoded;
+}
@@ -0,0 +1,57 @@
+#ifndef SEAM_DECODE_H
+#define SEAM_DECODE_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+
+/**
+ * @brief Size of a JPEG from its frame header, read without decoding.
+ */
+struct JpegHeader {
+    int width = 0;
+    int height = 0;
+    int channels = 0;  // 1 grey, 3 YCbCr, 4 CMYK
+};
+
+/**
+ * @brief Read the frame header of the JPEG file at path. Returns false if
+ * the file cannot be read or is not a JPEG.
+ */
+bool readJpegHeader(const std::string& path, JpegHeader& header);
+
+/**
+ * @brief Size of an encoded image from its header, read without decoding.
+ * channels and bytesPerSample bound the IMREAD_UNCHANGED decode from above.
+ */
+struct EncodedHeader {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int bytesPerSample = 1;
+};
+
+/**
+ * @brief Read the header of a PNG, JPEG, BMP or WebP image held in data.
+ * Returns false for any other format or a header cut short.
+ */
+bool readEncodedHeader(const std::string& data, EncodedHeader& header);
+
+/**
+ * @brief Largest reduction (1, 2, 4 or 8) at which a JPEG decoder still
+ * yields at least minimum on both sides of source. The decoder rounds a
+ * reduced side up, so a side of n becomes ceil(n / factor).
+ */
+int reducedDecodeFactor(cv::Size source, cv::Size minimum);
+
+/**
+ * @brief Decode the JPEG at path at 1 / factor of its size. The reduction
+ * happens in the DCT domain (OpenCV's IMREAD_REDUCED_* modes), so the
+ * larger the factor, the less of the image is decoded at all; at factor
+ * 8 only the DC coefficients are. Like a full IMREAD_UNCHANGED decode,
+ * a channels = 1 image stays grey and EXIF orientation is ignored. Factor
+ * 1 is the full decode. Throws std::runtime_error for any other factor
+ * or if the file cannot be decoded.
+ */
+cv::Mat imreadReduced(const std::string& path, int factor, int channels);
+
+#endif // SEAM_DECODE_H
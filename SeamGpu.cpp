@@ -0,0 +1,321 @@
+#include "SeamGpu.h"
+#include <opencv2/core/ocl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace {
+
+// Images are views into device buffers, so every plane comes with its row
+// step and byte offset (cv::ocl::KernelArg::ReadOnly / WriteOnly)
+const char* const kSeamKernels = R"CLC(
+inline int reflect101(int p, int n) {
+    if (n == 1) return 0;
+    if (p < 0) return -p;
+    if (p >= n) return 2 * n - p - 2;
+    return p;
+}
+
+// Per-pixel energy of the gray plane with SeamCarver's local kernels:
+// 0 Sobel, 1 Scharr, 2 dual gradient, 3 L1 gradient, 4 FastSobel
+__kernel void seam_energy(__global const uchar* gray, int grayStep, int grayOffset, int rows, int cols,
+                          __global uchar* energy, int energyStep, int energyOffset, int function) {
+    const int c = get_global_id(0);
+    const int r = get_global_id(1);
+    if (c >= cols || r >= rows) return;
+    int g[3][3];
+    for (int dr = -1; dr <= 1; dr++) {
+        __global const uchar* row = gray + grayOffset + reflect101(r + dr, rows) * grayStep;
+        for (int dc = -1; dc <= 1; dc++) g[dr + 1][dc + 1] = row[reflect101(c + dc, cols)];
+    }
+    float e;
+    if (function == 1) {
+        int gx = 3 * (g[0][2] - g[0][0]) + 10 * (g[1][2] - g[1][0]) + 3 * (g[2][2] - g[2][0]);
+        int gy = 3 * (g[2][0] - g[0][0]) + 10 * (g[2][1] - g[0][1]) + 3 * (g[2][2] - g[0][2]);
+        e = 0.25f * sqrt((float)(gx * gx + gy * gy));
+    } else if (function == 2) {
+        int dx = g[1][2] - g[1][0];
+        int dy = g[2][1] - g[0][1];
+        e = sqrt((float)(dx * dx + dy * dy));
+    } else if (function == 3) {
+        e = (float)(abs(g[1][2] - g[1][0]) + abs(g[2][1] - g[0][1]));
+    } else {
+        int gx = (g[0][2] - g[0][0]) + 2 * (g[1][2] - g[1][0]) + (g[2][2] - g[2][0]);
+        int gy = (g[2][0] - g[0][0]) + 2 * (g[2][1] - g[0][1]) + (g[2][2] - g[0][2]);
+        if (function == 4) {
+            gx = abs(gx);
+            gy = abs(gy);
+            e = 0.5f * (float)(2 * max(gx, gy) + min(gx, gy));
+        } else {
+            e = sqrt((float)(gx * gx + gy * gy));
+        }
+    }
+    *(__global float*)(energy + energyOffset + r * energyStep + c * (int)sizeof(float)) = e;
+}
+
+// Backward-energy DP of a vertical seam in a single work-group: the items
+// share each row and meet at a barrier before the next. Item 0 then
+// backtracks with the tie-breaking of every CPU path (seamParentOffset:
+// first minimum of the last row, then straight up, left, right).
+__kernel void seam_dp(__global const uchar* energy, int energyStep, int energyOffset, int rows, int cols,
+                      __global float* cost, __global int* seam) {
+    const int lid = get_local_id(0);
+    const int n = get_local_size(0);
+    for (int j = lid; j < cols; j += n) {
+        cost[j] = *(__global const float*)(energy + energyOffset + j * (int)sizeof(float));
+    }
+    barrier(CLK_GLOBAL_MEM_FENCE);
+    for (int i = 1; i < rows; i++) {
+        __global const float* e = (__global const float*)(energy + energyOffset + i * energyStep);
+        __global const float* prev = cost + (i - 1) * cols;
+        __global float* cur = cost + i * cols;
+        for (int j = lid; j < cols; j += n) {
+            float m = prev[j];
+            if (j > 0) m = fmin(m, prev[j - 1]);
+            if (j + 1 < cols) m = fmin(m, prev[j + 1]);
+            cur[j] = e[j] + m;
+        }
+        barrier(CLK_GLOBAL_MEM_FENCE);
+    }
+    if (lid != 0) return;
+
+    __global const float* last = cost + (rows - 1) * cols;
+    int j = 0;
+    for (int c = 1; c < cols; c++) {
+        if (last[c] < last[j]) j = c;
+    }
+    seam[rows - 1] = j;
+    for (int i = rows - 2; i >= 0; i--) {
+        __global const float* prev = cost + i * cols;
+        int best = j;
+        if (j > 0 && prev[j - 1] < prev[best]) best = j - 1;
+        if (j + 1 < cols && prev[j + 1] < prev[best]) best = j + 1;
+        j = best;
+        seam[i] = j;
+    }
+}
+
+// dst = src without the seam's pixel in every row
+__kernel void remove_seam(__global const uchar* src, int srcStep, int srcOffset, int srcRows, int srcCols,
+                          __global uchar* dst, int dstStep, int dstOffset, int dstRows, int dstCols,
+                          __global const int* seam, int pixelBytes) {
+    const int c = get_global_id(0);
+    const int r = get_global_id(1);
+    if (c >= dstCols || r >= dstRows) return;
+    const int from = c < seam[r] ? c : c + 1;
+    __global const uchar* s = src + srcOffset + r * srcStep + from * pixelBytes;
+    __global uchar* d = dst + dstOffset + r * dstStep + c * pixelBytes;
+    for (int b = 0; b < pixelBytes; b++) d[b] = s[b];
+}
+)CLC";
+
+// Function argument of seam_energy
+int energyFunctionCode(EnergyFunction function) {
+    switch (function) {
+    case EnergyFunction::Scharr: return 1;
+    case EnergyFunction::DualGradient: return 2;
+    case EnergyFunction::L1Gradient: return 3;
+    case EnergyFunction::FastSobel: return 4;
+    case EnergyFunction::Sobel:
+    default: return 0;
+    }
+}
+
+} // namespace
+
+// The program is built once per carver; kernel objects are cheap and made
+// per launch, so launches can queue up without waiting for each other
+struct GpuCarver::Kernels {
+    cv::ocl::Program program;
+    size_t dpGroupSize = 1;
+
+    bool build(cv::String* error) {
+        program = cv::ocl::Program(cv::ocl::ProgramSource(kSeamKernels), cv::String(), *error);
+        if (program.ptr() == nullptr) return false;
+        cv::ocl::Kernel dp("seam_dp", program);
+        if (dp.empty()) return false;
+        dpGroupSize = std::max<size_t>(1, std::min<size_t>(dp.workGroupSize(), 256));
+        return true;
+    }
+};
+
+bool GpuCarver::available() {
+    static const bool usable = [] {
+        if (!cv::ocl::haveOpenCL() || !cv::ocl::useOpenCL()) return false;
+        Kernels probe;
+        cv::String error;
+        return probe.build(&error);
+    }();
+    return usable;
+}
+
+GpuCarver::GpuCarver(const cv::Mat& img)
+    : kernels(std::make_unique<Kernels>()) {
+    if (img.empty() || !SeamCarver::isSupportedImageType(img.type())) {
+        throw std::runtime_error("GPU carving needs an 8-bit, 16-bit or float image with 1, 3 or 4 channels.");
+    }
+    cv::String error;
+    if (!available() || !kernels->build(&error)) {
+        throw std::runtime_error(error.empty() ? std::string("OpenCL is not available for seam carving.")
+                                               : "Could not build the OpenCL seam kernels: " + error);
+    }
+    img.copyTo(imageBuffers[0]);
+    rows = img.rows;
+    cols = img.cols;
+
+    // Gray plane as SeamCarver::toGray makes it, in its own buffer
+    cv::UMat bytes = imageBuffers[0];
+    if (img.depth() != CV_8U) {
+        imageBuffers[0].convertTo(bytes, CV_8U, img.depth() == CV_16U ? 1.0 / 257 : 255.0);
+    }
+    if (bytes.channels() == 1) {
+        bytes.copyTo(grayBuffers[0]);
+    } else {
+        cv::cvtColor(bytes, grayBuffers[0], bytes.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+    }
+    setLayout(false);
+}
+
+GpuCarver::~GpuCarver() = default;
+
+void GpuCarver::setEnergyFunction(EnergyFunction function) {
+    if (function == EnergyFunction::Saliency) {
+        throw std::runtime_error("GPU carving needs a per-pixel energy function (saliency is global).");
+    }
+    energyFunction = function;
+}
+
+// Bring the planes into the vertical (horizontal: transposed) layout and
+// size the scratch buffers for it
+void GpuCarver::setLayout(bool horizontal) {
+    if (horizontal != transposed) {
+        const cv::Rect view(0, 0, cols, rows);
+        cv::UMat image, gray;
+        cv::transpose(imageBuffers[current](view), image);
+        cv::transpose(grayBuffers[current](view), gray);
+        imageBuffers[0] = image;
+        grayBuffers[0] = gray;
+        current = 0;
+        std::swap(rows, cols);
+        transposed = horizontal;
+        haveSeam = false;  // in the other layout
+    } else if (!energyBuffer.empty()) {
+        return;
+    }
+    // Removal only shrinks the planes, so these fit the whole phase
+    imageBuffers[1 - current].create(rows, cols, imageBuffers[current].type());
+    grayBuffers[1 - current].create(rows, cols, CV_8UC1);
+    energyBuffer.create(rows, cols, CV_32F);
+    costBuffer.create(rows, cols, CV_32F);
+    seamBuffer.create(1, rows, CV_32S);
+}
+
+// Energy, DP and removal of one vertical seam of the planes. The last
+// launch waits for the queue, so progress and cancellation see finished
+// seams; nothing is read back.
+void GpuCarver::removeSeam() {
+    using cv::ocl::KernelArg;
+    const cv::Rect view(0, 0, cols, rows);
+    const cv::Rect carved(0, 0, cols - 1, rows);
+    cv::UMat gray = grayBuffers[current](view);
+    cv::UMat energy = energyBuffer(view);
+
+    size_t pixels[2] = { static_cast<size_t>(cols), static_cast<size_t>(rows) };
+    bool ok = cv::ocl::Kernel("seam_energy", kernels->program)
+                  .args(KernelArg::ReadOnly(gray), KernelArg::WriteOnlyNoSize(energy),
+                        energyFunctionCode(energyFunction))
+                  .run(2, pixels, nullptr, false);
+
+    size_t group[1] = { kernels->dpGroupSize };
+    ok = ok && cv::ocl::Kernel("seam_dp", kernels->program)
+                   .args(KernelArg::ReadOnly(energy), KernelArg::PtrReadWrite(costBuffer),
+                         KernelArg::PtrWriteOnly(seamBuffer))
+                   .run(1, group, group, false);
+
+    size_t kept[2] = { static_cast<size_t>(cols - 1), static_cast<size_t>(rows) };
+    cv::UMat* planes[2] = { imageBuffers, grayBuffers };
+    for (int p = 0; p < 2; p++) {
+        cv::UMat src = planes[p][current](view);
+        cv::UMat dst = planes[p][1 - current](carved);
+        ok = ok && cv::ocl::Kernel("remove_seam", kernels->program)
+                       .args(KernelArg::ReadOnly(src), KernelArg::WriteOnly(dst), KernelArg::PtrReadOnly(seamBuffer),
+                             static_cast<int>(src.elemSize()))
+                       .run(2, kept, nullptr, p == 1);
+    }
+    if (!ok) {
+        throw std::runtime_error("An OpenCL seam kernel failed to run.");
+    }
+    current = 1 - current;
+    cols--;
+    haveSeam = true;
+}
+
+int GpuCarver::removeSeams(int count, const ProgressCallback& progress, const CancelToken* cancel,
+                           int doneBefore, int total, std::chrono::steady_clock::time_point start) {
+    const int seams = std::max(0, std::min(count, cols - 1));
+    for (int k = 0; k < seams; k++) {
+        removeSeam();
+        if (progress) {
+            CarveProgress p;
+            p.seamsDone = doneBefore + k + 1;
+            p.seamsTotal = total;
+            p.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            progress(p);
+        }
+        if (cancel && cancel->cancelled() && doneBefore + k + 1 < total) {
+            throw CarveCancelled();
+        }
+    }
+    return seams;
+}
+
+int GpuCarver::removeVerticalSeams(int count, const ProgressCallback& progress, const CancelToken* cancel) {
+    setLayout(false);
+    const int total = std::max(0, std::min(count, cols - 1));
+    return removeSeams(total, progress, cancel, 0, total, std::chrono::steady_clock::now());
+}
+
+int GpuCarver::removeHorizontalSeams(int count, const ProgressCallback& progress, const CancelToken* cancel) {
+    setLayout(true);
+    const int total = std::max(0, std::min(count, cols - 1));
+    return removeSeams(total, progress, cancel, 0, total, std::chrono::steady_clock::now());
+}
+
+cv::Mat GpuCarver::resize(int newWidth, int newHeight, const ProgressCallback& progress, const CancelToken* cancel) {
+    if (newWidth < 1 || newHeight < 1 || newWidth > width() || newHeight > height()) {
+        throw std::runtime_error("GPU carving can only reduce the image, to at least 1x1.");
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const int vertical = width() - newWidth;
+    const int horizontal = height() - newHeight;
+    if (vertical > 0) {
+        setLayout(false);
+        removeSeams(vertical, progress, cancel, 0, vertical + horizontal, start);
+    }
+    if (horizontal > 0) {
+        setLayout(true);
+        removeSeams(horizontal, progress, cancel, vertical, vertical + horizontal, start);
+    }
+    return download();
+}
+
+cv::UMat GpuCarver::image() const {
+    cv::UMat view = imageBuffers[current](cv::Rect(0, 0, cols, rows));
+    if (!transposed) return view;
+    cv::UMat upright;
+    cv::transpose(view, upright);
+    return upright;
+}
+
+cv::Mat GpuCarver::download() const {
+    cv::Mat out;
+    image().copyTo(out);
+    return out;
+}
+
+std::vector<int> GpuCarver::lastSeam() const {
+    if (!haveSeam) return {};
+    cv::Mat seam;
+    seamBuffer.colRange(0, rows).copyTo(seam);
+    return std::vector<int>(seam.ptr<int>(0), seam.ptr<int>(0) + rows);
+}
@@ -0,0 +1,99 @@
+#ifndef SEAM_GPU_H
+#define SEAM_GPU_H
+
+#include "SeamCarver.h"
+#include <chrono>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Seam carving on an OpenCL device through OpenCV's cv::UMat.
+ *
+ * The image, its gray plane, the energy map, the DP cost table and the
+ * seam stay in device memory for the whole carve. Each seam is three
+ * kernels on the device queue: the per-pixel energy of the gray plane, a
+ * row-by-row DP in one work-group that also backtracks the seam, and the
+ * removal of the seam from the image and gray planes. Nothing is read back
+ * between seams; image() is the carved image still on the device, e.g. for
+ * cv::ogl interop with a display texture.
+ *
+ * Seams are those of findVerticalSeamDP (findHorizontalSeamDP) at Float
+ * precision, with the same kernels and tie-breaking, up to the rounding of
+ * the device's sqrt. Saliency, masks, forward energy and the other
+ * strategies stay on the CPU.
+ */
+class GpuCarver {
+public:
+    // @brief Whether OpenCV has an OpenCL device and the seam kernels build on it.
+    static bool available();
+
+    /**
+     * @brief Upload image (see SeamCarver::isSupportedImageType). Throws
+     * std::runtime_error if available() is false.
+     */
+    explicit GpuCarver(const cv::Mat& image);
+    ~GpuCarver();
+
+    // @brief Local energy function of the seams (EnergyFunction::Saliency
+    // is rejected, since it needs the whole map).
+    void setEnergyFunction(EnergyFunction function);
+    EnergyFunction getEnergyFunction() const { return energyFunction; }
+
+    int width() const { return transposed ? rows : cols; }
+    int height() const { return transposed ? cols : rows; }
+
+    /**
+     * @brief Remove count vertical (horizontal) seams, or fewer once the
+     * width (height) is 1. progress is reported and cancel checked after
+     * every seam; on CarveCancelled the seams removed so far stay removed.
+     * @return number of seams removed
+     */
+    int removeVerticalSeams(int count, const ProgressCallback& progress = ProgressCallback(),
+                            const CancelToken* cancel = nullptr);
+    int removeHorizontalSeams(int count, const ProgressCallback& progress = ProgressCallback(),
+                              const CancelToken* cancel = nullptr);
+
+    /**
+     * @brief Reduce to newWidth x newHeight, width first, and download the
+     * result. Throws std::runtime_error for a larger target (seam
+     * insertion is CPU only).
+     */
+    cv::Mat resize(int newWidth, int newHeight, const ProgressCallback& progress = ProgressCallback(),
+                   const CancelToken* cancel = nullptr);
+
+    // @brief The carved image on the device: a view of a device buffer, or
+    // after horizontal seams its transpose.
+    cv::UMat image() const;
+
+    // @brief Copy of the carved image in host memory.
+    cv::Mat download() const;
+
+    // @brief Last removed seam, read back from the device (empty before the first).
+    std::vector<int> lastSeam() const;
+
+private:
+    struct Kernels;
+
+    void setLayout(bool horizontal);
+    int removeSeams(int count, const ProgressCallback& progress, const CancelToken* cancel,
+                    int doneBefore, int total, std::chrono::steady_clock::time_point start);
+    void removeSeam();
+
+    std::unique_ptr<Kernels> kernels;
+    EnergyFunction energyFunction = EnergyFunction::Sobel;
+    // Planes in the layout of the current phase: transposed while carving
+    // horizontal seams, so every seam is a vertical seam of the planes.
+    // Image and gray are double-buffered; removal writes the other buffer.
+    cv::UMat imageBuffers[2];
+    cv::UMat grayBuffers[2];
+    int current = 0;
+    cv::UMat energyBuffer;
+    cv::UMat costBuffer;  // rows x cols float DP table
+    cv::UMat seamBuffer;  // 1 x rows CV_32S, last seam
+    bool transposed = false;
+    bool haveSeam = false;
+    int rows = 0;
+    int cols = 0;
+};
+
+#endif // SEAM_GPU_H
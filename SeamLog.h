@@ -0,0 +1,38 @@
+#ifndef SEAM_LOG_H
+#define SEAM_LOG_H
+
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+/**
+ * @brief Verbosity of SeamCarver's log messages.
+ *  - Silent: nothing (the default)
+ *  - Info:   one line per resize phase (start, seam counts, completion)
+ *  - Debug:  also a progress line every 10 seams
+ */
+enum class LogLevel {
+    Silent,
+    Info,
+    Debug
+};
+
+// Receives each message as one line, without the newline. Called on the
+// thread that runs the carver.
+typedef std::function<void(LogLevel, const std::string&)> SeamLogger;
+
+/**
+ * @brief Logger writing one line per message to os. Lines of all stream
+ * loggers are serialized by one mutex, so carvers on several threads may
+ * share a stream. os must outlive the logger.
+ */
+inline SeamLogger streamLogger(std::ostream& os) {
+    return [&os](LogLevel, const std::string& message) {
+        static std::mutex lineMutex;
+        std::lock_guard<std::mutex> lock(lineMutex);
+        os << message << '\n';
+    };
+}
+
+#endif // SEAM_LOG_H
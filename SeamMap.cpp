@@ -0,0 +1,394 @@
+#include "SeamMap.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kMagic[4] = { 'S', 'C', 'M', 'P' };
+
+#pragma pack(push, 1)
+struct SeamMapHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t minWidth;
+    int32_t minHeight;
+    uint64_t sourceHash;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(SeamMapHeader) % sizeof(int32_t) == 0,
+              "order planes must stay 4-byte aligned after the header");
+
+inline void fnv1a(uint64_t& h, const void* bytes, size_t n) {
+    const unsigned char* p = static_cast<const unsigned char*>(bytes);
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+}
+
+} // namespace
+
+uint64_t hashImage(const cv::Mat& img) {
+    uint64_t h = 14695981039346656037ULL;
+    int32_t dims[3] = { img.cols, img.rows, img.type() };
+    fnv1a(h, dims, sizeof(dims));
+    const size_t rowBytes = img.cols * img.elemSize();
+    for (int i = 0; i < img.rows; i++) {
+        fnv1a(h, img.ptr<uchar>(i), rowBytes);
+    }
+    return h;
+}
+
+std::string seamMapPathFor(const std::string& imagePath) {
+    return imagePath + ".seammap";
+}
+
+void saveSeamMap(const std::string& path, const SeamIndexMap& map, const cv::Mat& source) {
+    if (map.empty() || map.vertical.size() != source.size() || map.horizontal.size() != source.size()) {
+        throw std::runtime_error("Seam map does not match the source image.");
+    }
+
+    SeamMapHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kSeamMapVersion;
+    header.width = source.cols;
+    header.height = source.rows;
+    header.minWidth = map.minWidth;
+    header.minHeight = map.minHeight;
+    header.sourceHash = hashImage(source);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Could not open seam map for writing: " + path);
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const size_t rowBytes = source.cols * sizeof(int32_t);
+    for (const cv::Mat* plane : { &map.vertical, &map.horizontal }) {
+        for (int i = 0; i < plane->rows; i++) {
+            out.write(reinterpret_cast<const char*>(plane->ptr<int>(i)), rowBytes);
+        }
+    }
+    if (!out) {
+        throw std::runtime_error("Failed to write seam map: " + path);
+    }
+}
+
+MappedFile::MappedFile(const std::string& path, const std::string& what) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Could not open " + what + ": " + path);
+    }
+    fileHandle = file;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        unmap();
+        throw std::runtime_error("Could not read " + what + " size: " + path);
+    }
+    bytes = static_cast<size_t>(fileSize.QuadPart);
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle) {
+        base = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!base) {
+        unmap();
+        throw std::runtime_error("Could not map " + what + ": " + path);
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + what + ": " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Could not read " + what + " size: " + path);
+    }
+    bytes = static_cast<size_t>(st.st_size);
+    void* p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // the mapping keeps the file alive
+    if (p == MAP_FAILED) {
+        throw std::runtime_error("Could not map " + what + ": " + path);
+    }
+    base = static_cast<const unsigned char*>(p);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+void MappedFile::unmap() {
+#ifdef _WIN32
+    if (base) UnmapViewOfFile(base);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (base) munmap(const_cast<unsigned char*>(base), bytes);
+#endif
+    base = nullptr;
+    bytes = 0;
+}
+
+MappedSeamMap::MappedSeamMap(const std::string& path)
+    : file(path, "seam map") {
+    const unsigned char* data = file.data();
+    const size_t size = file.size();
+    SeamMapHeader header;
+    if (size < sizeof(header)) {
+        throw std::runtime_error("Seam map is truncated: " + path);
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kSeamMapVersion) {
+        throw std::runtime_error("Not a supported seam map file: " + path);
+    }
+    const size_t planeBytes = static_cast<size_t>(header.width) * header.height * sizeof(int32_t);
+    if (header.width <= 0 || header.height <= 0 || size != sizeof(header) + 2 * planeBytes) {
+        throw std::runtime_error("Seam map is truncated: " + path);
+    }
+
+    // Wrap the planes in place; the const_cast is safe as long as callers
+    // honour the read-only contract of map()
+    unsigned char* planes = const_cast<unsigned char*>(data) + sizeof(header);
+    seamMap.vertical = cv::Mat(header.height, header.width, CV_32S, planes);
+    seamMap.horizontal = cv::Mat(header.height, header.width, CV_32S, planes + planeBytes);
+    seamMap.minWidth = header.minWidth;
+    seamMap.minHeight = header.minHeight;
+    hash = header.sourceHash;
+}
+
+bool MappedSeamMap::matches(const cv::Mat& source) const {
+    return source.size() == seamMap.vertical.size() && hashImage(source) == hash;
+}
+
+MappedImage::MappedImage(const std::string& path)
+    : file(path, "image") {
+    // Netpbm header: magic, width, height and maxval separated by
+    // whitespace and '#' comments, then one whitespace byte
+    const unsigned char* data = file.data();
+    const size_t size = file.size();
+    size_t pos = 2;
+    auto field = [&]() {
+        for (;;) {
+            while (pos < size && std::isspace(data[pos])) pos++;
+            if (pos < size && data[pos] == '#') {
+                while (pos < size && data[pos] != '\n') pos++;
+                continue;
+            }
+            break;
+        }
+        long long value = 0;
+        const size_t start = pos;
+        while (pos < size && std::isdigit(data[pos]) && value <= INT32_MAX) value = value * 10 + (data[pos++] - '0');
+        if (pos == start || value > INT32_MAX) {
+            throw std::runtime_error("Invalid PPM/PGM header: " + path);
+        }
+        return static_cast<int>(value);
+    };
+    if (size < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6')) {
+        throw std::runtime_error("Not a binary PPM/PGM image: " + path);
+    }
+    planes = data[1] == '6' ? 3 : 1;
+    width = field();
+    height = field();
+    if (field() != 255) {
+        throw std::runtime_error("Only 8-bit PPM/PGM images can be mapped: " + path);
+    }
+    pos++;  // the single whitespace byte before the samples
+    const size_t rowBytes = static_cast<size_t>(width) * planes;
+    if (width <= 0 || height <= 0 || pos > size || (size - pos) / rowBytes < static_cast<size_t>(height)) {
+        throw std::runtime_error("Image is truncated: " + path);
+    }
+    pixels = data + pos;
+}
+
+cv::Mat MappedImage::readRows(int r0, int r1) const {
+    cv::Mat strip(r1 - r0, width, planes == 3 ? CV_8UC3 : CV_8UC1);
+    for (int r = r0; r < r1; r++) {
+        const uchar* src = row(r);
+        uchar* dst = strip.ptr<uchar>(r - r0);
+        if (planes == 1) {
+            std::memcpy(dst, src, width);
+            continue;
+        }
+        for (int c = 0; c < width; c++, src += 3, dst += 3) {
+            dst[0] = src[2];  // RGB in the file, BGR in OpenCV
+            dst[1] = src[1];
+            dst[2] = src[0];
+        }
+    }
+    return strip;
+}
+
+uint64_t hashImage(const MappedImage& img) {
+    uint64_t h = 14695981039346656037ULL;
+    int32_t dims[3] = { img.cols(), img.rows(), img.channels() == 3 ? CV_8UC3 : CV_8UC1 };
+    fnv1a(h, dims, sizeof(dims));
+    const size_t rowBytes = static_cast<size_t>(img.cols()) * img.channels();
+    std::vector<uchar> bgr(img.channels() == 3 ? rowBytes : 0);
+    for (int i = 0; i < img.rows(); i++) {
+        const uchar* src = img.row(i);
+        if (bgr.empty()) {
+            fnv1a(h, src, rowBytes);
+            continue;
+        }
+        for (size_t k = 0; k < rowBytes; k += 3) {
+            bgr[k] = src[k + 2];
+            bgr[k + 1] = src[k + 1];
+            bgr[k + 2] = src[k];
+        }
+        fnv1a(h, bgr.data(), rowBytes);
+    }
+    return h;
+}
+
+void renderSeamMapRows(const SeamIndexMap& map, int width, int height, size_t elemSize,
+                       const SeamRowSource& source, const SeamRowSink& sink) {
+    if (map.empty()) {
+        throw std::runtime_error("Seam index map does not match the source image.");
+    }
+    const int rows = map.vertical.rows;
+    const int cols = map.vertical.cols;
+    if (width < map.minWidth || width > cols || height < map.minHeight || height > rows) {
+        throw std::runtime_error("Target size is outside the range covered by the seam index map.");
+    }
+    const int removeVertical = cols - width;
+    const int removeHorizontal = rows - height;
+
+    // Row i after the width pass: source column and horizontal order of
+    // each kept pixel, the order clamped so kKept sorts as rows
+    std::vector<int> from(width), order(width);
+    auto narrow = [&](int i) {
+        const int* v = map.vertical.ptr<int>(i);
+        const int* h = map.horizontal.ptr<int>(i);
+        int o = 0;
+        for (int j = 0; j < cols; j++) {
+            if (v[j] < removeVertical) continue;
+            if (o == width) throw std::runtime_error("Seam index map is inconsistent.");
+            from[o] = j;
+            order[o++] = std::min(h[j], rows);
+        }
+        if (o != width) throw std::runtime_error("Seam index map is inconsistent.");
+    };
+
+    // Each column drops its removeHorizontal smallest (order, row) keys:
+    // every order below cut, and the first quota rows at cut. Untouched
+    // columns hold exactly one pixel of each horizontal seam.
+    std::vector<int> cut(width, removeHorizontal), quota(width, 0);
+    if (removeHorizontal > 0 && removeVertical > 0) {
+        // Per-column binary search for the smallest order with at least
+        // removeHorizontal pixels at or below it, all columns per pass
+        std::vector<int> lo(width, 0), hi(width, rows), count(width);
+        auto countBelow = [&](const std::vector<int>& bound, bool inclusive) {
+            std::fill(count.begin(), count.end(), 0);
+            for (int i = 0; i < rows; i++) {
+                narrow(i);
+                for (int c = 0; c < width; c++) {
+                    count[c] += inclusive ? order[c] <= bound[c] : order[c] < bound[c];
+                }
+            }
+        };
+        std::vector<int> mid(width);
+        for (;;) {
+            bool searching = false;
+            for (int c = 0; c < width; c++) {
+                mid[c] = lo[c] + (hi[c] - lo[c]) / 2;
+                searching |= lo[c] < hi[c];
+            }
+            if (!searching) break;
+            countBelow(mid, true);
+            for (int c = 0; c < width; c++) {
+                if (lo[c] == hi[c]) continue;
+                if (count[c] >= removeHorizontal) hi[c] = mid[c];
+                else lo[c] = mid[c] + 1;
+            }
+        }
+        cut = lo;
+        countBelow(cut, false);
+        for (int c = 0; c < width; c++) quota[c] = removeHorizontal - count[c];
+    }
+
+    // Kept pixels move up in their column; a row is passed on once every
+    // column has filled it
+    std::deque<std::vector<uchar>> open;   // output rows [done, done + open.size())
+    std::vector<std::vector<uchar>> spare;
+    std::vector<int> filled(width, 0);
+    int done = 0;
+    for (int i = 0; i < rows; i++) {
+        narrow(i);
+        const uchar* src = source(i);
+        for (int c = 0; c < width; c++) {
+            if (order[c] < cut[c]) continue;
+            if (order[c] == cut[c] && quota[c] > 0) {
+                quota[c]--;
+                continue;
+            }
+            const int r = filled[c]++;
+            if (r >= height) throw std::runtime_error("Seam index map is inconsistent.");
+            while (static_cast<size_t>(r - done) >= open.size()) {
+                if (spare.empty()) {
+                    open.emplace_back(static_cast<size_t>(width) * elemSize);
+                }
+                else {
+                    open.push_back(std::move(spare.back()));
+                    spare.pop_back();
+                }
+            }
+            std::memcpy(open[r - done].data() + c * elemSize, src + from[c] * elemSize, elemSize);
+        }
+        const int ready = *std::min_element(filled.begin(), filled.end());
+        for (; done < ready; done++) {
+            sink(open.front().data());
+            spare.push_back(std::move(open.front()));
+            open.pop_front();
+        }
+    }
+    if (done != height) throw std::runtime_error("Seam index map is inconsistent.");
+}
+
+NetpbmWriter::NetpbmWriter(const std::string& path, int width, int height, int channels)
+    : path(path), out(path, std::ios::binary | std::ios::trunc),
+      rowBytes(static_cast<size_t>(width) * channels), rowsLeft(height) {
+    if (!out) {
+        throw std::runtime_error("Could not open image for writing: " + path);
+    }
+    out << (channels == 3 ? "P6" : "P5") << '\n' << width << ' ' << height << "\n255\n";
+}
+
+void NetpbmWriter::writeRow(const uchar* row) {
+    out.write(reinterpret_cast<const char*>(row), static_cast<std::streamsize>(rowBytes));
+    rowsLeft--;
+    if (!out) {
+        throw std::runtime_error("Failed to save image to: " + path);
+    }
+}
+
+void NetpbmWriter::finish() {
+    out.flush();
+    if (rowsLeft != 0 || !out) {
+        throw std::runtime_error("Failed to save image to: " + path);
+    }
+}
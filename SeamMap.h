@@ -0,0 +1,179 @@
+#ifndef SEAM_MAP_H
+#define SEAM_MAP_H
+
+#include "SeamCarver.h"
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+
+/**
+ * @brief On-disk seam index map.
+ *
+ * Layout (little-endian, no padding):
+ *   char     magic[4]     "SCMP"
+ *   uint32   version      kSeamMapVersion
+ *   int32    width, height
+ *   int32    minWidth, minHeight
+ *   uint64   sourceHash   hashImage() of the image the map was built from
+ *   int32    vertical[height * width]    row-major removal order
+ *   int32    horizontal[height * width]
+ *
+ * The order planes are stored exactly as SeamIndexMap holds them, so a
+ * memory-mapped file is used in place without decoding.
+ */
+static constexpr uint32_t kSeamMapVersion = 1;
+
+/**
+ * @brief 64-bit FNV-1a hash of an image's size, type and pixel data.
+ */
+uint64_t hashImage(const cv::Mat& img);
+
+/**
+ * @brief Default seam map location for an image: next to it, with a
+ * ".seammap" suffix.
+ */
+std::string seamMapPathFor(const std::string& imagePath);
+
+/**
+ * @brief Write a seam index map built from source to path.
+ * Throws std::runtime_error if the map does not match source or the file
+ * cannot be written.
+ */
+void saveSeamMap(const std::string& path, const SeamIndexMap& map, const cv::Mat& source);
+
+/**
+ * @brief Read-only memory mapping of a whole file. Throws
+ * std::runtime_error naming what (e.g. "seam map") if the file cannot be
+ * opened, is empty or cannot be mapped.
+ */
+class MappedFile {
+public:
+    MappedFile(const std::string& path, const std::string& what);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const unsigned char* data() const { return base; }
+    size_t size() const { return bytes; }
+
+private:
+    void unmap();
+
+    const unsigned char* base = nullptr;
+    size_t bytes = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+/**
+ * @brief Read-only memory mapping of a seam map file. The order planes of
+ * map() point into the mapping and stay valid for the object's lifetime.
+ */
+class MappedSeamMap {
+public:
+    /**
+     * @brief Map the file at path. Throws std::runtime_error if it cannot be
+     * opened or is not a valid seam map.
+     */
+    explicit MappedSeamMap(const std::string& path);
+
+    // @brief The mapped seam index map (planes must not be written).
+    const SeamIndexMap& map() const { return seamMap; }
+
+    // @brief Hash of the image the map was built from.
+    uint64_t sourceHash() const { return hash; }
+
+    // @brief True if source is the image the map was built from.
+    bool matches(const cv::Mat& source) const;
+
+private:
+    MappedFile file;
+    SeamIndexMap seamMap;
+    uint64_t hash = 0;
+};
+
+/**
+ * @brief Read-only memory mapping of a binary PPM (P6) or PGM (P5) image
+ * with 8-bit samples. Rows are read straight from the mapping, so a large
+ * image is paged in strip by strip instead of decoded into memory whole.
+ */
+class MappedImage {
+public:
+    /**
+     * @brief Map the image at path. Throws std::runtime_error if it cannot
+     * be mapped or is not an 8-bit binary PPM/PGM.
+     */
+    explicit MappedImage(const std::string& path);
+
+    int rows() const { return height; }
+    int cols() const { return width; }
+    int channels() const { return planes; }
+
+    // @brief Row r as stored: cols() * channels() bytes, RGB for a PPM.
+    const uchar* row(int r) const { return pixels + static_cast<size_t>(r) * width * planes; }
+
+    // @brief Copy of rows [r0, r1) as CV_8UC3 (BGR) or CV_8UC1.
+    cv::Mat readRows(int r0, int r1) const;
+
+private:
+    MappedFile file;
+    const uchar* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int planes = 0;
+};
+
+/**
+ * @brief 64-bit FNV-1a hash of a mapped image, equal to hashImage() of the
+ * image decoded (BGR for a PPM), read one row at a time.
+ */
+uint64_t hashImage(const MappedImage& img);
+
+// Row i of a source image, read once each from the top down
+typedef std::function<const uchar*(int i)> SeamRowSource;
+
+// Takes the rows of a rendered image in order, valid for the call only
+typedef std::function<void(const uchar* row)> SeamRowSink;
+
+/**
+ * @brief SeamCarver::renderFromSeamIndexMap one row at a time: the same
+ * pixels, with the source read through source and each output row passed
+ * to sink once complete. Only the output rows some column has not reached
+ * yet are held (a few, as seams run across the whole width), plus a few
+ * int rows of width; when both sizes shrink, the order planes are read
+ * about log2(rows) more times to find each column's cut instead of
+ * gathering them. Pixels are elemSize bytes, copied as they are. Throws
+ * std::runtime_error if the size is outside the map's range or the map is
+ * inconsistent.
+ */
+void renderSeamMapRows(const SeamIndexMap& map, int width, int height, size_t elemSize,
+                       const SeamRowSource& source, const SeamRowSink& sink);
+
+/**
+ * @brief Binary PPM (P6) or PGM (P5) file written one row at a time, rows
+ * laid out as MappedImage::row() gives them (RGB for a PPM). Throws
+ * std::runtime_error if the file cannot be opened or written, or if
+ * finish() finds rows missing.
+ */
+class NetpbmWriter {
+public:
+    NetpbmWriter(const std::string& path, int width, int height, int channels);
+
+    // @brief Append the next row: width * channels bytes.
+    void writeRow(const uchar* row);
+
+    // @brief Check that every row was written and flush the file.
+    void finish();
+
+private:
+    std::string path;
+    std::ofstream out;
+    size_t rowBytes = 0;
+    int rowsLeft = 0;
+};
+
+#endif // SEAM_MAP_H
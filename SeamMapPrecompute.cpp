@@ -0,0 +1,89 @@
+#include "SeamMapPrecompute.h"
+#include <chrono>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Run the calling thread only when a core would otherwise idle
+void lowerThreadPriority() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_IDLE);
+#elif defined(__linux__)
+    sched_param param{};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+} // namespace
+
+SeamMapPrecompute::~SeamMapPrecompute() {
+    stop();
+}
+
+void SeamMapPrecompute::start(const cv::Mat& image, EnergyPrecision precision, EnergyFunction energy,
+                              const SeamIndexMap& known) {
+    stop();
+    cancel.reset();
+    busy = true;
+    thread = std::thread(&SeamMapPrecompute::build, this, image, precision, energy, known, ++builds);
+}
+
+void SeamMapPrecompute::stop() {
+    cancel.cancel();
+    if (thread.joinable()) thread.join();
+    builds++;  // a snapshot still unread is stale now
+}
+
+const SeamMapSnapshot* SeamMapPrecompute::poll() {
+    if (!snapshots.consume()) return nullptr;
+    const SeamMapSnapshot& snap = snapshots.readSlot();
+    return snap.build == builds ? &snap : nullptr;
+}
+
+void SeamMapPrecompute::build(cv::Mat image, EnergyPrecision precision, EnergyFunction energy, SeamIndexMap known,
+                              unsigned id) {
+    lowerThreadPriority();
+    const auto start = std::chrono::steady_clock::now();
+    auto publish = [&](SeamIndexMap map, SeamIndexGrid grid, bool complete, const std::string& error) {
+        SeamMapSnapshot& snap = snapshots.writeSlot();
+        snap.map = std::move(map);
+        snap.grid = std::move(grid);
+        snap.complete = complete;
+        snap.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        snap.error = error;
+        snap.build = id;
+        snapshots.publish();
+    };
+    try {
+        SeamCarver carver(image);
+        carver.setPrecision(precision);
+        carver.setEnergyFunction(energy);
+        SeamIndexMap map = known;
+        if (map.empty()) {
+            map = carver.buildSeamIndexMap(1, 1, kChunkSeams, [&](const SeamIndexMap& partial) {
+                publish(partial, SeamIndexGrid(), false, std::string());
+            }, &cancel);
+        }
+        else {
+            publish(map, SeamIndexGrid(), false, std::string());
+        }
+        SeamIndexGrid grid = carver.buildSeamIndexGrid(map, SeamIndexGrid::kDefaultLevels, &cancel);
+        publish(std::move(map), std::move(grid), true, std::string());
+    }
+    catch (const CarveCancelled&) {
+        // Replaced by a new build or stopped
+    }
+    catch (const std::exception& e) {
+        publish(SeamIndexMap(), SeamIndexGrid(), false, e.what());
+    }
+    busy = false;
+}
@@ -0,0 +1,68 @@
+#ifndef SEAM_MAP_PRECOMPUTE_H
+#define SEAM_MAP_PRECOMPUTE_H
+
+#include "CarveWorker.h"
+#include "SeamCarver.h"
+#include <string>
+#include <thread>
+
+// Newest state of a background seam map build
+struct SeamMapSnapshot {
+    SeamIndexMap map;            // covers map.minWidth x map.minHeight and up
+    SeamIndexGrid grid;          // built once the map is complete
+    bool complete = false;
+    double elapsedMs = 0.0;
+    std::string error;
+    unsigned build = 0;          // start() that produced it
+};
+
+/**
+ * @brief Builds the seam index map (and then its grid) of an image on a
+ * low-priority background thread, handing out partial maps as it goes, so
+ * the UI can render every size the map already covers while the rest is
+ * still being carved. The thread takes the idle time left by the UI and
+ * the carving worker; it never blocks either of them.
+ */
+class SeamMapPrecompute {
+public:
+    // Seams per axis between two partial maps
+    static constexpr int kChunkSeams = 16;
+
+    SeamMapPrecompute() = default;
+    ~SeamMapPrecompute();
+
+    SeamMapPrecompute(const SeamMapPrecompute&) = delete;
+    SeamMapPrecompute& operator=(const SeamMapPrecompute&) = delete;
+
+    /**
+     * @brief Cancel any build and start one of image down to 1 x 1 with the
+     * given energy settings. The buffer is shared and never written. A
+     * known map of image (e.g. from a cache) is handed out at once and only
+     * its grid is built.
+     */
+    void start(const cv::Mat& image, EnergyPrecision precision, EnergyFunction energy,
+               const SeamIndexMap& known = SeamIndexMap());
+
+    // @brief Cancel the build, if any, and wait for its thread.
+    void stop();
+
+    // @brief Whether a build is running.
+    bool running() const { return busy.load(); }
+
+    /**
+     * @brief Fetch the newest snapshot, if any; never blocks. The returned
+     * snapshot stays valid until the next poll().
+     */
+    const SeamMapSnapshot* poll();
+
+private:
+    void build(cv::Mat image, EnergyPrecision precision, EnergyFunction energy, SeamIndexMap known, unsigned id);
+
+    std::thread thread;
+    unsigned builds = 0;  // start() calls; older snapshots are dropped
+    CancelToken cancel;
+    std::atomic<bool> busy{ false };
+    TripleBuffer<SeamMapSnapshot> snapshots;
+};
+
+#endif // SEAM_MAP_PRECOMPUTE_H
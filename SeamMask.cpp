@@ -0,0 +1,241 @@
+#include "SeamMask.h"
+#include <algorithm>
+#include <stdexcept>
+
+SeamMask::SeamMask(const cv::Mat& protect, const cv::Mat& remove) {
+    if (protect.empty() && remove.empty()) return;
+    const cv::Mat& shape = protect.empty() ? remove : protect;
+    for (const cv::Mat* plane : { &protect, &remove }) {
+        if (!plane->empty() && (plane->type() != CV_8UC1 || plane->size() != shape.size())) {
+            throw std::runtime_error("Masks must be single-channel 8-bit planes of the image size.");
+        }
+    }
+    rows = shape.rows;
+    cols = shape.cols;
+    wordsPerRow = (cols + 63) / 64;
+    pack(protectBits, protect);
+    pack(removeBits, remove);
+    // Protect wins, so every counted pixel can actually be carved
+    for (size_t w = 0; w < removeBits.size(); w++) {
+        removeBits[w] &= ~protectBits[w];
+        for (uint64_t word = removeBits[w]; word; word &= word - 1) removeCount++;
+    }
+}
+
+void SeamMask::pack(std::vector<uint64_t>& bits, const cv::Mat& plane) {
+    bits.assign(static_cast<size_t>(rows) * wordsPerRow, 0);
+    if (plane.empty()) return;
+    for (int r = 0; r < rows; r++) {
+        const uchar* p = plane.ptr<uchar>(r);
+        for (int c = 0; c < cols; c++) {
+            if (p[c]) set(bits, r, c, true);
+        }
+    }
+}
+
+cv::Mat SeamMask::unpack(const std::vector<uint64_t>& bits) const {
+    cv::Mat plane(rows, cols, CV_8UC1);
+    for (int r = 0; r < rows; r++) {
+        uchar* p = plane.ptr<uchar>(r);
+        for (int c = 0; c < cols; c++) p[c] = test(bits, r, c) ? 255 : 0;
+    }
+    return plane;
+}
+
+// Drop column c of row r: the words from c on shift down one bit, each
+// taking the lowest bit of the next word. Bits past cols stay clear.
+void SeamMask::removeColumn(std::vector<uint64_t>& bits, int r, int c) {
+    uint64_t* row = bits.data() + static_cast<size_t>(r) * wordsPerRow;
+    const int w = c >> 6;
+    const uint64_t below = (uint64_t(1) << (c & 63)) - 1;
+    for (int v = w; v < wordsPerRow; v++) {
+        const uint64_t carry = v + 1 < wordsPerRow ? row[v + 1] << 63 : 0;
+        const uint64_t shifted = (row[v] >> 1) | carry;
+        row[v] = v == w ? (row[v] & below) | (shifted & ~below) : shifted;
+    }
+}
+
+// Inverse of removeColumn: the words from c on shift up one bit and bit c
+// becomes value. The row has room, since cols is below its original width.
+void SeamMask::insertColumn(std::vector<uint64_t>& bits, int r, int c, bool value) {
+    uint64_t* row = bits.data() + static_cast<size_t>(r) * wordsPerRow;
+    const int w = c >> 6;
+    const uint64_t below = (uint64_t(1) << (c & 63)) - 1;
+    for (int v = wordsPerRow - 1; v >= w; v--) {
+        const uint64_t carry = v > w ? row[v - 1] >> 63 : 0;
+        const uint64_t shifted = (row[v] << 1) | carry;
+        row[v] = v == w ? (row[v] & below) | (shifted & ~below) : shifted;
+    }
+    set(bits, r, c, value);
+}
+
+// Drop rows seamRows (ascending) of column c, moving the rest up
+void SeamMask::removeRows(std::vector<uint64_t>& bits, int c, const int* seamRows, size_t count) {
+    size_t next = 0;
+    int out = seamRows[0];
+    for (int r = out; r < rows; r++) {
+        if (next < count && seamRows[next] == r) {
+            if (&bits == &removeBits && test(bits, r, c)) removeCount--;
+            next++;
+            continue;
+        }
+        set(bits, out++, c, test(bits, r, c));
+    }
+    for (; out < rows; out++) set(bits, out, c, false);
+}
+
+void SeamMask::removeVerticalSeam(const std::vector<int>& seam) {
+    if (empty()) return;
+    for (int r = 0; r < rows; r++) {
+        if (test(removeBits, r, seam[r])) removeCount--;
+        removeColumn(protectBits, r, seam[r]);
+        removeColumn(removeBits, r, seam[r]);
+    }
+    cols--;
+}
+
+void SeamMask::removeHorizontalSeam(const std::vector<int>& seam) {
+    if (empty()) return;
+    for (int c = 0; c < cols; c++) {
+        removeRows(protectBits, c, &seam[c], 1);
+        removeRows(removeBits, c, &seam[c], 1);
+    }
+    rows--;
+}
+
+void SeamMask::removeVerticalSeams(const std::vector<std::vector<int>>& seams) {
+    if (empty() || seams.empty()) return;
+    std::vector<int> columns(seams.size());
+    for (int r = 0; r < rows; r++) {
+        for (size_t k = 0; k < seams.size(); k++) columns[k] = seams[k][r];
+        // Right to left, so the columns still to go keep their index
+        std::sort(columns.rbegin(), columns.rend());
+        for (int c : columns) {
+            if (test(removeBits, r, c)) removeCount--;
+            removeColumn(protectBits, r, c);
+            removeColumn(removeBits, r, c);
+        }
+    }
+    cols -= static_cast<int>(seams.size());
+}
+
+void SeamMask::removeHorizontalSeams(const std::vector<std::vector<int>>& seams) {
+    if (empty() || seams.empty()) return;
+    std::vector<int> seamRows(seams.size());
+    for (int c = 0; c < cols; c++) {
+        for (size_t k = 0; k < seams.size(); k++) seamRows[k] = seams[k][c];
+        std::sort(seamRows.begin(), seamRows.end());
+        removeRows(protectBits, c, seamRows.data(), seamRows.size());
+        removeRows(removeBits, c, seamRows.data(), seamRows.size());
+    }
+    rows -= static_cast<int>(seams.size());
+}
+
+std::vector<uint8_t> SeamMask::seamBits(const std::vector<int>& seam, bool vertical) const {
+    std::vector<uint8_t> bits;
+    if (empty()) return bits;
+    bits.resize(seam.size());
+    for (int k = 0; k < static_cast<int>(seam.size()); k++) {
+        const int r = vertical ? k : seam[k];
+        const int c = vertical ? seam[k] : k;
+        bits[k] = (test(protectBits, r, c) ? kSeamProtect : 0) | (test(removeBits, r, c) ? kSeamRemove : 0);
+    }
+    return bits;
+}
+
+void SeamMask::insertVerticalSeam(const std::vector<int>& seam, const std::vector<uint8_t>& bits) {
+    if (empty()) return;
+    if (cols >= wordsPerRow * 64) {
+        throw std::runtime_error("Mask has no removed column to put back.");
+    }
+    for (int r = 0; r < rows; r++) {
+        const bool remove = (bits[r] & kSeamRemove) != 0;
+        if (remove) removeCount++;
+        insertColumn(protectBits, r, seam[r], (bits[r] & kSeamProtect) != 0);
+        insertColumn(removeBits, r, seam[r], remove);
+    }
+    cols++;
+}
+
+void SeamMask::insertHorizontalSeam(const std::vector<int>& seam, const std::vector<uint8_t>& bits) {
+    if (empty()) return;
+    if (static_cast<size_t>(rows + 1) * wordsPerRow > protectBits.size()) {
+        throw std::runtime_error("Mask has no removed row to put back.");
+    }
+    rows++;
+    for (int c = 0; c < cols; c++) {
+        // Move column c down one row from the seam on, then fill the gap
+        for (int r = rows - 1; r > seam[c]; r--) {
+            set(protectBits, r, c, test(protectBits, r - 1, c));
+            set(removeBits, r, c, test(removeBits, r - 1, c));
+        }
+        const bool remove = (bits[c] & kSeamRemove) != 0;
+        if (remove) removeCount++;
+        set(protectBits, seam[c], c, (bits[c] & kSeamProtect) != 0);
+        set(removeBits, seam[c], c, remove);
+    }
+}
+
+void SeamMask::transpose() {
+    if (empty()) return;
+    SeamMask t;
+    t.rows = cols;
+    t.cols = rows;
+    t.wordsPerRow = (t.cols + 63) / 64;
+    t.protectBits.assign(static_cast<size_t>(t.rows) * t.wordsPerRow, 0);
+    t.removeBits.assign(t.protectBits.size(), 0);
+    t.removeCount = removeCount;
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            if (test(protectBits, r, c)) t.set(t.protectBits, c, r, true);
+            if (test(removeBits, r, c)) t.set(t.removeBits, c, r, true);
+        }
+    }
+    *this = std::move(t);
+}
+
+template <typename T>
+static void applyBits(cv::Mat& energy, const std::vector<uint64_t>& bits, int wordsPerRow, double value) {
+    const T v = cv::saturate_cast<T>(value);
+    for (int r = 0; r < energy.rows; r++) {
+        const uint64_t* row = bits.data() + static_cast<size_t>(r) * wordsPerRow;
+        T* e = energy.ptr<T>(r);
+        for (int w = 0; w < wordsPerRow; w++) {
+            for (uint64_t word = row[w], b = 0; word; word >>= 1, b++) {
+                if (word & 1) e[w * 64 + b] = v;
+            }
+        }
+    }
+}
+
+// The mask energies need a signed floating-point map
+static void checkMaskedMap(const cv::Mat& energy, cv::Size size) {
+    if (energy.size() != size) {
+        throw std::runtime_error("Mask does not match the energy map.");
+    }
+    if (energy.depth() == CV_16U) {
+        throw std::runtime_error("A CV_16U energy map cannot hold the mask energies (use CV_32F).");
+    }
+    if (energy.depth() != CV_32F && energy.depth() != CV_64F) {
+        throw std::runtime_error("Unsupported energy map depth.");
+    }
+}
+
+void SeamMask::applyTo(cv::Mat& energy) const {
+    if (empty()) return;
+    checkMaskedMap(energy, size());
+    if (energy.depth() == CV_32F) {
+        applyBits<float>(energy, removeBits, wordsPerRow, -kProtectEnergy);
+        applyBits<float>(energy, protectBits, wordsPerRow, kProtectEnergy);
+    } else {
+        applyBits<double>(energy, removeBits, wordsPerRow, -kProtectEnergy);
+        applyBits<double>(energy, protectBits, wordsPerRow, kProtectEnergy);
+    }
+}
+
+void SeamMask::applyShiftedTo(const cv::Mat& energy, cv::Mat& shifted) const {
+    checkMaskedMap(energy, empty() ? energy.size() : size());
+    energy.convertTo(shifted, CV_64F, 1.0, kProtectEnergy);
+    applyBits<double>(shifted, removeBits, wordsPerRow, 0.0);
+    applyBits<double>(shifted, protectBits, wordsPerRow, 2 * kProtectEnergy);
+}
@@ -0,0 +1,108 @@
+#ifndef SEAM_MASK_H
+#define SEAM_MASK_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Protect/remove mask of an image, one bit per pixel and plane.
+ *
+ * Each row is packed into 64-bit words, bit j % 64 of word j / 64 holding
+ * column j. The mask is carved with the same seams as the image, so it
+ * always covers the current image. Only masked pixels are visited when it
+ * is applied to an energy map, and all-clear words are skipped whole.
+ */
+class SeamMask {
+public:
+    // Energy of protected pixels; removed pixels get its negation
+    static constexpr double kProtectEnergy = 1e6;
+
+    SeamMask() = default;
+
+    /**
+     * @param protect CV_8UC1, nonzero = keep; may be empty
+     * @param remove  CV_8UC1, nonzero = carve first; may be empty
+     * Non-empty planes must have the same size. Throws std::runtime_error
+     * otherwise. Pixels marked in both planes are protected.
+     */
+    SeamMask(const cv::Mat& protect, const cv::Mat& remove);
+
+    bool empty() const { return rows == 0; }
+    cv::Size size() const { return cv::Size(cols, rows); }
+
+    // @brief Pixels marked for removal that are still in the image. Kept up
+    // to date by the seam removals, so reading it is O(1).
+    int remainingRemove() const { return removeCount; }
+
+    // @brief Mask planes as CV_8UC1 (255 = set), for display and tests.
+    cv::Mat protectPlane() const { return unpack(protectBits); }
+    cv::Mat removePlane() const { return unpack(removeBits); }
+
+    void removeVerticalSeam(const std::vector<int>& seam);
+    void removeHorizontalSeam(const std::vector<int>& seam);
+
+    // @brief Disjoint seams from one cost table, all in current coordinates.
+    void removeVerticalSeams(const std::vector<std::vector<int>>& seams);
+    void removeHorizontalSeams(const std::vector<std::vector<int>>& seams);
+
+    /**
+     * @brief Mask bits along a seam of the current mask, one byte per seam
+     * pixel (kSeamProtect | kSeamRemove); what insert*Seam needs to put
+     * the seam back. Empty for an empty mask.
+     */
+    std::vector<uint8_t> seamBits(const std::vector<int>& seam, bool vertical) const;
+
+    // @brief Inverse of remove*Seam: put a seam with the given seamBits
+    // back. Only seams removed since construction can be reinserted.
+    void insertVerticalSeam(const std::vector<int>& seam, const std::vector<uint8_t>& bits);
+    void insertHorizontalSeam(const std::vector<int>& seam, const std::vector<uint8_t>& bits);
+
+    static constexpr uint8_t kSeamProtect = 1;
+    static constexpr uint8_t kSeamRemove = 2;
+
+    void transpose();
+
+    /**
+     * @brief Overwrite the energy of masked pixels: kProtectEnergy for
+     * protected ones and -kProtectEnergy for removed ones. Protect wins
+     * where both are set. energy must match size() and be CV_32F or
+     * CV_64F; a CV_16U (Fixed16) map cannot hold the values and throws
+     * std::runtime_error.
+     */
+    void applyTo(cv::Mat& energy) const;
+
+    /**
+     * @brief The masked energy for solvers that need non-negative costs
+     * (graph cut): energy as CV_64F raised by kProtectEnergy, with removed
+     * pixels 0 and protected ones 2 * kProtectEnergy. A seam crosses every
+     * row (column) once, so seams rank as they do under applyTo. shifted is
+     * reused when it has the size already. Same requirements as applyTo.
+     */
+    void applyShiftedTo(const cv::Mat& energy, cv::Mat& shifted) const;
+
+private:
+    bool test(const std::vector<uint64_t>& bits, int r, int c) const {
+        return (bits[r * wordsPerRow + (c >> 6)] >> (c & 63)) & 1;
+    }
+    void set(std::vector<uint64_t>& bits, int r, int c, bool value) {
+        uint64_t& w = bits[r * wordsPerRow + (c >> 6)];
+        const uint64_t bit = uint64_t(1) << (c & 63);
+        w = value ? (w | bit) : (w & ~bit);
+    }
+    void pack(std::vector<uint64_t>& bits, const cv::Mat& plane);
+    cv::Mat unpack(const std::vector<uint64_t>& bits) const;
+    void removeColumn(std::vector<uint64_t>& bits, int r, int c);
+    void insertColumn(std::vector<uint64_t>& bits, int r, int c, bool value);
+    // Drop the count ascending seamRows from column c
+    void removeRows(std::vector<uint64_t>& bits, int c, const int* seamRows, size_t count);
+
+    int rows = 0;
+    int cols = 0;
+    int wordsPerRow = 0;  // fixed at construction; carving only lowers cols
+    int removeCount = 0;  // set bits of removeBits
+    std::vector<uint64_t> protectBits;
+    std::vector<uint64_t> removeBits;
+};
+
+#endif // SEAM_MASK_H
@@ -0,0 +1,218 @@
+#include "SeamMemory.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <malloc.h>
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t kAlignment = 64;
+
+size_t roundUp(size_t n, size_t to) {
+    return (n + to - 1) / to * to;
+}
+
+unsigned char* alignedAlloc(size_t n) {
+#ifdef _WIN32
+    void* p = _aligned_malloc(n, kAlignment);
+#else
+    void* p = std::aligned_alloc(kAlignment, roundUp(n, kAlignment));
+#endif
+    if (!p) throw std::bad_alloc();
+    return static_cast<unsigned char*>(p);
+}
+
+void alignedFree(unsigned char* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+#if defined(__linux__)
+// mbind(2) modes; the syscall is used directly so libnuma is not needed
+const int kMpolPreferred = 1;
+
+bool preferNode(void* addr, size_t bytes, int node) {
+    std::vector<unsigned long> mask(static_cast<size_t>(node) / (8 * sizeof(unsigned long)) + 1, 0ul);
+    mask[static_cast<size_t>(node) / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_mbind, addr, bytes, kMpolPreferred, mask.data(), mask.size() * 8 * sizeof(unsigned long),
+                   0u) == 0;
+}
+#endif
+
+} // namespace
+
+unsigned char* PageBuffer::reserve(size_t n) {
+    if (n <= length && bytes) return bytes;
+    release();
+    if (n == 0) return nullptr;
+
+    if (placement.isDefault()) {
+        bytes = alignedAlloc(n);
+        length = n;
+        source = Source::Heap;
+        return bytes;
+    }
+    const bool wantHuge = placement.hugePages && n >= BufferPlacement::kHugePageBytes;
+    const int node = placement.numaNode == BufferPlacement::kLocalNode ? currentNumaNode() : placement.numaNode;
+
+#if defined(__linux__)
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void* p = MAP_FAILED;
+    if (wantHuge) {
+        mapped = roundUp(n, BufferPlacement::kHugePageBytes);
+        p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        huge = p != MAP_FAILED;
+    }
+    if (p == MAP_FAILED) {
+        // No reserved huge pages: ask for transparent ones on a plain
+        // mapping, aligned to whole huge pages by its size
+        mapped = roundUp(n, wantHuge ? BufferPlacement::kHugePageBytes : page);
+        p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+        huge = wantHuge && madvise(p, mapped, MADV_HUGEPAGE) == 0;
+#endif
+    }
+    // Before the first touch, so every page is placed by the policy
+    if (node >= 0 && preferNode(p, mapped, node)) boundNode = node;
+    bytes = static_cast<unsigned char*>(p);
+    length = n;
+    source = Source::Mapped;
+    return bytes;
+#elif defined(_WIN32)
+    void* p = nullptr;
+    const DWORD flags = MEM_RESERVE | MEM_COMMIT;
+    const SIZE_T largePage = GetLargePageMinimum();
+    if (wantHuge && largePage > 0) {
+        // Needs the "Lock pages in memory" privilege; plain pages otherwise
+        mapped = roundUp(n, largePage);
+        p = node >= 0 ? VirtualAllocExNuma(GetCurrentProcess(), nullptr, mapped, flags | MEM_LARGE_PAGES,
+                                           PAGE_READWRITE, static_cast<DWORD>(node))
+                      : VirtualAlloc(nullptr, mapped, flags | MEM_LARGE_PAGES, PAGE_READWRITE);
+        huge = p != nullptr;
+    }
+    if (!p) {
+        mapped = n;
+        p = node >= 0 ? VirtualAllocExNuma(GetCurrentProcess(), nullptr, mapped, flags, PAGE_READWRITE,
+                                           static_cast<DWORD>(node))
+                      : VirtualAlloc(nullptr, mapped, flags, PAGE_READWRITE);
+        if (!p) throw std::bad_alloc();
+    }
+    if (node >= 0) boundNode = node;
+    bytes = static_cast<unsigned char*>(p);
+    length = n;
+    source = Source::Mapped;
+    return bytes;
+#else
+    // No placement controls: plain heap memory
+    (void)wantHuge;
+    (void)node;
+    bytes = alignedAlloc(n);
+    length = n;
+    source = Source::Heap;
+    return bytes;
+#endif
+}
+
+void PageBuffer::release() {
+    if (source == Source::Heap) {
+        alignedFree(bytes);
+    }
+    else if (source == Source::Mapped) {
+#if defined(__linux__)
+        munmap(bytes, mapped);
+#elif defined(_WIN32)
+        VirtualFree(bytes, 0, MEM_RELEASE);
+#endif
+    }
+    bytes = nullptr;
+    length = mapped = 0;
+    source = Source::None;
+    huge = false;
+    boundNode = -1;
+}
+
+int numaNodeCount() {
+#if defined(__linux__)
+    // "0" or "0-1" (or a list of ranges); the highest node plus one
+    int count = 1;
+    if (FILE* f = std::fopen("/sys/devices/system/node/online", "r")) {
+        int first = 0, last = 0;
+        char sep = 0;
+        while (std::fscanf(f, "%d", &first) == 1) {
+            last = first;
+            if (std::fscanf(f, "%c", &sep) == 1 && sep == '-' && std::fscanf(f, "%d", &last) == 1) {
+                (void)std::fscanf(f, "%c", &sep);
+            }
+            count = std::max(count, last + 1);
+        }
+        std::fclose(f);
+    }
+    return count;
+#elif defined(_WIN32)
+    ULONG highest = 0;
+    return GetNumaHighestNodeNumber(&highest) ? static_cast<int>(highest) + 1 : 1;
+#else
+    return 1;
+#endif
+}
+
+int currentNumaNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu = 0, node = 0;
+    return syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 ? static_cast<int>(node) : 0;
+#elif defined(_WIN32)
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT node = 0;
+    return GetNumaProcessorNodeEx(&processor, &node) ? static_cast<int>(node) : 0;
+#else
+    return 0;
+#endif
+}
+
+bool pinThreadToCpu(unsigned index) {
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+    std::vector<int> cpus;
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (CPU_ISSET(c, &allowed)) cpus.push_back(c);
+    }
+    if (cpus.empty()) return false;
+    cpu_set_t one;
+    CPU_ZERO(&one);
+    CPU_SET(cpus[index % cpus.size()], &one);
+    return pthread_setaffinity_np(pthread_self(), sizeof(one), &one) == 0;
+#elif defined(_WIN32)
+    DWORD_PTR process = 0, system = 0;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &process, &system) || process == 0) return false;
+    std::vector<int> cpus;
+    for (int c = 0; c < static_cast<int>(8 * sizeof(DWORD_PTR)); c++) {
+        if (process & (DWORD_PTR(1) << c)) cpus.push_back(c);
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpus[index % cpus.size()]) != 0;
+#else
+    (void)index;
+    return false;
+#endif
+}
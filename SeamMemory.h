@@ -0,0 +1,87 @@
+#ifndef SEAM_MEMORY_H
+#define SEAM_MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Where the pages of SeamCarver's large scratch planes (DP cost
+ * tables, parent offsets, energy and gradient maps) come from. The
+ * defaults leave it to the OS: 4 KiB pages on the node of the first
+ * thread that writes them.
+ */
+struct BufferPlacement {
+    static constexpr int kFirstTouch = -1;  // the OS default
+    static constexpr int kLocalNode = -2;   // node of the CPU the allocating thread runs on
+
+    // Huge pages for buffers of at least kHugePageBytes: the reserved pool
+    // (MAP_HUGETLB, MEM_LARGE_PAGES) if it has room, else transparent huge
+    // pages, else plain pages
+    bool hugePages = false;
+    // kFirstTouch, kLocalNode or a node number; preferred, not enforced,
+    // so a full node falls back to the others
+    int numaNode = kFirstTouch;
+
+    static constexpr size_t kHugePageBytes = size_t(2) << 20;
+
+    bool isDefault() const { return !hugePages && numaNode == kFirstTouch; }
+};
+
+/**
+ * @brief Growable byte buffer placed by a BufferPlacement, the backing of
+ * one scratch plane. It only grows: reserve() keeps the buffer when it is
+ * large enough and otherwise replaces it, dropping the contents. Always
+ * 64-byte aligned.
+ */
+class PageBuffer {
+public:
+    PageBuffer() = default;
+    ~PageBuffer() { release(); }
+
+    PageBuffer(const PageBuffer&) = delete;
+    PageBuffer& operator=(const PageBuffer&) = delete;
+
+    // @brief Placement of the next allocation; the current buffer stays.
+    void setPlacement(const BufferPlacement& p) { placement = p; }
+    const BufferPlacement& getPlacement() const { return placement; }
+
+    // @brief At least bytes long; returns data().
+    unsigned char* reserve(size_t bytes);
+    void release();
+
+    unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+    // @brief Whether the buffer was mapped with huge pages (or advised to
+    // use transparent ones).
+    bool hugePages() const { return huge; }
+
+    // @brief Node the buffer was preferred on; -1 when left to the OS.
+    int node() const { return boundNode; }
+
+private:
+    enum class Source { None, Heap, Mapped };
+
+    BufferPlacement placement;
+    unsigned char* bytes = nullptr;
+    size_t length = 0;     // usable bytes
+    size_t mapped = 0;     // bytes of the mapping (length rounded to pages)
+    Source source = Source::None;
+    bool huge = false;
+    int boundNode = -1;
+};
+
+// @brief NUMA nodes of the machine; 1 where unknown.
+int numaNodeCount();
+
+// @brief Node of the CPU the calling thread runs on; 0 where unknown.
+int currentNumaNode();
+
+/**
+ * @brief Pin the calling thread to the index-th CPU the process may run
+ * on (modulo their count), so its first-touch and kLocalNode buffers stay
+ * on one node. Returns false where pinning is not supported.
+ */
+bool pinThreadToCpu(unsigned index);
+
+#endif // SEAM_MEMORY_H
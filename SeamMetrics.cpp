@@ -0,0 +1,185 @@
+#include "SeamMetrics.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+const double CarveMetrics::kBucketMs[kBuckets] = {
+    0.01, 0.05, 0.1, 0.5, 1, 5, 10, 50, 100, 500, 1000, 5000, 10000, 60000
+};
+
+namespace {
+
+std::string number(double v) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.6g", v);
+    return buf;
+}
+
+// "DP forward" -> "dp_forward"
+std::string phaseLabel(SeamPhase p) {
+    std::string label;
+    for (const char* c = SeamCarverStats::name(p); *c; c++) {
+        label += *c == ' ' ? '_' : static_cast<char>(std::tolower(static_cast<unsigned char>(*c)));
+    }
+    return label;
+}
+
+void writeMetric(std::string& out, const char* name, const char* type, const char* help) {
+    out += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " " + type + "\n";
+}
+
+} // namespace
+
+void CarveMetrics::Histogram::add(double ms) {
+    int b = 0;
+    while (b < kBuckets && ms > kBucketMs[b]) b++;
+    counts[b]++;
+    count++;
+    sum += ms;
+}
+
+void CarveMetrics::Histogram::write(std::string& out, const std::string& name, const std::string& labels) const {
+    const std::string prefix = labels.empty() ? "{" : "{" + labels + ",";
+    uint64_t cumulative = 0;
+    for (int b = 0; b < kBuckets; b++) {
+        cumulative += counts[b];
+        out += name + "_bucket" + prefix + "le=\"" + number(kBucketMs[b]) + "\"} " + std::to_string(cumulative) + "\n";
+    }
+    out += name + "_bucket" + prefix + "le=\"+Inf\"} " + std::to_string(count) + "\n";
+    const std::string plain = labels.empty() ? "" : "{" + labels + "}";
+    out += name + "_sum" + plain + " " + number(sum) + "\n";
+    out += name + "_count" + plain + " " + std::to_string(count) + "\n";
+}
+
+void CarveMetrics::recordJob(const SeamCarverStats& phases, long long jobSeams, long long jobPixels,
+                             double jobMsTotal, size_t workspaceBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs++;
+    seams += static_cast<uint64_t>(std::max(jobSeams, 0LL));
+    pixels += static_cast<uint64_t>(std::max(jobPixels, 0LL));
+    workspaceAllocated += workspaceBytes;
+    carveMs += jobMsTotal;
+    jobMs.add(jobMsTotal);
+    if (jobSeams > 0) seamMs.add(jobMsTotal / jobSeams);
+    for (int p = 0; p < SeamCarverStats::kPhases; p++) {
+        const PhaseStats& s = phases.phases[p];
+        if (s.calls == 0) continue;
+        PhaseStats& t = phaseTotals[p];
+        t.calls += s.calls;
+        t.totalMs += s.totalMs;
+        t.maxMs = std::max(t.maxMs, s.maxMs);
+        phaseMs[p].add(s.totalMs / s.calls);
+    }
+}
+
+void CarveMetrics::recordFailure() {
+    std::lock_guard<std::mutex> lock(mutex);
+    failures++;
+}
+
+void CarveMetrics::recordCache(bool hit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    (hit ? cacheHits : cacheMisses)++;
+}
+
+std::string CarveMetrics::prometheus() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::string out;
+    writeMetric(out, "seam_jobs_total", "counter", "Images carved.");
+    out += "seam_jobs_total " + std::to_string(jobs) + "\n";
+    writeMetric(out, "seam_job_failures_total", "counter", "Jobs that failed or timed out.");
+    out += "seam_job_failures_total " + std::to_string(failures) + "\n";
+    writeMetric(out, "seam_seams_total", "counter", "Seams removed or inserted.");
+    out += "seam_seams_total " + std::to_string(seams) + "\n";
+    writeMetric(out, "seam_pixels_total", "counter", "Source pixels of the carved images.");
+    out += "seam_pixels_total " + std::to_string(pixels) + "\n";
+    writeMetric(out, "seam_seams_per_second", "gauge", "Seams per second of carving time, over all jobs.");
+    out += "seam_seams_per_second " + number(carveMs > 0 ? seams * 1000.0 / carveMs : 0.0) + "\n";
+
+    writeMetric(out, "seam_job_ms", "histogram", "Wall time of a carving job.");
+    jobMs.write(out, "seam_job_ms", "");
+    writeMetric(out, "seam_seam_ms", "histogram", "Mean time per seam of a job.");
+    seamMs.write(out, "seam_seam_ms", "");
+
+    writeMetric(out, "seam_phase_ms_total", "counter", "Wall time per carving phase.");
+    for (int p = 0; p < SeamCarverStats::kPhases; p++) {
+        out += "seam_phase_ms_total{phase=\"" + phaseLabel(static_cast<SeamPhase>(p)) + "\"} " +
+               number(phaseTotals[p].totalMs) + "\n";
+    }
+    writeMetric(out, "seam_phase_calls_total", "counter", "Calls per carving phase.");
+    for (int p = 0; p < SeamCarverStats::kPhases; p++) {
+        out += "seam_phase_calls_total{phase=\"" + phaseLabel(static_cast<SeamPhase>(p)) + "\"} " +
+               std::to_string(phaseTotals[p].calls) + "\n";
+    }
+    writeMetric(out, "seam_phase_max_ms", "gauge", "Longest single call per carving phase.");
+    for (int p = 0; p < SeamCarverStats::kPhases; p++) {
+        out += "seam_phase_max_ms{phase=\"" + phaseLabel(static_cast<SeamPhase>(p)) + "\"} " +
+               number(phaseTotals[p].maxMs) + "\n";
+    }
+    writeMetric(out, "seam_phase_call_ms", "histogram", "Mean call time per phase of a job.");
+    for (int p = 0; p < SeamCarverStats::kPhases; p++) {
+        phaseMs[p].write(out, "seam_phase_call_ms", "phase=\"" + phaseLabel(static_cast<SeamPhase>(p)) + "\"");
+    }
+
+    writeMetric(out, "seam_cache_lookups_total", "counter", "Cache lookups of carving jobs.");
+    out += "seam_cache_lookups_total{result=\"hit\"} " + std::to_string(cacheHits) + "\n";
+    out += "seam_cache_lookups_total{result=\"miss\"} " + std::to_string(cacheMisses) + "\n";
+    writeMetric(out, "seam_cache_hit_ratio", "gauge", "Share of cache lookups that hit.");
+    const uint64_t lookups = cacheHits + cacheMisses;
+    out += "seam_cache_hit_ratio " + number(lookups ? static_cast<double>(cacheHits) / lookups : 0.0) + "\n";
+
+    writeMetric(out, "seam_queue_depth", "gauge", "Jobs waiting to be carved.");
+    out += "seam_queue_depth " + std::to_string(queueDepth.load()) + "\n";
+    writeMetric(out, "seam_workspace_allocated_bytes_total", "counter", "Scratch plane bytes allocated by jobs.");
+    out += "seam_workspace_allocated_bytes_total " + std::to_string(workspaceAllocated) + "\n";
+    writeMetric(out, "seam_allocated_bytes", "gauge", "Bytes held by carvers, caches and jobs in flight.");
+    out += "seam_allocated_bytes " + std::to_string(bytesHeld.load()) + "\n";
+    return out;
+}
+
+MetricsFileWriter::MetricsFileWriter(std::function<std::string()> source, const std::string& file, int intervalMs,
+                                     SeamLogger log)
+    : exposition(std::move(source)), path(file), interval(std::max(intervalMs, 1)), logger(std::move(log)) {
+    writer = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, interval, [&] { return stopping; })) {
+            lock.unlock();
+            dump();
+            lock.lock();
+        }
+    });
+}
+
+MetricsFileWriter::~MetricsFileWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+    dump();
+}
+
+bool MetricsFileWriter::dump() {
+    const std::string text = exposition();
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream f(temp, std::ios::binary | std::ios::trunc);
+        f << text;
+        if (!f) {
+            if (logger) logger(LogLevel::Info, "Could not write metrics to " + temp);
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+    if (ec) {
+        if (logger) logger(LogLevel::Info, "Could not replace " + path + ": " + ec.message());
+        return false;
+    }
+    return true;
+}
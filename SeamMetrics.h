@@ -0,0 +1,110 @@
+#ifndef SEAM_METRICS_H
+#define SEAM_METRICS_H
+
+#include "SeamLog.h"
+#include "SeamStats.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Carving counters and histograms of a process (seam_service, long
+ * CLI batches) in the Prometheus text exposition format.
+ *
+ * Jobs add the phase timers of their SeamCarver (SeamCarver::stats) once
+ * they finish, so the hot path keeps its per-phase counters and the
+ * metrics cost one lock per job. Exported:
+ *  - jobs, seams and source pixels carved, and failed jobs
+ *  - job and per-seam latency histograms, and seams per carving second
+ *  - per phase: wall time, calls, and a histogram of each job's mean call
+ *  - cache hits and misses, queue depth, scratch bytes allocated by the
+ *    jobs and the owner's count of bytes held
+ * All calls are thread-safe.
+ */
+class CarveMetrics {
+public:
+    static constexpr int kBuckets = 14;
+    // Upper bounds in milliseconds of the histogram buckets, below +Inf
+    static const double kBucketMs[kBuckets];
+
+    /**
+     * @brief Add a finished job.
+     * @param phases         the carver's stats() over the job (resetStats first)
+     * @param seams          seams removed or inserted
+     * @param pixels         pixels of the source image
+     * @param carveMs        wall time of the job
+     * @param workspaceBytes growth of the carver's workspaceBytes() over the job
+     */
+    void recordJob(const SeamCarverStats& phases, long long seams, long long pixels, double carveMs,
+                   size_t workspaceBytes);
+    void recordFailure();
+    void recordCache(bool hit);
+
+    // Gauges, set by the owner before an exposition
+    void setQueueDepth(long long jobs) { queueDepth = jobs; }
+    void setBytesAllocated(long long bytes) { bytesHeld = bytes; }
+
+    std::string prometheus() const;
+
+private:
+    struct Histogram {
+        uint64_t counts[kBuckets + 1] = {};  // last: above every bound
+        uint64_t count = 0;
+        double sum = 0.0;
+        void add(double ms);
+        void write(std::string& out, const std::string& name, const std::string& labels) const;
+    };
+
+    mutable std::mutex mutex;
+    uint64_t jobs = 0;
+    uint64_t failures = 0;
+    uint64_t seams = 0;
+    uint64_t pixels = 0;
+    uint64_t cacheHits = 0;
+    uint64_t cacheMisses = 0;
+    uint64_t workspaceAllocated = 0;
+    double carveMs = 0.0;
+    Histogram jobMs;
+    Histogram seamMs;
+    PhaseStats phaseTotals[SeamCarverStats::kPhases];
+    Histogram phaseMs[SeamCarverStats::kPhases];
+    std::atomic<long long> queueDepth{ 0 };
+    std::atomic<long long> bytesHeld{ 0 };
+};
+
+/**
+ * @brief Writes an exposition to a file every interval, e.g. for the node
+ * exporter's textfile collector. Each dump replaces the file through a
+ * temporary and a rename, so readers never see a partial one. The
+ * destructor writes a last dump and stops the thread. A failed dump is
+ * reported to logger (on the writer thread), if any.
+ */
+class MetricsFileWriter {
+public:
+    MetricsFileWriter(std::function<std::string()> exposition, const std::string& path, int intervalMs,
+                      SeamLogger logger = SeamLogger());
+    ~MetricsFileWriter();
+
+    MetricsFileWriter(const MetricsFileWriter&) = delete;
+    MetricsFileWriter& operator=(const MetricsFileWriter&) = delete;
+
+    // @brief Write now; false (and the logger says why) if the file cannot be written.
+    bool dump();
+
+private:
+    std::function<std::string()> exposition;
+    std::string path;
+    std::chrono::milliseconds interval;
+    SeamLogger logger;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread writer;
+};
+
+#endif // SEAM_METRICS_H
@@ -0,0 +1,42 @@
+#ifndef SEAM_PACK_H
+#define SEAM_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief A seam stored as its first index and one 2-bit move per further
+ * row (column): about a sixteenth of the std::vector<int> it packs.
+ *
+ * Connected seams step by -1, 0 or +1 between neighbouring rows, so every
+ * move fits its code. A larger step is kept as an escape holding the
+ * absolute index, so any seam round-trips exactly. unpack() decodes a byte
+ * (four moves) per table lookup.
+ */
+class PackedSeam {
+public:
+    PackedSeam() = default;
+    explicit PackedSeam(const std::vector<int>& seam);
+
+    // @brief The seam as packed; seam is resized to size().
+    void unpack(std::vector<int>& seam) const;
+    std::vector<int> unpack() const;
+
+    size_t size() const { return static_cast<size_t>(length); }
+    bool empty() const { return length == 0; }
+
+    // @brief Heap bytes held by the packed moves and escapes.
+    size_t bytes() const { return moves.capacity() + escapes.capacity() * sizeof(int); }
+
+private:
+    // Move codes, four per byte from the lowest bits up
+    static constexpr uint8_t kStay = 0, kRight = 1, kLeft = 2, kEscape = 3;
+
+    int first = 0;
+    int length = 0;
+    std::vector<uint8_t> moves;  // move i leads from entry i to entry i + 1
+    std::vector<int> escapes;    // entries reached by an escape, in order
+};
+
+#endif // SEAM_PACK_H
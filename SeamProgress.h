@@ -0,0 +1,43 @@
+#ifndef SEAM_PROGRESS_H
+#define SEAM_PROGRESS_H
+
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+
+/**
+ * @brief Progress of a long carve: seams removed or inserted so far, out of
+ * all the call will carve, and the wall time since it started.
+ */
+struct CarveProgress {
+    int seamsDone = 0;
+    int seamsTotal = 0;
+    double elapsedMs = 0.0;
+};
+
+// Called on the carving thread after every carve step (a seam, a batch of
+// seams or an insertion pass)
+typedef std::function<void(const CarveProgress&)> ProgressCallback;
+
+/**
+ * @brief Cooperative cancellation flag. Any thread may cancel(); the
+ * carver checks it between seams and stops with CarveCancelled.
+ */
+class CancelToken {
+public:
+    void cancel() { flag.store(true, std::memory_order_relaxed); }
+    void reset() { flag.store(false, std::memory_order_relaxed); }
+    bool cancelled() const { return flag.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> flag{ false };
+};
+
+// Thrown out of a carve whose CancelToken was cancelled. The carver keeps
+// the image it had before the call.
+class CarveCancelled : public std::runtime_error {
+public:
+    CarveCancelled() : std::runtime_error("Carving was cancelled.") {}
+};
+
+#endif // SEAM_PROGRESS_H
@@ -0,0 +1,224 @@
+#include "SeamCarver.h"
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace py = pybind11;
+
+// ============================================================================
+// Python module "seamcarver": SeamCarver::resize and calculateEnergy on NumPy
+// arrays. Images are wrapped as cv::Mat headers, not copied, and results come
+// back as arrays over the carver's buffers. The GIL is released while
+// carving, so Python threads resize in parallel:
+//
+//   out = seamcarver.resize(img, 640, 480)          # rows x cols x 3 BGR uint8
+//   out = seamcarver.resize(img, options, protect=mask)
+// ============================================================================
+
+namespace {
+
+// OpenCV depth of an array's element type; -1 for one the carver has no
+// kernels for
+int matDepth(const py::array& a) {
+    if (py::isinstance<py::array_t<uint8_t>>(a)) return CV_8U;
+    if (py::isinstance<py::array_t<uint16_t>>(a)) return CV_16U;
+    if (py::isinstance<py::array_t<float>>(a)) return CV_32F;
+    return -1;
+}
+
+py::dtype arrayType(int depth) {
+    switch (depth) {
+    case CV_8U: return py::dtype::of<uint8_t>();
+    case CV_16U: return py::dtype::of<uint16_t>();
+    case CV_32F: return py::dtype::of<float>();
+    case CV_64F: return py::dtype::of<double>();
+    }
+    throw std::runtime_error("No NumPy type for OpenCV depth " + std::to_string(depth) + ".");
+}
+
+// Header over the pixels of a rows x cols or rows x cols x channels array.
+// Rows may be padded (a slice of a wider array), but the pixels of a row
+// must be packed in order.
+cv::Mat wrapArray(const py::array& a, const std::string& what) {
+    const int depth = matDepth(a);
+    if (depth < 0) {
+        throw std::runtime_error(what + " must be uint8, uint16 or float32.");
+    }
+    if (a.ndim() != 2 && a.ndim() != 3) {
+        throw std::runtime_error(what + " must be rows x cols or rows x cols x channels.");
+    }
+    const int channels = a.ndim() == 3 ? static_cast<int>(a.shape(2)) : 1;
+    const py::ssize_t item = a.itemsize();
+    const py::ssize_t row = static_cast<py::ssize_t>(a.shape(1)) * channels * item;
+    if ((a.ndim() == 3 && a.strides(2) != item) || a.strides(1) != channels * item ||
+        (a.shape(0) > 1 && a.strides(0) < row)) {
+        throw std::runtime_error(what + " needs packed pixels in row order (see numpy.ascontiguousarray).");
+    }
+    const size_t stride = a.shape(0) > 1 ? static_cast<size_t>(a.strides(0)) : static_cast<size_t>(row);
+    return cv::Mat(static_cast<int>(a.shape(0)), static_cast<int>(a.shape(1)), CV_MAKETYPE(depth, channels),
+                   const_cast<void*>(a.data()), stride);
+}
+
+// Array over m without copying, shaped like source (a trailing channel
+// axis if source has one). The array holds a reference to m's buffer; a
+// result still on source's own pixels (nothing carved) keeps source alive
+// instead.
+py::array wrapMat(const cv::Mat& m, const py::array& source) {
+    std::vector<py::ssize_t> shape = { m.rows, m.cols };
+    std::vector<py::ssize_t> strides = { static_cast<py::ssize_t>(m.step[0]), static_cast<py::ssize_t>(m.elemSize()) };
+    if (source.ndim() == 3) {
+        shape.push_back(m.channels());
+        strides.push_back(static_cast<py::ssize_t>(m.elemSize1()));
+    }
+    const uchar* first = static_cast<const uchar*>(source.data());
+    const uchar* end = first + (source.shape(0) > 0 ? source.strides(0) * source.shape(0) : 0);
+    if (m.data >= first && m.data < end) {
+        return py::array(arrayType(m.depth()), shape, strides, m.data, source);
+    }
+    cv::Mat* owner = new cv::Mat(m);
+    py::capsule base(owner, [](void* p) { delete static_cast<cv::Mat*>(p); });
+    return py::array(arrayType(m.depth()), shape, strides, owner->data, base);
+}
+
+// SeamCarver::resize of image with options. The masks (None or uint8
+// arrays of the image size) are wrapped like the image; progress (None or
+// a callable(done, total, elapsed_ms)) is called with the GIL held.
+py::array resizeArray(const py::array& image, ResizeOptions options, const py::object& protect,
+                      const py::object& remove, const py::object& progress, const CancelToken* cancel) {
+    const cv::Mat pixels = wrapArray(image, "image");
+    py::array maskArrays[2];  // alive until the carve is done
+    cv::Mat masks[2];
+    const py::object* maskArgs[2] = { &protect, &remove };
+    for (int k = 0; k < 2; k++) {
+        if (maskArgs[k]->is_none()) continue;
+        maskArrays[k] = maskArgs[k]->cast<py::array>();
+        masks[k] = wrapArray(maskArrays[k], k == 0 ? "protect" : "remove");
+    }
+    if (!progress.is_none()) {
+        options.progress = [&progress](const CarveProgress& p) {
+            py::gil_scoped_acquire gil;
+            progress(p.seamsDone, p.seamsTotal, p.elapsedMs);
+        };
+    }
+    options.cancel = cancel;
+
+    cv::Mat result;
+    {
+        // The carver reads image's buffer in place: Python code must not
+        // write into it until resize returns
+        py::gil_scoped_release released;
+        SeamCarver carver(pixels.data, pixels.cols, pixels.rows, pixels.step[0], pixels.type());
+        if (!masks[0].empty() || !masks[1].empty()) carver.setMask(masks[0], masks[1]);
+        result = carver.resize(options);
+    }
+    return wrapMat(result, image);
+}
+
+py::array energyArray(const py::array& image, EnergyFunction function, EnergyPrecision precision) {
+    const cv::Mat pixels = wrapArray(image, "image");
+    cv::Mat energy;
+    {
+        py::gil_scoped_release released;
+        SeamCarver carver(pixels.data, pixels.cols, pixels.rows, pixels.step[0], pixels.type());
+        carver.setEnergyFunction(function);
+        carver.setPrecision(precision);
+        energy = carver.calculateEnergy(pixels);
+    }
+    // One value per pixel: no channel axis
+    cv::Mat* owner = new cv::Mat(energy);
+    py::capsule base(owner, [](void* p) { delete static_cast<cv::Mat*>(p); });
+    return py::array(arrayType(energy.depth()), { energy.rows, energy.cols },
+                     { static_cast<py::ssize_t>(energy.step[0]), static_cast<py::ssize_t>(energy.elemSize()) },
+                     owner->data, base);
+}
+
+} // namespace
+
+PYBIND11_MODULE(seamcarver, m) {
+    m.doc() = "Content-aware image resizing (seam carving) on NumPy arrays";
+
+    py::register_exception<CarveCancelled>(m, "CarveCancelled");
+
+    py::enum_<SeamStrategy>(m, "SeamStrategy")
+        .value("DP", SeamStrategy::DP)
+        .value("Greedy", SeamStrategy::Greedy)
+        .value("Pyramid", SeamStrategy::Pyramid)
+        .value("GraphCut", SeamStrategy::GraphCut);
+    py::enum_<EnergyModel>(m, "EnergyModel")
+        .value("Backward", EnergyModel::Backward)
+        .value("Forward", EnergyModel::Forward);
+    py::enum_<EnergyFunction>(m, "EnergyFunction")
+        .value("Sobel", EnergyFunction::Sobel)
+        .value("Scharr", EnergyFunction::Scharr)
+        .value("DualGradient", EnergyFunction::DualGradient)
+        .value("L1Gradient", EnergyFunction::L1Gradient)
+        .value("Saliency", EnergyFunction::Saliency)
+        .value("FastSobel", EnergyFunction::FastSobel);
+    py::enum_<EnergyPrecision>(m, "EnergyPrecision")
+        .value("Double", EnergyPrecision::Double)
+        .value("Float", EnergyPrecision::Float)
+        .value("Fixed16", EnergyPrecision::Fixed16);
+    py::enum_<SeamOrder>(m, "SeamOrder")
+        .value("WidthFirst", SeamOrder::WidthFirst)
+        .value("Optimal", SeamOrder::Optimal)
+        .value("Cheapest", SeamOrder::Cheapest);
+
+    py::class_<CancelToken>(m, "CancelToken", "Cancels a resize running on another thread")
+        .def(py::init<>())
+        .def("cancel", &CancelToken::cancel)
+        .def("reset", &CancelToken::reset)
+        .def_property_readonly("cancelled", &CancelToken::cancelled);
+
+    // The fields of ResizeOptions under their snake_case names; progress
+    // and cancel are arguments of resize
+    py::class_<ResizeOptions>(m, "ResizeOptions", "Settings of one resize (see SeamCarver.h)")
+        .def(py::init<>())
+        .def_readwrite("width", &ResizeOptions::width)
+        .def_readwrite("height", &ResizeOptions::height)
+        .def_readwrite("strategy", &ResizeOptions::strategy)
+        .def_readwrite("energy_model", &ResizeOptions::energyModel)
+        .def_readwrite("energy_function", &ResizeOptions::energyFunction)
+        .def_readwrite("precision", &ResizeOptions::precision)
+        .def_readwrite("seam_order", &ResizeOptions::seamOrder)
+        .def_readwrite("seam_batch", &ResizeOptions::seamBatch)
+        .def_readwrite("incremental_energy", &ResizeOptions::incrementalEnergy)
+        .def_readwrite("incremental_dp", &ResizeOptions::incrementalDP)
+        .def_readwrite("energy_threads", &ResizeOptions::energyThreads)
+        .def_readwrite("dp_threads", &ResizeOptions::dpThreads)
+        .def_readwrite("bidirectional_dp", &ResizeOptions::bidirectionalDP)
+        .def_readwrite("lazy_removal", &ResizeOptions::lazyRemoval)
+        .def_readwrite("seam_step", &ResizeOptions::seamStep)
+        .def_readwrite("carve_quality", &ResizeOptions::carveQuality)
+        .def_readwrite("border_trim", &ResizeOptions::borderTrim)
+        .def_property("region",
+            [](const ResizeOptions& o) { return py::make_tuple(o.region.x, o.region.y, o.region.width, o.region.height); },
+            [](ResizeOptions& o, const py::tuple& r) {
+                if (r.size() != 4) throw std::runtime_error("region is (x, y, width, height).");
+                o.region = cv::Rect(r[0].cast<int>(), r[1].cast<int>(), r[2].cast<int>(), r[3].cast<int>());
+            });
+
+    m.def("resize", &resizeArray, py::arg("image"), py::arg("options"), py::kw_only(),
+          py::arg("protect") = py::none(), py::arg("remove") = py::none(), py::arg("progress") = py::none(),
+          py::arg("cancel") = nullptr,
+          "Carve image (rows x cols [x 1|3|4] of uint8, uint16 or float32, BGR order) to options.width x "
+          "options.height. The result shares no memory with image unless nothing was carved.");
+    m.def("resize",
+          [](const py::array& image, int width, int height, SeamStrategy strategy, const py::object& protect,
+             const py::object& remove, const py::object& progress, const CancelToken* cancel) {
+              ResizeOptions options;
+              options.width = width;
+              options.height = height;
+              options.strategy = strategy;
+              return resizeArray(image, options, protect, remove, progress, cancel);
+          },
+          py::arg("image"), py::arg("width"), py::arg("height"), py::arg("strategy") = SeamStrategy::DP,
+          py::kw_only(), py::arg("protect") = py::none(), py::arg("remove") = py::none(),
+          py::arg("progress") = py::none(), py::arg("cancel") = nullptr,
+          "resize with default options and the given size and seam finder.");
+    m.def("energy", &energyArray, py::arg("image"), py::arg("function") = EnergyFunction::Sobel,
+          py::arg("precision") = EnergyPrecision::Double,
+          "Per-pixel backward energy of image: float64, float32 or uint16 by precision.");
+}
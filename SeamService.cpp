@@ -0,0 +1,820 @@
+#include "SeamService.h"
+#include "BatchScheduler.h"
+#include "SeamDecode.h"
+#include "SeamMap.h"
+#include "SeamSettings.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET SocketHandle;
+static const SocketHandle kNoSocket = INVALID_SOCKET;
+static void closeSocket(SocketHandle s) { closesocket(s); }
+#else
+#include <netdb.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int SocketHandle;
+static const SocketHandle kNoSocket = -1;
+static void closeSocket(SocketHandle s) { ::close(s); }
+#endif
+
+namespace {
+
+double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// MIME type of a result format; throws for formats the service does not write
+std::string contentTypeOf(const std::string& format) {
+    if (format == "png") return "image/png";
+    if (format == "jpg" || format == "jpeg") return "image/jpeg";
+    if (format == "webp") return "image/webp";
+    if (format == "bmp") return "image/bmp";
+    throw std::runtime_error("Unknown format: " + format);
+}
+
+ResizeResponse failure(int status, const std::string& error) {
+    ResizeResponse r;
+    r.status = status;
+    r.error = error;
+    r.cache = "miss";
+    return r;
+}
+
+} // namespace
+
+// ============================================================================
+// Metrics
+// ============================================================================
+
+void ServiceMetrics::Window::add(double v) {
+    if (values.size() < kLatencyWindow) {
+        values.push_back(v);
+    } else {
+        values[next] = v;
+    }
+    next = (next + 1) % kLatencyWindow;
+}
+
+double ServiceMetrics::Window::percentile(double p) const {
+    if (values.empty()) return 0.0;
+    std::vector<double> sorted = values;
+    const size_t k = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+ServiceMetrics::ServiceMetrics()
+    : start(std::chrono::steady_clock::now()), perSecond(kRateSeconds, 0) {
+}
+
+void ServiceMetrics::record(const ResizeResponse& response, double totalMs, size_t requestBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    byStatus[response.status]++;
+    bytesIn += static_cast<long long>(requestBytes);
+    if (response.status == 200) {
+        bytesOut += static_cast<long long>(response.body.size());
+        pixelsOut += static_cast<long long>(response.width) * response.height;
+        if (response.cache == "hit") cacheHits++;
+        if (response.cache == "seammap") seamMapHits++;
+        total.add(totalMs);
+        queue.add(response.queueMs);
+        carve.add(response.carveMs);
+    }
+    // Clear the seconds skipped since the last request
+    const long long second = static_cast<long long>(msSince(start) / 1000.0);
+    for (long long s = std::max(lastSecond + 1, second - kRateSeconds + 1); s <= second; s++) {
+        perSecond[s % kRateSeconds] = 0;
+    }
+    lastSecond = std::max(lastSecond, second);
+    perSecond[second % kRateSeconds]++;
+}
+
+void ServiceMetrics::recordBatch(size_t jobs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    batches++;
+    batchedJobs += static_cast<long long>(jobs);
+}
+
+std::string ServiceMetrics::prometheus() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream os;
+    os << "# TYPE seam_requests_total counter\n";
+    for (const auto& s : byStatus) {
+        os << "seam_requests_total{status=\"" << s.first << "\"} " << s.second << "\n";
+    }
+    os << "# TYPE seam_cache_hits_total counter\n"
+       << "seam_cache_hits_total{kind=\"result\"} " << cacheHits << "\n"
+       << "seam_cache_hits_total{kind=\"seammap\"} " << seamMapHits << "\n"
+       << "# TYPE seam_request_bytes_total counter\nseam_request_bytes_total " << bytesIn << "\n"
+       << "# TYPE seam_response_bytes_total counter\nseam_response_bytes_total " << bytesOut << "\n"
+       << "# TYPE seam_output_pixels_total counter\nseam_output_pixels_total " << pixelsOut << "\n"
+       << "# TYPE seam_batches_total counter\nseam_batches_total " << batches << "\n"
+       << "# TYPE seam_batched_jobs_total counter\nseam_batched_jobs_total " << batchedJobs << "\n";
+    const std::pair<const char*, const Window*> windows[] = {
+        { "seam_request_latency_ms", &total }, { "seam_queue_latency_ms", &queue }, { "seam_carve_latency_ms", &carve }
+    };
+    for (const auto& w : windows) {
+        os << "# TYPE " << w.first << " summary\n";
+        for (double q : { 0.5, 0.9, 0.99 }) {
+            os << w.first << "{quantile=\"" << q << "\"} " << w.second->percentile(q) << "\n";
+        }
+        os << w.first << "_count " << w.second->values.size() << "\n";
+    }
+    os << "# TYPE seam_in_flight_bytes gauge\nseam_in_flight_bytes " << inFlightBytes.load() << "\n"
+       << "# TYPE seam_memory_budget_bytes gauge\nseam_memory_budget_bytes " << budgetBytes.load() << "\n"
+       << "# TYPE seam_uptime_seconds gauge\nseam_uptime_seconds " << msSince(start) / 1000.0 << "\n";
+    return os.str();
+}
+
+std::string ServiceMetrics::json() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream os;
+    long long requests = 0;
+    os << "{\"uptime_s\":" << msSince(start) / 1000.0 << ",\"status\":{";
+    bool first = true;
+    for (const auto& s : byStatus) {
+        os << (first ? "" : ",") << "\"" << s.first << "\":" << s.second;
+        requests += s.second;
+        first = false;
+    }
+    os << "},\"requests\":" << requests
+       << ",\"cache_hits\":" << cacheHits << ",\"seammap_hits\":" << seamMapHits
+       << ",\"bytes_in\":" << bytesIn << ",\"bytes_out\":" << bytesOut << ",\"pixels_out\":" << pixelsOut
+       << ",\"batches\":" << batches << ",\"batched_jobs\":" << batchedJobs
+       << ",\"queued_jobs\":" << queuedJobs.load() << ",\"in_flight_bytes\":" << inFlightBytes.load()
+       << ",\"memory_budget_bytes\":" << budgetBytes.load();
+    const std::pair<const char*, const Window*> windows[] = {
+        { "latency_ms", &total }, { "queue_ms", &queue }, { "carve_ms", &carve }
+    };
+    for (const auto& w : windows) {
+        os << ",\"" << w.first << "\":{\"p50\":" << w.second->percentile(0.5)
+           << ",\"p90\":" << w.second->percentile(0.9) << ",\"p99\":" << w.second->percentile(0.99) << "}";
+    }
+    // Requests per second, oldest first; the current second is still filling
+    const long long now = static_cast<long long>(msSince(start) / 1000.0);
+    os << ",\"rate\":[";
+    for (long long s = now - kRateSeconds + 1; s <= now; s++) {
+        const bool kept = s >= 0 && s <= lastSecond && s > lastSecond - kRateSeconds;
+        os << (s == now - kRateSeconds + 1 ? "" : ",") << (kept ? perSecond[s % kRateSeconds] : 0);
+    }
+    os << "]}";
+    return os.str();
+}
+
+// ============================================================================
+// Carving
+// ============================================================================
+
+struct ResizeService::Job {
+    const ResizeRequest* request = nullptr;
+    cv::Mat source;
+    uint64_t sourceHash = 0;
+    int width = 0;
+    int height = 0;
+    bool small = false;
+    std::chrono::steady_clock::time_point queued;
+    cv::Mat result;
+    ResizeResponse response;
+    std::promise<void> done;
+};
+
+ResizeService::ResizeService(const ServiceOptions& options)
+    : opts(options), cache(options.cacheBytes, options.cacheDir) {
+    opts.batchSize = std::max(opts.batchSize, 1);
+    unsigned count = opts.workers ? opts.workers : std::max(1u, std::thread::hardware_concurrency());
+    counters.budgetBytes = static_cast<long long>(opts.memoryBudget);
+    workspaceBytes.assign(count, 0);
+    for (unsigned i = 0; i < count; i++) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ResizeService::~ResizeService() {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& t : workers) t.join();
+}
+
+// Wait until bytes fit the budget next to the jobs in flight. As in
+// BatchScheduler a job larger than the whole budget still runs, alone.
+bool ResizeService::admit(size_t bytes, double timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex);
+    const auto fits = [&] { return inFlight == 0 || inFlight + bytes <= opts.memoryBudget; };
+    if (!budgetFreed.wait_for(lock, std::chrono::duration<double, std::milli>(timeoutMs), fits)) {
+        return false;
+    }
+    inFlight += bytes;
+    counters.inFlightBytes = static_cast<long long>(inFlight);
+    return true;
+}
+
+void ResizeService::release(size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight -= bytes;
+        counters.inFlightBytes = static_cast<long long>(inFlight);
+    }
+    budgetFreed.notify_all();
+}
+
+ResizeResponse ResizeService::resize(const ResizeRequest& request) {
+    const auto t0 = std::chrono::steady_clock::now();
+    auto finish = [&](ResizeResponse response) {
+        counters.record(response, msSince(t0), request.body.size());
+        return response;
+    };
+
+    Job job;
+    job.request = &request;
+    std::string contentType;
+    EncodedHeader header;
+    try {
+        contentType = contentTypeOf(request.format);
+        const SeamStrategy strategy = parseStrategy(request.method);
+        parsePrecision(request.precision);
+        parseEnergyModel(request.energy);
+        parseEnergyFunction(request.energyFunction);
+        if (request.seamMap && (strategy != SeamStrategy::DP || request.energy != "backward")) {
+            throw std::runtime_error("seammap needs method dp with backward energy.");
+        }
+        if (request.seamMap && request.carveQuality < 1.0) {
+            throw std::runtime_error("quality cannot be combined with seammap.");
+        }
+        if (request.body.empty()) {
+            throw std::runtime_error("Empty request body: expected an encoded image.");
+        }
+        if (!readEncodedHeader(request.body, header)) {
+            throw std::runtime_error("Unsupported image format: expected PNG, JPEG, BMP or WebP.");
+        }
+        if (static_cast<double>(header.width) * header.height > static_cast<double>(opts.maxPixels)) {
+            std::ostringstream os;
+            os << "Image of " << header.width << "x" << header.height << " exceeds the limit of "
+               << opts.maxPixels << " pixels.";
+            return finish(failure(413, os.str()));
+        }
+        job.width = parseDimension(request.width, header.width);
+        job.height = parseDimension(request.height, header.height);
+        if (job.width > header.width * opts.maxScale || job.height > header.height * opts.maxScale) {
+            std::ostringstream os;
+            os << "Target " << job.width << "x" << job.height << " exceeds " << opts.maxScale
+               << " times the source size " << header.width << "x" << header.height << ".";
+            throw std::runtime_error(os.str());
+        }
+    }
+    catch (const std::exception& e) {
+        return finish(failure(400, e.what()));
+    }
+
+    // Admitted on the header's size before decoding, so the budget covers
+    // the decode too. Enlarging works on planes of the target size.
+    const double grow = static_cast<double>(std::max(job.width, header.width)) / header.width *
+                        std::max(job.height, header.height) / header.height;
+    const size_t bytes = static_cast<size_t>(
+        BatchScheduler::workingSet(cv::Size(header.width, header.height),
+                                   static_cast<size_t>(header.channels) * header.bytesPerSample) * grow);
+    if (!admit(bytes, opts.queueTimeoutMs)) {
+        return finish(failure(503, "The service is over its memory budget; retry later."));
+    }
+    // Holds the budget until resize() returns
+    struct Admitted {
+        ResizeService& service;
+        size_t bytes;
+        ~Admitted() { service.release(bytes); }
+    } admitted{ *this, bytes };
+
+    try {
+        cv::Mat buffer(1, static_cast<int>(request.body.size()), CV_8U, const_cast<char*>(request.body.data()));
+        job.source = cv::imdecode(buffer, cv::IMREAD_UNCHANGED);
+        if (job.source.empty()) {
+            throw std::runtime_error("Could not decode the request body as an image.");
+        }
+        if (job.source.total() != static_cast<size_t>(header.width) * header.height) {
+            throw std::runtime_error("The image data does not match the size in its header.");
+        }
+        if (!SeamCarver::isSupportedImageType(job.source.type())) {
+            throw std::runtime_error("Unsupported pixel type: expected 8-bit, 16-bit or float with 1, 3 or 4 channels.");
+        }
+    }
+    catch (const std::exception& e) {
+        return finish(failure(400, e.what()));
+    }
+    job.small = job.source.total() <= static_cast<size_t>(std::max(opts.smallPixels, 0));
+    job.sourceHash = hashImage(job.source);
+
+    const std::string resultKey = CarveCache::key(job.sourceHash,
+        request.method + "/" + request.precision + "/" + request.energy + "/" + request.energyFunction +
+        (request.carveQuality < 1.0 ? "/q" + std::to_string(request.carveQuality) : "") +
+        (request.seamMap ? "/map/" : "/") + std::to_string(job.width) + "x" + std::to_string(job.height));
+    auto encode = [&](const cv::Mat& out, ResizeResponse response) {
+        std::vector<uchar> bytes;
+        if (!cv::imencode("." + request.format, out, bytes)) {
+            return failure(500, "Could not encode the result as " + request.format + ".");
+        }
+        response.body.assign(bytes.begin(), bytes.end());
+        response.contentType = contentType;
+        response.width = out.cols;
+        response.height = out.rows;
+        return response;
+    };
+
+    // Served from the cache without carving: a stored result, or a render
+    // from a seam map that covers the target
+    cv::Mat cached;
+    if (cache.findResult(resultKey, cached)) {
+        carving.recordCache(true);
+        ResizeResponse response;
+        response.cache = "hit";
+        return finish(encode(cached, response));
+    }
+    const std::string mapKey = CarveCache::key(job.sourceHash, "map/" + request.precision + "/" + request.energyFunction);
+    SeamIndexMap map;
+    if (request.seamMap && job.width <= job.source.cols && job.height <= job.source.rows &&
+        cache.findSeamMap(mapKey, map) && job.width >= map.minWidth && job.height >= map.minHeight) {
+        carving.recordCache(true);
+        const auto tc = std::chrono::steady_clock::now();
+        SeamCarver renderer{ cv::Mat(job.source) };
+        cv::Mat out = renderer.renderFromSeamIndexMap(map, job.source, job.width, job.height);
+        ResizeResponse response;
+        response.cache = "seammap";
+        response.carveMs = msSince(tc);
+        return finish(encode(out, response));
+    }
+
+    carving.recordCache(false);
+    std::future<void> done = job.done.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job.queued = std::chrono::steady_clock::now();
+        jobs.push_back(&job);
+        counters.queuedJobs = static_cast<long long>(jobs.size());
+    }
+    jobReady.notify_one();
+    done.wait();
+
+    if (job.response.status != 200) {
+        return finish(job.response);
+    }
+    cache.storeResult(resultKey, job.result);
+    return finish(encode(job.result, job.response));
+}
+
+std::string ResizeService::exposition() {
+    size_t held = cache.memoryBytes();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t bytes : workspaceBytes) held += bytes;
+        held += inFlight;
+        carving.setQueueDepth(static_cast<long long>(jobs.size()));
+    }
+    carving.setBytesAllocated(static_cast<long long>(held));
+    return counters.prometheus() + carving.prometheus();
+}
+
+void ResizeService::workerLoop(size_t index) {
+    // One carver per worker, reset for every job, so its scratch planes
+    // are reused across a batch
+    SeamCarver carver{ cv::Mat(1, 1, CV_8UC3, cv::Scalar::all(0)) };
+    for (;;) {
+        std::vector<Job*> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            batch.push_back(jobs.front());
+            jobs.pop_front();
+            // A small job takes the next small jobs along, in arrival order
+            for (auto it = jobs.begin(); batch.front()->small && it != jobs.end() &&
+                                         batch.size() < static_cast<size_t>(opts.batchSize);) {
+                if ((*it)->small) {
+                    batch.push_back(*it);
+                    it = jobs.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            counters.queuedJobs = static_cast<long long>(jobs.size());
+        }
+        if (batch.size() > 1) counters.recordBatch(batch.size());
+        for (Job* job : batch) {
+            carve(carver, *job);
+            job->done.set_value();  // the job belongs to resize() again
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        workspaceBytes[index] = carver.workspaceBytes();
+    }
+}
+
+void ResizeService::carve(SeamCarver& carver, Job& job) {
+    const ResizeRequest& request = *job.request;
+    ResizeResponse& response = job.response;
+    response.queueMs = msSince(job.queued);
+    const auto t0 = std::chrono::steady_clock::now();
+    const size_t workspaceBefore = carver.workspaceBytes();
+    carver.resetStats();
+    try {
+        carver.reset(cv::Mat(job.source));  // shares the decoded buffer
+        carver.setPrecision(parsePrecision(request.precision));
+        carver.setEnergyModel(parseEnergyModel(request.energy));
+        carver.setEnergyFunction(parseEnergyFunction(request.energyFunction));
+        carver.setInitialEnergy(cv::Mat());
+
+        if (request.seamMap) {
+            // Map down to the target (sizes beyond the source are enlarged)
+            const int width = std::min(job.width, job.source.cols);
+            const int height = std::min(job.height, job.source.rows);
+            SeamIndexMap map = carver.buildSeamIndexMap(width, height);
+            cache.storeSeamMap(CarveCache::key(job.sourceHash, "map/" + request.precision + "/" + request.energyFunction),
+                               map, job.source);
+            job.result = carver.renderFromSeamIndexMap(map, job.source, width, height);
+            if (job.width > width || job.height > height) {
+                job.result = carver.enlargeImage(job.result, job.width, job.height);
+            }
+        } else {
+            const std::string energyKey = CarveCache::key(job.sourceHash,
+                CarveCache::energySettings(carver.getPrecision(), carver.getEnergyFunction()));
+            cv::Mat energy;
+            if (!cache.findEnergy(energyKey, energy)) {
+                energy = carver.calculateEnergy(job.source);
+                cache.storeEnergy(energyKey, energy);
+            }
+            carver.setInitialEnergy(energy);
+
+            // The deadline is checked between seams
+            CancelToken cancel;
+            ResizeOptions options = carver.resizeOptions(job.width, job.height, parseStrategy(request.method));
+            options.carveQuality = request.carveQuality;
+            options.cancel = &cancel;
+            if (request.timeoutMs > 0) {
+                options.progress = [&](const CarveProgress& p) {
+                    if (p.elapsedMs > request.timeoutMs) cancel.cancel();
+                };
+            }
+            job.result = carver.resize(options);
+        }
+        response.status = 200;
+    }
+    catch (const CarveCancelled&) {
+        response = failure(504, "Resize timed out after " + std::to_string(static_cast<long long>(msSince(t0))) + " ms.");
+    }
+    catch (const std::exception& e) {
+        response = failure(500, e.what());
+    }
+    response.carveMs = msSince(t0);
+    if (response.status == 200) {
+        const long long seams = std::abs(job.result.cols - job.source.cols) + std::abs(job.result.rows - job.source.rows);
+        carving.recordJob(carver.stats(), seams, static_cast<long long>(job.source.total()), response.carveMs,
+                          carver.workspaceBytes() - workspaceBefore);
+    } else {
+        carving.recordFailure();
+    }
+}
+
+// ============================================================================
+// HTTP
+// ============================================================================
+
+namespace {
+
+// Live view of /stats, refreshed every second
+const char* kDashboard = R"(<!DOCTYPE html>
+<html><head><meta charset="utf-8"><title>seam_service</title>
+<style>body{font:14px sans-serif;margin:2em}td{padding:2px 12px}canvas{border:1px solid #ccc}</style>
+</head><body>
+<h2>seam_service</h2>
+<canvas id="rate" width="600" height="120"></canvas>
+<table id="stats"></table>
+<script>
+async function tick() {
+  const s = await (await fetch('/stats')).json();
+  const rows = [
+    ['requests', s.requests], ['requests/s (last 10 s)', (s.rate.slice(-11, -1).reduce((a, b) => a + b, 0) / 10).toFixed(1)],
+    ['latency p50 / p90 / p99 ms', [s.latency_ms.p50, s.latency_ms.p90, s.latency_ms.p99].map(v => v.toFixed(1)).join(' / ')],
+    ['queue p50 / p99 ms', s.queue_ms.p50.toFixed(1) + ' / ' + s.queue_ms.p99.toFixed(1)],
+    ['carve p50 / p99 ms', s.carve_ms.p50.toFixed(1) + ' / ' + s.carve_ms.p99.toFixed(1)],
+    ['cache hits / seam map hits', s.cache_hits + ' / ' + s.seammap_hits],
+    ['batches (jobs)', s.batches + ' (' + s.batched_jobs + ')'],
+    ['queued jobs', s.queued_jobs],
+    ['in flight MB / budget MB', (s.in_flight_bytes / 1048576).toFixed(1) + ' / ' + (s.memory_budget_bytes / 1048576).toFixed(0)],
+    ['status', JSON.stringify(s.status)]];
+  document.getElementById('stats').innerHTML = rows.map(r => '<tr><td>' + r[0] + '</td><td>' + r[1] + '</td></tr>').join('');
+  const c = document.getElementById('rate').getContext('2d');
+  const max = Math.max(1, ...s.rate);
+  const w = c.canvas.width / s.rate.length;
+  c.clearRect(0, 0, c.canvas.width, c.canvas.height);
+  c.fillStyle = '#4a7';
+  s.rate.forEach((v, i) => c.fillRect(i * w, c.canvas.height * (1 - v / max), w - 1, c.canvas.height * v / max));
+  c.fillStyle = '#000';
+  c.fillText('requests/s, last 60 s (max ' + max + ')', 4, 12);
+}
+setInterval(tick, 1000); tick();
+</script></body></html>
+)";
+
+const char* statusText(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 411: return "Length Required";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Timeout";
+    default:  return "Error";
+    }
+}
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> query;
+    std::map<std::string, std::string> headers;  // lower-case names
+    std::string body;
+};
+
+std::string lower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return s;
+}
+
+std::string urlDecode(const std::string& s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '+') {
+            out += ' ';
+        } else if (s[i] == '%' && i + 2 < s.size() && std::isxdigit((unsigned char)s[i + 1]) &&
+                   std::isxdigit((unsigned char)s[i + 2])) {
+            out += static_cast<char>(std::stoi(s.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+bool sendAll(SocketHandle s, const char* data, size_t size) {
+    while (size > 0) {
+        const int sent = static_cast<int>(::send(s, data, static_cast<int>(std::min<size_t>(size, 1 << 20)), 0));
+        if (sent <= 0) return false;
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+void sendResponse(SocketHandle s, int status, const std::string& contentType, const std::string& body,
+                  const std::string& extraHeaders = std::string()) {
+    std::ostringstream head;
+    head << "HTTP/1.1 " << status << " " << statusText(status) << "\r\n"
+         << "Content-Type: " << contentType << "\r\n"
+         << "Content-Length: " << body.size() << "\r\n"
+         << extraHeaders << "Connection: close\r\n\r\n";
+    const std::string h = head.str();
+    if (sendAll(s, h.data(), h.size())) sendAll(s, body.data(), body.size());
+}
+
+// Read one request; on a malformed or oversized one returns the HTTP
+// status to answer with, 0 if the peer went away
+int readRequest(SocketHandle s, size_t maxBody, HttpRequest& request) {
+    static constexpr size_t kMaxHeader = 16 << 10;
+    std::string data;
+    size_t headerEnd = std::string::npos;
+    char chunk[16 << 10];
+    while (headerEnd == std::string::npos) {
+        if (data.size() > kMaxHeader) return 431;
+        const int got = static_cast<int>(::recv(s, chunk, sizeof(chunk), 0));
+        if (got <= 0) return 0;
+        data.append(chunk, static_cast<size_t>(got));
+        headerEnd = data.find("\r\n\r\n");
+    }
+
+    std::istringstream head(data.substr(0, headerEnd));
+    std::string line;
+    std::getline(head, line);
+    std::istringstream requestLine(line);
+    std::string target;
+    requestLine >> request.method >> target;
+    if (request.method.empty() || target.empty()) return 400;
+    const size_t q = target.find('?');
+    request.path = target.substr(0, q);
+    if (q != std::string::npos) {
+        std::istringstream params(target.substr(q + 1));
+        std::string param;
+        while (std::getline(params, param, '&')) {
+            const size_t eq = param.find('=');
+            if (param.empty()) continue;
+            request.query[urlDecode(param.substr(0, eq))] = eq == std::string::npos ? "" : urlDecode(param.substr(eq + 1));
+        }
+    }
+    while (std::getline(head, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        const size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        size_t v = colon + 1;
+        while (v < line.size() && line[v] == ' ') v++;
+        request.headers[lower(line.substr(0, colon))] = line.substr(v);
+    }
+
+    request.body = data.substr(headerEnd + 4);
+    if (request.method != "POST") return 200;
+    if (request.headers.count("transfer-encoding") || !request.headers.count("content-length")) return 411;
+    size_t length = 0;
+    try {
+        length = static_cast<size_t>(std::stoull(request.headers["content-length"]));
+    }
+    catch (const std::exception&) {
+        return 400;
+    }
+    if (length > maxBody) return 413;
+    if (lower(request.headers["expect"]) == "100-continue" && request.body.size() < length) {
+        static const char kContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        if (!sendAll(s, kContinue, sizeof(kContinue) - 1)) return 0;
+    }
+    request.body.reserve(length);
+    while (request.body.size() < length) {
+        const int got = static_cast<int>(::recv(s, chunk, static_cast<int>(std::min(sizeof(chunk), length - request.body.size())), 0));
+        if (got <= 0) return 0;
+        request.body.append(chunk, static_cast<size_t>(got));
+    }
+    request.body.resize(length);
+    return 200;
+}
+
+} // namespace
+
+void ResizeService::serve(intptr_t client) {
+    const SocketHandle s = static_cast<SocketHandle>(client);
+    HttpRequest http;
+    const int status = readRequest(s, opts.maxRequestBytes, http);
+    if (status == 0) {
+        closeSocket(s);
+        return;
+    }
+    if (status != 200) {
+        ResizeResponse refused = failure(status, statusText(status));
+        counters.record(refused, 0.0, http.body.size());
+        sendResponse(s, status, "text/plain", std::string(statusText(status)) + "\n");
+        closeSocket(s);
+        return;
+    }
+
+    if (http.path == "/resize") {
+        if (http.method != "POST") {
+            sendResponse(s, 405, "text/plain", "POST an image to /resize\n", "Allow: POST\r\n");
+        } else {
+            ResizeRequest request;
+            request.body = std::move(http.body);
+            auto param = [&](const char* name, std::string& value) {
+                auto it = http.query.find(name);
+                if (it != http.query.end()) value = it->second;
+            };
+            param("width", request.width);
+            param("height", request.height);
+            param("method", request.method);
+            param("precision", request.precision);
+            param("energy", request.energy);
+            param("function", request.energyFunction);
+            param("format", request.format);
+            std::string seamMap, quality, timeout;
+            param("seammap", seamMap);
+            param("quality", quality);
+            param("timeout_ms", timeout);
+            request.seamMap = seamMap == "1" || seamMap == "true";
+            request.carveQuality = quality.empty() ? 1.0 : std::min(1.0, std::max(0.0, std::atof(quality.c_str())));
+            request.timeoutMs = timeout.empty() ? 0.0 : std::atof(timeout.c_str());
+
+            ResizeResponse response = resize(request);
+            if (response.status == 200) {
+                std::ostringstream headers;
+                headers << "X-Cache: " << response.cache << "\r\n"
+                        << "X-Queue-Ms: " << response.queueMs << "\r\n"
+                        << "X-Carve-Ms: " << response.carveMs << "\r\n";
+                sendResponse(s, 200, response.contentType, response.body, headers.str());
+            } else {
+                sendResponse(s, response.status, "text/plain", response.error + "\n",
+                             response.status == 503 ? "Retry-After: 1\r\n" : "");
+            }
+        }
+    }
+    else if (http.method != "GET") {
+        sendResponse(s, 405, "text/plain", "Method not allowed\n", "Allow: GET\r\n");
+    }
+    else if (http.path == "/metrics") {
+        sendResponse(s, 200, "text/plain; version=0.0.4", exposition());
+    }
+    else if (http.path == "/stats") {
+        sendResponse(s, 200, "application/json", counters.json());
+    }
+    else if (http.path == "/") {
+        sendResponse(s, 200, "text/html; charset=utf-8", kDashboard);
+    }
+    else if (http.path == "/healthz") {
+        sendResponse(s, 200, "text/plain", "ok\n");
+    }
+    else {
+        sendResponse(s, 404, "text/plain", "Not found\n");
+    }
+    closeSocket(s);
+}
+
+void ResizeService::run() {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        throw std::runtime_error("Could not initialise Winsock.");
+    }
+#endif
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* addresses = nullptr;
+    const std::string port = std::to_string(opts.port);
+    if (getaddrinfo(opts.host.empty() ? nullptr : opts.host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        throw std::runtime_error("Could not resolve " + opts.host + ":" + port);
+    }
+    SocketHandle server = kNoSocket;
+    for (addrinfo* a = addresses; a && server == kNoSocket; a = a->ai_next) {
+        server = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (server == kNoSocket) continue;
+        const int yes = 1;
+        setsockopt(server, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&yes), sizeof(yes));
+        if (::bind(server, a->ai_addr, static_cast<int>(a->ai_addrlen)) != 0 || ::listen(server, 128) != 0) {
+            closeSocket(server);
+            server = kNoSocket;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (server == kNoSocket) {
+        throw std::runtime_error("Could not listen on " + opts.host + ":" + port);
+    }
+
+    serving = true;
+    std::unique_ptr<MetricsFileWriter> metricsFile;
+    if (!opts.metricsFile.empty()) {
+        metricsFile = std::make_unique<MetricsFileWriter>([this] { return exposition(); }, opts.metricsFile,
+                                                          opts.metricsIntervalMs, opts.logger);
+    }
+    {
+        // Connections wait for a free handler; past a few per handler they
+        // are refused right away, so a flood cannot pile up sockets
+        // Declared first: ~ThreadPool runs the queued handlers, which use it
+        std::atomic<unsigned> waiting{ 0 };
+        ThreadPool handlers(std::max(opts.connections, 1u));
+        const unsigned maxWaiting = 4 * handlers.size();
+        while (serving) {
+            // Wake up regularly to notice stop()
+            fd_set ready;
+            FD_ZERO(&ready);
+            FD_SET(server, &ready);
+            timeval tick = { 0, 200 * 1000 };
+            if (select(static_cast<int>(server) + 1, &ready, nullptr, nullptr, &tick) <= 0) continue;
+            SocketHandle client = ::accept(server, nullptr, nullptr);
+            if (client == kNoSocket) continue;
+#ifdef _WIN32
+            DWORD timeout = 30 * 1000;
+#else
+            timeval timeout = { 30, 0 };
+#endif
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+            if (waiting >= maxWaiting) {
+                sendResponse(client, 503, "text/plain", "Too many connections\n", "Retry-After: 1\r\n");
+                closeSocket(client);
+                continue;
+            }
+            waiting++;
+            handlers.submit([this, client, &waiting] {
+                waiting--;
+                serve(static_cast<intptr_t>(client));
+            });
+        }
+    }
+    closeSocket(server);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void ResizeService::stop() {
+    serving = false;
+}
@@ -0,0 +1,207 @@
+#ifndef SEAM_SERVICE_H
+#define SEAM_SERVICE_H
+
+#include "CarveCache.h"
+#include "SeamCarver.h"
+#include "SeamMetrics.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Settings of ResizeService and its HTTP front end.
+ */
+struct ServiceOptions {
+    std::string host = "0.0.0.0";
+    int port = 8080;
+    unsigned workers = 0;                   // carving threads; 0: one per core
+    unsigned connections = 32;              // requests read and answered at once
+    size_t memoryBudget = size_t(1) << 30;  // working set of the jobs in flight
+    int smallPixels = 512 * 512;            // jobs up to this size are batched
+    int batchSize = 8;                      // small jobs one worker takes at a time
+    int queueTimeoutMs = 5000;              // wait for the budget before 503
+    double maxScale = 2.0;                  // largest target side over the source side; above: 400
+    size_t maxPixels = 100'000'000;         // largest source, from its header; above: 413
+    size_t maxRequestBytes = size_t(64) << 20;
+    size_t cacheBytes = CarveCache::kDefaultMemoryBudget;
+    std::string cacheDir;                   // empty: memory cache only
+    std::string metricsFile;                // also dump /metrics here; empty: no file
+    int metricsIntervalMs = 10000;
+    SeamLogger logger;                      // metrics file errors; none: silent
+};
+
+/**
+ * @brief One resize: an encoded image and the carving settings, named as in
+ * the CLI (seam_cli --help).
+ */
+struct ResizeRequest {
+    std::string body;                // encoded source image
+    std::string width = "100%";      // "640" or "60%"
+    std::string height = "100%";
+    std::string method = "dp";       // dp | greedy | pyramid | graph
+    std::string precision = "double";
+    std::string energy = "backward";
+    std::string energyFunction = "sobel";
+    std::string format = "png";      // encoding of the result: png | jpg | jpeg | webp | bmp
+    bool seamMap = false;            // dp: build and reuse a seam map of the source
+    double carveQuality = 1.0;       // below 1: hybrid scale + carve (not with seamMap)
+    double timeoutMs = 0.0;          // 0: none
+};
+
+/**
+ * @brief Result of ResizeService::resize. status is an HTTP status code;
+ * on success body is the encoded result.
+ */
+struct ResizeResponse {
+    int status = 200;
+    std::string contentType;
+    std::string body;
+    std::string error;
+    std::string cache = "miss";      // hit | seammap | miss
+    int width = 0;
+    int height = 0;
+    double queueMs = 0.0;
+    double carveMs = 0.0;
+};
+
+/**
+ * @brief Request counters and latency percentiles of a ResizeService,
+ * exported as the Prometheus text format and as JSON for the dashboard.
+ * All calls are thread-safe.
+ */
+class ServiceMetrics {
+public:
+    // Latencies kept for the percentiles: the most recent requests
+    static constexpr size_t kLatencyWindow = 4096;
+    // Seconds of throughput history of the dashboard
+    static constexpr int kRateSeconds = 60;
+
+    ServiceMetrics();
+
+    void record(const ResizeResponse& response, double totalMs, size_t bytesIn);
+    void recordBatch(size_t jobs);
+
+    // Gauges, set by the service
+    std::atomic<long long> queuedJobs{ 0 };
+    std::atomic<long long> inFlightBytes{ 0 };
+    std::atomic<long long> budgetBytes{ 0 };
+
+    std::string prometheus() const;
+    std::string json() const;
+
+private:
+    struct Window {
+        std::vector<double> values;
+        size_t next = 0;
+        void add(double v);
+        double percentile(double p) const;
+    };
+
+    mutable std::mutex mutex;
+    std::chrono::steady_clock::time_point start;
+    std::map<int, long long> byStatus;
+    long long cacheHits = 0;
+    long long seamMapHits = 0;
+    long long bytesIn = 0;
+    long long bytesOut = 0;
+    long long pixelsOut = 0;
+    long long batches = 0;
+    long long batchedJobs = 0;
+    Window total;
+    Window queue;
+    Window carve;
+    // Requests completed in each of the last kRateSeconds seconds
+    std::vector<long long> perSecond;
+    long long lastSecond = 0;
+};
+
+/**
+ * @brief Resize service on the seamcarver library.
+ *
+ * resize() reads the size of a request's image from its header and admits
+ * it once the estimated working set of all jobs in flight
+ * (BatchScheduler::workingSet, scaled up to the target size when that is
+ * larger) fits the memory budget; only then is the image decoded. A request
+ * that waits longer than the queue timeout is refused with 503 instead, one
+ * whose target exceeds maxScale times a source side with 400, and one over
+ * maxPixels with 413. Admitted jobs queue for a fixed pool of workers. A
+ * worker takes up to batchSize small jobs at once and carves them back to
+ * back with one SeamCarver, whose scratch planes are then sized once per
+ * batch; large jobs are carved one at a time.
+ *
+ * Results are cached by source hash and settings (CarveCache). With
+ * seamMap a DP request builds a seam index map of the source down to its
+ * target, and later requests for any size the map covers are rendered from
+ * it without carving.
+ *
+ * run() serves HTTP/1.1 on host:port:
+ *  - POST /resize?width=&height=&method=&precision=&energy=&function=
+ *    &format=&seammap=1&quality=&timeout_ms= with the image as the body
+ *  - GET /metrics (Prometheus: the request metrics and CarveMetrics),
+ *    /stats (JSON), / (dashboard), /healthz
+ */
+class ResizeService {
+public:
+    explicit ResizeService(const ServiceOptions& options);
+    ~ResizeService();
+
+    ResizeService(const ResizeService&) = delete;
+    ResizeService& operator=(const ResizeService&) = delete;
+
+    /**
+     * @brief Carve one request on the worker pool, blocking the calling
+     * thread until it is done or refused.
+     */
+    ResizeResponse resize(const ResizeRequest& request);
+
+    /**
+     * @brief Serve HTTP until stop(). Throws std::runtime_error if the
+     * socket cannot be bound.
+     */
+    void run();
+
+    // @brief Make run() return; safe from a signal handler's thread.
+    void stop();
+
+    const ServiceMetrics& metrics() const { return counters; }
+    const CarveMetrics& carveMetrics() const { return carving; }
+
+    // @brief The Prometheus exposition of /metrics, with fresh gauges.
+    std::string exposition();
+
+private:
+    struct Job;
+
+    void serve(intptr_t client);
+    void workerLoop(size_t index);
+    void carve(SeamCarver& carver, Job& job);
+    bool admit(size_t bytes, double timeoutMs);
+    void release(size_t bytes);
+
+    ServiceOptions opts;
+    CarveCache cache;
+    ServiceMetrics counters;
+    CarveMetrics carving;
+
+    std::mutex mutex;
+    std::condition_variable jobReady;    // workers: a job was queued
+    std::condition_variable budgetFreed; // resize(): bytes were released
+    std::deque<Job*> jobs;
+    size_t inFlight = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+    std::vector<size_t> workspaceBytes;  // per worker, under mutex
+
+    std::atomic<bool> serving{ false };
+};
+
+#endif // SEAM_SERVICE_H
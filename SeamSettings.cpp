@@ -0,0 +1,58 @@
+#include "SeamSettings.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+int parseDimension(const std::string& spec, int original) {
+    size_t used = 0;
+    double value = std::stod(spec, &used);
+    if (used < spec.size() && spec.substr(used) == "%") {
+        value = original * value / 100.0;
+    }
+    else if (used != spec.size()) {
+        throw std::runtime_error("Invalid size: " + spec);
+    }
+    if (!(value < std::numeric_limits<int>::max())) {
+        throw std::runtime_error("Size out of range: " + spec);
+    }
+    return std::max(1, (int)std::lround(value));
+}
+
+EnergyPrecision parsePrecision(const std::string& name) {
+    if (name == "double") return EnergyPrecision::Double;
+    if (name == "float") return EnergyPrecision::Float;
+    if (name == "fixed16") return EnergyPrecision::Fixed16;
+    throw std::runtime_error("Unknown precision: " + name);
+}
+
+EnergyModel parseEnergyModel(const std::string& name) {
+    if (name == "backward") return EnergyModel::Backward;
+    if (name == "forward") return EnergyModel::Forward;
+    throw std::runtime_error("Unknown energy model: " + name);
+}
+
+EnergyFunction parseEnergyFunction(const std::string& name) {
+    if (name == "sobel") return EnergyFunction::Sobel;
+    if (name == "scharr") return EnergyFunction::Scharr;
+    if (name == "dual") return EnergyFunction::DualGradient;
+    if (name == "l1") return EnergyFunction::L1Gradient;
+    if (name == "saliency") return EnergyFunction::Saliency;
+    if (name == "fast") return EnergyFunction::FastSobel;
+    throw std::runtime_error("Unknown energy function: " + name);
+}
+
+SeamOrder parseSeamOrder(const std::string& name) {
+    if (name == "width") return SeamOrder::WidthFirst;
+    if (name == "optimal") return SeamOrder::Optimal;
+    if (name == "cheapest") return SeamOrder::Cheapest;
+    throw std::runtime_error("Unknown seam order: " + name);
+}
+
+SeamStrategy parseStrategy(const std::string& name) {
+    if (name == "dp") return SeamStrategy::DP;
+    if (name == "greedy") return SeamStrategy::Greedy;
+    if (name == "pyramid") return SeamStrategy::Pyramid;
+    if (name == "graph") return SeamStrategy::GraphCut;
+    throw std::runtime_error("Unknown method: " + name);
+}
@@ -0,0 +1,21 @@
+#ifndef SEAM_SETTINGS_H
+#define SEAM_SETTINGS_H
+
+#include "SeamCarver.h"
+#include <string>
+
+// Parsers of the carving settings by the names of seam_cli --help, shared
+// by the CLI and seam_service. Each throws std::runtime_error on an
+// unknown name.
+
+// @brief "640" -> 640 px, "60%" -> 60% of original; at least 1, and below
+// INT_MAX.
+int parseDimension(const std::string& spec, int original);
+
+EnergyPrecision parsePrecision(const std::string& name);   // double | float | fixed16
+EnergyModel parseEnergyModel(const std::string& name);     // backward | forward
+EnergyFunction parseEnergyFunction(const std::string& name);  // sobel | scharr | dual | l1 | saliency | fast
+SeamOrder parseSeamOrder(const std::string& name);         // width | optimal | cheapest
+SeamStrategy parseStrategy(const std::string& name);       // dp | greedy | pyramid | graph
+
+#endif // SEAM_SETTINGS_H
@@ -0,0 +1,139 @@
+#ifndef SEAM_STATS_H
+#define SEAM_STATS_H
+
+#include "SeamTrace.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Per-phase counters and timers (SeamCarver::stats). Set to 0 from CMake
+// (SEAMCARVER_STATS=OFF) to compile every timer out.
+#ifndef SEAMCARVER_STATS
+#define SEAMCARVER_STATS 1
+#endif
+
+/**
+ * @brief Hot-path phases timed by SeamCarver.
+ *  - Gray:          toGray
+ *  - Energy:        full energy maps and incremental patches
+ *  - DPForward:     cost table fill of the DP finders; greedy, pyramid,
+ *                   graph and fused searches count their whole search here
+ *  - Backtrack:     seam recovery from a DP cost table
+ *  - Removal:       seam removal from any plane
+ *  - TextureUpload: GUI only, image upload to the GPU
+ */
+enum class SeamPhase {
+    Gray,
+    Energy,
+    DPForward,
+    Backtrack,
+    Removal,
+    TextureUpload,
+    Count
+};
+
+struct PhaseStats {
+    uint64_t calls = 0;
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+};
+
+/**
+ * @brief Memory accounting of SeamCarver's resize calls.
+ *  - peakBytes:      most bytes held at once by the working planes (image,
+ *                    gray, energy, cost table) and the seam workspaces,
+ *                    sampled after every carving step
+ *  - allocations:    operator new calls on the calling thread during the
+ *                    calls, and allocatedBytes their bytes; only counted
+ *                    when HeapCount.cpp is linked (heapCounted). OpenCV
+ *                    allocates cv::Mat pixels with its own allocator, so
+ *                    plane buffers show in peakBytes rather than here
+ *  - removalBytes:   bytes moved or copied by seam removal
+ *  - transposeBytes: bytes copied by plane transposes
+ */
+struct MemoryStats {
+    size_t peakBytes = 0;
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+    uint64_t removalBytes = 0;
+    uint64_t transposeBytes = 0;
+    bool heapCounted = false;
+};
+
+/**
+ * @brief Heap allocations made so far on the calling thread. Counted by
+ * the replacement operator new of HeapCount.cpp; without it the counters
+ * stay zero and heapCountingLinked() is false.
+ */
+struct HeapCounter {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+HeapCounter& threadHeapCounter();
+bool heapCountingLinked();
+void setHeapCountingLinked();
+
+struct SeamCarverStats {
+    static constexpr int kPhases = static_cast<int>(SeamPhase::Count);
+
+    PhaseStats phases[kPhases];
+    MemoryStats memory;
+    SeamTrace* trace = nullptr;  // not owned; phases also go here as spans
+
+    const PhaseStats& operator[](SeamPhase p) const { return phases[static_cast<int>(p)]; }
+    PhaseStats& operator[](SeamPhase p) { return phases[static_cast<int>(p)]; }
+
+    void record(SeamPhase p, double ms) {
+        PhaseStats& s = (*this)[p];
+        s.calls++;
+        s.totalMs += ms;
+        if (ms > s.maxMs) s.maxMs = ms;
+    }
+
+    // Zeroes the counters and keeps the trace
+    void reset() {
+        SeamTrace* keep = trace;
+        *this = SeamCarverStats();
+        trace = keep;
+    }
+
+    static const char* name(SeamPhase p) {
+        static const char* const names[kPhases] = {
+            "Gray", "Energy", "DP forward", "Backtrack", "Removal", "Texture upload"
+        };
+        return names[static_cast<int>(p)];
+    }
+};
+
+#if SEAMCARVER_STATS
+// Adds the lifetime of the scope to one phase; no-op for a null target
+class ScopedPhaseTimer {
+public:
+    ScopedPhaseTimer(SeamCarverStats* stats, SeamPhase phase)
+        : stats(stats), phase(phase), start(std::chrono::steady_clock::now()) {}
+    ~ScopedPhaseTimer() {
+        if (stats) {
+            const auto end = std::chrono::steady_clock::now();
+            stats->record(phase, std::chrono::duration<double, std::milli>(end - start).count());
+            if (stats->trace) stats->trace->span(SeamCarverStats::name(phase), "phase", start, end);
+        }
+    }
+    ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+    ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+private:
+    SeamCarverStats* stats;
+    SeamPhase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define SEAM_PHASE_CONCAT2(a, b) a##b
+#define SEAM_PHASE_CONCAT(a, b) SEAM_PHASE_CONCAT2(a, b)
+// Time the rest of the enclosing scope as phase of *stats
+#define SEAM_PHASE(stats, phase) \
+    ScopedPhaseTimer SEAM_PHASE_CONCAT(seamPhaseTimer, __LINE__)((stats), SeamPhase::phase)
+#else
+#define SEAM_PHASE(stats, phase) ((void)(stats))
+#endif
+
+#endif // SEAM_STATS_H
@@ -0,0 +1,199 @@
+#include "SeamStream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Cumulative cost type per energy depth, as in SeamCarver's DP
+template <typename T> struct StreamCost { typedef T type; };
+// Streamed images can be taller than SeamCarver::kMaxFixedSeamLength rows
+template <> struct StreamCost<ushort> { typedef long long type; };
+
+template <typename Acc>
+Acc infinity() {
+    return std::numeric_limits<Acc>::has_infinity ? std::numeric_limits<Acc>::infinity()
+                                                  : std::numeric_limits<Acc>::max();
+}
+
+// Cost row i from the previous one; both are padded with an infinite
+// sentinel on each side, so row[1 + j] is column j
+template <typename T, typename Acc>
+void costRow(const T* energy, const Acc* prev, Acc* cur, int cols) {
+    for (int j = 0; j < cols; j++) {
+        cur[j + 1] = energy[j] + std::min(std::min(prev[j], prev[j + 1]), prev[j + 2]);
+    }
+}
+
+template <typename T, typename Acc>
+void firstCostRow(const T* energy, Acc* cur, int cols) {
+    for (int j = 0; j < cols; j++) cur[j + 1] = static_cast<Acc>(energy[j]);
+}
+
+} // namespace
+
+StreamCarver::StreamCarver(const MappedImage& image, int rowsPerStrip)
+    : source(image),
+      // Header over the first mapped row: settings only, never carved
+      seamCarver(const_cast<uchar*>(image.row(0)), image.cols(), 1,
+                 static_cast<size_t>(image.cols()) * image.channels(), image.channels() == 3 ? CV_8UC3 : CV_8UC1),
+      stripRows(std::max(1, rowsPerStrip)),
+      cols(image.cols()),
+      removed(image.rows()) {
+}
+
+// Row r of the carved image: the source row without its removed columns
+void StreamCarver::carvedRow(int r, uchar* dst, bool bgr) const {
+    const int cn = source.channels();
+    const uchar* src = source.row(r);
+    auto copy = [&](int c0, int c1) {
+        if (!bgr || cn == 1) {
+            std::memcpy(dst, src + c0 * cn, static_cast<size_t>(c1 - c0) * cn);
+            dst += (c1 - c0) * cn;
+            return;
+        }
+        for (int c = c0; c < c1; c++, dst += 3) {
+            dst[0] = src[c * 3 + 2];  // RGB in the file, BGR in OpenCV
+            dst[1] = src[c * 3 + 1];
+            dst[2] = src[c * 3];
+        }
+    };
+    int c0 = 0;
+    for (int c : removed[r]) {
+        copy(c0, c);
+        c0 = c + 1;
+    }
+    copy(c0, source.cols());
+}
+
+cv::Mat StreamCarver::readRows(int r0, int r1) const {
+    cv::Mat rows(r1 - r0, cols, source.channels() == 3 ? CV_8UC3 : CV_8UC1);
+    for (int r = r0; r < r1; r++) carvedRow(r, rows.ptr<uchar>(r - r0), true);
+    return rows;
+}
+
+// Energy of carved rows [r0, r1) at depth. The gray strip gets a one-row
+// halo on each side that is not an image border, so the rows match the
+// energy of the whole carved image exactly. A Fixed16 search falls back to
+// Float for every strip once its longest one is too long for CV_16U, while
+// the carver does so only for the long strips: their short ones are scaled
+// back here.
+cv::Mat StreamCarver::strip(int r0, int r1, int depth) {
+    const int h0 = std::max(0, r0 - 1);
+    const int h1 = std::min(height(), r1 + 1);
+    cv::Mat energy = seamCarver.calculateEnergyFromGray(seamCarver.toGray(readRows(h0, h1)));
+    if (energy.depth() == CV_16U && depth == CV_32F) {
+        energy.convertTo(energy, CV_32F, 1.0 / SeamCarver::kFixedEnergyScale);
+    }
+    if (energy.depth() != depth) {
+        throw std::runtime_error("Streamed energy strip of an unexpected depth.");
+    }
+    return energy.rowRange(r0 - h0, r1 - h0);
+}
+
+template <typename T>
+std::vector<int> StreamCarver::findSeam() {
+    typedef typename StreamCost<T>::type Acc;
+    const int rows = height();
+    const int strips = (rows + stripRows - 1) / stripRows;
+    const size_t rowLength = static_cast<size_t>(cols) + 2;
+
+    // Forward pass: keep the last cost row of every strip
+    std::vector<Acc> checkpoints(strips * rowLength, infinity<Acc>());
+    std::vector<Acc> prev(rowLength, infinity<Acc>());
+    std::vector<Acc> cur(rowLength, infinity<Acc>());
+    for (int s = 0; s < strips; s++) {
+        const int r0 = s * stripRows;
+        const int r1 = std::min(rows, r0 + stripRows);
+        cv::Mat energy = strip(r0, r1, cv::DataType<T>::depth);
+        for (int r = r0; r < r1; r++) {
+            const T* e = energy.ptr<T>(r - r0);
+            if (r == 0) firstCostRow(e, cur.data(), cols);
+            else costRow(e, prev.data(), cur.data(), cols);
+            std::swap(prev, cur);
+        }
+        std::copy(prev.begin(), prev.end(), checkpoints.begin() + s * rowLength);
+    }
+
+    // Backtrack with backtrackDP's tie-breaking (seamParentOffset). Each
+    // strip's cost rows are recomputed from the checkpoint above it.
+    std::vector<int> seam(rows);
+    const Acc* last = checkpoints.data() + (strips - 1) * rowLength + 1;
+    int j = seamEndIndex(last, cols);
+    std::vector<Acc> table(static_cast<size_t>(stripRows) * rowLength, infinity<Acc>());
+    for (int s = strips - 1; s >= 0; s--) {
+        const int r0 = s * stripRows;
+        const int r1 = std::min(rows, r0 + stripRows);
+        cv::Mat energy = strip(r0, r1, cv::DataType<T>::depth);
+        const Acc* above = s > 0 ? checkpoints.data() + (s - 1) * rowLength : nullptr;
+        for (int r = r0; r < r1; r++) {
+            Acc* row = table.data() + (r - r0) * rowLength;
+            const T* e = energy.ptr<T>(r - r0);
+            if (r == 0) firstCostRow(e, row, cols);
+            else costRow(e, r == r0 ? above : row - rowLength, row, cols);
+        }
+        for (int r = r1 - 1; r >= r0; r--) {
+            seam[r] = j;
+            if (r == 0) break;
+            const Acc* p = (r == r0 ? above : table.data() + (r - 1 - r0) * rowLength) + 1;
+            j += seamParentOffset(p[j - 1], p[j], p[j + 1]);
+        }
+    }
+    return seam;
+}
+
+void StreamCarver::removeSeam(const std::vector<int>& seam) {
+    for (int r = 0; r < height(); r++) {
+        // Column of the carved row -> column of the source row
+        std::vector<int>& gone = removed[r];
+        int c = seam[r];
+        auto it = gone.begin();
+        for (; it != gone.end() && *it <= c; ++it) c++;
+        gone.insert(it, c);
+    }
+    cols--;
+}
+
+int StreamCarver::removeVerticalSeams(int count, const ProgressCallback& progress, const CancelToken* cancel) {
+    if (seamCarver.getEnergyFunction() == EnergyFunction::Saliency) {
+        throw std::runtime_error("Streaming carving needs a per-pixel energy function (saliency is global).");
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const int total = std::max(0, std::min(count, cols - 1));
+    for (int k = 0; k < total; k++) {
+        std::vector<int> seam;
+        // Gray strips (with their halo) longer than kMaxFixedSeamLength on
+        // either side get Float maps from the carver
+        const bool fixed = std::max(cols, std::min(height(), stripRows + 2)) <= SeamCarver::kMaxFixedSeamLength;
+        switch (seamCarver.getPrecision()) {
+        case EnergyPrecision::Float: seam = findSeam<float>(); break;
+        case EnergyPrecision::Fixed16: seam = fixed ? findSeam<ushort>() : findSeam<float>(); break;
+        case EnergyPrecision::Double:
+        default: seam = findSeam<double>(); break;
+        }
+        removeSeam(seam);
+        if (progress) {
+            CarveProgress p;
+            p.seamsDone = k + 1;
+            p.seamsTotal = total;
+            p.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            progress(p);
+        }
+        if (cancel && cancel->cancelled() && k + 1 < total) {
+            throw CarveCancelled();
+        }
+    }
+    return total;
+}
+
+void StreamCarver::save(const std::string& path) const {
+    NetpbmWriter out(path, cols, height(), source.channels());
+    std::vector<uchar> row(static_cast<size_t>(cols) * source.channels());
+    for (int r = 0; r < height(); r++) {
+        carvedRow(r, row.data(), false);
+        out.writeRow(row.data());
+    }
+    out.finish();
+}
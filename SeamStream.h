@@ -0,0 +1,76 @@
+#ifndef SEAM_STREAM_H
+#define SEAM_STREAM_H
+
+#include "SeamCarver.h"
+#include "SeamMap.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Width reduction of a memory-mapped image in row strips.
+ *
+ * The pixels stay in the mapping. Each seam is a backward-energy DP over
+ * the carved image streamed one strip at a time: the energy of one strip
+ * (with a one-row halo), the cost row carried between strips and one
+ * checkpoint cost row per strip. The backtrack then recomputes the strips
+ * bottom up from their checkpoints. Only the removed columns of every row
+ * stay resident, so peak memory is O(W * stripRows + W * H / stripRows +
+ * seams * H) rather than two or three copies of the image.
+ *
+ * Seams are the ones findVerticalSeamDP finds on the image in memory,
+ * for every energy function except the (global) saliency weighting.
+ */
+class StreamCarver {
+public:
+    static constexpr int kDefaultStripRows = 256;
+
+    /**
+     * @param source image to carve; must outlive the carver
+     * @param stripRows rows streamed per strip (at least 1)
+     */
+    explicit StreamCarver(const MappedImage& source, int stripRows = kDefaultStripRows);
+
+    // @brief Energy settings (precision, energy function, energy threads).
+    // Its own image is a one-row header and is not carved.
+    SeamCarver& carver() { return seamCarver; }
+    const SeamCarver& carver() const { return seamCarver; }
+
+    int width() const { return cols; }
+    int height() const { return source.rows(); }
+
+    /**
+     * @brief Remove count vertical seams, or fewer once the width is 1.
+     * progress is reported and cancel checked after every seam; on
+     * CarveCancelled the seams removed so far stay removed.
+     * @return number of seams removed
+     */
+    int removeVerticalSeams(int count, const ProgressCallback& progress = ProgressCallback(),
+                            const CancelToken* cancel = nullptr);
+
+    // @brief Carved rows [r0, r1) as CV_8UC3 (BGR) or CV_8UC1.
+    cv::Mat readRows(int r0, int r1) const;
+
+    /**
+     * @brief Write the carved image as a binary PPM/PGM, row by row from
+     * the mapping. Throws std::runtime_error if the file cannot be written.
+     */
+    void save(const std::string& path) const;
+
+    // @brief Columns of the source removed from row r, ascending.
+    const std::vector<int>& removedColumns(int r) const { return removed[r]; }
+
+private:
+    template <typename T>
+    std::vector<int> findSeam();
+    void carvedRow(int r, uchar* dst, bool bgr) const;
+    cv::Mat strip(int r0, int r1, int depth);
+    void removeSeam(const std::vector<int>& seam);
+
+    const MappedImage& source;
+    SeamCarver seamCarver;
+    int stripRows;
+    int cols;
+    std::vector<std::vector<int>> removed;  // per row, ascending source columns
+};
+
+#endif // SEAM_STREAM_H
@@ -0,0 +1,363 @@
+// Self-checking tests of the seamcarver library, one ctest case each:
+//   seam_tests <case>   runs one case
+//   seam_tests          runs them all
+// A failed check throws std::runtime_error; the exit status is non-zero.
+#include "SeamCarver.h"
+#include "SeamDecode.h"
+#include "SeamStats.h"
+#include "SeamStream.h"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+#define SEAM_CHECK(cond) check((cond), #cond, __LINE__)
+
+void check(bool ok, const char* what, int line) {
+    if (!ok) throw std::runtime_error("line " + std::to_string(line) + ": " + what);
+}
+
+// Banded, textured BGR test image; a fixed LCG keeps it the same everywhere
+cv::Mat syntheticImage(int rows, int cols, uint32_t seed) {
+    cv::Mat img(rows, cols, CV_8UC3);
+    uint32_t state = seed;
+    for (int r = 0; r < rows; r++) {
+        cv::Vec3b* row = img.ptr<cv::Vec3b>(r);
+        for (int c = 0; c < cols; c++) {
+            state = state * 1664525u + 1013904223u;
+            const int band = ((r / 7 + c / 5) % 3) * 60;
+            row[c] = cv::Vec3b(static_cast<uchar>(band + (state >> 24) % 40), static_cast<uchar>(r * 3 % 256),
+                               static_cast<uchar>(band + (state >> 16) % 90));
+        }
+    }
+    return img;
+}
+
+// Double energy of a seam
+double seamCost(const cv::Mat& energy, const std::vector<int>& seam, bool vertical) {
+    double sum = 0.0;
+    for (size_t k = 0; k < seam.size(); k++) {
+        const int i = static_cast<int>(k);
+        sum += vertical ? energy.at<double>(i, seam[k]) : energy.at<double>(seam[k], i);
+    }
+    return sum;
+}
+
+// Float and Fixed16 seams are optimal seams of the Double map up to their
+// rounding: Float's relative error, and half a Fixed16 step per pixel on
+// both the found and the optimal seam. Most are the very same seam.
+void testPrecisionEquivalence() {
+    const cv::Size sizes[] = { cv::Size(48, 32), cv::Size(97, 61), cv::Size(160, 120) };
+    int same = 0;
+    int total = 0;
+    for (const cv::Size& size : sizes) {
+        for (uint32_t seed = 1; seed <= 4; seed++) {
+            const cv::Mat img = syntheticImage(size.height, size.width, seed);
+            SeamCarver carver(img);
+            const cv::Mat reference = carver.calculateEnergy(img);
+            for (bool vertical : { true, false }) {
+                auto find = [&](const cv::Mat& energy) {
+                    return vertical ? carver.findVerticalSeamDP(energy) : carver.findHorizontalSeamDP(energy);
+                };
+                const std::vector<int> best = find(reference);
+                const double optimal = seamCost(reference, best, vertical);
+                const double length = static_cast<double>(best.size());
+                for (EnergyPrecision precision : { EnergyPrecision::Float, EnergyPrecision::Fixed16 }) {
+                    carver.setPrecision(precision);
+                    const std::vector<int> seam = find(carver.calculateEnergy(img));
+                    carver.setPrecision(EnergyPrecision::Double);
+                    const double slack = precision == EnergyPrecision::Float ? optimal * 1e-5
+                                                                             : length / SeamCarver::kFixedEnergyScale;
+                    SEAM_CHECK(seam.size() == best.size());
+                    SEAM_CHECK(seamCost(reference, seam, vertical) <= optimal + slack);
+                    same += seam == best;
+                    total++;
+                }
+            }
+        }
+    }
+    SEAM_CHECK(same * 4 >= total * 3);
+}
+
+// Fixed16 falls back to Float where its CV_32S cost could overflow
+void testFixedCostGuard() {
+    const int length = SeamCarver::kMaxFixedSeamLength + 1;
+    SeamCarver carver(syntheticImage(2, 2, 1));
+    carver.setPrecision(EnergyPrecision::Fixed16);
+    SEAM_CHECK(carver.calculateEnergy(syntheticImage(2, 8, 1)).depth() == CV_16U);
+    SEAM_CHECK(carver.calculateEnergy(syntheticImage(2, length, 1)).depth() == CV_32F);
+
+    bool threw = false;
+    try {
+        carver.findHorizontalSeamDP(cv::Mat(2, length, CV_16U, cv::Scalar(65535)));
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    SEAM_CHECK(threw);
+}
+
+bool sameImage(const cv::Mat& a, const cv::Mat& b) {
+    if (a.size() != b.size() || a.type() != b.type()) return false;
+    for (int r = 0; r < a.rows; r++) {
+        if (std::memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()) != 0) return false;
+    }
+    return true;
+}
+
+// Every finder and precision carves a full-height remove stripe first,
+// even with a flat (zero energy) region to the left of it
+void testMaskedCarve() {
+    cv::Mat img = syntheticImage(30, 40, 7);
+    img.colRange(0, 12).setTo(cv::Scalar(90, 90, 90));
+    const int first = 20;
+    const int width = 3;
+    cv::Mat remove(img.size(), CV_8UC1, cv::Scalar(0));
+    remove.colRange(first, first + width).setTo(cv::Scalar(255));
+    cv::Mat expected;
+    cv::hconcat(img.colRange(0, first), img.colRange(first + width, img.cols), expected);
+
+    for (SeamStrategy strategy : { SeamStrategy::DP, SeamStrategy::GraphCut }) {
+        for (EnergyPrecision precision : { EnergyPrecision::Double, EnergyPrecision::Fixed16 }) {
+            SeamCarver carver(img);
+            carver.setMask(cv::Mat(), remove);
+            ResizeOptions options = carver.resizeOptions(img.cols - width, img.rows, strategy);
+            options.precision = precision;
+            SEAM_CHECK(sameImage(carver.resize(options), expected));
+        }
+    }
+}
+
+// Vertical bands of flat color and a flat block: integer energies with
+// ties between most seams
+cv::Mat bandedImage(int rows, int cols) {
+    cv::Mat img(rows, cols, CV_8UC3);
+    for (int c = 0; c < cols; c++) {
+        const uchar v = static_cast<uchar>((c / 9) % 3 * 60);
+        img.col(c).setTo(cv::Scalar(v, 255 - v, v / 2));
+    }
+    img(cv::Rect(cols / 3, rows / 4, cols / 3, rows / 2)).setTo(cv::Scalar(30, 30, 30));
+    return img;
+}
+
+// Every backend follows the one tie-breaking rule (seamParentOffset,
+// seamEndIndex): the DP in both storage modes, split over threads and
+// bidirectional, the fused DP, the graph solvers and the streaming carver
+// return the same seam on a tie-heavy image. Wide enough for the threaded
+// DP's column chunks.
+void testTieBreaking() {
+    const cv::Mat img = bandedImage(24, 2 * SeamCarver::kMinDPChunkColumns + 40);
+    const fs::path ppm = fs::temp_directory_path() / "seam_tests_tie_breaking.ppm";
+    SEAM_CHECK(cv::imwrite(ppm.string(), img));
+    for (EnergyPrecision precision : { EnergyPrecision::Double, EnergyPrecision::Fixed16 }) {
+        SeamCarver carver(img);
+        carver.setPrecision(precision);
+        const cv::Mat energy = carver.calculateEnergy(img);
+        const std::vector<int> vertical = carver.findVerticalSeamDP(energy);
+        const std::vector<int> horizontal = carver.findHorizontalSeamDP(energy);
+        auto expectSame = [&](const char* backend, const std::vector<int>& v, const std::vector<int>& h) {
+            if (v != vertical || (!h.empty() && h != horizontal)) {
+                throw std::runtime_error(std::string(backend) + " breaks a tie differently");
+            }
+        };
+
+        SeamCarver backpointers(img);
+        backpointers.setPrecision(precision);
+        backpointers.setDPStorage(DPStorage::Backpointers);
+        expectSame("backpointer dp", backpointers.findVerticalSeamDP(energy),
+                   backpointers.findHorizontalSeamDP(energy));
+
+        SeamCarver threaded(img);
+        threaded.setPrecision(precision);
+        threaded.setDPThreads(2);
+        expectSame("threaded dp", threaded.findVerticalSeamDP(energy), threaded.findHorizontalSeamDP(energy));
+        threaded.setBidirectionalDP(true);
+        expectSame("bidirectional dp", threaded.findVerticalSeamDP(energy), threaded.findHorizontalSeamDP(energy));
+
+        const cv::Mat gray = carver.toGray(img);
+        expectSame("fused dp", carver.findVerticalSeamFusedDP(gray), carver.findHorizontalSeamFusedDP(gray));
+
+        for (GraphSolver solver : { GraphSolver::Dijkstra, GraphSolver::DagRelaxation, GraphSolver::AStar }) {
+            SeamCarver graph(img);
+            graph.setPrecision(precision);
+            graph.setGraphSolver(solver);
+            expectSame("graph", graph.findVerticalSeamGraphCut(energy), graph.findHorizontalSeamGraphCut(energy));
+        }
+
+        const MappedImage mapped(ppm.string());
+        StreamCarver stream(mapped, 5);
+        stream.carver().setPrecision(precision);
+        stream.removeVerticalSeams(1);
+        std::vector<int> streamed(img.rows);
+        for (int r = 0; r < img.rows; r++) streamed[r] = stream.removedColumns(r).front();
+        expectSame("stream", streamed, {});
+    }
+    fs::remove(ppm);
+}
+
+// GraphCut with incrementalDP repairs the distance labels the last seam
+// changed; its seams are those of a full DagRelaxation search, flat
+// (tied) regions included
+void testGraphCutIncremental() {
+    cv::Mat img = syntheticImage(40, 64, 11);
+    img(cv::Rect(8, 0, 16, 40)).setTo(cv::Scalar(120, 120, 120));
+    for (EnergyPrecision precision : { EnergyPrecision::Double, EnergyPrecision::Fixed16 }) {
+        cv::Mat carved[2];
+        for (bool incremental : { false, true }) {
+            SeamCarver carver(img);
+            carver.setSmallImagePath(false);
+            carver.setGraphSolver(GraphSolver::DagRelaxation);
+            ResizeOptions options = carver.resizeOptions(img.cols - 20, img.rows, SeamStrategy::GraphCut);
+            options.precision = precision;
+            options.incrementalDP = incremental;
+            carved[incremental] = carver.resize(options);
+        }
+        SEAM_CHECK(sameImage(carved[0], carved[1]));
+    }
+}
+
+// Heap allocations of a width-only resize by seams, in a fresh carver
+uint64_t resizeAllocations(const cv::Mat& img, int seams, const std::function<void(SeamCarver&, ResizeOptions&)>& setup) {
+    SeamCarver carver(img);
+    carver.setSmallImagePath(false);
+    ResizeOptions options = carver.resizeOptions(img.cols - seams, img.rows, SeamStrategy::DP);
+    setup(carver, options);
+    const uint64_t before = threadHeapCounter().allocations;
+    carver.resize(options);
+    return threadHeapCounter().allocations - before;
+}
+
+// Single-threaded carves allocate nothing per seam once warm: six more
+// seams cost no more allocations than the first few
+void testSteadyStateAllocations() {
+    SEAM_CHECK(heapCountingLinked());
+    const cv::Mat img = syntheticImage(64, 96, 5);
+    cv::Mat protect(img.size(), CV_8UC1, cv::Scalar(0));
+    protect.colRange(40, 50).setTo(cv::Scalar(255));
+    typedef std::function<void(SeamCarver&, ResizeOptions&)> Setup;
+    const std::vector<std::pair<const char*, Setup>> configs = {
+        { "fused dp", [](SeamCarver&, ResizeOptions&) {} },
+        { "map dp", [](SeamCarver&, ResizeOptions& o) { o.incrementalEnergy = true; } },
+        { "incremental dp", [](SeamCarver&, ResizeOptions& o) { o.incrementalDP = true; } },
+        { "forward dp", [](SeamCarver&, ResizeOptions& o) { o.energyModel = EnergyModel::Forward; } },
+        { "fixed16 dp", [](SeamCarver&, ResizeOptions& o) { o.precision = EnergyPrecision::Fixed16; } },
+        { "masked dp", [&](SeamCarver& c, ResizeOptions&) { c.setMask(protect, cv::Mat()); } },
+        { "greedy", [](SeamCarver&, ResizeOptions& o) { o.strategy = SeamStrategy::Greedy; } },
+        { "graph cut", [](SeamCarver&, ResizeOptions& o) { o.strategy = SeamStrategy::GraphCut; } },
+    };
+    for (const auto& config : configs) {
+        const uint64_t warm = resizeAllocations(img, 4, config.second);
+        const uint64_t longer = resizeAllocations(img, 10, config.second);
+        if (longer != warm) {
+            throw std::runtime_error(std::string(config.first) + ": " + std::to_string(longer - warm) +
+                                     " allocations in 6 steady-state seams");
+        }
+    }
+}
+
+// The message of the std::runtime_error fn throws, empty if none
+std::string errorOf(const std::function<void()>& fn) {
+    try {
+        fn();
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+
+// removeObject clears the remove mask; a stall blames the protect mask
+// only when one is set
+void testObjectRemoval() {
+    const cv::Mat img = syntheticImage(30, 40, 3);
+    cv::Mat remove(img.size(), CV_8UC1, cv::Scalar(0));
+    remove(cv::Rect(10, 8, 6, 5)).setTo(cv::Scalar(255));
+    for (EnergyPrecision precision : { EnergyPrecision::Double, EnergyPrecision::Fixed16 }) {
+        SeamCarver carver(img);
+        carver.setPrecision(precision);
+        carver.setMask(cv::Mat(), remove);
+        carver.removeObject();
+        SEAM_CHECK(carver.getMask().remainingRemove() == 0);
+    }
+
+    // One marked pixel inside a protected ring: every seam through it
+    // crosses the ring twice
+    cv::Mat dot(img.size(), CV_8UC1, cv::Scalar(0));
+    dot.at<uchar>(15, 20) = 255;
+    cv::Mat ring(img.size(), CV_8UC1, cv::Scalar(0));
+    ring(cv::Rect(19, 14, 3, 3)).setTo(cv::Scalar(255));
+    ring.at<uchar>(15, 20) = 0;
+    SeamCarver walled(img);
+    walled.setMask(ring, dot);
+    SEAM_CHECK(errorOf([&] { walled.removeObject(); }) == "Object removal is blocked by the protect mask.");
+
+    SeamCarver everything(img);
+    everything.setMask(cv::Mat(), cv::Mat(img.size(), CV_8UC1, cv::Scalar(255)));
+    SEAM_CHECK(errorOf([&] { everything.removeObject(); }) == "Object removal would remove the whole image.");
+}
+
+// Header sizes match the decoded image for every format the service takes
+void testEncodedHeader() {
+    const cv::Mat img = syntheticImage(21, 34, 5);
+    for (const char* ext : { ".png", ".jpg", ".bmp" }) {
+        std::vector<uchar> bytes;
+        SEAM_CHECK(cv::imencode(ext, img, bytes));
+        const std::string data(bytes.begin(), bytes.end());
+        EncodedHeader header;
+        SEAM_CHECK(readEncodedHeader(data, header));
+        SEAM_CHECK(header.width == img.cols && header.height == img.rows);
+        SEAM_CHECK(header.channels >= img.channels());
+        SEAM_CHECK(!readEncodedHeader(data.substr(0, 12), header));
+    }
+    EncodedHeader header;
+    SEAM_CHECK(!readEncodedHeader("not an image", header));
+}
+
+struct TestCase {
+    const char* name;
+    std::function<void()> run;
+};
+
+const std::vector<TestCase>& testCases() {
+    static const std::vector<TestCase> cases = {
+        { "precision_equivalence", testPrecisionEquivalence },
+        { "fixed_cost_guard", testFixedCostGuard },
+        { "masked_carve", testMaskedCarve },
+        { "object_removal", testObjectRemoval },
+        { "steady_state_allocations", testSteadyStateAllocations },
+        { "graph_cut_incremental", testGraphCutIncremental },
+        { "tie_breaking", testTieBreaking },
+        { "encoded_header", testEncodedHeader },
+    };
+    return cases;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string only = argc > 1 ? argv[1] : "";
+    int failed = 0;
+    bool found = false;
+    for (const TestCase& test : testCases()) {
+        if (!only.empty() && only != test.name) continue;
+        found = true;
+        try {
+            test.run();
+            std::cout << "ok   " << test.name << std::endl;
+        } catch (const std::exception& e) {
+            std::cout << "FAIL " << test.name << ": " << e.what() << std::endl;
+            failed++;
+        }
+    }
+    if (!found) {
+        std::cerr << "Unknown test case: " << only << std::endl;
+        return 2;
+    }
+    return failed == 0 ? 0 : 1;
+}
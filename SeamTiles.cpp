@@ -0,0 +1,138 @@
+#include "SeamTiles.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <exception>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+// [start, end) of part k of n equal parts of length, the first ones shorter
+cv::Range share(int length, int k, int n) {
+    return cv::Range(static_cast<int>(static_cast<long long>(length) * k / n),
+                     static_cast<int>(static_cast<long long>(length) * (k + 1) / n));
+}
+
+} // namespace
+
+TileCarver::TileCarver(unsigned threads)
+    : pool(std::make_unique<ThreadPool>(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))) {}
+
+TileCarver::~TileCarver() = default;
+
+unsigned TileCarver::threads() const {
+    return static_cast<unsigned>(pool->size());
+}
+
+cv::Mat TileCarver::carve(const cv::Mat& image, const ResizeOptions& options) {
+    if (options.height != image.rows) {
+        throw std::runtime_error("Tiled carving only reduces the width; the height must stay " +
+                                 std::to_string(image.rows) + ".");
+    }
+    if (options.width < 1 || options.width > image.cols) {
+        throw std::runtime_error("Tiled carving needs a width between 1 and " + std::to_string(image.cols) + ".");
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const int sourceWidth = image.cols;
+    const int newWidth = options.width;
+    const int seams = sourceWidth - newWidth;
+    tileRanges.clear();
+    if (seams == 0) return image;
+
+    const int count = std::max(1, std::min(tiles > 0 ? tiles : static_cast<int>(threads()), newWidth / kMinTileWidth));
+    // Every carved tile holds half a strip at each inner edge, and a strip
+    // removes the seams of its share of the width, at most half its columns
+    int half = count > 1 ? std::max(0, std::min(overlap, newWidth / count / 2 - 1)) : 0;
+    const int stripSeams =
+        half > 0 ? std::min(half, static_cast<int>(static_cast<long long>(seams) * 2 * half / sourceWidth)) : 0;
+    if (stripSeams == 0) half = 0;
+    const int tileSeams = seams - (count - 1) * stripSeams;
+
+    // One carver per tile or strip on a pool thread; the rest of the
+    // settings come from options
+    ResizeOptions settings = options;
+    settings.energyThreads = 1;
+    settings.dpThreads = 1;
+    settings.progress = ProgressCallback();
+    auto carvePart = [&settings](const cv::Mat& part, int width) {
+        SeamCarver carver(part);
+        ResizeOptions o = settings;
+        o.width = width;
+        o.height = part.rows;
+        return carver.resize(o);
+    };
+    int seamsDone = 0;
+    auto report = [&](int done) {
+        seamsDone += done;
+        if (!options.progress) return;
+        CarveProgress p;
+        p.seamsDone = seamsDone;
+        p.seamsTotal = seams;
+        p.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        options.progress(p);
+    };
+
+    // Pass 1: every tile carved on its own, then stitched
+    std::vector<cv::Mat> carved(count);
+    std::vector<int> removed(count);
+    std::vector<std::future<void>> tasks;
+    for (int k = 0; k < count; k++) {
+        tileRanges.push_back(share(sourceWidth, k, count));
+        const cv::Range seamShare = share(tileSeams, k, count);
+        removed[k] = seamShare.end - seamShare.start;
+        tasks.push_back(pool->submit([&, k] {
+            // The copy keeps the tile's rows contiguous for its carver
+            const cv::Mat tile = image.colRange(tileRanges[k]).clone();
+            carved[k] = carvePart(tile, tile.cols - removed[k]);
+        }));
+    }
+    for (int k = 0; k < count; k++) {
+        try {
+            tasks[k].get();
+        }
+        catch (...) {
+            // The other tiles reference image and carved until they are done
+            tasks.erase(tasks.begin(), tasks.begin() + k + 1);
+            pool->waitAll(tasks, std::current_exception());
+        }
+        report(removed[k]);
+    }
+
+    cv::Mat stitched(image.rows, newWidth + (count - 1) * stripSeams, image.type());
+    std::vector<int> edges(count + 1, 0);  // tile k spans [edges[k], edges[k + 1]) of stitched
+    for (int k = 0; k < count; k++) {
+        edges[k + 1] = edges[k] + carved[k].cols;
+        carved[k].copyTo(stitched.colRange(edges[k], edges[k + 1]));
+        carved[k].release();
+    }
+    if (half == 0) return stitched;
+
+    // Pass 2: a strip across every inner tile edge, carved in place of
+    // the columns it covers
+    std::vector<cv::Mat> strips(count - 1);
+    tasks.clear();
+    for (int k = 1; k < count; k++) {
+        tasks.push_back(pool->submit([&, k] {
+            const cv::Mat strip = stitched.colRange(edges[k] - half, edges[k] + half).clone();
+            strips[k - 1] = carvePart(strip, strip.cols - stripSeams);
+        }));
+    }
+    pool->waitAll(tasks);
+    report((count - 1) * stripSeams);
+
+    cv::Mat out(image.rows, newWidth, image.type());
+    int from = 0;  // next stitched column to copy
+    int to = 0;    // next output column
+    for (int k = 1; k < count; k++) {
+        const int gap = edges[k] - half - from;
+        stitched.colRange(from, from + gap).copyTo(out.colRange(to, to + gap));
+        to += gap;
+        strips[k - 1].copyTo(out.colRange(to, to + strips[k - 1].cols));
+        to += strips[k - 1].cols;
+        from = edges[k] + half;
+    }
+    stitched.colRange(from, stitched.cols).copyTo(out.colRange(to, newWidth));
+    return out;
+}
@@ -0,0 +1,81 @@
+#ifndef SEAM_TILES_H
+#define SEAM_TILES_H
+
+#include "SeamCarver.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief Width reduction of very wide or very large images (panoramas) in
+ * vertical tiles carved in parallel.
+ *
+ * The image is cut into tiles of about equal width, and every tile is
+ * carved on its own thread with its own SeamCarver, removing a share of
+ * the seams proportional to its width. Each tile's seams stay inside it,
+ * and its working set is the tile's, not the image's. The carved tiles
+ * are stitched side by side. A final pass then carves a strip of
+ * 2 * overlap columns centred on every seam between two tiles, again in
+ * parallel, so the columns along a tile edge can be removed as well. Strips
+ * are cut from the stitched image and never touch one another.
+ *
+ * Seams are no longer globally optimal: a seam cannot leave its tile or
+ * strip, and the energy at a tile edge is computed from the tile alone.
+ * In exchange the wall time scales with the tiles up to the core count.
+ */
+class TileCarver {
+public:
+    static constexpr int kDefaultOverlap = 64;
+    // Narrowest carved tile: fewer tiles are used below this
+    static constexpr int kMinTileWidth = 32;
+
+    /**
+     * @param threads carving threads (0: one per core)
+     */
+    explicit TileCarver(unsigned threads = 0);
+    ~TileCarver();
+
+    TileCarver(const TileCarver&) = delete;
+    TileCarver& operator=(const TileCarver&) = delete;
+
+    /**
+     * @brief Number of tiles (default 0: one per thread). Clamped so every
+     * carved tile keeps at least kMinTileWidth columns.
+     */
+    void setTiles(int count) { tiles = std::max(count, 0); }
+    int getTiles() const { return tiles; }
+
+    /**
+     * @brief Half-width of the boundary strips of the final pass (default
+     * kDefaultOverlap). 0 skips the pass. Narrowed to fit the carved tiles.
+     */
+    void setOverlap(int columns) { overlap = std::max(columns, 0); }
+    int getOverlap() const { return overlap; }
+
+    unsigned threads() const;
+
+    /**
+     * @brief Carve image to options.width columns. options.height must be
+     * image.rows: tiles only reduce the width. The other options are the
+     * settings of every tile's carver, each running single-threaded; the
+     * energy and DP thread counts are ignored. progress is called on the
+     * calling thread whenever a tile or strip is done, and cancel is
+     * checked by all of them between seams.
+     * Throws std::runtime_error for any other size and CarveCancelled
+     * if cancelled.
+     */
+    cv::Mat carve(const cv::Mat& image, const ResizeOptions& options);
+
+    // @brief Column ranges [first, last) of the source tiles of the last carve.
+    const std::vector<cv::Range>& lastTiles() const { return tileRanges; }
+
+private:
+    int tiles = 0;
+    int overlap = kDefaultOverlap;
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<cv::Range> tileRanges;
+};
+
+#endif // SEAM_TILES_H
@@ -0,0 +1,101 @@
+#include "SeamTrace.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+
+void writeString(std::ostream& os, const char* s) {
+    os << '"';
+    for (; *s; s++) {
+        const unsigned char c = static_cast<unsigned char>(*s);
+        if (c == '"' || c == '\\') {
+            os << '\\' << *s;
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            os << escaped;
+        } else {
+            os << *s;
+        }
+    }
+    os << '"';
+}
+
+} // namespace
+
+int SeamTrace::threadIndex() {
+    auto it = tids.emplace(std::this_thread::get_id(), static_cast<int>(tids.size()) + 1).first;
+    return it->second;
+}
+
+void SeamTrace::span(const char* name, const char* category, Clock::time_point start, Clock::time_point end,
+                     const Arg* args, int argCount) {
+    Event e;
+    e.name = name;
+    e.category = category;
+    e.startUs = std::chrono::duration<double, std::micro>(start - origin).count();
+    e.durationUs = std::chrono::duration<double, std::micro>(end - start).count();
+    e.argCount = std::min(argCount, kMaxArgs);
+    for (int k = 0; k < e.argCount; k++) e.args[k] = args[k];
+
+    std::lock_guard<std::mutex> lock(mutex);
+    e.tid = threadIndex();
+    events.push_back(e);
+}
+
+void SeamTrace::nameThread(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    threadNames[threadIndex()] = name;
+}
+
+size_t SeamTrace::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return events.size();
+}
+
+void SeamTrace::write(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    char number[32];
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& t : threadNames) {
+        os << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t.first
+           << ",\"args\":{\"name\":";
+        writeString(os, t.second.c_str());
+        os << "}}";
+        first = false;
+    }
+    for (const Event& e : events) {
+        os << (first ? "\n" : ",\n") << "{\"name\":";
+        writeString(os, e.name);
+        os << ",\"cat\":";
+        writeString(os, e.category);
+        std::snprintf(number, sizeof(number), "%.3f", e.startUs);
+        os << ",\"ph\":\"X\",\"ts\":" << number;
+        std::snprintf(number, sizeof(number), "%.3f", e.durationUs);
+        os << ",\"dur\":" << number << ",\"pid\":1,\"tid\":" << e.tid;
+        if (e.argCount > 0) {
+            os << ",\"args\":{";
+            for (int k = 0; k < e.argCount; k++) {
+                if (k) os << ',';
+                writeString(os, e.args[k].key);
+                os << ':' << e.args[k].value;
+            }
+            os << '}';
+        }
+        os << '}';
+        first = false;
+    }
+    os << "\n]}\n";
+}
+
+void SeamTrace::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::trunc);
+    write(out);
+    if (!out) {
+        throw std::runtime_error("Failed to write trace: " + path);
+    }
+}
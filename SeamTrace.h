@@ -0,0 +1,98 @@
+#ifndef SEAM_TRACE_H
+#define SEAM_TRACE_H
+
+#include <chrono>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Timeline of complete spans in the Chrome trace-event JSON format,
+ * for chrome://tracing and ui.perfetto.dev.
+ *
+ * Spans may be added from any thread; each thread gets its own track. Span
+ * names, categories and argument keys are not copied, so they must be
+ * string literals (or otherwise outlive the trace).
+ */
+class SeamTrace {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Arg {
+        const char* key = nullptr;
+        long long value = 0;
+    };
+    static constexpr int kMaxArgs = 3;
+
+    SeamTrace() : origin(Clock::now()) {}
+
+    SeamTrace(const SeamTrace&) = delete;
+    SeamTrace& operator=(const SeamTrace&) = delete;
+
+    void span(const char* name, const char* category, Clock::time_point start, Clock::time_point end,
+              const Arg* args = nullptr, int argCount = 0);
+
+    // @brief Label the calling thread's track.
+    void nameThread(const std::string& name);
+
+    size_t size() const;
+
+    // @brief Write the whole trace as one JSON object.
+    void write(std::ostream& os) const;
+
+    // @brief write() to a file; throws std::runtime_error when it fails.
+    void save(const std::string& path) const;
+
+private:
+    struct Event {
+        const char* name;
+        const char* category;
+        int tid;
+        double startUs;
+        double durationUs;
+        int argCount;
+        Arg args[kMaxArgs];
+    };
+
+    int threadIndex();  // called with mutex held
+
+    Clock::time_point origin;
+    mutable std::mutex mutex;
+    std::vector<Event> events;
+    std::map<std::thread::id, int> tids;
+    std::map<int, std::string> threadNames;
+};
+
+/**
+ * @brief Adds its own lifetime to a trace as one span; no-op for a null
+ * trace. Arguments set before the scope ends go into the span.
+ */
+class TraceSpan {
+public:
+    TraceSpan(SeamTrace* trace, const char* name, const char* category)
+        : trace(trace), name(name), category(category) {
+        if (trace) start = SeamTrace::Clock::now();
+    }
+    ~TraceSpan() {
+        if (trace) trace->span(name, category, start, SeamTrace::Clock::now(), args, argCount);
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void arg(const char* key, long long value) {
+        if (argCount < SeamTrace::kMaxArgs) args[argCount++] = { key, value };
+    }
+
+private:
+    SeamTrace* trace;
+    const char* name;
+    const char* category;
+    SeamTrace::Clock::time_point start;
+    SeamTrace::Arg args[SeamTrace::kMaxArgs];
+    int argCount = 0;
+};
+
+#endif // SEAM_TRACE_H
@@ -0,0 +1,443 @@
+#include "SeamVideo.h"
+#include "BoundedQueue.h"
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A frame of carveFile: BGR, or planes with setYuv
+struct QueuedFrame {
+    cv::Mat bgr;
+    YuvFrame yuv;
+    cv::Size size() const { return bgr.empty() ? yuv.y.size() : bgr.size(); }
+};
+
+// Calls fn with a value of the pixel type of an energy map's depth
+template <typename Fn>
+void byEnergyDepth(int depth, Fn&& fn) {
+    if (depth == CV_16U) fn(ushort());
+    else if (depth == CV_32F) fn(float());
+    else fn(double());
+}
+
+// Mean of the frames' energies over columns [c0, c1) of a row. The sums run
+// along the row, one frame at a time, so they vectorise over the pixels.
+template <typename T>
+void meanEnergyRow(const std::vector<const cv::Mat*>& maps, cv::Mat& mean, int row, int c0, int c1,
+                   std::vector<double>& sums) {
+    sums.assign(static_cast<size_t>(c1 - c0), 0.0);
+    for (const cv::Mat* map : maps) {
+        const T* in = map->ptr<T>(row) + c0;
+        for (int j = 0; j < c1 - c0; j++) sums[j] += in[j];
+    }
+    const double scale = 1.0 / maps.size();
+    T* out = mean.ptr<T>(row) + c0;
+    for (int j = 0; j < c1 - c0; j++) out[j] = cv::saturate_cast<T>(sums[j] * scale);
+}
+
+template <typename T>
+void meanEnergyAt(const std::vector<const cv::Mat*>& maps, cv::Mat& mean, int row, int col) {
+    double sum = 0.0;
+    for (const cv::Mat* map : maps) sum += map->at<T>(row, col);
+    mean.at<T>(row, col) = cv::saturate_cast<T>(sum / maps.size());
+}
+
+void meanEnergy(const std::vector<const cv::Mat*>& maps, cv::Mat& mean) {
+    const cv::Mat& first = *maps.front();
+    mean.create(first.size(), first.type());
+    std::vector<double> sums;
+    byEnergyDepth(first.depth(), [&](auto tag) {
+        typedef decltype(tag) T;
+        for (int i = 0; i < mean.rows; i++) meanEnergyRow<T>(maps, mean, i, 0, mean.cols, sums);
+    });
+}
+
+// Recompute the mean along a removed seam, over the band that
+// SeamCarver patches in each frame's energy: the columns (rows)
+// [min - 1, max] of the seam in the lines next to each line.
+void patchMeanEnergy(const std::vector<const cv::Mat*>& maps, cv::Mat& mean, const std::vector<int>& seam,
+                     bool vertical) {
+    const int lines = vertical ? mean.rows : mean.cols;
+    const int width = vertical ? mean.cols : mean.rows;
+    std::vector<double> sums;
+    byEnergyDepth(mean.depth(), [&](auto tag) {
+        typedef decltype(tag) T;
+        for (int i = 0; i < lines; i++) {
+            int lo = seam[i];
+            int hi = seam[i];
+            for (int r = std::max(0, i - 1); r <= std::min(lines - 1, i + 1); r++) {
+                lo = std::min(lo, seam[r]);
+                hi = std::max(hi, seam[r]);
+            }
+            lo = std::max(0, lo - 1);
+            hi = std::min(width - 1, hi);
+            if (vertical) {
+                meanEnergyRow<T>(maps, mean, i, lo, hi + 1, sums);
+            } else {
+                for (int r = lo; r <= hi; r++) meanEnergyAt<T>(maps, mean, r, i);
+            }
+        }
+    });
+}
+
+} // namespace
+
+YuvFrame bgrToYuv420(const cv::Mat& bgr) {
+    if (bgr.type() != CV_8UC3) {
+        throw std::runtime_error("4:2:0 conversion needs an 8-bit BGR frame.");
+    }
+    cv::Mat yuv;
+    cv::cvtColor(bgr, yuv, cv::COLOR_BGR2YUV);
+    std::vector<cv::Mat> planes;
+    cv::split(yuv, planes);
+    const cv::Size half((bgr.cols + 1) / 2, (bgr.rows + 1) / 2);
+    YuvFrame frame;
+    frame.y = planes[0];
+    cv::resize(planes[1], frame.u, half, 0, 0, cv::INTER_AREA);
+    cv::resize(planes[2], frame.v, half, 0, 0, cv::INTER_AREA);
+    return frame;
+}
+
+cv::Mat yuvToBgr(const YuvFrame& frame) {
+    if (frame.u.empty()) {
+        cv::Mat bgr;
+        cv::cvtColor(frame.y, bgr, cv::COLOR_GRAY2BGR);
+        return bgr;
+    }
+    std::vector<cv::Mat> planes(3);
+    planes[0] = frame.y;
+    for (int k = 1; k < 3; k++) {
+        const cv::Mat& chroma = k == 1 ? frame.u : frame.v;
+        if (chroma.size() == frame.y.size()) planes[k] = chroma;
+        else cv::resize(chroma, planes[k], frame.y.size(), 0, 0, cv::INTER_LINEAR);
+    }
+    cv::Mat yuv, bgr;
+    cv::merge(planes, yuv);
+    cv::cvtColor(yuv, bgr, cv::COLOR_YUV2BGR);
+    return bgr;
+}
+
+VideoCarver::VideoCarver(int newWidth, int newHeight)
+    // Settings only; frames are carved as they are passed in
+    : seamCarver(cv::Mat(1, 1, CV_8UC3, cv::Scalar::all(0))),
+      targetWidth(std::max(newWidth, 1)),
+      targetHeight(std::max(newHeight, 1)) {
+}
+
+void VideoCarver::resetTemporal() {
+    verticalSeams.clear();
+    horizontalSeams.clear();
+    previousSize = cv::Size();
+}
+
+// Remove count seams in one direction from every frame of block. Off
+// keyframes seam k is searched around seam k of the previous block, which
+// was found on planes of the same size. A block of one frame searches its
+// own energy; larger blocks search blockEnergy, the mean of theirs.
+void VideoCarver::carveSeams(std::vector<FramePlanes>& block, cv::Mat& blockEnergy, bool vertical, int count,
+                             bool keyframe) {
+    std::vector<PackedSeam>& seams = vertical ? verticalSeams : horizontalSeams;
+    seams.resize(count);
+    // Saliency is a global map, so it cannot be patched along the seam
+    const bool patch = seamCarver.isIncrementalEnergy() &&
+                       seamCarver.getEnergyFunction() != EnergyFunction::Saliency;
+    const bool shared = block.size() > 1;
+    std::vector<const cv::Mat*> maps;
+    for (const FramePlanes& f : block) maps.push_back(&f.energy);
+    cv::Mat& energy = shared ? blockEnergy : block[0].energy;
+    std::vector<int> seam;
+    for (int k = 0; k < count; k++) {
+        if (!keyframe) {
+            seams[k].unpack(seam);
+            seam = vertical ? seamCarver.findVerticalSeamInCorridor(energy, seam, corridor)
+                            : seamCarver.findHorizontalSeamInCorridor(energy, seam, corridor);
+            totals.corridorSeams++;
+        } else {
+            if (vertical) seamCarver.findVerticalSeamDP(energy, seam);
+            else seamCarver.findHorizontalSeamDP(energy, seam);
+            totals.fullSeams++;
+        }
+        seams[k] = PackedSeam(seam);
+        for (FramePlanes& f : block) {
+            if (vertical) {
+                if (!f.img.empty()) seamCarver.removeVerticalSeamInPlace(f.img, seam);
+                seamCarver.removeVerticalSeamInPlace(f.gray, seam);
+                if (patch) seamCarver.updateEnergyAfterVerticalSeamInPlace(f.energy, f.gray, seam);
+            } else {
+                if (!f.img.empty()) seamCarver.removeHorizontalSeamInPlace(f.img, seam);
+                seamCarver.removeHorizontalSeamInPlace(f.gray, seam);
+                if (patch) seamCarver.updateEnergyAfterHorizontalSeamInPlace(f.energy, f.gray, seam);
+            }
+            carveChroma(f, seam, vertical);
+            if (!patch) f.energy = seamCarver.calculateEnergyFromGray(f.gray);
+        }
+        if (!shared) continue;
+        if (patch) {
+            if (vertical) seamCarver.removeVerticalSeamInPlace(blockEnergy, seam);
+            else seamCarver.removeHorizontalSeamInPlace(blockEnergy, seam);
+            patchMeanEnergy(maps, blockEnergy, seam, vertical);
+        } else {
+            meanEnergy(maps, blockEnergy);
+        }
+    }
+}
+
+// Remove the projection of a luma seam, just removed from f.gray, from
+// the chroma planes, if their size calls for it
+void VideoCarver::carveChroma(FramePlanes& f, const std::vector<int>& seam, bool vertical) {
+    if (f.u.empty()) return;
+    const int shift = vertical ? f.chromaShiftX : f.chromaShiftY;
+    const int lineShift = vertical ? f.chromaShiftY : f.chromaShiftX;
+    const int luma = vertical ? f.gray.cols : f.gray.rows;
+    const int chroma = vertical ? f.u.cols : f.u.rows;
+    if (((luma + (1 << shift) - 1) >> shift) == chroma) return;
+    const int lines = vertical ? f.u.rows : f.u.cols;
+    std::vector<int> projected(lines);
+    for (int i = 0; i < lines; i++) {
+        const int first = i << lineShift;
+        const int last = std::min(static_cast<int>(seam.size()), (i + 1) << lineShift);
+        int at = seam[first];
+        for (int l = first + 1; l < last; l++) at = std::min(at, seam[l]);
+        projected[i] = std::min(at >> shift, chroma - 1);
+    }
+    for (cv::Mat* plane : { &f.u, &f.v }) {
+        if (vertical) seamCarver.removeVerticalSeamInPlace(*plane, projected);
+        else seamCarver.removeHorizontalSeamInPlace(*plane, projected);
+    }
+}
+
+cv::Mat VideoCarver::carveFrame(cv::Mat frame) {
+    return carveBlock({ std::move(frame) }).front();
+}
+
+std::vector<cv::Mat> VideoCarver::carveBlock(std::vector<cv::Mat> frames) {
+    if (frames.empty()) return frames;
+    const cv::Mat& first = frames.front();
+    for (const cv::Mat& frame : frames) {
+        if (frame.empty() || !SeamCarver::isSupportedImageType(frame.type())) {
+            throw std::runtime_error("Unsupported video frame: expected 8-bit, 16-bit or float pixels with 1, 3 or 4 channels.");
+        }
+        if (frame.size() != first.size() || frame.type() != first.type()) {
+            throw std::runtime_error("The frames of a block must share their size and type.");
+        }
+    }
+    std::vector<FramePlanes> block(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        FramePlanes& f = block[i];
+        f.img = frames[i];
+        f.gray = seamCarver.toGray(f.img);
+        if (f.gray.data == f.img.data) f.gray = f.gray.clone();  // carved separately from the frame
+    }
+    carvePlanes(block);
+    for (size_t i = 0; i < frames.size(); i++) frames[i] = block[i].img;
+    return frames;
+}
+
+YuvFrame VideoCarver::carveYuvFrame(YuvFrame frame) {
+    return carveYuvBlock({ std::move(frame) }).front();
+}
+
+std::vector<YuvFrame> VideoCarver::carveYuvBlock(std::vector<YuvFrame> frames) {
+    if (frames.empty()) return frames;
+    const YuvFrame& first = frames.front();
+    const cv::Size half((first.y.cols + 1) / 2, (first.y.rows + 1) / 2);
+    for (const YuvFrame& frame : frames) {
+        if (frame.y.empty() || frame.y.type() != CV_8UC1 || frame.u.empty() != frame.v.empty() ||
+            (!frame.u.empty() && (frame.u.type() != CV_8UC1 || frame.v.type() != CV_8UC1 ||
+                                  frame.u.size() != frame.v.size() ||
+                                  (frame.u.size() != frame.y.size() && frame.u.size() != half)))) {
+            throw std::runtime_error("Unsupported YUV frame: expected 8-bit planes, chroma 4:4:4 or 4:2:0.");
+        }
+        if (frame.y.size() != first.y.size() || frame.u.size() != first.u.size()) {
+            throw std::runtime_error("The frames of a block must share their size and type.");
+        }
+    }
+    // 4:2:0 chroma of a one-pixel side is the luma size; it is 4:4:4 there
+    const bool subsampled = !first.u.empty() && first.u.size() != first.y.size();
+    std::vector<FramePlanes> block(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        FramePlanes& f = block[i];
+        f.gray = frames[i].y;
+        f.u = frames[i].u;
+        f.v = frames[i].v;
+        f.chromaShiftX = f.chromaShiftY = subsampled ? 1 : 0;
+    }
+    carvePlanes(block);
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].y = block[i].gray;
+        frames[i].u = block[i].u;
+        frames[i].v = block[i].v;
+    }
+    return frames;
+}
+
+// Carve a checked block of frames of one size, gray set
+void VideoCarver::carvePlanes(std::vector<FramePlanes>& block) {
+    const cv::Size size = block.front().gray.size();
+    if (size.width < targetWidth || size.height < targetHeight) {
+        throw std::runtime_error("Video carving only reduces frames: " + std::to_string(size.width) + "x" +
+                                 std::to_string(size.height) + " is smaller than the output.");
+    }
+    // Seams of a frame of another size do not fit this one
+    const int count = static_cast<int>(block.size());
+    const bool keyframe = size != previousSize ||
+                          corridor == 0 || (keyframeInterval > 0 && sinceKeyframe >= keyframeInterval);
+    if (keyframe) {
+        sinceKeyframe = 0;
+        totals.keyframes += count;
+    }
+    previousSize = size;
+
+    std::vector<const cv::Mat*> maps;
+    for (FramePlanes& f : block) {
+        f.energy = seamCarver.calculateEnergyFromGray(f.gray);
+        maps.push_back(&f.energy);
+    }
+    cv::Mat blockEnergy;
+    if (count > 1) meanEnergy(maps, blockEnergy);
+    carveSeams(block, blockEnergy, true, size.width - targetWidth, keyframe);
+    carveSeams(block, blockEnergy, false, size.height - targetHeight, keyframe);
+    sinceKeyframe += count;
+    totals.frames += count;
+    totals.blocks++;
+}
+
+VideoCarveStats VideoCarver::carveFile(const std::string& input, const std::string& output,
+                                       const ProgressCallback& progress, const CancelToken* cancel) {
+    cv::VideoCapture capture(input);
+    if (!capture.isOpened()) {
+        throw std::runtime_error("Could not open video: " + input);
+    }
+    double fps = capture.get(cv::CAP_PROP_FPS);
+    if (fps <= 0.0) fps = 30.0;
+    const int codec = fourcc.size() == 4
+        ? cv::VideoWriter::fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3])
+        : static_cast<int>(capture.get(cv::CAP_PROP_FOURCC));
+    const int frameCount = std::max(0, static_cast<int>(capture.get(cv::CAP_PROP_FRAME_COUNT)));
+    cv::VideoWriter writer(output, codec, fps, cv::Size(targetWidth, targetHeight));
+    if (!writer.isOpened()) {
+        throw std::runtime_error("Could not open video for writing: " + output);
+    }
+
+    resetTemporal();
+    VideoCarveStats stats;
+    const VideoCarveStats before = totals;
+    const auto start = std::chrono::steady_clock::now();
+    BoundedQueue<QueuedFrame> decoded(queueFrames);
+    BoundedQueue<QueuedFrame> carved(queueFrames);
+
+    // Each stage time is written by its own thread and read after the joins
+    std::exception_ptr decodeError;
+    std::exception_ptr encodeError;
+    std::thread decoder([&] {
+        for (;;) {
+            const auto t0 = std::chrono::steady_clock::now();
+            QueuedFrame frame;  // a new buffer per frame: the last one is still queued
+            if (!capture.read(frame.bgr)) break;
+            if (yuv) {
+                try {
+                    frame.yuv = bgrToYuv420(frame.bgr);
+                }
+                catch (...) {
+                    decodeError = std::current_exception();
+                    break;
+                }
+                frame.bgr.release();
+            }
+            stats.decodeMs += msSince(t0);
+            if (!decoded.push(std::move(frame))) break;
+        }
+        decoded.close();
+    });
+    std::thread encoder([&] {
+        QueuedFrame frame;
+        while (carved.pop(frame)) {
+            const auto t0 = std::chrono::steady_clock::now();
+            try {
+                writer.write(frame.bgr.empty() ? yuvToBgr(frame.yuv) : frame.bgr);
+            }
+            catch (...) {
+                encodeError = std::current_exception();
+                decoded.close();
+                carved.close();
+                break;
+            }
+            stats.encodeMs += msSince(t0);
+        }
+    });
+    auto finish = [&] {
+        decoded.close();
+        carved.close();
+        decoder.join();
+        encoder.join();
+        writer.release();
+    };
+
+    // Carve the pending block and pass it on; false once the encoder stopped
+    std::vector<QueuedFrame> pending;
+    auto carveBlockOut = [&] {
+        const auto t0 = std::chrono::steady_clock::now();
+        std::vector<QueuedFrame> results(pending.size());
+        if (yuv) {
+            std::vector<YuvFrame> frames;
+            for (QueuedFrame& f : pending) frames.push_back(std::move(f.yuv));
+            frames = carveYuvBlock(std::move(frames));
+            for (size_t i = 0; i < frames.size(); i++) results[i].yuv = std::move(frames[i]);
+        } else {
+            std::vector<cv::Mat> frames;
+            for (QueuedFrame& f : pending) frames.push_back(std::move(f.bgr));
+            frames = carveBlock(std::move(frames));
+            for (size_t i = 0; i < frames.size(); i++) results[i].bgr = std::move(frames[i]);
+        }
+        pending.clear();
+        stats.carveMs += msSince(t0);
+        for (QueuedFrame& result : results) {
+            if (!carved.push(std::move(result))) return false;
+        }
+        const int done = totals.frames - before.frames;
+        if (progress) {
+            CarveProgress p;
+            p.seamsDone = done;
+            p.seamsTotal = frameCount;
+            p.elapsedMs = msSince(start);
+            progress(p);
+        }
+        if (cancel && cancel->cancelled() && (frameCount == 0 || done < frameCount)) {
+            throw CarveCancelled();
+        }
+        return true;
+    };
+
+    try {
+        QueuedFrame frame;
+        bool writing = true;
+        while (writing && decoded.pop(frame)) {
+            // A change of size ends the block early
+            if (!pending.empty() && frame.size() != pending.front().size()) writing = carveBlockOut();
+            pending.push_back(std::move(frame));
+            if (writing && static_cast<int>(pending.size()) >= blockFrames) writing = carveBlockOut();
+        }
+        if (writing && !pending.empty()) carveBlockOut();
+    }
+    catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+    if (decodeError) std::rethrow_exception(decodeError);
+    if (encodeError) std::rethrow_exception(encodeError);
+
+    stats.frames = totals.frames - before.frames;
+    stats.blocks = totals.blocks - before.blocks;
+    stats.keyframes = totals.keyframes - before.keyframes;
+    stats.corridorSeams = totals.corridorSeams - before.corridorSeams;
+    stats.fullSeams = totals.fullSeams - before.fullSeams;
+    stats.elapsedMs = msSince(start);
+    return stats;
+}
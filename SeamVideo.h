@@ -0,0 +1,212 @@
+#ifndef SEAM_VIDEO_H
+#define SEAM_VIDEO_H
+
+#include "SeamCarver.h"
+#include "SeamPack.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Timings and seam counts of VideoCarver::carveFile. The stage
+ * times are the busy time of each pipeline thread, so with the pipeline
+ * full elapsedMs approaches the largest of them rather than their sum.
+ */
+struct VideoCarveStats {
+    int frames = 0;
+    int blocks = 0;              // seam searches shared by a block of frames
+    int keyframes = 0;           // frames carved with the full DP
+    long long corridorSeams = 0; // seams searched around the previous frame's
+    long long fullSeams = 0;     // seams searched with the full DP
+    double decodeMs = 0.0;
+    double carveMs = 0.0;
+    double encodeMs = 0.0;
+    double elapsedMs = 0.0;
+};
+
+/**
+ * @brief Y'CbCr planes of a frame: 8-bit y at the frame size, and 8-bit u
+ * and v either at the same size (4:4:4) or at half the size rounded up
+ * (4:2:0). u and v may both be empty for a grey frame.
+ */
+struct YuvFrame {
+    cv::Mat y;
+    cv::Mat u;
+    cv::Mat v;
+};
+
+// @brief 4:2:0 planes of an 8-bit BGR frame; y is the BT.601 luma that
+// SeamCarver::toGray gives, the chroma is area-averaged.
+YuvFrame bgrToYuv420(const cv::Mat& bgr);
+
+// @brief 8-bit BGR frame of planes; subsampled chroma is scaled up bilinearly.
+cv::Mat yuvToBgr(const YuvFrame& frame);
+
+/**
+ * @brief Seam carving of video frames to one output size with temporal
+ * coherence.
+ *
+ * A keyframe is carved with the full backward-energy DP. Every later
+ * frame searches its k-th seam only in a corridor around the k-th seam of
+ * the frame before (SeamCarver::findVerticalSeamInCorridor), which is both
+ * cheaper, O(H * corridor) instead of O(W * H) per seam, and keeps the
+ * removed pixels from jumping between frames. A keyframe comes every
+ * keyframeInterval() frames so the seams can follow larger motion.
+ *
+ * With setBlockFrames(n) consecutive frames are carved as a block of n:
+ * the seams are searched once on the block's mean energy and the same
+ * seam is removed from every frame, a seam surface of the frames x rows
+ * volume that is straight in time. The search (and its corridor around
+ * the previous block's seams) is then paid once per block; only the
+ * energy of each frame, patched along the seam, stays per frame.
+ *
+ * Frames given as Y'CbCr planes (carveYuvFrame) are carved without a BGR
+ * image: the energy comes from y, which is the grey image a BGR frame is
+ * reduced to anyway, and the chroma planes lose each seam projected onto
+ * their grid. On 4:2:0 planes a seam moves 1.5 bytes a pixel instead of
+ * the 4 of a BGR frame and its grey copy.
+ *
+ * carveFile() reads frames with cv::VideoCapture on one thread, carves on
+ * the calling thread and encodes with cv::VideoWriter on a third, with a
+ * few frames queued between the stages.
+ */
+class VideoCarver {
+public:
+    static constexpr int kDefaultCorridor = 8;
+    static constexpr int kDefaultKeyframeInterval = 30;
+    static constexpr int kDefaultQueueFrames = 4;
+    static constexpr int kDefaultBlockFrames = 1;
+
+    /**
+     * @brief Carve frames to newWidth x newHeight. Frames must be at least
+     * that large: video carving only removes seams.
+     */
+    VideoCarver(int newWidth, int newHeight);
+
+    // @brief Energy settings (precision, energy function, incremental
+    // energy, energy and DP threads). Its own image is a placeholder.
+    SeamCarver& carver() { return seamCarver; }
+    const SeamCarver& carver() const { return seamCarver; }
+
+    int width() const { return targetWidth; }
+    int height() const { return targetHeight; }
+
+    /**
+     * @brief Half-width of the seam corridor of non-key frames (default
+     * kDefaultCorridor). 0 runs the full DP on every frame.
+     */
+    void setCorridor(int radius) { corridor = std::max(radius, 0); }
+    int getCorridor() const { return corridor; }
+
+    /**
+     * @brief Frames from one keyframe to the next (default
+     * kDefaultKeyframeInterval); 0 keys only the first frame.
+     */
+    void setKeyframeInterval(int frames) { keyframeInterval = std::max(frames, 0); }
+    int getKeyframeInterval() const { return keyframeInterval; }
+
+    /**
+     * @brief Frames of carveFile carved together with shared seams (default
+     * kDefaultBlockFrames, each frame on its own). A block ends early at a
+     * change of frame size or at the end of the video.
+     */
+    void setBlockFrames(int frames) { blockFrames = std::max(frames, 1); }
+    int getBlockFrames() const { return blockFrames; }
+
+    // @brief Frames queued between the pipeline stages of carveFile (at least 1).
+    void setQueueFrames(int frames) { queueFrames = std::max(frames, 1); }
+    int getQueueFrames() const { return queueFrames; }
+
+    // @brief Four-character codec of carveFile's output; empty keeps the input's.
+    void setFourcc(const std::string& code) { fourcc = code; }
+
+    /**
+     * @brief Carve carveFile's frames as 4:2:0 planes (default off). The
+     * capture and writer deal in BGR, so the decoder and encoder threads
+     * convert, off the carving thread.
+     */
+    void setYuv(bool on) { yuv = on; }
+    bool getYuv() const { return yuv; }
+
+    /**
+     * @brief Carve the next frame of the sequence (see isSupportedImageType),
+     * in place: the result is a view of frame's buffer. A frame of a
+     * different size than the one before starts a new keyframe. Throws
+     * std::runtime_error for a frame smaller than the output.
+     */
+    cv::Mat carveFrame(cv::Mat frame);
+
+    /**
+     * @brief Carve frames, the next frames of the sequence, with one set of
+     * seams for all of them (see setBlockFrames), each in place. The frames
+     * must share a size and type; throws std::runtime_error otherwise.
+     */
+    std::vector<cv::Mat> carveBlock(std::vector<cv::Mat> frames);
+
+    /**
+     * @brief carveFrame of planes (see YuvFrame), in place. The seams are
+     * the ones carveFrame finds on the BGR frame of the same luma. A
+     * subsampled chroma plane loses a column (row) with every second seam,
+     * at the seam's leftmost (topmost) pixel over the luma lines of each
+     * chroma line, halved, so it stays at half the luma size rounded up.
+     * Throws std::runtime_error for planes of other types or sizes.
+     */
+    YuvFrame carveYuvFrame(YuvFrame frame);
+
+    // @brief carveBlock of planes: one set of seams for all of the frames,
+    // which must share their plane sizes.
+    std::vector<YuvFrame> carveYuvBlock(std::vector<YuvFrame> frames);
+
+    // @brief Make the next frame a keyframe, e.g. at a scene cut.
+    void resetTemporal();
+
+    /**
+     * @brief Carve every frame of input into output at the input's frame
+     * rate. progress is reported with frames as its steps (seamsTotal is
+     * the container's frame count, 0 when unknown) and cancel is checked
+     * between frames; on CarveCancelled the frames carved so far are
+     * written. Throws std::runtime_error if a file cannot be opened.
+     */
+    VideoCarveStats carveFile(const std::string& input, const std::string& output,
+                              const ProgressCallback& progress = ProgressCallback(),
+                              const CancelToken* cancel = nullptr);
+
+    // @brief Counters of the frames carved since construction.
+    const VideoCarveStats& stats() const { return totals; }
+
+private:
+    // Planes of one frame of a block, carved in place
+    struct FramePlanes {
+        cv::Mat img;        // empty for a YuvFrame; gray is its y
+        cv::Mat gray;
+        cv::Mat energy;
+        cv::Mat u;
+        cv::Mat v;
+        int chromaShiftX = 0;  // log2 of the chroma subsampling
+        int chromaShiftY = 0;
+    };
+
+    void carvePlanes(std::vector<FramePlanes>& block);
+    void carveSeams(std::vector<FramePlanes>& block, cv::Mat& blockEnergy, bool vertical, int count,
+                    bool keyframe);
+    void carveChroma(FramePlanes& f, const std::vector<int>& seam, bool vertical);
+
+    SeamCarver seamCarver;
+    int targetWidth;
+    int targetHeight;
+    int corridor = kDefaultCorridor;
+    int keyframeInterval = kDefaultKeyframeInterval;
+    int queueFrames = kDefaultQueueFrames;
+    int blockFrames = kDefaultBlockFrames;
+    std::string fourcc;
+    bool yuv = false;
+
+    // Seams of the previous frame, in removal order, and its size
+    std::vector<PackedSeam> verticalSeams;
+    std::vector<PackedSeam> horizontalSeams;
+    cv::Size previousSize;
+    int sinceKeyframe = 0;
+    VideoCarveStats totals;
+};
+
+#endif // SEAM_VIDEO_H
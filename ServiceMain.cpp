@@ -0,0 +1,95 @@
+#include "SeamService.h"
+#include <csignal>
+#include <iostream>
+#include <string>
+
+// ============================================================================
+// seam_service: HTTP resize service on the seamcarver library
+// ============================================================================
+
+namespace {
+
+ResizeService* running = nullptr;
+
+void onSignal(int) {
+    if (running) running->stop();
+}
+
+void printUsage(std::ostream& os) {
+    os << "Usage: seam_service [options]\n"
+          "  --host <addr>           address to listen on (default 0.0.0.0)\n"
+          "  --port <n>              port (default 8080)\n"
+          "  --workers <n>           carving threads (default: one per core)\n"
+          "  --connections <n>       requests read and answered at once (default 32)\n"
+          "  --memory-mb <MB>        working set of the jobs in flight (default 1024);\n"
+          "                          requests wait for it, then get 503\n"
+          "  --queue-timeout-ms <ms> longest wait for the memory budget (default 5000)\n"
+          "  --max-scale <x>         largest target side as a multiple of the source's\n"
+          "                          (default 2); larger targets get 400\n"
+          "  --max-megapixels <n>    largest source image, read from its header before\n"
+          "                          decoding (default 100); larger ones get 413\n"
+          "  --small-pixels <n>      images up to n pixels are carved in batches\n"
+          "                          (default 262144)\n"
+          "  --batch <n>             small images one worker takes at a time (default 8)\n"
+          "  --max-request-mb <MB>   largest request body (default 64)\n"
+          "  --cache-mb <MB>         in-memory result and seam map cache (default 256)\n"
+          "  --cache-dir <dir>       also keep the cache on disk\n"
+          "  --metrics-file <file>   also write the /metrics exposition to file\n"
+          "  --metrics-interval-ms <ms>  how often (default 10000)\n"
+          "  --help                  show this help\n"
+          "Endpoints:\n"
+          "  POST /resize?width=<px|pct%>&height=<px|pct%>[&method=&precision=&energy=\n"
+          "       &function=&format=png|jpg|webp|bmp&seammap=1&quality=&timeout_ms=]\n"
+          "       body: image\n"
+          "  GET  /metrics (Prometheus), /stats (JSON), / (dashboard), /healthz\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    ServiceOptions opt;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--help") { printUsage(std::cout); return 0; }
+            else if (arg == "--host") opt.host = value();
+            else if (arg == "--port") opt.port = std::stoi(value());
+            else if (arg == "--workers") opt.workers = (unsigned)std::max(0, std::stoi(value()));
+            else if (arg == "--connections") opt.connections = (unsigned)std::max(1, std::stoi(value()));
+            else if (arg == "--memory-mb") opt.memoryBudget = (size_t)std::max(1, std::stoi(value())) << 20;
+            else if (arg == "--queue-timeout-ms") opt.queueTimeoutMs = std::max(0, std::stoi(value()));
+            else if (arg == "--max-scale") opt.maxScale = std::max(1.0, std::stod(value()));
+            else if (arg == "--max-megapixels") opt.maxPixels = (size_t)std::max(1, std::stoi(value())) * 1000000;
+            else if (arg == "--small-pixels") opt.smallPixels = std::max(0, std::stoi(value()));
+            else if (arg == "--batch") opt.batchSize = std::max(1, std::stoi(value()));
+            else if (arg == "--max-request-mb") opt.maxRequestBytes = (size_t)std::max(1, std::stoi(value())) << 20;
+            else if (arg == "--cache-mb") opt.cacheBytes = (size_t)std::max(0, std::stoi(value())) << 20;
+            else if (arg == "--cache-dir") opt.cacheDir = value();
+            else if (arg == "--metrics-file") opt.metricsFile = value();
+            else if (arg == "--metrics-interval-ms") opt.metricsIntervalMs = std::max(1, std::stoi(value()));
+            else {
+                std::cerr << "Unknown option: " << arg << "\n";
+                printUsage(std::cerr);
+                return 1;
+            }
+        }
+
+        opt.logger = streamLogger(std::cerr);
+        ResizeService service(opt);
+        running = &service;
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+        std::cerr << "seam_service listening on " << opt.host << ":" << opt.port << "\n";
+        service.run();
+        running = nullptr;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
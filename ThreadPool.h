@@ -0,0 +1,198 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed-size work-stealing pool of worker threads. The destructor
+ * finishes all queued tasks before joining.
+ *
+ * Tasks submitted from outside the pool are queued in FIFO order. A task
+ * submitted by a worker goes to that worker's own queue, which it runs
+ * newest first; idle workers steal the oldest task of a busy worker's queue
+ * before they start a new outside task. So work a running task splits off
+ * (the shares of a big image) spreads over the idle workers first, while
+ * independent jobs keep the others busy.
+ *
+ * A worker blocked in wait() runs the queued worker tasks meanwhile instead
+ * of idling, so tasks may wait for the tasks they submit without running
+ * out of threads.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Start the workers (at least one).
+     */
+    explicit ThreadPool(unsigned threadCount) {
+        if (threadCount == 0) threadCount = 1;
+        for (unsigned i = 0; i < threadCount; i++) {
+            local.push_back(std::make_unique<TaskQueue>());
+        }
+        for (unsigned i = 0; i < threadCount; i++) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queue a task; the future yields its result or exception.
+     */
+    template <typename Fn>
+    auto submit(Fn&& fn) -> std::future<decltype(fn())> {
+        typedef decltype(fn()) R;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<Fn>(fn));
+        std::future<R> result = task->get_future();
+        TaskQueue& queue = onWorker() ? *local[current().index] : outside;
+        // Counted before the push: a worker may take the task at once
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queued++;
+        }
+        try {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.emplace_back([task] { (*task)(); });
+        }
+        catch (...) {
+            queued--;
+            throw;
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    /**
+     * @brief future.get() of a task of this pool. On a worker thread the
+     * queued worker tasks are run until the result is ready.
+     */
+    template <typename R>
+    R wait(std::future<R>& future) {
+        if (onWorker()) {
+            const unsigned self = current().index;
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                std::function<void()> task;
+                // Nothing left to help with: the task is running elsewhere
+                if (!take(self, false, task)) break;
+                task();
+            }
+        }
+        return future.get();
+    }
+
+    /**
+     * @brief wait() for every future, then rethrow error if set, else the
+     * first exception of the tasks. Tasks that reference the caller's
+     * locals are all done before the caller unwinds.
+     */
+    void waitAll(std::vector<std::future<void>>& futures, std::exception_ptr error = nullptr) {
+        for (std::future<void>& f : futures) {
+            try {
+                wait(f);
+            }
+            catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+    // @brief Number of worker threads.
+    unsigned size() const { return static_cast<unsigned>(local.size()); }
+
+    // @brief Whether the calling thread is one of the workers.
+    bool onWorker() const { return current().pool == this; }
+
+    // @brief Index of the calling worker thread of this pool, -1 off the pool.
+    int workerIndex() const { return onWorker() ? static_cast<int>(current().index) : -1; }
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // The pool and index of the worker running on this thread, if any
+    struct WorkerId {
+        const ThreadPool* pool = nullptr;
+        unsigned index = 0;
+    };
+    static WorkerId& current() {
+        static thread_local WorkerId id;
+        return id;
+    }
+
+    static bool pop(TaskQueue& queue, bool newest, std::function<void()>& task) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        if (newest) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+
+    // Own queue newest first, then the other workers' oldest tasks, then
+    // (if outsideToo) the outside queue
+    bool take(unsigned self, bool outsideToo, std::function<void()>& task) {
+        const unsigned n = size();
+        bool found = pop(*local[self], true, task);
+        for (unsigned k = 1; !found && k < n; k++) {
+            found = pop(*local[(self + k) % n], false, task);
+        }
+        if (!found && outsideToo) found = pop(outside, false, task);
+        if (found) queued--;
+        return found;
+    }
+
+    void workerLoop(unsigned self) {
+        current().pool = this;
+        current().index = self;
+        for (;;) {
+            std::function<void()> task;
+            if (take(self, true, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            if (queued == 0) return;  // stopping and drained
+        }
+    }
+
+    std::vector<std::thread> workers;
+    // One per worker, all made before any worker starts
+    std::vector<std::unique_ptr<TaskQueue>> local;
+    TaskQueue outside;
+    // Tasks in all queues, or about to be pushed to one; raised under
+    // sleepMutex before the push, so no wake-up is lost and a take never
+    // lowers it below zero
+    std::atomic<size_t> queued{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+#endif // THREAD_POOL_H